@@ -2,10 +2,20 @@
 #define GOBLIN_ALGEBRA_HEADER
 
 #include <math.h>
+#include <string.h>
 // Windows defines these, but we'll use our own for portability
 #undef min
 #undef max
 
+// Define GOBLIN_DISABLE_SIMD to make the array kernels use plain floats
+#if !defined(GOBLIN_DISABLE_SIMD) && defined(__AVX__)
+	#include <immintrin.h>
+	#define GOBLIN_SIMD_AVX
+#elif !defined(GOBLIN_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#include <emmintrin.h>
+	#define GOBLIN_SIMD_SSE
+#endif
+
 namespace goblin {
 
 const float pi = 3.14159265f;
@@ -163,6 +173,29 @@ Matrix4x4 transformToMatrix4x4(const Transform& t);
 // Same result as inverse(transformToMatrix4x4(t)), but skips computing a matrix inverse
 Matrix4x4 transformToMatrix4x4Inverse(const Transform& t);
 
+/* Array versions of the functions they're named after, for processing many at once.
+They work on 8 elements at a time with AVX, 4 with SSE, and one at a time otherwise.
+Results match the single versions, apart from float rounding.
+Outputs can be the same arrays as inputs, except where noted. */
+void concatenateTransformsN(Transform* out_transforms, const Transform* parents, const Transform* children, unsigned int count);
+void transformsToMatrices4x4N(Matrix4x4* out_matrices, const Transform* transforms, unsigned int count);
+void nlerpQuaternionsN(Quaternion* out_quaternions, const Quaternion* a, const Quaternion* b, float t, unsigned int count);
+void lerpTransformsN(Transform* out_transforms, const Transform* a, const Transform* b, float t, unsigned int count);
+// out_matrices can be the same array as a, but not b
+void mat4MulN(Matrix4x4* out_matrices, const Matrix4x4* a, const Matrix4x4* b, unsigned int count);
+
+/* Compact encodings, for storing vertex data in fewer bytes */
+// IEEE 754 half precision floats, rounded to nearest. Values too big for a half become infinity.
+unsigned short floatToHalf(float x);
+float halfToFloat(unsigned short half);
+// Maps a unit vector onto an octahedron, unfolded onto the square from -1 to 1.
+// Two components are enough, and the error is spread much more evenly than with spherical coordinates.
+Vec2 encodeOctahedral(Vec3 unitVector);
+Vec3 decodeOctahedral(Vec2 encoded);
+// Signed normalized 16 bit integers, where -32767 is -1 and 32767 is 1
+short floatToSnorm16(float x);
+float snorm16ToFloat(short x);
+
 
 /* Implementation */
 
@@ -767,5 +800,405 @@ Transform concatenateTransforms(Transform parent, Transform child)
 	return result;
 }
 
+// Array kernels ==============================================================
+
+/* FloatLanes holds as many floats as the instruction set can work on at once.
+The kernels are written once on top of these, so the plain version is the same math. */
+#if defined(GOBLIN_SIMD_AVX)
+typedef __m256 FloatLanes;
+static const unsigned int floatLaneCount = 8;
+inline FloatLanes loadLanes(const float* f) { return _mm256_load_ps(f); }
+inline FloatLanes loadUnalignedLanes(const float* f) { return _mm256_loadu_ps(f); }
+inline void storeLanes(float* out_f, FloatLanes a) { _mm256_store_ps(out_f, a); }
+inline FloatLanes setLanes(float f) { return _mm256_set1_ps(f); }
+inline FloatLanes addLanes(FloatLanes a, FloatLanes b) { return _mm256_add_ps(a, b); }
+inline FloatLanes subtractLanes(FloatLanes a, FloatLanes b) { return _mm256_sub_ps(a, b); }
+inline FloatLanes multiplyLanes(FloatLanes a, FloatLanes b) { return _mm256_mul_ps(a, b); }
+inline FloatLanes divideLanes(FloatLanes a, FloatLanes b) { return _mm256_div_ps(a, b); }
+inline FloatLanes sqrtLanes(FloatLanes a) { return _mm256_sqrt_ps(a); }
+inline FloatLanes minLanes(FloatLanes a, FloatLanes b) { return _mm256_min_ps(a, b); }
+inline FloatLanes maxLanes(FloatLanes a, FloatLanes b) { return _mm256_max_ps(a, b); }
+// Negates the lanes of a where test is less than 0
+inline FloatLanes negateWhereNegative(FloatLanes a, FloatLanes test) {
+	FloatLanes isNegative = _mm256_cmp_ps(test, _mm256_setzero_ps(), _CMP_LT_OQ);
+	return _mm256_xor_ps(a, _mm256_and_ps(isNegative, _mm256_set1_ps(-0.0f)));
+}
+// Zeroes the lanes of a where test is 0
+inline FloatLanes zeroWhereZero(FloatLanes a, FloatLanes test) {
+	return _mm256_and_ps(a, _mm256_cmp_ps(test, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+}
+// Bit i is set where lane i of a is less than lane i of b
+inline unsigned int lessThanLanesMask(FloatLanes a, FloatLanes b) { return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+#elif defined(GOBLIN_SIMD_SSE)
+typedef __m128 FloatLanes;
+static const unsigned int floatLaneCount = 4;
+inline FloatLanes loadLanes(const float* f) { return _mm_load_ps(f); }
+inline FloatLanes loadUnalignedLanes(const float* f) { return _mm_loadu_ps(f); }
+inline void storeLanes(float* out_f, FloatLanes a) { _mm_store_ps(out_f, a); }
+inline FloatLanes setLanes(float f) { return _mm_set1_ps(f); }
+inline FloatLanes addLanes(FloatLanes a, FloatLanes b) { return _mm_add_ps(a, b); }
+inline FloatLanes subtractLanes(FloatLanes a, FloatLanes b) { return _mm_sub_ps(a, b); }
+inline FloatLanes multiplyLanes(FloatLanes a, FloatLanes b) { return _mm_mul_ps(a, b); }
+inline FloatLanes divideLanes(FloatLanes a, FloatLanes b) { return _mm_div_ps(a, b); }
+inline FloatLanes sqrtLanes(FloatLanes a) { return _mm_sqrt_ps(a); }
+inline FloatLanes minLanes(FloatLanes a, FloatLanes b) { return _mm_min_ps(a, b); }
+inline FloatLanes maxLanes(FloatLanes a, FloatLanes b) { return _mm_max_ps(a, b); }
+inline FloatLanes negateWhereNegative(FloatLanes a, FloatLanes test) {
+	return _mm_xor_ps(a, _mm_and_ps(_mm_cmplt_ps(test, _mm_setzero_ps()), _mm_set1_ps(-0.0f)));
+}
+inline FloatLanes zeroWhereZero(FloatLanes a, FloatLanes test) {
+	return _mm_and_ps(a, _mm_cmpneq_ps(test, _mm_setzero_ps()));
+}
+inline unsigned int lessThanLanesMask(FloatLanes a, FloatLanes b) { return (unsigned int)_mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+#else
+struct FloatLanes { float f; };
+static const unsigned int floatLaneCount = 1;
+inline FloatLanes loadLanes(const float* f) { FloatLanes result = {*f}; return result; }
+inline FloatLanes loadUnalignedLanes(const float* f) { return loadLanes(f); }
+inline void storeLanes(float* out_f, FloatLanes a) { *out_f = a.f; }
+inline FloatLanes setLanes(float f) { FloatLanes result = {f}; return result; }
+inline FloatLanes addLanes(FloatLanes a, FloatLanes b) { FloatLanes result = {a.f+b.f}; return result; }
+inline FloatLanes subtractLanes(FloatLanes a, FloatLanes b) { FloatLanes result = {a.f-b.f}; return result; }
+inline FloatLanes multiplyLanes(FloatLanes a, FloatLanes b) { FloatLanes result = {a.f*b.f}; return result; }
+inline FloatLanes divideLanes(FloatLanes a, FloatLanes b) { FloatLanes result = {a.f/b.f}; return result; }
+inline FloatLanes sqrtLanes(FloatLanes a) { FloatLanes result = {sqrtf(a.f)}; return result; }
+inline FloatLanes minLanes(FloatLanes a, FloatLanes b) { FloatLanes result = {a.f < b.f ? a.f : b.f}; return result; }
+inline FloatLanes maxLanes(FloatLanes a, FloatLanes b) { FloatLanes result = {a.f > b.f ? a.f : b.f}; return result; }
+inline FloatLanes negateWhereNegative(FloatLanes a, FloatLanes test) { FloatLanes result = {test.f < 0 ? -a.f : a.f}; return result; }
+inline FloatLanes zeroWhereZero(FloatLanes a, FloatLanes test) { FloatLanes result = {test.f == 0 ? 0 : a.f}; return result; }
+inline unsigned int lessThanLanesMask(FloatLanes a, FloatLanes b) { return (a.f < b.f) ? 1 : 0; }
+#endif
+
+/* Each of the floats of up to floatLaneCount objects, with one object per lane.
+Arrays of structs are loaded by copying each float through an aligned buffer. */
+struct QuaternionLanes { FloatLanes w, x, y, z; };
+struct Vec3Lanes { FloatLanes x, y, z; };
+struct TransformLanes { Vec3Lanes position; QuaternionLanes rotation; Vec3Lanes scale; };
+
+// Loads floatsPerObject floats from count objects that are objectStride floats apart.
+// Lanes past count repeat the last object, so they stay valid numbers.
+void loadFloatLanes(FloatLanes* out_lanes, const float* objects, unsigned int objectStride, unsigned int floatsPerObject, unsigned int count)
+{
+	alignas(32) float buffer[floatLaneCount];
+	for (unsigned int f=0; f<floatsPerObject; f++)
+	{
+		for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+			unsigned int object = (lane < count) ? lane : count-1;
+			buffer[lane] = objects[object*objectStride + f];
+		}
+		out_lanes[f] = loadLanes(buffer);
+	}
+}
+
+void storeFloatLanes(float* out_objects, unsigned int objectStride, unsigned int floatsPerObject, unsigned int count, const FloatLanes* lanes)
+{
+	alignas(32) float buffer[floatLaneCount];
+	for (unsigned int f=0; f<floatsPerObject; f++)
+	{
+		storeLanes(buffer, lanes[f]);
+		for (unsigned int lane=0; lane<count; lane++) {
+			out_objects[lane*objectStride + f] = buffer[lane];
+		}
+	}
+}
+
+static const unsigned int floatsPerTransform = sizeof(Transform)/sizeof(float);
+static const unsigned int floatsPerQuaternion = sizeof(Quaternion)/sizeof(float);
+
+void loadTransformLanes(TransformLanes* out_lanes, const Transform* transforms, unsigned int count)
+{
+	loadFloatLanes((FloatLanes*)out_lanes, (const float*)transforms, floatsPerTransform, floatsPerTransform, count);
+}
+
+void storeTransformLanes(Transform* out_transforms, const TransformLanes& lanes, unsigned int count)
+{
+	storeFloatLanes((float*)out_transforms, floatsPerTransform, floatsPerTransform, count, (const FloatLanes*)&lanes);
+}
+
+Vec3Lanes lerpVec3Lanes(Vec3Lanes a, Vec3Lanes b, FloatLanes oneMinusT, FloatLanes t)
+{
+	Vec3Lanes result = {
+		addLanes(multiplyLanes(a.x, oneMinusT), multiplyLanes(b.x, t)),
+		addLanes(multiplyLanes(a.y, oneMinusT), multiplyLanes(b.y, t)),
+		addLanes(multiplyLanes(a.z, oneMinusT), multiplyLanes(b.z, t))
+	};
+	return result;
+}
+
+Vec3Lanes multiplyVec3Lanes(Vec3Lanes a, Vec3Lanes b)
+{
+	Vec3Lanes result = {multiplyLanes(a.x, b.x), multiplyLanes(a.y, b.y), multiplyLanes(a.z, b.z)};
+	return result;
+}
+
+// Same as lerp(Quaternion, Quaternion, float)
+QuaternionLanes nlerpQuaternionLanes(QuaternionLanes a, QuaternionLanes b, FloatLanes oneMinusT, FloatLanes t)
+{
+	FloatLanes dot = addLanes(addLanes(addLanes(
+		multiplyLanes(a.w, b.w), multiplyLanes(a.x, b.x)), multiplyLanes(a.y, b.y)), multiplyLanes(a.z, b.z));
+	b.w = negateWhereNegative(b.w, dot);
+	b.x = negateWhereNegative(b.x, dot);
+	b.y = negateWhereNegative(b.y, dot);
+	b.z = negateWhereNegative(b.z, dot);
+
+	QuaternionLanes q = {
+		addLanes(multiplyLanes(a.w, oneMinusT), multiplyLanes(b.w, t)),
+		addLanes(multiplyLanes(a.x, oneMinusT), multiplyLanes(b.x, t)),
+		addLanes(multiplyLanes(a.y, oneMinusT), multiplyLanes(b.y, t)),
+		addLanes(multiplyLanes(a.z, oneMinusT), multiplyLanes(b.z, t))
+	};
+	FloatLanes length = sqrtLanes(addLanes(addLanes(addLanes(
+		multiplyLanes(q.w, q.w), multiplyLanes(q.x, q.x)), multiplyLanes(q.y, q.y)), multiplyLanes(q.z, q.z)));
+	QuaternionLanes result = {
+		zeroWhereZero(divideLanes(q.w, length), length),
+		zeroWhereZero(divideLanes(q.x, length), length),
+		zeroWhereZero(divideLanes(q.y, length), length),
+		zeroWhereZero(divideLanes(q.z, length), length)
+	};
+	return result;
+}
+
+// Same as operator*(Quaternion, Quaternion)
+QuaternionLanes multiplyQuaternionLanes(QuaternionLanes q1, QuaternionLanes q2)
+{
+	QuaternionLanes result = {
+		subtractLanes(subtractLanes(subtractLanes(multiplyLanes(q1.w, q2.w), multiplyLanes(q1.x, q2.x)), multiplyLanes(q1.y, q2.y)), multiplyLanes(q1.z, q2.z)),
+		subtractLanes(addLanes(addLanes(multiplyLanes(q1.w, q2.x), multiplyLanes(q1.x, q2.w)), multiplyLanes(q1.y, q2.z)), multiplyLanes(q1.z, q2.y)),
+		subtractLanes(addLanes(addLanes(multiplyLanes(q1.w, q2.y), multiplyLanes(q1.y, q2.w)), multiplyLanes(q1.z, q2.x)), multiplyLanes(q1.x, q2.z)),
+		subtractLanes(addLanes(addLanes(multiplyLanes(q1.w, q2.z), multiplyLanes(q1.z, q2.w)), multiplyLanes(q1.x, q2.y)), multiplyLanes(q1.y, q2.x))
+	};
+	return result;
+}
+
+// The 3x3 rotation part of quaternionToMatrix4x4(), as out_rows[row][column]
+void quaternionLanesToRotation(FloatLanes out_rows[3][3], QuaternionLanes q)
+{
+	FloatLanes one = setLanes(1);
+	FloatLanes two = setLanes(2);
+	FloatLanes twoX = multiplyLanes(two, q.x);
+	FloatLanes twoY = multiplyLanes(two, q.y);
+	FloatLanes twoZ = multiplyLanes(two, q.z);
+	out_rows[0][0] = subtractLanes(subtractLanes(one, multiplyLanes(twoY, q.y)), multiplyLanes(twoZ, q.z));
+	out_rows[0][1] = subtractLanes(multiplyLanes(twoX, q.y), multiplyLanes(twoZ, q.w));
+	out_rows[0][2] = addLanes(multiplyLanes(twoX, q.z), multiplyLanes(twoY, q.w));
+	out_rows[1][0] = addLanes(multiplyLanes(twoX, q.y), multiplyLanes(twoZ, q.w));
+	out_rows[1][1] = subtractLanes(subtractLanes(one, multiplyLanes(twoX, q.x)), multiplyLanes(twoZ, q.z));
+	out_rows[1][2] = subtractLanes(multiplyLanes(twoY, q.z), multiplyLanes(twoX, q.w));
+	out_rows[2][0] = subtractLanes(multiplyLanes(twoX, q.z), multiplyLanes(twoY, q.w));
+	out_rows[2][1] = addLanes(multiplyLanes(twoY, q.z), multiplyLanes(twoX, q.w));
+	out_rows[2][2] = subtractLanes(subtractLanes(one, multiplyLanes(twoX, q.x)), multiplyLanes(twoY, q.y));
+}
+
+void concatenateTransformsN(Transform* out_transforms, const Transform* parents, const Transform* children, unsigned int count)
+{
+	for (unsigned int i=0; i<count; i+=floatLaneCount)
+	{
+		unsigned int laneCount = (count-i < floatLaneCount) ? count-i : floatLaneCount;
+		TransformLanes parent, child;
+		loadTransformLanes(&parent, parents+i, laneCount);
+		loadTransformLanes(&child, children+i, laneCount);
+
+		TransformLanes result;
+		result.scale = multiplyVec3Lanes(child.scale, parent.scale);
+		result.rotation = multiplyQuaternionLanes(parent.rotation, child.rotation);
+
+		FloatLanes rotation[3][3];
+		quaternionLanesToRotation(rotation, parent.rotation);
+		Vec3Lanes p = multiplyVec3Lanes(child.position, parent.scale);
+		result.position.x = addLanes(addLanes(addLanes(multiplyLanes(rotation[0][0], p.x), multiplyLanes(rotation[0][1], p.y)), multiplyLanes(rotation[0][2], p.z)), parent.position.x);
+		result.position.y = addLanes(addLanes(addLanes(multiplyLanes(rotation[1][0], p.x), multiplyLanes(rotation[1][1], p.y)), multiplyLanes(rotation[1][2], p.z)), parent.position.y);
+		result.position.z = addLanes(addLanes(addLanes(multiplyLanes(rotation[2][0], p.x), multiplyLanes(rotation[2][1], p.y)), multiplyLanes(rotation[2][2], p.z)), parent.position.z);
+
+		storeTransformLanes(out_transforms+i, result, laneCount);
+	}
+}
+
+void transformsToMatrices4x4N(Matrix4x4* out_matrices, const Transform* transforms, unsigned int count)
+{
+	for (unsigned int i=0; i<count; i+=floatLaneCount)
+	{
+		unsigned int laneCount = (count-i < floatLaneCount) ? count-i : floatLaneCount;
+		TransformLanes t;
+		loadTransformLanes(&t, transforms+i, laneCount);
+
+		// Translation * rotation * scale, with the zeros multiplied out
+		FloatLanes rotation[3][3];
+		quaternionLanesToRotation(rotation, t.rotation);
+		FloatLanes zero = setLanes(0);
+		FloatLanes cells[16] = {
+			multiplyLanes(rotation[0][0], t.scale.x), multiplyLanes(rotation[0][1], t.scale.y), multiplyLanes(rotation[0][2], t.scale.z), t.position.x,
+			multiplyLanes(rotation[1][0], t.scale.x), multiplyLanes(rotation[1][1], t.scale.y), multiplyLanes(rotation[1][2], t.scale.z), t.position.y,
+			multiplyLanes(rotation[2][0], t.scale.x), multiplyLanes(rotation[2][1], t.scale.y), multiplyLanes(rotation[2][2], t.scale.z), t.position.z,
+			zero, zero, zero, setLanes(1)
+		};
+		storeFloatLanes((float*)(out_matrices+i), 16, 16, laneCount, cells);
+	}
+}
+
+void nlerpQuaternionsN(Quaternion* out_quaternions, const Quaternion* a, const Quaternion* b, float t, unsigned int count)
+{
+	FloatLanes tLanes = setLanes(t);
+	FloatLanes oneMinusT = setLanes(1-t);
+	for (unsigned int i=0; i<count; i+=floatLaneCount)
+	{
+		unsigned int laneCount = (count-i < floatLaneCount) ? count-i : floatLaneCount;
+		QuaternionLanes qa, qb;
+		loadFloatLanes((FloatLanes*)&qa, (const float*)(a+i), floatsPerQuaternion, floatsPerQuaternion, laneCount);
+		loadFloatLanes((FloatLanes*)&qb, (const float*)(b+i), floatsPerQuaternion, floatsPerQuaternion, laneCount);
+		QuaternionLanes result = nlerpQuaternionLanes(qa, qb, oneMinusT, tLanes);
+		storeFloatLanes((float*)(out_quaternions+i), floatsPerQuaternion, floatsPerQuaternion, laneCount, (const FloatLanes*)&result);
+	}
+}
+
+void lerpTransformsN(Transform* out_transforms, const Transform* a, const Transform* b, float t, unsigned int count)
+{
+	FloatLanes tLanes = setLanes(t);
+	FloatLanes oneMinusT = setLanes(1-t);
+	for (unsigned int i=0; i<count; i+=floatLaneCount)
+	{
+		unsigned int laneCount = (count-i < floatLaneCount) ? count-i : floatLaneCount;
+		TransformLanes ta, tb;
+		loadTransformLanes(&ta, a+i, laneCount);
+		loadTransformLanes(&tb, b+i, laneCount);
+
+		TransformLanes result;
+		result.position = lerpVec3Lanes(ta.position, tb.position, oneMinusT, tLanes);
+		result.rotation = nlerpQuaternionLanes(ta.rotation, tb.rotation, oneMinusT, tLanes);
+		result.scale = lerpVec3Lanes(ta.scale, tb.scale, oneMinusT, tLanes);
+		storeTransformLanes(out_transforms+i, result, laneCount);
+	}
+}
+
+void mat4MulN(Matrix4x4* out_matrices, const Matrix4x4* a, const Matrix4x4* b, unsigned int count)
+{
+#if defined(GOBLIN_SIMD_AVX) || defined(GOBLIN_SIMD_SSE)
+	// Each row of the result is a's row weighting b's rows, which is one SSE register per row
+	for (unsigned int i=0; i<count; i++)
+	{
+		const Matrix4x4& ma = a[i];
+		__m128 b0 = _mm_loadu_ps(b[i].c[0]);
+		__m128 b1 = _mm_loadu_ps(b[i].c[1]);
+		__m128 b2 = _mm_loadu_ps(b[i].c[2]);
+		__m128 b3 = _mm_loadu_ps(b[i].c[3]);
+		for (unsigned int row=0; row<4; row++)
+		{
+			__m128 result = _mm_mul_ps(_mm_set1_ps(ma.c[row][0]), b0);
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(ma.c[row][1]), b1));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(ma.c[row][2]), b2));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(ma.c[row][3]), b3));
+			_mm_storeu_ps(out_matrices[i].c[row], result);
+		}
+	}
+#else
+	for (unsigned int i=0; i<count; i++) {
+		out_matrices[i] = a[i]*b[i];
+	}
+#endif
+}
+
+// Compact encodings ==========================================================
+
+unsigned short floatToHalf(float x)
+{
+	unsigned int bits;
+	memcpy(&bits, &x, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int exponent = (bits >> 23) & 0xFF;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	// Infinity and NaN
+	if (exponent == 0xFF) {
+		return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+	int halfExponent = (int)exponent - 127 + 15;
+	if (halfExponent >= 31) {
+		return (unsigned short)(sign | 0x7C00);
+	}
+	if (halfExponent <= 0) {
+		// Too small for a normal half, so it's denormal or 0
+		if (halfExponent < -10) {
+			return (unsigned short)sign;
+		}
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - halfExponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift-1);
+		if (remainder > halfway || (remainder == halfway && (half & 1))) {
+			half++;
+		}
+		return (unsigned short)(sign | half);
+	}
+
+	unsigned int half = ((unsigned int)halfExponent << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1FFF;
+	// Rounding up can carry into the exponent, which is still the right answer
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+		half++;
+	}
+	return (unsigned short)(sign | half);
+}
+
+float halfToFloat(unsigned short half)
+{
+	unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+	unsigned int exponent = (half >> 10) & 0x1F;
+	unsigned int mantissa = half & 0x3FF;
+	if (exponent == 0) {
+		float result = ldexpf((float)mantissa, -24);
+		return sign ? -result : result;
+	}
+	unsigned int bits;
+	if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+Vec2 encodeOctahedral(Vec3 unitVector)
+{
+	float sum = fabsf(unitVector.x) + fabsf(unitVector.y) + fabsf(unitVector.z);
+	if (sum == 0) {
+		Vec2 result = {0, 0};
+		return result;
+	}
+	Vec2 result = {unitVector.x/sum, unitVector.y/sum};
+	// The lower half folds out over the corners
+	if (unitVector.z < 0) {
+		Vec2 folded = {
+			(1 - fabsf(result.y)) * (result.x >= 0 ? 1.0f : -1.0f),
+			(1 - fabsf(result.x)) * (result.y >= 0 ? 1.0f : -1.0f)
+		};
+		result = folded;
+	}
+	return result;
+}
+
+Vec3 decodeOctahedral(Vec2 encoded)
+{
+	Vec3 result = {encoded.x, encoded.y, 1 - fabsf(encoded.x) - fabsf(encoded.y)};
+	if (result.z < 0) {
+		float x = result.x;
+		result.x = (1 - fabsf(result.y)) * (x >= 0 ? 1.0f : -1.0f);
+		result.y = (1 - fabsf(x)) * (result.y >= 0 ? 1.0f : -1.0f);
+	}
+	return normalize(result);
+}
+
+short floatToSnorm16(float x)
+{
+	return (short)round(clamp(x, -1, 1) * 32767.0f);
+}
+
+float snorm16ToFloat(short x)
+{
+	return max((float)x / 32767.0f, -1.0f);
+}
+
 } // namespace
 #endif // include guard
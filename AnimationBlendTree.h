@@ -0,0 +1,359 @@
+#ifndef GOBLIN_ANIMATION_BLEND_TREE_HEADER
+#define GOBLIN_ANIMATION_BLEND_TREE_HEADER
+
+#include "SkeletonAnimation.h"
+#include <assert.h>
+#include <vector>
+
+namespace goblin {
+
+static const unsigned int maxBlendTreeNodeInputs = 8;
+
+enum BlendTreeNodeType {
+	// Samples an animation, using a parameter as the time
+	BlendTreeNode_clip,
+	// Blends from input 0 to input 1, using a parameter from 0 to 1
+	BlendTreeNode_lerp,
+	// Adds input 1 on top of input 0, using a parameter as the weight.
+	// If there is an input 2, it is the reference pose input 1 is the difference from.
+	// Otherwise, input 1 should already be a difference pose.
+	BlendTreeNode_additive,
+	// Blends between the two inputs on either side of a parameter.
+	// Each input has a position on a line, in samplePositions[i][0], sorted smallest first.
+	BlendTreeNode_blendSpace1D,
+	// Blends the inputs around a point made of two parameters, with gradient band interpolation,
+	// so the weights change smoothly as the point moves and inputs far from it get none.
+	// Each input has a position in samplePositions[i].
+	BlendTreeNode_blendSpace2D
+};
+
+/* One node of a blend tree, as authored.
+Inputs are indices of other nodes in the same array.
+Every node can only be the input of one other node. */
+struct BlendTreeNode
+{
+	BlendTreeNodeType type;
+	unsigned int inputs[maxBlendTreeNodeInputs];
+	unsigned int inputCount;
+	SkeletonAnimation* animation;
+	// Which parameter controls this node: the time for a clip, the weight for lerp and additive,
+	// and the x position for blend spaces
+	unsigned int parameter;
+	// The y position for 2D blend spaces
+	unsigned int parameterY;
+	float samplePositions[maxBlendTreeNodeInputs][2];
+};
+
+/* One step of a compiled blend tree.
+Instructions are ordered so every input is evaluated before it's used,
+and the root is last.
+Poses are stored in a small set of buffers, reused once the pose in them isn't needed.
+Buffer 0 is the output pose. */
+struct BlendTreeInstruction
+{
+	BlendTreeNodeType type;
+	unsigned int outputBuffer;
+	unsigned int inputInstructions[maxBlendTreeNodeInputs];
+	unsigned int inputBuffers[maxBlendTreeNodeInputs];
+	unsigned int inputCount;
+	SkeletonAnimation* animation;
+	unsigned int parameter;
+	unsigned int parameterY;
+	float samplePositions[maxBlendTreeNodeInputs][2];
+};
+
+struct BlendTree
+{
+	BlendTreeInstruction* instructions;
+	unsigned int instructionCount;
+	// The most poses that are needed at once, including the output
+	unsigned int bufferCount;
+	unsigned int jointCount;
+};
+
+/* Compiles the tree under rootNodeIndex into a list of instructions.
+Every animation in the tree must have jointCount joints.
+The nodes aren't needed after this. */
+void createBlendTree(BlendTree* out_tree, const BlendTreeNode* nodes, unsigned int nodeCount, unsigned int rootNodeIndex, unsigned int jointCount);
+void destroyBlendTree(BlendTree* tree);
+
+/* Evaluates the tree into out_jointPoses, which has room for the tree's jointCount.
+parameters are the values nodes refer to by index.
+Inputs that end up with no weight aren't evaluated, along with everything under them.
+The intermediate poses are pushed onto scratch and popped before returning.
+Returns the number of clips that were sampled. */
+unsigned int evaluateBlendTree(
+	Transform* out_jointPoses,
+	const BlendTree& tree,
+	const float* parameters,
+	FrameArena* scratch);
+
+
+
+// Implementation =============================================================
+
+// Returns the index of the instruction added for the node
+unsigned int compileBlendTreeNode(
+	std::vector<BlendTreeInstruction>& mod_instructions,
+	std::vector<unsigned int>& mod_freeBuffers,
+	unsigned int& mod_bufferCount,
+	std::vector<bool>& mod_compiledNodes,
+	const BlendTreeNode* nodes,
+	unsigned int nodeCount,
+	unsigned int nodeIndex)
+{
+	assert(nodeIndex < nodeCount);
+	assert(!mod_compiledNodes[nodeIndex] && "Blend tree nodes can only have one parent");
+	mod_compiledNodes[nodeIndex] = true;
+	const BlendTreeNode& node = nodes[nodeIndex];
+
+	BlendTreeInstruction instruction = {};
+	instruction.type = node.type;
+	instruction.inputCount = node.inputCount;
+	instruction.animation = node.animation;
+	instruction.parameter = node.parameter;
+	instruction.parameterY = node.parameterY;
+	memcpy(instruction.samplePositions, node.samplePositions, sizeof(node.samplePositions));
+
+	if (node.type == BlendTreeNode_clip)
+	{
+		assert(node.inputCount == 0);
+		if (mod_freeBuffers.size() > 0) {
+			instruction.outputBuffer = mod_freeBuffers.back();
+			mod_freeBuffers.pop_back();
+		}
+		else {
+			instruction.outputBuffer = mod_bufferCount++;
+		}
+	}
+	else
+	{
+		assert(node.inputCount > 0 && node.inputCount <= maxBlendTreeNodeInputs);
+		assert(node.type != BlendTreeNode_lerp || node.inputCount == 2);
+		assert(node.type != BlendTreeNode_additive || node.inputCount == 2 || node.inputCount == 3);
+
+		// Each input's pose stays in its buffer until this node uses it
+		for (unsigned int i=0; i<node.inputCount; i++)
+		{
+			unsigned int input = compileBlendTreeNode(mod_instructions, mod_freeBuffers, mod_bufferCount, mod_compiledNodes, nodes, nodeCount, node.inputs[i]);
+			instruction.inputInstructions[i] = input;
+			instruction.inputBuffers[i] = mod_instructions[input].outputBuffer;
+		}
+		// Blend in place into the first input's buffer, and the rest are free after this
+		instruction.outputBuffer = instruction.inputBuffers[0];
+		for (unsigned int i=1; i<node.inputCount; i++) {
+			mod_freeBuffers.push_back(instruction.inputBuffers[i]);
+		}
+	}
+
+	mod_instructions.push_back(instruction);
+	return (unsigned int)mod_instructions.size()-1;
+}
+
+void createBlendTree(BlendTree* out_tree, const BlendTreeNode* nodes, unsigned int nodeCount, unsigned int rootNodeIndex, unsigned int jointCount)
+{
+	BlendTree zero = {};
+	*out_tree = zero;
+
+	std::vector<BlendTreeInstruction> instructions;
+	std::vector<unsigned int> freeBuffers;
+	std::vector<bool> compiledNodes(nodeCount, false);
+	unsigned int bufferCount = 0;
+	compileBlendTreeNode(instructions, freeBuffers, bufferCount, compiledNodes, nodes, nodeCount, rootNodeIndex);
+
+	// Swap buffer numbers so the root's buffer is 0, and it can be the caller's output
+	unsigned int rootBuffer = instructions.back().outputBuffer;
+	for (unsigned int i=0; i<instructions.size(); i++)
+	{
+		BlendTreeInstruction& instruction = instructions[i];
+		if (instruction.outputBuffer == rootBuffer) { instruction.outputBuffer = 0; }
+		else if (instruction.outputBuffer == 0) { instruction.outputBuffer = rootBuffer; }
+		for (unsigned int j=0; j<instruction.inputCount; j++)
+		{
+			if (instruction.inputBuffers[j] == rootBuffer) { instruction.inputBuffers[j] = 0; }
+			else if (instruction.inputBuffers[j] == 0) { instruction.inputBuffers[j] = rootBuffer; }
+		}
+	}
+
+	out_tree->instructionCount = (unsigned int)instructions.size();
+	out_tree->instructions = new BlendTreeInstruction[out_tree->instructionCount];
+	memcpy(out_tree->instructions, &instructions[0], sizeof(BlendTreeInstruction)*out_tree->instructionCount);
+	out_tree->bufferCount = bufferCount;
+	out_tree->jointCount = jointCount;
+	for (unsigned int i=0; i<out_tree->instructionCount; i++) {
+		assert(!out_tree->instructions[i].animation || out_tree->instructions[i].animation->jointCount == jointCount);
+	}
+}
+
+void destroyBlendTree(BlendTree* tree)
+{
+	delete[] tree->instructions;
+	BlendTree zero = {};
+	*tree = zero;
+}
+
+// Fills out_weights with how much each input contributes to the instruction.
+// Inputs with a weight of 0 don't need to be evaluated.
+void computeBlendTreeInputWeights(float* out_weights, const BlendTreeInstruction& instruction, const float* parameters)
+{
+	for (unsigned int i=0; i<instruction.inputCount; i++) {
+		out_weights[i] = 0;
+	}
+
+	if (instruction.type == BlendTreeNode_lerp)
+	{
+		float t = clamp(parameters[instruction.parameter], 0, 1);
+		out_weights[0] = 1.0f-t;
+		out_weights[1] = t;
+	}
+	else if (instruction.type == BlendTreeNode_additive)
+	{
+		float weight = parameters[instruction.parameter];
+		out_weights[0] = 1;
+		if (weight != 0) {
+			for (unsigned int i=1; i<instruction.inputCount; i++) {
+				out_weights[i] = weight;
+			}
+		}
+	}
+	else if (instruction.type == BlendTreeNode_blendSpace1D)
+	{
+		float x = parameters[instruction.parameter];
+		unsigned int last = instruction.inputCount-1;
+		if (x <= instruction.samplePositions[0][0]) {
+			out_weights[0] = 1;
+		}
+		else if (x >= instruction.samplePositions[last][0]) {
+			out_weights[last] = 1;
+		}
+		else
+		{
+			unsigned int i = 1;
+			while (instruction.samplePositions[i][0] < x) {
+				i++;
+			}
+			float start = instruction.samplePositions[i-1][0];
+			float end = instruction.samplePositions[i][0];
+			float t = (end > start) ? (x-start)/(end-start) : 0;
+			out_weights[i-1] = 1.0f-t;
+			out_weights[i] = t;
+		}
+	}
+	else if (instruction.type == BlendTreeNode_blendSpace2D)
+	{
+		/* Gradient band interpolation: along the line from a sample to each other sample,
+		the sample's weight falls from 1 at itself to 0 at the other, and it takes the smallest of those.
+		That changes smoothly as the point moves, and the closest sample always has a weight of at least a half. */
+		Vec2 point = {parameters[instruction.parameter], parameters[instruction.parameterY]};
+		float totalWeight = 0;
+		for (unsigned int i=0; i<instruction.inputCount; i++)
+		{
+			Vec2 sample = {instruction.samplePositions[i][0], instruction.samplePositions[i][1]};
+			Vec2 toPoint = point - sample;
+			float weight = 1;
+			for (unsigned int j=0; j<instruction.inputCount; j++)
+			{
+				Vec2 toOther = Vec2{instruction.samplePositions[j][0], instruction.samplePositions[j][1]} - sample;
+				float squaredLength = dot(toOther, toOther);
+				// Skips the sample itself, and others at the same position
+				if (squaredLength > 0) {
+					weight = min(weight, 1.0f - dot(toPoint, toOther)/squaredLength);
+				}
+			}
+			out_weights[i] = max(weight, 0.0f);
+			totalWeight += out_weights[i];
+		}
+		for (unsigned int i=0; i<instruction.inputCount; i++) {
+			out_weights[i] /= totalWeight;
+		}
+	}
+}
+
+unsigned int evaluateBlendTree(Transform* out_jointPoses, const BlendTree& tree, const float* parameters, FrameArena* scratch)
+{
+	unsigned int jointCount = tree.jointCount;
+	size_t marker = getFrameArenaMarker(scratch);
+
+	// Buffer 0 is the output
+	Transform** buffers = pushFrameArenaArray<Transform*>(scratch, tree.bufferCount);
+	buffers[0] = out_jointPoses;
+	for (unsigned int i=1; i<tree.bufferCount; i++) {
+		buffers[i] = pushFrameArenaArray<Transform>(scratch, jointCount);
+	}
+
+	// Walk from the root to the leaves to find which instructions contribute to the output
+	float* inputWeights = pushFrameArenaArray<float>(scratch, tree.instructionCount*maxBlendTreeNodeInputs);
+	bool* needed = pushFrameArenaArray<bool>(scratch, tree.instructionCount);
+	for (unsigned int i=0; i<tree.instructionCount; i++) {
+		needed[i] = false;
+	}
+	needed[tree.instructionCount-1] = true;
+	for (unsigned int i=tree.instructionCount; i-- > 0;)
+	{
+		if (!needed[i]) {
+			continue;
+		}
+		const BlendTreeInstruction& instruction = tree.instructions[i];
+		float* weights = inputWeights + i*maxBlendTreeNodeInputs;
+		computeBlendTreeInputWeights(weights, instruction, parameters);
+		for (unsigned int j=0; j<instruction.inputCount; j++) {
+			needed[instruction.inputInstructions[j]] = (weights[j] != 0);
+		}
+	}
+
+	unsigned int sampledClipCount = 0;
+	for (unsigned int i=0; i<tree.instructionCount; i++)
+	{
+		if (!needed[i]) {
+			continue;
+		}
+		const BlendTreeInstruction& instruction = tree.instructions[i];
+		const float* weights = inputWeights + i*maxBlendTreeNodeInputs;
+		Transform* output = buffers[instruction.outputBuffer];
+
+		if (instruction.type == BlendTreeNode_clip)
+		{
+			sampleSkeletonAnimation(output, parameters[instruction.parameter], *instruction.animation);
+			sampledClipCount++;
+		}
+		else if (instruction.type == BlendTreeNode_additive)
+		{
+			if (weights[1] != 0)
+			{
+				Transform* added = buffers[instruction.inputBuffers[1]];
+				if (instruction.inputCount == 3) {
+					buildDifferenceSkeletonPose(added, buffers[instruction.inputBuffers[2]], added, jointCount);
+				}
+				additiveBlendSkeletonPoses(output, output, added, jointCount, weights[1]);
+			}
+		}
+		else
+		{
+			// Lerp and blend spaces are a weighted average of their inputs.
+			// Each input is blended in by its share of the weight so far.
+			float totalWeight = 0;
+			for (unsigned int j=0; j<instruction.inputCount; j++)
+			{
+				if (weights[j] == 0) {
+					continue;
+				}
+				Transform* input = buffers[instruction.inputBuffers[j]];
+				if (totalWeight == 0) {
+					if (input != output) {
+						memcpy(output, input, sizeof(Transform)*jointCount);
+					}
+				}
+				else {
+					lerpBlendSkeletonPoses(output, output, input, jointCount, weights[j]/(totalWeight+weights[j]));
+				}
+				totalWeight += weights[j];
+			}
+		}
+	}
+
+	popFrameArenaToMarker(scratch, marker);
+	return sampledClipCount;
+}
+
+} // namespace
+#endif // header include guard
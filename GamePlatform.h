@@ -2,9 +2,15 @@
 #define PLATFORM_HEADER
 #include "general/BasicTypes.h"
 #include "goblin3D/Goblin3D.h"
+#include <assert.h>
 #include <vector>
+#include <deque>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
 
 #ifdef SDL
 	#include "libraries/SDL/SDL_main.h"
@@ -17,6 +23,20 @@
 #ifdef WIN32
 	#define WIN32_LEAN_AND_MEAN
 	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <ucontext.h>
+#endif
+
+// Stops the compiler from keeping a thread_local's address across a fiber switch,
+// since the fiber can be resumed on another thread
+#ifdef _MSC_VER
+	#define PLATFORM_NOINLINE __declspec(noinline)
+#else
+	#define PLATFORM_NOINLINE __attribute__((noinline))
 #endif
 
 namespace platform {
@@ -48,14 +68,73 @@ struct WindowMessages
 
 struct File
 {
+	// Where the bytes came from, so releaseFile() knows how to give them back
+	enum Storage {
+		heap,     // Read into a new[] buffer
+		mapped,   // Memory mapped with mapFile()
+		borrowed, // Points into an archive that's still open, so there's nothing to release
+	};
+
 	char* bytes;
 	size_t byteCount;
+	Storage storage;
+	#ifdef WIN32
+		HANDLE mappingHandle;
+	#endif
+};
+
+/* A .gobarchive file, built by gobarchive_packer: many files packed into one,
+with a hash table of their names so finding one doesn't touch the disk.
+File format:
+Header
+{
+uint32 magic "GARC"
+uint32 version
+uint32 number of entries
+uint32 number of hash table slots (a power of 2)
+}
+Entry slots [number of slots], placed by FNV-1a hash of the name with linear probing
+Names (null terminated)
+File data, each starting 16 byte aligned. Compressed entries use LZ4 block compression.
+*/
+struct Archive
+{
+	struct Header {
+		uint magic;
+		uint version;
+		uint entryCount;
+		uint slotCount;
+	};
+	struct Entry {
+		uint64 nameHash;
+		uint64 offset; // From the start of the archive
+		uint storedByteCount;
+		uint byteCount; // After decompressing
+		uint nameOffset; // From the start of the names
+		uint flags;
+	};
+	enum EntryFlags {
+		entry_used = 1,
+		entry_compressed = 2
+	};
+
+	File file;
+	Header header;
+	Entry* slots;
+	char* names;
+	// Up to the first file's data, since the header doesn't store it
+	size_t nameByteCount;
 };
 
+static const uint archiveMagic = 0x43524147; // "GARC"
+static const uint archiveVersion = 1;
+
 struct FileSystem
 {
 	// Directories or asset archives
 	std::vector<std::string> fileLocations;
+	// Archives are searched before directories
+	std::vector<Archive> archives;
 };
 
 struct Input
@@ -102,7 +181,7 @@ struct Mutex
 	#ifdef SDL
 		SDL_mutex* mutex;
 	#else
-		//#error
+		CRITICAL_SECTION criticalSection;
 	#endif
 };
 
@@ -111,34 +190,155 @@ struct CondVar
 	#ifdef SDL
 		SDL_cond* condVar;
 	#else
-		//#error
+		CONDITION_VARIABLE conditionVariable;
 	#endif
 };
 
+/* A stack and saved registers that a thread can switch to and from.
+SDL doesn't have fibers, so these use the OS directly. */
+struct Fiber
+{
+	void (*startRoutine)(void*);
+	void* parameter;
+	#ifdef WIN32
+		void* handle;
+	#else
+		ucontext_t context;
+		char* stack;
+	#endif
+};
+
+typedef uint AsyncFileHandle;
+
+enum AsyncFileStatus {
+	AsyncFileStatus_queued,
+	AsyncFileStatus_loading,
+	AsyncFileStatus_loaded,   // Waiting for updateAsyncFileLoader() to call its callback
+	AsyncFileStatus_finished  // The callback was called, or the request was cancelled
+};
+
+/* Called from updateAsyncFileLoader() on the thread that calls it.
+The callback owns the file, and has to releaseFile() it when it's done. */
+typedef void (*AsyncFileCallback)(void* userData, AsyncFileHandle handle, File* file, bool success);
+
+/* Loads files on background I/O threads.
+Requests are loaded highest priority first, and in the order they were made within a priority.
+Finished files wait until updateAsyncFileLoader() hands them to their callbacks,
+which only runs for as long as its budget allows each frame. */
+struct AsyncFileLoader
+{
+	struct Request {
+		AsyncFileHandle handle;
+		int priority;
+		uint64 order;
+		std::string fileName;
+		AsyncFileCallback callback;
+		void* userData;
+		AsyncFileStatus status;
+		bool cancelled;
+		bool success;
+		File file;
+	};
+
+	FileSystem fileSystem;
+	Mutex mutex;
+	CondVar requestsAvailable;
+	std::vector<Request*> queue; // A heap, with the next request to load at the front
+	std::deque<Request*> loaded; // In the order they finished loading, taken from the front
+	std::unordered_map<AsyncFileHandle, Request*> requests;
+	AsyncFileHandle nextHandle;
+	uint64 nextOrder;
+	Thread* workers;
+	uint workerCount;
+	bool quitting;
+};
+
+/* Counts the unfinished jobs that were added with it.
+Start it at zero, with JobCounter counter = {};
+waitForJobCounter() runs other jobs until it reaches zero again,
+so a job can be made to depend on others by waiting on their counter. */
+struct JobCounter
+{
+	std::atomic<int> unfinishedCount;
+};
+
+/* A job system: each worker thread has its own queue of jobs,
+and takes work from the other queues when its own runs out.
+Threads that aren't workers, like the main thread, share one more queue,
+and help run jobs while they wait for them to finish.
+In fiber mode, workers run each job on a fiber of its own,
+so a job that waits is put aside and its worker goes on to other jobs. */
 struct ThreadPool
 {
+	// The most jobs each queue can hold. A job added to a full queue runs right away instead.
+	static const uint maxQueuedJobs = 4096;
+	static const size_t fiberStackByteCount = 128*1024;
+	static const size_t defaultScratchByteCount = 256*1024;
+
 	struct Job {
-		enum Status { enqueued, started, finished };
-		Status status;
 		int(*startRoutine)(void*);
-		void* param;
-		CondVar cond;
-		Mutex mutex;
+		void* parameter;
+		JobCounter* counter;
+	};
+
+	/* A slot in a queue's ring. A thief can read a slot while the owner writes it,
+	if the owner has wrapped around to it, so its fields are atomic. The thief then fails to take the job. */
+	struct JobSlot {
+		std::atomic<int(*)(void*)> startRoutine;
+		std::atomic<void*> parameter;
+		std::atomic<JobCounter*> counter;
 	};
-	struct Worker {
-		Thread thread;
 
+	/* A Chase-Lev work stealing deque.
+	The thread that owns it pushes and pops jobs at the bottom without locking,
+	and other threads steal them from the top. */
+	struct JobQueue {
+		std::atomic<int64> top;
+		std::atomic<int64> bottom;
+		JobSlot* jobs; // maxQueuedJobs of them, used as a ring
 	};
+
 	struct WorkerParams {
 		ThreadPool* pool;
-		int workerIndex;
+		uint workerIndex;
+	};
+
+	struct JobFiber {
+		Fiber fiber;
+		ThreadPool* pool;
+		Job job;
+		// The worker that last switched to this fiber, and that it switches back to
+		Fiber* scheduler;
+		// Set while the job is waiting for a counter, otherwise the fiber is running or free
+		JobCounter* waitCounter;
 	};
 
 	uint workerCount;
 	Thread* workers;
-	DynamicArray<Job> jobQueue;
-	Mutex queueMutex;
-	CondVar queueCond;
+	WorkerParams* workerParams;
+	// Each worker's scratch memory, see getThreadScratchArena()
+	goblin::FrameArena* scratchArenas;
+	// One for each worker, then the shared one for other threads
+	JobQueue* queues;
+	// Pushing and popping the shared queue isn't lock free, since any thread can do it
+	Mutex sharedQueueMutex;
+
+	// Idle workers sleep until jobs are added
+	std::atomic<int> queuedJobCount;
+	std::atomic<int> sleepingWorkerCount;
+	Mutex sleepMutex;
+	CondVar jobsAvailable;
+	std::atomic<bool> quitting;
+
+	// Fiber mode, when fiberCount isn't 0
+	uint fiberCount;
+	JobFiber* fibers;
+	Fiber* workerFibers; // What each worker thread runs its scheduling loop on
+	Mutex fiberMutex;
+	std::vector<JobFiber*> freeFibers;
+	std::vector<JobFiber*> waitingFibers;
+	// Goes up whenever a counter reaches zero, so sleeping workers check the waiting fibers again
+	std::atomic<uint> counterFinishedCount;
 };
 
 // Key codes for indexing the array of keys in Input
@@ -510,11 +710,6 @@ FUNCTION_DEF WindowMessages processWindowMessages(Window* inout_win)
 	return result;
 }
 
-FUNCTION_DEF void addFileLocation(FileSystem* out_fs, std::string name)
-{
-	out_fs->fileLocations.push_back(name);
-}
-
 
 FUNCTION_DEF bool loadFile(File* out_file, std::string fileName)
 {
@@ -558,8 +753,289 @@ FUNCTION_DEF File loadFile(std::string fileName)
 	return newFile;
 }
 
+/* Maps the file into memory instead of reading it, so pages are only loaded as they're touched
+and nothing is copied. Writing to the bytes is allowed, but only changes this process's copy.
+Loaders with a copyBytes parameter can use the bytes in place when it's false. */
+FUNCTION_DEF bool mapFile(File* out_file, std::string fileName)
+{
+	File zero = {};
+	*out_file = zero;
+	#ifdef WIN32
+		HANDLE fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		if (fileSize.QuadPart == 0) {
+			CloseHandle(fileHandle);
+			return true;
+		}
+		// The mapping keeps the file open, so its handle can be closed now
+		HANDLE mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_WRITECOPY, 0, 0, 0);
+		CloseHandle(fileHandle);
+		if (!mappingHandle) {
+			return false;
+		}
+		void* bytes = MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+		if (!bytes) {
+			CloseHandle(mappingHandle);
+			return false;
+		}
+		out_file->mappingHandle = mappingHandle;
+		out_file->byteCount = (size_t)fileSize.QuadPart;
+	#else
+		int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+		if (fileDescriptor < 0) {
+			return false;
+		}
+		struct stat fileStatus;
+		if (fstat(fileDescriptor, &fileStatus) != 0) {
+			close(fileDescriptor);
+			return false;
+		}
+		if (fileStatus.st_size == 0) {
+			close(fileDescriptor);
+			return true;
+		}
+		void* bytes = mmap(0, (size_t)fileStatus.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+		// The mapping keeps the file open, so its descriptor can be closed now
+		close(fileDescriptor);
+		if (bytes == MAP_FAILED) {
+			return false;
+		}
+		out_file->byteCount = (size_t)fileStatus.st_size;
+	#endif
+	out_file->bytes = (char*)bytes;
+	out_file->storage = File::mapped;
+	return true;
+}
+
+FUNCTION_DEF void releaseFile(File* file)
+{
+	if (file->bytes)
+	{
+		if (file->storage == File::mapped) {
+			#ifdef WIN32
+				UnmapViewOfFile(file->bytes);
+				CloseHandle(file->mappingHandle);
+			#else
+				munmap(file->bytes, file->byteCount);
+			#endif
+		}
+		else if (file->storage == File::heap) {
+			delete[] file->bytes;
+		}
+	}
+	File zero = {};
+	*file = zero;
+}
+
+// FNV-1a
+FUNCTION_DEF uint64 hashArchiveName(const char* name)
+{
+	uint64 hash = 14695981039346656037ull;
+	for (const char* c = name; *c; c++) {
+		hash ^= (uint8)*c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Returns false if the compressed bytes don't decompress to exactly byteCount bytes
+FUNCTION_DEF bool decompressLZ4Block(char* out_bytes, uint byteCount, const char* compressedBytes, uint compressedByteCount)
+{
+	const uint8* in = (const uint8*)compressedBytes;
+	const uint8* inEnd = in + compressedByteCount;
+	uint8* out = (uint8*)out_bytes;
+	uint8* outEnd = out + byteCount;
+
+	while (in < inEnd)
+	{
+		// Each sequence is a run of literal bytes, then a copy of earlier output
+		uint token = *in++;
+		size_t literalCount = token >> 4;
+		if (literalCount == 15) {
+			uint extra;
+			do {
+				if (in >= inEnd) { return false; }
+				extra = *in++;
+				literalCount += extra;
+			} while (extra == 255);
+		}
+		if (literalCount > (size_t)(inEnd-in) || literalCount > (size_t)(outEnd-out)) {
+			return false;
+		}
+		memcpy(out, in, literalCount);
+		in += literalCount;
+		out += literalCount;
+		// The last sequence has no match
+		if (in >= inEnd) {
+			break;
+		}
+
+		if (inEnd-in < 2) {
+			return false;
+		}
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		size_t matchCount = token & 15;
+		if (matchCount == 15) {
+			uint extra;
+			do {
+				if (in >= inEnd) { return false; }
+				extra = *in++;
+				matchCount += extra;
+			} while (extra == 255);
+		}
+		matchCount += 4;
+		if (offset == 0 || offset > (size_t)(out-(uint8*)out_bytes) || matchCount > (size_t)(outEnd-out)) {
+			return false;
+		}
+		// Byte by byte, because the match can overlap what it's writing
+		const uint8* match = out - offset;
+		for (size_t i=0; i<matchCount; i++) {
+			out[i] = match[i];
+		}
+		out += matchCount;
+	}
+	return out == outEnd;
+}
+
+FUNCTION_DEF bool openArchive(Archive* out_archive, std::string fileName)
+{
+	Archive zero = {};
+	*out_archive = zero;
+	if (!mapFile(&out_archive->file, fileName)) {
+		return false;
+	}
+
+	File& file = out_archive->file;
+	Archive::Header& header = out_archive->header;
+	bool valid = file.byteCount >= sizeof(Archive::Header);
+	if (valid) {
+		memcpy(&header, file.bytes, sizeof(Archive::Header));
+		size_t tableEnd = sizeof(Archive::Header) + (size_t)header.slotCount*sizeof(Archive::Entry);
+		valid = header.magic == archiveMagic
+			&& header.version == archiveVersion
+			&& header.slotCount > header.entryCount
+			&& (header.slotCount & (header.slotCount-1)) == 0
+			&& tableEnd <= file.byteCount;
+	}
+	if (!valid) {
+		releaseFile(&file);
+		*out_archive = zero;
+		return false;
+	}
+	out_archive->slots = (Archive::Entry*)(file.bytes + sizeof(Archive::Header));
+	out_archive->names = file.bytes + sizeof(Archive::Header) + header.slotCount*sizeof(Archive::Entry);
+	size_t namesStart = out_archive->names - file.bytes;
+	size_t namesEnd = file.byteCount;
+	for (uint i=0; i<header.slotCount; i++) {
+		const Archive::Entry& entry = out_archive->slots[i];
+		if ((entry.flags & Archive::entry_used) && entry.offset >= namesStart && entry.offset < namesEnd) {
+			namesEnd = (size_t)entry.offset;
+		}
+	}
+	out_archive->nameByteCount = namesEnd - namesStart;
+	return true;
+}
+
+FUNCTION_DEF void closeArchive(Archive* archive)
+{
+	releaseFile(&archive->file);
+	Archive zero = {};
+	*archive = zero;
+}
+
+// Returns the entry with the name, or 0 if the archive doesn't have it
+FUNCTION_DEF Archive::Entry* findArchiveEntry(Archive& archive, const char* fileName)
+{
+	uint64 hash = hashArchiveName(fileName);
+	uint mask = archive.header.slotCount-1;
+	// There's always an empty slot, so probing stops
+	for (uint slot = (uint)hash & mask; ; slot = (slot+1) & mask)
+	{
+		Archive::Entry& entry = archive.slots[slot];
+		if (!(entry.flags & Archive::entry_used)) {
+			return 0;
+		}
+		// A corrupt name that isn't terminated inside the names can't match
+		if (entry.nameHash == hash && entry.nameOffset < archive.nameByteCount
+			&& memchr(archive.names + entry.nameOffset, 0, archive.nameByteCount - entry.nameOffset)
+			&& strcmp(archive.names + entry.nameOffset, fileName) == 0) {
+			return &entry;
+		}
+	}
+}
+
+/* Uncompressed files are borrowed straight from the archive's mapping,
+and compressed files are decompressed into a new buffer. */
+FUNCTION_DEF bool loadArchiveFile(File* out_file, Archive& archive, const char* fileName)
+{
+	File zero = {};
+	*out_file = zero;
+	Archive::Entry* entry = findArchiveEntry(archive, fileName);
+	if (!entry || entry->offset > archive.file.byteCount || entry->storedByteCount > archive.file.byteCount - entry->offset) {
+		return false;
+	}
+
+	char* storedBytes = archive.file.bytes + entry->offset;
+	if (!(entry->flags & Archive::entry_compressed)) {
+		// Only the stored bytes were checked against the archive's size
+		if (entry->byteCount != entry->storedByteCount) {
+			return false;
+		}
+		out_file->bytes = storedBytes;
+		out_file->byteCount = entry->byteCount;
+		out_file->storage = File::borrowed;
+		return true;
+	}
+
+	char* bytes = new char[entry->byteCount];
+	if (!decompressLZ4Block(bytes, entry->byteCount, storedBytes, entry->storedByteCount)) {
+		delete[] bytes;
+		return false;
+	}
+	out_file->bytes = bytes;
+	out_file->byteCount = entry->byteCount;
+	out_file->storage = File::heap;
+	return true;
+}
+
+/* Locations ending in .gobarchive are opened as archives, and everything else is a directory.
+Files loaded from an archive can point into it, so keep the FileSystem until they're released. */
+FUNCTION_DEF void addFileLocation(FileSystem* out_fs, std::string name)
+{
+	std::string extension = ".gobarchive";
+	if (name.size() > extension.size() && name.compare(name.size()-extension.size(), extension.size(), extension) == 0)
+	{
+		Archive archive;
+		if (openArchive(&archive, name)) {
+			out_fs->archives.push_back(archive);
+		}
+		return;
+	}
+	out_fs->fileLocations.push_back(name);
+}
+
+// Closes the FileSystem's archives
+FUNCTION_DEF void destroyFileSystem(FileSystem* fs)
+{
+	for (uint i=0; i<fs->archives.size(); i++) {
+		closeArchive(&fs->archives[i]);
+	}
+	fs->archives.clear();
+	fs->fileLocations.clear();
+}
+
 FUNCTION_DEF bool loadFile(File *out_file, FileSystem& fs, std::string fileName)
 {
+	for (uint i=0; i<fs.archives.size(); i++) {
+		if (loadArchiveFile(out_file, fs.archives[i], fileName.c_str())) {
+			return true;
+		}
+	}
 	// Look in each location in the FileSystem for the file
 	for (uint i=0; i<fs.fileLocations.size(); i++)
 	{
@@ -572,13 +1048,23 @@ FUNCTION_DEF bool loadFile(File *out_file, FileSystem& fs, std::string fileName)
 	return false;
 }
 
-FUNCTION_DEF void releaseFile(File* file)
+// Files in archives are borrowed or decompressed the same way as loadFile()
+FUNCTION_DEF bool mapFile(File *out_file, FileSystem& fs, std::string fileName)
 {
-	if (file->bytes) {
-		delete[] file->bytes;
+	for (uint i=0; i<fs.archives.size(); i++) {
+		if (loadArchiveFile(out_file, fs.archives[i], fileName.c_str())) {
+			return true;
+		}
+	}
+	for (uint i=0; i<fs.fileLocations.size(); i++)
+	{
+		std::string fullPath = fs.fileLocations[i] + "/" + fileName;
+		if (mapFile(out_file, fullPath)) {
+			return true;
+		}
 	}
-	file->bytes = 0;
-	file->byteCount = 0;
+	*out_file = {};
+	return false;
 }
 
 FUNCTION_DEF std::string getFileExtensionString(std::string fullFileName)
@@ -757,98 +1243,872 @@ joinThread(Thread* thread)
 	*thread = {0};
 }
 
-/*FUNCTION_DEF void
-createMutex()
+FUNCTION_DEF void createMutex(Mutex* out_mutex)
+{
+	#ifdef SDL
+		out_mutex->mutex = SDL_CreateMutex();
+	#else
+		InitializeCriticalSection(&out_mutex->criticalSection);
+	#endif
+}
+
+FUNCTION_DEF void destroyMutex(Mutex* mutex)
 {
+	#ifdef SDL
+		SDL_DestroyMutex(mutex->mutex);
+		mutex->mutex = 0;
+	#else
+		DeleteCriticalSection(&mutex->criticalSection);
+	#endif
+}
 
+FUNCTION_DEF void lockMutex(Mutex* mutex)
+{
+	#ifdef SDL
+		SDL_LockMutex(mutex->mutex);
+	#else
+		EnterCriticalSection(&mutex->criticalSection);
+	#endif
 }
 
-FUNCTION_DEF void
-destroyMutex()
+FUNCTION_DEF void unlockMutex(Mutex* mutex)
 {
+	#ifdef SDL
+		SDL_UnlockMutex(mutex->mutex);
+	#else
+		LeaveCriticalSection(&mutex->criticalSection);
+	#endif
+}
 
+FUNCTION_DEF void createCondVar(CondVar* out_condVar)
+{
+	#ifdef SDL
+		out_condVar->condVar = SDL_CreateCond();
+	#else
+		InitializeConditionVariable(&out_condVar->conditionVariable);
+	#endif
 }
 
-FUNCTION_DEF void
-lockMutex()
+FUNCTION_DEF void destroyCondVar(CondVar* condVar)
 {
+	#ifdef SDL
+		SDL_DestroyCond(condVar->condVar);
+		condVar->condVar = 0;
+	#endif
+	// Win32 condition variables don't need to be destroyed
+}
 
+// Unlocks the mutex while waiting, and locks it again before returning.
+// Can wake up without being signalled, so check the condition again after waiting.
+FUNCTION_DEF void waitCondVar(CondVar* condVar, Mutex* lockedMutex)
+{
+	#ifdef SDL
+		SDL_CondWait(condVar->condVar, lockedMutex->mutex);
+	#else
+		SleepConditionVariableCS(&condVar->conditionVariable, &lockedMutex->criticalSection, INFINITE);
+	#endif
 }
 
-FUNCTION_DEF void
-unlock_mutex()
+// Wakes one waiting thread
+FUNCTION_DEF void signalCondVar(CondVar* condVar)
 {
+	#ifdef SDL
+		SDL_CondSignal(condVar->condVar);
+	#else
+		WakeConditionVariable(&condVar->conditionVariable);
+	#endif
+}
 
+// Wakes every waiting thread
+FUNCTION_DEF void broadcastCondVar(CondVar* condVar)
+{
+	#ifdef SDL
+		SDL_CondBroadcast(condVar->condVar);
+	#else
+		WakeAllConditionVariable(&condVar->conditionVariable);
+	#endif
 }
 
-FUNCTION_DEF int
-threadJobIdleLoop(void* param)
+#ifdef WIN32
+	FUNCTION_DEF VOID WINAPI fiberEntry(LPVOID parameter)
+	{
+		Fiber* fiber = (Fiber*)parameter;
+		fiber->startRoutine(fiber->parameter);
+	}
+#else
+	// makecontext() only passes ints, so the pointer is split in two
+	FUNCTION_DEF void fiberEntry(uint pointerHigh, uint pointerLow)
+	{
+		Fiber* fiber = (Fiber*)(((uintptr_t)pointerHigh << 16 << 16) | (uintptr_t)pointerLow);
+		fiber->startRoutine(fiber->parameter);
+	}
+#endif
+
+/* Creates a fiber that will call startRoutine(parameter) when it's first switched to.
+startRoutine must never return; it switches to another fiber instead.
+The fiber must stay at the same address, since it's passed to its start routine. */
+FUNCTION_DEF void createFiber(Fiber* out_fiber, void(*startRoutine)(void*), void* parameter, size_t stackByteCount)
 {
-	ThreadPool::WorkerParams* params = (ThreadPool::WorkerParams*) param;
-	ThreadPool* pool = params->pool;
+	out_fiber->startRoutine = startRoutine;
+	out_fiber->parameter = parameter;
+	#ifdef WIN32
+		out_fiber->handle = CreateFiber(stackByteCount, fiberEntry, out_fiber);
+	#else
+		out_fiber->stack = new char[stackByteCount];
+		getcontext(&out_fiber->context);
+		out_fiber->context.uc_stack.ss_sp = out_fiber->stack;
+		out_fiber->context.uc_stack.ss_size = stackByteCount;
+		out_fiber->context.uc_link = 0;
+		uintptr_t pointer = (uintptr_t)out_fiber;
+		makecontext(&out_fiber->context, (void(*)())fiberEntry, 2, (uint)(pointer >> 16 >> 16), (uint)pointer);
+	#endif
+}
 
+FUNCTION_DEF void destroyFiber(Fiber* fiber)
+{
+	#ifdef WIN32
+		DeleteFiber(fiber->handle);
+		fiber->handle = 0;
+	#else
+		delete[] fiber->stack;
+		fiber->stack = 0;
+	#endif
+}
+
+// A thread has to become a fiber before it can switch to others
+FUNCTION_DEF void convertThreadToFiber(Fiber* out_fiber)
+{
+	out_fiber->startRoutine = 0;
+	out_fiber->parameter = 0;
+	#ifdef WIN32
+		out_fiber->handle = ConvertThreadToFiber(0);
+	#else
+		// The context is saved when it first switches away
+		out_fiber->stack = 0;
+	#endif
+}
+
+FUNCTION_DEF void convertFiberToThread(Fiber* fiber)
+{
+	#ifdef WIN32
+		ConvertFiberToThread();
+		fiber->handle = 0;
+	#else
+		// A thread's own context was never allocated, so there's nothing to free
+		(void)fiber;
+	#endif
+}
+
+// Saves the running fiber's state in from, and continues where to left off
+FUNCTION_DEF void switchToFiber(Fiber* from, Fiber* to)
+{
+	#ifdef WIN32
+		SwitchToFiber(to->handle);
+	#else
+		swapcontext(&from->context, &to->context);
+	#endif
+}
+
+// Orders the request heap so the highest priority, then earliest request, is at the front
+FUNCTION_DEF bool isAsyncFileRequestAfter(AsyncFileLoader::Request* a, AsyncFileLoader::Request* b)
+{
+	if (a->priority != b->priority) {
+		return a->priority < b->priority;
+	}
+	return a->order > b->order;
+}
+
+FUNCTION_DEF int asyncFileLoaderWorkerLoop(void* parameter)
+{
+	AsyncFileLoader* loader = (AsyncFileLoader*)parameter;
+	lockMutex(&loader->mutex);
+	while (1)
+	{
+		while (!loader->quitting && loader->queue.empty()) {
+			waitCondVar(&loader->requestsAvailable, &loader->mutex);
+		}
+		if (loader->quitting) {
+			break;
+		}
+
+		std::pop_heap(loader->queue.begin(), loader->queue.end(), isAsyncFileRequestAfter);
+		AsyncFileLoader::Request* request = loader->queue.back();
+		loader->queue.pop_back();
+		// Cancelled requests are left in the queue, and cleaned up here
+		if (request->cancelled) {
+			delete request;
+			continue;
+		}
+		request->status = AsyncFileStatus_loading;
+		unlockMutex(&loader->mutex);
+
+		// Each file is read with one big read, and the file system isn't changed after creation
+		File file;
+		bool success = loadFile(&file, loader->fileSystem, request->fileName);
+
+		lockMutex(&loader->mutex);
+		if (request->cancelled) {
+			releaseFile(&file);
+			delete request;
+			continue;
+		}
+		request->file = file;
+		request->success = success;
+		request->status = AsyncFileStatus_loaded;
+		loader->loaded.push_back(request);
+	}
+	unlockMutex(&loader->mutex);
+	return 0;
+}
+
+/* Starts workerCount I/O threads, which look for files in the file system's locations.
+A few workers are enough to keep a disk busy; more only help with slow or network drives.
+The loader shares fs's archives, so keep fs until the loader is destroyed. */
+FUNCTION_DEF void createAsyncFileLoader(AsyncFileLoader* out_loader, const FileSystem& fs, uint workerCount = 2)
+{
+	out_loader->fileSystem = fs;
+	out_loader->queue.clear();
+	out_loader->loaded.clear();
+	out_loader->requests.clear();
+	out_loader->nextHandle = 1;
+	out_loader->nextOrder = 0;
+	out_loader->quitting = false;
+	createMutex(&out_loader->mutex);
+	createCondVar(&out_loader->requestsAvailable);
+
+	out_loader->workerCount = workerCount;
+	out_loader->workers = new Thread[workerCount];
+	forloop(i, workerCount) {
+		createThread(&out_loader->workers[i], asyncFileLoaderWorkerLoop, out_loader);
+	}
+}
+
+// Stops the workers. Files that were loaded but not handed to their callbacks are released.
+FUNCTION_DEF void destroyAsyncFileLoader(AsyncFileLoader* loader)
+{
+	lockMutex(&loader->mutex);
+	loader->quitting = true;
+	broadcastCondVar(&loader->requestsAvailable);
+	unlockMutex(&loader->mutex);
+	forloop(i, loader->workerCount) {
+		joinThread(&loader->workers[i]);
+	}
+	delete[] loader->workers;
+	loader->workers = 0;
+	loader->workerCount = 0;
+
+	// Every request is either in the queue or the loaded list, unless it was cancelled
+	for (uint i=0; i<loader->queue.size(); i++) {
+		delete loader->queue[i];
+	}
+	for (uint i=0; i<loader->loaded.size(); i++) {
+		releaseFile(&loader->loaded[i]->file);
+		delete loader->loaded[i];
+	}
+	loader->queue.clear();
+	loader->loaded.clear();
+	loader->requests.clear();
+	destroyCondVar(&loader->requestsAvailable);
+	destroyMutex(&loader->mutex);
+}
+
+// Higher priorities are loaded first
+FUNCTION_DEF AsyncFileHandle loadFileAsync(AsyncFileLoader* loader, std::string fileName, AsyncFileCallback callback, void* userData, int priority = 0)
+{
+	assert(callback);
+	AsyncFileLoader::Request* request = new AsyncFileLoader::Request;
+	request->priority = priority;
+	request->fileName = fileName;
+	request->callback = callback;
+	request->userData = userData;
+	request->status = AsyncFileStatus_queued;
+	request->cancelled = false;
+	request->success = false;
+	request->file = {};
+
+	lockMutex(&loader->mutex);
+	request->handle = loader->nextHandle++;
+	request->order = loader->nextOrder++;
+	loader->requests[request->handle] = request;
+	loader->queue.push_back(request);
+	std::push_heap(loader->queue.begin(), loader->queue.end(), isAsyncFileRequestAfter);
+	signalCondVar(&loader->requestsAvailable);
+	unlockMutex(&loader->mutex);
+	return request->handle;
+}
+
+FUNCTION_DEF AsyncFileStatus getAsyncFileStatus(AsyncFileLoader* loader, AsyncFileHandle handle)
+{
+	AsyncFileStatus status = AsyncFileStatus_finished;
+	lockMutex(&loader->mutex);
+	std::unordered_map<AsyncFileHandle, AsyncFileLoader::Request*>::iterator found = loader->requests.find(handle);
+	if (found != loader->requests.end()) {
+		status = found->second->status;
+	}
+	unlockMutex(&loader->mutex);
+	return status;
+}
+
+/* The request's callback won't be called. A file that's already loading finishes,
+and is released by the worker. Returns false if the callback was already called. */
+FUNCTION_DEF bool cancelAsyncFileRequest(AsyncFileLoader* loader, AsyncFileHandle handle)
+{
+	lockMutex(&loader->mutex);
+	std::unordered_map<AsyncFileHandle, AsyncFileLoader::Request*>::iterator found = loader->requests.find(handle);
+	if (found == loader->requests.end()) {
+		unlockMutex(&loader->mutex);
+		return false;
+	}
+	AsyncFileLoader::Request* request = found->second;
+	loader->requests.erase(found);
+	if (request->status == AsyncFileStatus_loaded)
+	{
+		// Nothing else refers to a loaded request
+		loader->loaded.erase(std::find(loader->loaded.begin(), loader->loaded.end(), request));
+		releaseFile(&request->file);
+		delete request;
+	}
+	else {
+		// The worker that takes it off the queue, or is loading it, deletes it
+		request->cancelled = true;
+	}
+	unlockMutex(&loader->mutex);
+	return true;
+}
+
+/* Calls the callbacks of loaded files, in the order they finished.
+Stops once budgetSeconds have passed, leaving the rest for the next update,
+so a burst of loads can't take over a frame. At least one callback is called each update.
+Returns how many callbacks were called. */
+FUNCTION_DEF uint updateAsyncFileLoader(AsyncFileLoader* loader, double budgetSeconds)
+{
+	int64 startTime = getGlobalTime();
+	int64 budgetTicks = (int64)(budgetSeconds * getTicksPerSecond());
+	uint callbackCount = 0;
 	while (1)
 	{
-		lockMutex(pool->queueMutex);
-		// Find the first job in the list that hasn't started
-		ThreadPool::Job* job = 0;
-		for (uint i=pool->jobQueue.size(); i>=0; --i) {
-			if (pool->jobQueue[i].status == ThreadPool::Job::enqueued) {
-				job = &pool->jobQueue[i];
+		lockMutex(&loader->mutex);
+		if (loader->loaded.empty()) {
+			unlockMutex(&loader->mutex);
+			break;
+		}
+		AsyncFileLoader::Request* request = loader->loaded.front();
+		loader->loaded.pop_front();
+		loader->requests.erase(request->handle);
+		unlockMutex(&loader->mutex);
+
+		// Called without the lock, so callbacks can make more requests
+		request->callback(request->userData, request->handle, &request->file, request->success);
+		delete request;
+		callbackCount++;
+
+		if (getGlobalTime() - startTime >= budgetTicks) {
+			break;
+		}
+	}
+	return callbackCount;
+}
+
+FUNCTION_DEF uint getProcessorCount()
+{
+	#ifdef SDL
+		return (uint)SDL_GetCPUCount();
+	#else
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return (uint)info.dwNumberOfProcessors;
+	#endif
+}
+
+// The pool the current thread is a worker of, so jobs it adds go in its own queue
+static thread_local ThreadPool* currentThreadPool = 0;
+static thread_local uint currentThreadPoolWorker = 0;
+// The fiber the current worker is running a job on, in fiber mode
+static thread_local ThreadPool::JobFiber* currentJobFiber = 0;
+static thread_local goblin::FrameArena* currentScratchArena = 0;
+
+// Jobs on fibers can move between threads when they wait, so these read the thread_locals again every time
+PLATFORM_NOINLINE FUNCTION_DEF uint getCurrentJobQueueIndex(ThreadPool* pool)
+{
+	return (currentThreadPool == pool) ? currentThreadPoolWorker : pool->workerCount;
+}
+
+PLATFORM_NOINLINE FUNCTION_DEF ThreadPool::JobFiber* getCurrentJobFiber()
+{
+	return currentJobFiber;
+}
+
+/* Scratch memory for the job running on the current thread, so jobs don't need the heap:
+its worker's arena, or the one a thread that isn't a worker gave setThreadScratchArena().
+Returns 0 if the thread has neither. Jobs pop back to where they started before they return or wait,
+since a job that waits can be resumed on another thread. */
+PLATFORM_NOINLINE FUNCTION_DEF goblin::FrameArena* getThreadScratchArena()
+{
+	return currentScratchArena;
+}
+
+// For threads that aren't workers, like the main thread, to give the jobs they run scratch memory
+PLATFORM_NOINLINE FUNCTION_DEF void setThreadScratchArena(goblin::FrameArena* arena)
+{
+	currentScratchArena = arena;
+}
+
+// Relaxed, since the queue's top and bottom order the slots with everything else
+FUNCTION_DEF void writeJobSlot(ThreadPool::JobSlot* slot, const ThreadPool::Job& job)
+{
+	slot->startRoutine.store(job.startRoutine, std::memory_order_relaxed);
+	slot->parameter.store(job.parameter, std::memory_order_relaxed);
+	slot->counter.store(job.counter, std::memory_order_relaxed);
+}
+
+FUNCTION_DEF ThreadPool::Job readJobSlot(const ThreadPool::JobSlot* slot)
+{
+	ThreadPool::Job job;
+	job.startRoutine = slot->startRoutine.load(std::memory_order_relaxed);
+	job.parameter = slot->parameter.load(std::memory_order_relaxed);
+	job.counter = slot->counter.load(std::memory_order_relaxed);
+	return job;
+}
+
+// Only the queue's owner can push. Returns false if the queue is full.
+FUNCTION_DEF bool pushJobQueue(ThreadPool::JobQueue* queue, const ThreadPool::Job& job)
+{
+	int64 bottom = queue->bottom.load(std::memory_order_relaxed);
+	int64 top = queue->top.load(std::memory_order_acquire);
+	if (bottom - top >= (int64)ThreadPool::maxQueuedJobs) {
+		return false;
+	}
+	writeJobSlot(&queue->jobs[bottom & (ThreadPool::maxQueuedJobs-1)], job);
+	// The job has to be written before thieves can see the new bottom
+	queue->bottom.store(bottom+1, std::memory_order_release);
+	return true;
+}
+
+// Only the queue's owner can pop. Takes the newest job, whose data is most likely still in cache.
+FUNCTION_DEF bool popJobQueue(ThreadPool::JobQueue* queue, ThreadPool::Job* out_job)
+{
+	int64 bottom = queue->bottom.load(std::memory_order_relaxed) - 1;
+	queue->bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64 top = queue->top.load(std::memory_order_relaxed);
+	if (top > bottom) {
+		queue->bottom.store(bottom+1, std::memory_order_relaxed);
+		return false;
+	}
+	*out_job = readJobSlot(&queue->jobs[bottom & (ThreadPool::maxQueuedJobs-1)]);
+	if (top == bottom) {
+		// The last job, which a thief might be taking at the same time
+		bool taken = queue->top.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		queue->bottom.store(bottom+1, std::memory_order_relaxed);
+		return taken;
+	}
+	return true;
+}
+
+// Any thread can steal. Takes the oldest job, and fails if another thread took it first.
+FUNCTION_DEF bool stealJobQueue(ThreadPool::JobQueue* queue, ThreadPool::Job* out_job)
+{
+	int64 top = queue->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64 bottom = queue->bottom.load(std::memory_order_acquire);
+	if (top >= bottom) {
+		return false;
+	}
+	// The owner can't reuse this slot until top moves past it,
+	// and if another thief moved it the job is thrown away
+	*out_job = readJobSlot(&queue->jobs[top & (ThreadPool::maxQueuedJobs-1)]);
+	return queue->top.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+// Takes a job from the current thread's queue, or steals one from another
+FUNCTION_DEF bool takeThreadPoolJob(ThreadPool* pool, ThreadPool::Job* out_job)
+{
+	uint queueCount = pool->workerCount + 1;
+	uint ownIndex = getCurrentJobQueueIndex(pool);
+	bool taken;
+	if (ownIndex == pool->workerCount) {
+		lockMutex(&pool->sharedQueueMutex);
+		taken = popJobQueue(&pool->queues[ownIndex], out_job);
+		unlockMutex(&pool->sharedQueueMutex);
+	}
+	else {
+		taken = popJobQueue(&pool->queues[ownIndex], out_job);
+	}
+	// Starting from the next queue along spreads thieves over the queues
+	for (uint i=1; i<queueCount && !taken; i++) {
+		taken = stealJobQueue(&pool->queues[(ownIndex+i) % queueCount], out_job);
+	}
+	if (taken) {
+		pool->queuedJobCount.fetch_sub(1, std::memory_order_seq_cst);
+	}
+	return taken;
+}
+
+FUNCTION_DEF void runThreadPoolJob(ThreadPool* pool, const ThreadPool::Job& job)
+{
+	job.startRoutine(job.parameter);
+	if (job.counter) {
+		int unfinishedCount = job.counter->unfinishedCount.fetch_sub(1, std::memory_order_release) - 1;
+		// A fiber might be waiting for this counter, so make sure a worker looks.
+		// The counter can't be touched after this, since its waiter may already have gone on.
+		if (unfinishedCount == 0 && pool->fiberCount > 0) {
+			pool->counterFinishedCount.fetch_add(1, std::memory_order_seq_cst);
+			if (pool->sleepingWorkerCount.load(std::memory_order_seq_cst) > 0) {
+				lockMutex(&pool->sleepMutex);
+				signalCondVar(&pool->jobsAvailable);
+				unlockMutex(&pool->sleepMutex);
 			}
 		}
-		
-		if (job) {
-			lockMutex(job->mutex);
-			job->status = ThreadPool::Job::started;
-			unlockMutex(job->mutex);
-			job->startRoutine(job->param);
-			lockMutex(job->mutex);
-			job->status = ThreadPool::Job::finished;
-			condVarBroadcast(job->finishCond);
-			unlockMutex(job->mutex);
+	}
+}
+
+// A job fiber runs jobs until the pool is destroyed, switching back to its worker after each one
+FUNCTION_DEF void jobFiberLoop(void* parameter)
+{
+	ThreadPool::JobFiber* fiber = (ThreadPool::JobFiber*)parameter;
+	while (1) {
+		runThreadPoolJob(fiber->pool, fiber->job);
+		switchToFiber(&fiber->fiber, fiber->scheduler);
+	}
+}
+
+// Takes a waiting fiber whose counter has reached zero
+FUNCTION_DEF ThreadPool::JobFiber* takeReadyJobFiber(ThreadPool* pool)
+{
+	ThreadPool::JobFiber* ready = 0;
+	lockMutex(&pool->fiberMutex);
+	for (size_t i=0; i<pool->waitingFibers.size(); i++) {
+		ThreadPool::JobFiber* fiber = pool->waitingFibers[i];
+		if (fiber->waitCounter->unfinishedCount.load(std::memory_order_acquire) <= 0) {
+			pool->waitingFibers.erase(pool->waitingFibers.begin() + i);
+			fiber->waitCounter = 0;
+			ready = fiber;
+			break;
+		}
+	}
+	unlockMutex(&pool->fiberMutex);
+	return ready;
+}
+
+/* Resumes a fiber that has finished waiting, or starts the next job on a free fiber.
+Returns false if there was nothing to do. */
+FUNCTION_DEF bool runNextJobFiber(ThreadPool* pool, uint workerIndex)
+{
+	// Waiting jobs go first, so they finish and free their fibers
+	ThreadPool::JobFiber* fiber = takeReadyJobFiber(pool);
+	if (!fiber)
+	{
+		ThreadPool::Job job;
+		if (!takeThreadPoolJob(pool, &job)) {
+			return false;
+		}
+		lockMutex(&pool->fiberMutex);
+		if (!pool->freeFibers.empty()) {
+			fiber = pool->freeFibers.back();
+			pool->freeFibers.pop_back();
+		}
+		unlockMutex(&pool->fiberMutex);
+		if (!fiber) {
+			// Every fiber is waiting, so this job runs on the worker's own stack, and helps while it waits
+			runThreadPoolJob(pool, job);
+			return true;
+		}
+		fiber->job = job;
+	}
+
+	Fiber* scheduler = &pool->workerFibers[workerIndex];
+	fiber->scheduler = scheduler;
+	currentJobFiber = fiber;
+	switchToFiber(scheduler, &fiber->fiber);
+	currentJobFiber = 0;
+
+	// The job finished or is waiting. Only now that this thread is off the fiber's stack can another resume it.
+	lockMutex(&pool->fiberMutex);
+	if (fiber->waitCounter) {
+		pool->waitingFibers.push_back(fiber);
+	}
+	else {
+		pool->freeFibers.push_back(fiber);
+	}
+	unlockMutex(&pool->fiberMutex);
+	return true;
+}
+
+FUNCTION_DEF int threadPoolWorkerLoop(void* parameter)
+{
+	ThreadPool::WorkerParams* params = (ThreadPool::WorkerParams*)parameter;
+	ThreadPool* pool = params->pool;
+	currentThreadPool = pool;
+	currentThreadPoolWorker = params->workerIndex;
+	currentScratchArena = &pool->scratchArenas[params->workerIndex];
+	if (pool->fiberCount > 0) {
+		convertThreadToFiber(&pool->workerFibers[params->workerIndex]);
+	}
+
+	while (!pool->quitting.load(std::memory_order_relaxed))
+	{
+		uint seenCounterFinishedCount = pool->counterFinishedCount.load(std::memory_order_seq_cst);
+		if (pool->fiberCount > 0) {
+			if (runNextJobFiber(pool, params->workerIndex)) {
+				continue;
+			}
 		}
 		else {
-			condVarWait(pool->queueCond, pool->queueMutex);
+			ThreadPool::Job job;
+			if (takeThreadPoolJob(pool, &job)) {
+				runThreadPoolJob(pool, job);
+				continue;
+			}
+		}
+
+		/* Sleep until there are jobs, or a waiting fiber might be ready. Adding a job or finishing a counter
+		increments its count before checking sleepingWorkerCount, and this does the opposite,
+		so one of them always sees the other. */
+		lockMutex(&pool->sleepMutex);
+		pool->sleepingWorkerCount.fetch_add(1, std::memory_order_seq_cst);
+		while (pool->queuedJobCount.load(std::memory_order_seq_cst) <= 0
+			&& pool->counterFinishedCount.load(std::memory_order_seq_cst) == seenCounterFinishedCount
+			&& !pool->quitting.load(std::memory_order_relaxed))
+		{
+			waitCondVar(&pool->jobsAvailable, &pool->sleepMutex);
 		}
-		unlockMutex(pool->queueMutex);
+		pool->sleepingWorkerCount.fetch_sub(1, std::memory_order_seq_cst);
+		unlockMutex(&pool->sleepMutex);
+	}
+
+	if (pool->fiberCount > 0) {
+		convertFiberToThread(&pool->workerFibers[params->workerIndex]);
 	}
 	return 0;
 }
 
-FUNCTION_DEF void
-createThreadPool(ThreadPool* pool)
+/* Starts workerCount worker threads, or one less than the number of processors if it's 0,
+since the thread that waits for jobs helps run them.
+If fiberCount isn't 0, workers run jobs on that many fibers, which is the most jobs that can be waiting at once.
+Once they're all waiting, workers run jobs on their own stacks, and those help while they wait, resuming fibers that are ready as well as starting jobs.
+Each worker gets a scratch arena of scratchByteCount bytes for its jobs. */
+FUNCTION_DEF void createThreadPool(ThreadPool* out_pool, uint workerCount = 0, uint fiberCount = 0, size_t scratchByteCount = ThreadPool::defaultScratchByteCount)
+{
+	if (workerCount == 0) {
+		uint processorCount = getProcessorCount();
+		workerCount = (processorCount > 1) ? processorCount-1 : 1;
+	}
+	out_pool->workerCount = workerCount;
+	out_pool->queues = new ThreadPool::JobQueue[workerCount+1]();
+	forloop(i, workerCount+1) {
+		out_pool->queues[i].jobs = new ThreadPool::JobSlot[ThreadPool::maxQueuedJobs]();
+	}
+	createMutex(&out_pool->sharedQueueMutex);
+	out_pool->queuedJobCount = 0;
+	out_pool->sleepingWorkerCount = 0;
+	out_pool->quitting = false;
+	createMutex(&out_pool->sleepMutex);
+	createCondVar(&out_pool->jobsAvailable);
+
+	out_pool->fiberCount = fiberCount;
+	out_pool->counterFinishedCount = 0;
+	out_pool->freeFibers.clear();
+	out_pool->waitingFibers.clear();
+	out_pool->fibers = 0;
+	out_pool->workerFibers = 0;
+	if (fiberCount > 0) {
+		createMutex(&out_pool->fiberMutex);
+		out_pool->workerFibers = new Fiber[workerCount];
+		out_pool->fibers = new ThreadPool::JobFiber[fiberCount]();
+		forloop(i, fiberCount) {
+			ThreadPool::JobFiber* fiber = &out_pool->fibers[i];
+			fiber->pool = out_pool;
+			createFiber(&fiber->fiber, jobFiberLoop, fiber, ThreadPool::fiberStackByteCount);
+			out_pool->freeFibers.push_back(fiber);
+		}
+	}
+
+	out_pool->scratchArenas = new goblin::FrameArena[workerCount];
+	forloop(i, workerCount) {
+		goblin::createFrameArena(&out_pool->scratchArenas[i], scratchByteCount);
+	}
+
+	out_pool->workers = new Thread[workerCount];
+	out_pool->workerParams = new ThreadPool::WorkerParams[workerCount];
+	forloop(i, workerCount) {
+		out_pool->workerParams[i].pool = out_pool;
+		out_pool->workerParams[i].workerIndex = i;
+		createThread(&out_pool->workers[i], threadPoolWorkerLoop, &out_pool->workerParams[i]);
+	}
+}
+
+// Stops the workers. Wait for any jobs that were added first, since queued and waiting jobs won't run.
+FUNCTION_DEF void destroyThreadPool(ThreadPool* pool)
 {
-	*pool = {0};
-	pool->threadCount = SDL_GetCPUCount();
-	pool->threads = ALLOC_ARRAY(Thread, pool->threadCount);
-	forloop(i, pool->threadCount) {
-		createThread(&pool->threads[i], threadJobIdleLoop, pool);
+	lockMutex(&pool->sleepMutex);
+	pool->quitting = true;
+	broadcastCondVar(&pool->jobsAvailable);
+	unlockMutex(&pool->sleepMutex);
+	forloop(i, pool->workerCount) {
+		joinThread(&pool->workers[i]);
 	}
-	pool->queueCond = SDL_CreateCond();
-	pool->queueMutex = SDL_CreateMutex();
+	delete[] pool->workers;
+	delete[] pool->workerParams;
+	forloop(i, pool->workerCount) {
+		goblin::destroyFrameArena(&pool->scratchArenas[i]);
+	}
+	delete[] pool->scratchArenas;
+	forloop(i, pool->workerCount+1) {
+		delete[] pool->queues[i].jobs;
+	}
+	delete[] pool->queues;
+	destroyMutex(&pool->sharedQueueMutex);
+	destroyMutex(&pool->sleepMutex);
+	destroyCondVar(&pool->jobsAvailable);
+	if (pool->fiberCount > 0) {
+		forloop(i, pool->fiberCount) {
+			destroyFiber(&pool->fibers[i].fiber);
+		}
+		delete[] pool->fibers;
+		delete[] pool->workerFibers;
+		destroyMutex(&pool->fiberMutex);
+		pool->freeFibers.clear();
+		pool->waitingFibers.clear();
+		pool->fibers = 0;
+		pool->workerFibers = 0;
+		pool->fiberCount = 0;
+	}
+	pool->workerCount = 0;
+	pool->workers = 0;
+	pool->workerParams = 0;
+	pool->scratchArenas = 0;
+	pool->queues = 0;
 }
 
-FUNCTION_DEF ThreadJobHandle
-addThreadJob(ThreadPool* pool, int(*startRoutine)(void*), void* parameter)
+/* Queues a job to call startRoutine(parameter) on some thread.
+If counter isn't null, it counts the job until it has finished.
+Jobs can add more jobs, which go in their worker's own queue. */
+FUNCTION_DEF void addThreadJob(ThreadPool* pool, int(*startRoutine)(void*), void* parameter, JobCounter* counter = 0)
 {
-	ThreadJobHandle jobHandle = {0};
-	ThreadPool::Job job ={0};
-	job.param = parameter;
-	job.startRoutine = startRoutine;
-	pool->jobQueue.push_front(job);
-	return jobHandle;
+	if (counter) {
+		counter->unfinishedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	ThreadPool::Job job = {startRoutine, parameter, counter};
+	uint queueIndex = getCurrentJobQueueIndex(pool);
+	bool pushed;
+	if (queueIndex == pool->workerCount) {
+		lockMutex(&pool->sharedQueueMutex);
+		pushed = pushJobQueue(&pool->queues[queueIndex], job);
+		unlockMutex(&pool->sharedQueueMutex);
+	}
+	else {
+		pushed = pushJobQueue(&pool->queues[queueIndex], job);
+	}
+	if (!pushed) {
+		runThreadPoolJob(pool, job);
+		return;
+	}
+
+	pool->queuedJobCount.fetch_add(1, std::memory_order_seq_cst);
+	if (pool->sleepingWorkerCount.load(std::memory_order_seq_cst) > 0) {
+		lockMutex(&pool->sleepMutex);
+		signalCondVar(&pool->jobsAvailable);
+		unlockMutex(&pool->sleepMutex);
+	}
 }
 
-FUNCTION_DEF void
-joinThreadJob(ThreadJobHandle job)
+/* Runs queued jobs until every job counted by counter has finished, instead of blocking.
+This can be called from inside a job, to wait for jobs it depends on.
+It may run jobs that have nothing to do with the counter, so it can take longer to return than they do.
+In fiber mode, a job on a fiber is put aside instead, and resumed by a worker once the counter reaches zero.
+It may be resumed on a different thread. */
+FUNCTION_DEF void waitForJobCounter(ThreadPool* pool, JobCounter* counter)
 {
-	while (!job->worker->done) {
-		condWait(job->worker->finishCond);
-		condBroadcast(job->worker->restartCond);
+	ThreadPool::JobFiber* fiber = getCurrentJobFiber();
+	if (fiber && fiber->pool == pool) {
+		if (counter->unfinishedCount.load(std::memory_order_acquire) > 0) {
+			// The worker adds the fiber to the waiting list once it has switched away from it
+			fiber->waitCounter = counter;
+			switchToFiber(&fiber->fiber, fiber->scheduler);
+		}
+		return;
 	}
-}*/
 
+	/* A worker gets here in fiber mode when every fiber was waiting, so it ran a job on its own stack.
+	What that job waits for may be a fiber's job, so it resumes ready fibers as well as starting jobs. */
+	bool fiberWorker = (currentThreadPool == pool && pool->fiberCount > 0);
+	while (counter->unfinishedCount.load(std::memory_order_acquire) > 0)
+	{
+		if (fiberWorker) {
+			if (!runNextJobFiber(pool, currentThreadPoolWorker)) {
+				std::this_thread::yield();
+			}
+			continue;
+		}
+		ThreadPool::Job job;
+		if (takeThreadPoolJob(pool, &job)) {
+			runThreadPoolJob(pool, job);
+		}
+		else {
+			// The jobs left are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+// Processes the items from first to first+count-1
+typedef void (*ParallelForFunction)(void* parameter, uint first, uint count);
+
+// Shared by every thread working on one parallelFor(), which each take ranges until there are none left
+struct ParallelForState
+{
+	ParallelForFunction function;
+	void* parameter;
+	uint count;
+	uint grainSize;
+	std::atomic<uint64> nextFirst; // 64 bits, so threads adding past the end of a huge count can't wrap around
+};
+
+FUNCTION_DEF int runParallelForJob(void* parameter)
+{
+	ParallelForState* state = (ParallelForState*)parameter;
+	while (1) {
+		uint64 first = state->nextFirst.fetch_add(state->grainSize, std::memory_order_relaxed);
+		if (first >= state->count) {
+			return 0;
+		}
+		state->function(state->parameter, (uint)first, std::min(state->grainSize, state->count - (uint)first));
+	}
+}
+
+/* Calls function on ranges of grainSize items at a time, across the pool's threads,
+and returns once all count items are done. The calling thread does the first range itself,
+then takes ranges along with the workers.
+There's at most one job per worker, whatever the count, so this doesn't allocate anything.
+Pick a grain size that makes each range worth more than the cost of a job, around tens of microseconds. */
+FUNCTION_DEF void parallelFor(ThreadPool* pool, uint count, uint grainSize, ParallelForFunction function, void* parameter)
+{
+	if (grainSize == 0) {
+		grainSize = 1;
+	}
+	uint rangeCount = (count + grainSize-1) / grainSize;
+	if (rangeCount <= 1) {
+		if (count > 0) {
+			function(parameter, 0, count);
+		}
+		return;
+	}
+
+	ParallelForState state;
+	state.function = function;
+	state.parameter = parameter;
+	state.count = count;
+	state.grainSize = grainSize;
+	state.nextFirst = grainSize;
+	JobCounter counter = {};
+	uint jobCount = std::min(rangeCount-1, pool->workerCount);
+	for (uint i=0; i<jobCount; i++) {
+		addThreadJob(pool, runParallelForJob, &state, &counter);
+	}
+	function(parameter, 0, grainSize);
+	runParallelForJob(&state);
+	waitForJobCounter(pool, &counter);
+}
 
 } // namespace
 #endif // include guard
\ No newline at end of file
@@ -24,8 +24,24 @@
 
 #include "Algebra.h"
 #include <string.h>
+#include <assert.h>
 #include <string>
 
+/* GamePlatform.h's job system, which the parallel functions here and in SkeletonAnimation.h run on.
+It's only declared here, so this doesn't have to include GamePlatform.h.
+Define GOBLIN_DISABLE_THREAD_POOL to build without GamePlatform.h; the parallel functions then run on the calling thread. */
+namespace goblin {
+struct FrameArena;
+}
+namespace platform {
+struct ThreadPool;
+#ifndef GOBLIN_DISABLE_THREAD_POOL
+typedef void (*ParallelForFunction)(void* parameter, unsigned int first, unsigned int count);
+void parallelFor(ThreadPool* pool, unsigned int count, unsigned int grainSize, ParallelForFunction function, void* parameter);
+goblin::FrameArena* getThreadScratchArena();
+#endif
+}
+
 namespace goblin {
 
 static const int maxShaderVariableNameLength = 64;
@@ -33,6 +49,12 @@ static const int maxShaderVariableNameLength = 64;
 void goblinDebugLog(const char* message);
 void goblinDebugLog(const char* fileName, const char* functionName, int lineNumber, GLenum errorCode);
 
+/* platform::parallelFor() on pool, or function(parameter, 0, count) on the calling thread
+when pool is 0 or GOBLIN_DISABLE_THREAD_POOL is defined. */
+void goblinParallelFor(platform::ThreadPool* pool, unsigned int count, unsigned int grainSize, void (*function)(void* parameter, unsigned int first, unsigned int count), void* parameter);
+// platform::getThreadScratchArena(), or 0 when GOBLIN_DISABLE_THREAD_POOL is defined
+FrameArena* goblinThreadScratchArena();
+
 class BinaryReader
 {
 public:
@@ -48,6 +70,32 @@ private:
 	size_t _readPosition;
 };
 
+/* A linear allocator for scratch memory that only lives for a frame, like temporary poses while blending.
+Pushing just moves an offset forward, and everything is freed at once by resetFrameArena().
+The memory is allocated once by createFrameArena(), so using it never touches the heap.
+Running out of space is a programming error; use peakByteCount to size it. */
+struct FrameArena
+{
+	char* memory;
+	size_t byteCount;
+	size_t usedByteCount;
+	size_t peakByteCount;
+};
+
+void createFrameArena(FrameArena* out_arena, size_t byteCount);
+void destroyFrameArena(FrameArena* arena);
+// Frees everything pushed to the arena
+void resetFrameArena(FrameArena* arena);
+// Returns 0 if the arena is full
+void* pushFrameArena(FrameArena* arena, size_t byteCount, size_t alignment=16);
+template<typename T>
+T* pushFrameArenaArray(FrameArena* arena, size_t count) {
+	return (T*)pushFrameArena(arena, sizeof(T)*count, alignof(T) > 16 ? alignof(T) : 16);
+}
+// Get a marker before pushing temporary memory, then pop back to it to free only that memory
+size_t getFrameArenaMarker(FrameArena* arena);
+void popFrameArenaToMarker(FrameArena* arena, size_t marker);
+
 enum CullingMode {
 	CullingMode_unchanged,
 	CullingMode_none,
@@ -128,6 +176,14 @@ bool createRenderStateD3D(RenderState* rs, ID3D11Device* device, ID3D11DeviceCon
 
 void render(RenderState* rs);
 void renderRange(RenderState* rs, unsigned int firstTriangleIndex, unsigned int trianglesToRender);
+// A run of triangles in the bound mesh
+struct TriangleRange
+{
+	unsigned int firstTriangle;
+	unsigned int triangleCount;
+};
+// Same as calling renderRange() for each range, but with as few draw calls as the API allows
+void renderRanges(RenderState* rs, const TriangleRange* ranges, unsigned int rangeCount);
 void renderInstanced(RenderState* rs, int instances);
 void waitForCompletion(RenderState* rs);
 
@@ -145,7 +201,18 @@ struct VertexDataType
 		tangents_4floats,
 		colors_4ubytes,
 		jointIndices_4ints,
-		jointWeights_4floats
+		jointWeights_4floats,
+		/* Compact formats, which the shader sees as floats in the same ranges,
+		except for octahedral ones, which it must decode itself:
+		vec3 n = vec3(e.xy, 1-abs(e.x)-abs(e.y)); float t = max(-n.z, 0); n.xy -= sign(n.xy)*t; n = normalize(n); */
+		uvs_2halfs,
+		normals_2snorm16Octahedral,
+		// The octahedral tangent direction, then the bitangent sign as -1 or 1, then 0
+		tangents_4snorm16Octahedral,
+		jointIndices_4ubytes,
+		jointWeights_4unorm16,
+		// For skeletons with more than 256 joints
+		jointIndices_4ushorts
 	};
 
 	char nameInShader[maxShaderVariableNameLength];
@@ -160,12 +227,19 @@ struct VertexLayout
 
 void createVertexLayout(VertexLayout* out_layout, VertexDataType* dataTypes, unsigned int dataTypeCount);
 void createBasicVertexLayout(VertexLayout* out_layout);
+unsigned int getVertexFormatByteCount(VertexDataType::Format format);
 
 struct IndexedTriangle
 {
 	unsigned int vertexIndex[3];
 };
 
+// For meshes with fewer than 65536 vertices
+struct IndexedTriangle16
+{
+	unsigned short vertexIndex[3];
+};
+
 struct Mesh
 {
 	unsigned int triangleCount;
@@ -182,17 +256,107 @@ struct Mesh
 		ID3D11Buffer** d3dVertexBuffers;
 		unsigned int* d3dVertexBufferStrides;
 		unsigned int* d3dVertexBufferOffsets;
+		DXGI_FORMAT d3dIndexFormat;
 	#endif
 };
 
 void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int faceCount, unsigned int vertexCount, unsigned short *faces, void* interleavedVertexData);
 void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int faceCount, unsigned int vertexCount, IndexedTriangle *faces, Vec3* positions, Vec2* uvs=0, Vec3* normals=0, Vec4 *tangents=0, unsigned int* boneIndices=0, float* boneWeights=0);
-void fillVertexTangentArray(Vec4 *out_tangents, unsigned int faceCount, unsigned int vertexCount, IndexedTriangle *faces, Vec3 *positions, Vec2 *uvs, Vec3 *normals);
+/* One vertex buffer per entry in layout, with vertexStreams[i] in the format of layout.dataTypes[i].
+A stream that is 0 leaves that attribute unset.
+bytesPerIndex is 2 for IndexedTriangle16 faces, or 4 for IndexedTriangle faces. */
+void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int faceCount, unsigned int vertexCount, const void* faces, unsigned int bytesPerIndex, const void* const* vertexStreams);
+void fillVertexTangentArray(Vec4 *out_tangents, unsigned int faceCount, unsigned int vertexCount, const IndexedTriangle *faces, const Vec3 *positions, const Vec2 *uvs, const Vec3 *normals);
+/* Same result as fillVertexTangentArray(), apart from float rounding, spread across pool's workers and the calling thread.
+With no pool, it's fillVertexTangentArray(). */
+void fillVertexTangentArrayParallel(Vec4 *out_tangents, unsigned int faceCount, unsigned int vertexCount, const IndexedTriangle *faces, const Vec3 *positions, const Vec2 *uvs, const Vec3 *normals, platform::ThreadPool* pool = 0);
 void createMeshPrimativeCube(RenderState* rs, Mesh* out_mesh, VertexLayout layout);
 void createMeshPrimativeCylinder(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int sides, bool capEnds);
 void createMeshPrimativeCone(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int sides, bool capEnd);
-bool createMeshFromGOBMESH(RenderState* rs, Mesh* out_mesh, VertexLayout layout, char* bytes, size_t byteCount);
+/* A copy of a mesh's triangles and positions kept on the CPU, for raycasts and other queries after the file's bytes are gone.
+Only has the full mesh, not its other levels of detail. See MeshBVH.h for raycasting it quickly. */
+struct CPUMesh
+{
+	unsigned int triangleCount;
+	unsigned int vertexCount;
+	IndexedTriangle* faces;
+	Vec3* positions;
+};
+// When the file has levels of detail, triangleCount is the full mesh's, so render() draws that.
+// Draw the others with renderRange(), using readGOBMESHLODs().
+// out_cpuMesh is filled too if it isn't 0, so the file doesn't need reading twice. Destroy it with destroyCPUMesh().
+// Files without tangents get them generated, on pool if it isn't 0.
+bool createMeshFromGOBMESH(RenderState* rs, Mesh* out_mesh, VertexLayout layout, char* bytes, size_t byteCount, CPUMesh* out_cpuMesh = 0, platform::ThreadPool* pool = 0);
 void destroyMesh(Mesh* mesh);
+
+// Skinned vertices have this many joint indices and weights each
+static const unsigned int jointsPerVertex = 4;
+
+/* The arrays stored in a .gobmesh file, for using mesh data on the CPU.
+They point into the file's bytes, so keep the bytes around while using them.
+Arrays the file doesn't have are 0.
+Version 1 files use the full size arrays. Version 2 files use the compact arrays instead,
+except for faces when the mesh has 65536 or more vertices. The decodeGOBMESH functions
+below fill full size arrays from either version.
+faceCount counts the faces of every level of detail, which follow the full mesh's. */
+struct GOBMESHData
+{
+	unsigned int version;
+	unsigned int faceCount;
+	unsigned int vertexCount;
+	IndexedTriangle* faces;
+	IndexedTriangle16* shortFaces;
+	Vec3* positions;
+	Vec2* uvs;
+	Vec3* normals;
+	unsigned int* jointIndices; // jointsPerVertex for each vertex
+	float* jointWeights; // jointsPerVertex for each vertex
+
+	// Version 2
+	unsigned short* halfUVs; // 2 for each vertex
+	short* octahedralNormals; // 2 for each vertex
+	short* octahedralTangents; // 4 for each vertex, as in VertexDataType::tangents_4snorm16Octahedral
+	unsigned char* shortJointIndices; // jointsPerVertex for each vertex
+	unsigned short* wideJointIndices; // jointsPerVertex for each vertex, instead of shortJointIndices for more than 256 joints
+	unsigned short* unormJointWeights; // jointsPerVertex for each vertex
+	// Extra data after the vertices, each {uint32 id, uint32 byteCount, bytes padded to 4}
+	unsigned int chunkCount;
+	char* chunks;
+};
+
+// The first four bytes of a version 2 .gobmesh file: "GMS2".
+// Version 1 files start with the face count instead.
+static const unsigned int gobmeshVersion2Magic = 0x32534D47;
+
+/* A level of detail in a .gobmesh file: a run of faces using the same vertices as the full mesh,
+which is the first level. Levels go from most to least detailed. */
+struct MeshLOD
+{
+	unsigned int firstTriangle;
+	unsigned int triangleCount;
+	// How far, in model space units, the surface may have moved from the full mesh
+	float error;
+};
+
+// The chunk in a .gobmesh file that holds its MeshLODs: "LODS"
+static const unsigned int gobmeshLODChunkId = 0x53444F4C;
+
+// Returns false if the bytes aren't a complete .gobmesh file
+bool readGOBMESH(GOBMESHData* out_data, char* bytes, size_t byteCount);
+// Returns the chunk's bytes, or 0 if the file doesn't have a chunk with that id
+char* findGOBMESHChunk(const GOBMESHData& data, unsigned int id, unsigned int* out_byteCount);
+/* Points out_lods into the file's bytes. Returns false if the file doesn't have levels of detail,
+in which case the whole file is one level, which out_fullLOD is always set to. out_fullLOD can be 0. */
+bool readGOBMESHLODs(const MeshLOD** out_lods, unsigned int* out_lodCount, MeshLOD* out_fullLOD, const GOBMESHData& data);
+void decodeGOBMESHFaces(IndexedTriangle* out_faces, const GOBMESHData& data);
+// Copies the full mesh's faces and positions, so the CPUMesh doesn't need the file's bytes
+void createCPUMeshFromGOBMESH(CPUMesh* out_cpuMesh, const GOBMESHData& data);
+void destroyCPUMesh(CPUMesh* cpuMesh);
+// These return false, without writing anything, if the file doesn't have that data
+bool decodeGOBMESHUVs(Vec2* out_uvs, const GOBMESHData& data);
+bool decodeGOBMESHNormals(Vec3* out_normals, const GOBMESHData& data);
+bool decodeGOBMESHTangents(Vec4* out_tangents, const GOBMESHData& data);
+bool decodeGOBMESHJoints(unsigned int* out_jointIndices, float* out_jointWeights, const GOBMESHData& data);
 void bindMesh(RenderState* rs, Mesh& mesh);
 
 struct UVSphere
@@ -349,6 +513,28 @@ void goblinDebugLog(const char* message)
 	#endif
 }
 
+void goblinParallelFor(platform::ThreadPool* pool, unsigned int count, unsigned int grainSize, void (*function)(void* parameter, unsigned int first, unsigned int count), void* parameter)
+{
+	#ifndef GOBLIN_DISABLE_THREAD_POOL
+		if (pool) {
+			platform::parallelFor(pool, count, grainSize, function, parameter);
+			return;
+		}
+	#endif
+	if (count > 0) {
+		function(parameter, 0, count);
+	}
+}
+
+FrameArena* goblinThreadScratchArena()
+{
+	#ifndef GOBLIN_DISABLE_THREAD_POOL
+		return platform::getThreadScratchArena();
+	#else
+		return 0;
+	#endif
+}
+
 #ifdef GOBLIN_ENABLE_GL
 void goblinDebugLog(const char* fileName, const char* functionName, int lineNumber, GLenum errorCode)
 {
@@ -385,6 +571,53 @@ bool BinaryReader::atEnd()
 	return (_readPosition==_byteCount);
 }
 
+void createFrameArena(FrameArena* out_arena, size_t byteCount)
+{
+	FrameArena zero = {};
+	*out_arena = zero;
+	out_arena->memory = new char[byteCount];
+	out_arena->byteCount = byteCount;
+}
+
+void destroyFrameArena(FrameArena* arena)
+{
+	delete[] arena->memory;
+	FrameArena zero = {};
+	*arena = zero;
+}
+
+void resetFrameArena(FrameArena* arena)
+{
+	arena->usedByteCount = 0;
+}
+
+void* pushFrameArena(FrameArena* arena, size_t byteCount, size_t alignment)
+{
+	size_t address = (size_t)(arena->memory + arena->usedByteCount);
+	size_t padding = (alignment - (address % alignment)) % alignment;
+	if (arena->usedByteCount + padding + byteCount > arena->byteCount) {
+		assert(false && "FrameArena is out of space");
+		return 0;
+	}
+	void* memory = arena->memory + arena->usedByteCount + padding;
+	arena->usedByteCount += padding + byteCount;
+	if (arena->usedByteCount > arena->peakByteCount) {
+		arena->peakByteCount = arena->usedByteCount;
+	}
+	return memory;
+}
+
+size_t getFrameArenaMarker(FrameArena* arena)
+{
+	return arena->usedByteCount;
+}
+
+void popFrameArenaToMarker(FrameArena* arena, size_t marker)
+{
+	assert(marker <= arena->usedByteCount);
+	arena->usedByteCount = marker;
+}
+
 
 #ifdef GOBLIN_ENABLE_GL
 void createRenderStateGL(RenderState* rs)
@@ -462,13 +695,49 @@ void renderRange(RenderState* rs, unsigned int firstTriangleIndex, unsigned int
 		glDrawElements(GL_TRIANGLES, trianglesToRender*3, rs->boundMeshIndexBufferType, (void*)firstElementByteOffset);
 	}GOBLIN_END_GL
 #endif
+
+#ifdef GOBLIN_ENABLE_D3D
+		GOBLIN_BEGIN_D3D{
+		rs->deviceContext->DrawIndexed(3*trianglesToRender, 3*firstTriangleIndex, 0);
+	}GOBLIN_END_D3D
+#endif
+}
+
+void renderRanges(RenderState* rs, const TriangleRange* ranges, unsigned int rangeCount)
+{
+#ifdef GOBLIN_ENABLE_GL
+	GOBLIN_BEGIN_GL{
+		// Batched through arrays on the stack, so drawing doesn't allocate
+		static const unsigned int batchSize = 64;
+		GLsizei counts[batchSize];
+		const void* offsets[batchSize];
+		size_t bytesPerIndex = (rs->boundMeshIndexBufferType==GL_UNSIGNED_SHORT) ? 2 : 4;
+		for (unsigned int first=0; first<rangeCount; first+=batchSize)
+		{
+			unsigned int count = (rangeCount-first < batchSize) ? rangeCount-first : batchSize;
+			for (unsigned int i=0; i<count; i++) {
+				counts[i] = ranges[first+i].triangleCount*3;
+				offsets[i] = (const void*)(3 * ranges[first+i].firstTriangle * bytesPerIndex);
+			}
+			glMultiDrawElements(GL_TRIANGLES, counts, rs->boundMeshIndexBufferType, offsets, count);
+		}
+	}GOBLIN_END_GL
+#endif
+
+#ifdef GOBLIN_ENABLE_D3D
+		GOBLIN_BEGIN_D3D{
+		for (unsigned int i=0; i<rangeCount; i++) {
+			rs->deviceContext->DrawIndexed(3*ranges[i].triangleCount, 3*ranges[i].firstTriangle, 0);
+		}
+	}GOBLIN_END_D3D
+#endif
 }
 
 void renderInstanced(RenderState* rs, int instances)
 {
 #ifdef GOBLIN_ENABLE_GL
 	GOBLIN_BEGIN_GL{
-		glDrawElementsInstanced(GL_TRIANGLES, rs->boundMeshTriangleCount*3, GL_UNSIGNED_INT, 0, instances);
+		glDrawElementsInstanced(GL_TRIANGLES, rs->boundMeshTriangleCount*3, rs->boundMeshIndexBufferType, 0, instances);
 	}GOBLIN_END_GL
 #endif
 
@@ -574,6 +843,77 @@ void destroyVertexLayout(VertexLayout* layout)
 	*layout = {0};
 }
 
+unsigned int getVertexFormatByteCount(VertexDataType::Format format)
+{
+	switch (format)
+	{
+		case VertexDataType::positions_2floats: return 2*sizeof(float);
+		case VertexDataType::positions_3floats: return 3*sizeof(float);
+		case VertexDataType::uvs_2floats: return 2*sizeof(float);
+		case VertexDataType::normals_3floats: return 3*sizeof(float);
+		case VertexDataType::tangents_4floats: return 4*sizeof(float);
+		case VertexDataType::colors_4ubytes: return 4*sizeof(char);
+		case VertexDataType::jointIndices_4ints: return 4*sizeof(int);
+		case VertexDataType::jointWeights_4floats: return 4*sizeof(float);
+		case VertexDataType::uvs_2halfs: return 2*sizeof(short);
+		case VertexDataType::normals_2snorm16Octahedral: return 2*sizeof(short);
+		case VertexDataType::tangents_4snorm16Octahedral: return 4*sizeof(short);
+		case VertexDataType::jointIndices_4ubytes: return 4*sizeof(char);
+		case VertexDataType::jointWeights_4unorm16: return 4*sizeof(short);
+		case VertexDataType::jointIndices_4ushorts: return 4*sizeof(short);
+		default: assert(!"Missing a case");
+	}
+	return 0;
+}
+
+#ifdef GOBLIN_ENABLE_GL
+// Points attribute index at the bound GL_ARRAY_BUFFER, and enables it
+void setGLVertexAttribute(unsigned int index, VertexDataType::Format format, unsigned int stride, size_t offset)
+{
+	switch (format)
+	{
+		case VertexDataType::positions_2floats:
+		case VertexDataType::uvs_2floats:
+			glVertexAttribPointer(index, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+			break;
+		case VertexDataType::positions_3floats:
+		case VertexDataType::normals_3floats:
+			glVertexAttribPointer(index, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+			break;
+		case VertexDataType::tangents_4floats:
+		case VertexDataType::jointWeights_4floats:
+			glVertexAttribPointer(index, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+			break;
+		case VertexDataType::colors_4ubytes:
+			glVertexAttribPointer(index, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offset);
+			break;
+		case VertexDataType::jointIndices_4ints:
+			glVertexAttribIPointer(index, 4, GL_UNSIGNED_INT, stride, (void*)offset);
+			break;
+		case VertexDataType::uvs_2halfs:
+			glVertexAttribPointer(index, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+			break;
+		case VertexDataType::normals_2snorm16Octahedral:
+			glVertexAttribPointer(index, 2, GL_SHORT, GL_TRUE, stride, (void*)offset);
+			break;
+		case VertexDataType::tangents_4snorm16Octahedral:
+			glVertexAttribPointer(index, 4, GL_SHORT, GL_TRUE, stride, (void*)offset);
+			break;
+		case VertexDataType::jointIndices_4ubytes:
+			glVertexAttribIPointer(index, 4, GL_UNSIGNED_BYTE, stride, (void*)offset);
+			break;
+		case VertexDataType::jointIndices_4ushorts:
+			glVertexAttribIPointer(index, 4, GL_UNSIGNED_SHORT, stride, (void*)offset);
+			break;
+		case VertexDataType::jointWeights_4unorm16:
+			glVertexAttribPointer(index, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offset);
+			break;
+		default: assert(!"Missing a case");
+	}
+	glEnableVertexAttribArray(index);
+}
+#endif
+
 void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int faceCount, unsigned int vertexCount, unsigned short *faces, void* interleavedVertexData)
 {
 	*out_mesh ={0};
@@ -586,20 +926,8 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 		glBindVertexArray(out_mesh->glVertexArrayObjectHandle);
 
 		unsigned int totalVertexSize = 0;
-		for (unsigned int i=0; i<layout.dataTypeCount; ++i)
-		{
-			switch (layout.dataTypes[i].type)
-			{
-				case VertexDataType::positions_2floats:	totalVertexSize += 2*sizeof(float); break;
-				case VertexDataType::positions_3floats:	totalVertexSize += 3*sizeof(float); break;
-				case VertexDataType::normals_3floats: totalVertexSize += 3*sizeof(float); break;
-				case VertexDataType::tangents_4floats: totalVertexSize += 4*sizeof(float); break;
-				case VertexDataType::uvs_2floats: totalVertexSize += 2*sizeof(float); break;
-				case VertexDataType::colors_4ubytes: totalVertexSize += 4*sizeof(char); break;
-				case VertexDataType::jointIndices_4ints: totalVertexSize += 4*sizeof(int); break;
-				case VertexDataType::jointWeights_4floats: totalVertexSize += 4*sizeof(float); break;
-				default: assert(!"Missing a case");
-			}
+		for (unsigned int i=0; i<layout.dataTypeCount; ++i) {
+			totalVertexSize += getVertexFormatByteCount(layout.dataTypes[i].type);
 		}
 		GOBLIN_PRINT_GL_ERRORS;
 
@@ -613,50 +941,8 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 
 		for (unsigned int i=0; i<layout.dataTypeCount; ++i)
 		{
-			switch (layout.dataTypes[i].type)
-			{
-				case VertexDataType::positions_2floats:
-					glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 2*sizeof(float);
-					break;
-				case VertexDataType::positions_3floats:
-					glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 3*sizeof(float);
-					break;
-				case VertexDataType::normals_3floats:
-					glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 3*sizeof(float);
-					break;
-				case VertexDataType::tangents_4floats:
-					glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 4*sizeof(float);
-					break;
-				case VertexDataType::uvs_2floats:
-					glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 2*sizeof(float);
-					break;
-				case VertexDataType::colors_4ubytes:
-					glVertexAttribPointer(i, 4, GL_UNSIGNED_BYTE, GL_TRUE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 4*sizeof(char);
-					break;
-				case VertexDataType::jointIndices_4ints:
-					glVertexAttribIPointer(i, 4, GL_UNSIGNED_INT, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 4*sizeof(int);
-					break;
-				case VertexDataType::jointWeights_4floats:
-					glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, totalVertexSize, (void*)offset);
-					glEnableVertexAttribArray(i);
-					offset += 4*sizeof(float);
-					break;
-				default: assert(!"Missing a case");
-			}
+			setGLVertexAttribute(i, layout.dataTypes[i].type, totalVertexSize, offset);
+			offset += getVertexFormatByteCount(layout.dataTypes[i].type);
 		}
 		GOBLIN_PRINT_GL_ERRORS;
 		
@@ -674,13 +960,33 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 
 void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int faceCount, unsigned int vertexCount, IndexedTriangle *faces, Vec3* positions, Vec2* uvs, Vec3* normals, Vec4 *tangents, unsigned int* boneIndices, float* boneWeights)
 {
+	std::vector<const void*> vertexStreams(layout.dataTypeCount, (const void*)0);
+	for (unsigned int i=0; i<layout.dataTypeCount; ++i)
+	{
+		switch (layout.dataTypes[i].type)
+		{
+			case VertexDataType::positions_3floats: vertexStreams[i] = positions; break;
+			case VertexDataType::uvs_2floats: vertexStreams[i] = uvs; break;
+			case VertexDataType::normals_3floats: vertexStreams[i] = normals; break;
+			case VertexDataType::tangents_4floats: vertexStreams[i] = tangents; break;
+			case VertexDataType::jointIndices_4ints: vertexStreams[i] = boneIndices; break;
+			case VertexDataType::jointWeights_4floats: vertexStreams[i] = boneWeights; break;
+			default: break;
+		}
+	}
+	createMesh(rs, out_mesh, layout, faceCount, vertexCount, faces, sizeof(unsigned int), vertexStreams.data());
+}
+
+void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned int faceCount, unsigned int vertexCount, const void* faces, unsigned int bytesPerIndex, const void* const* vertexStreams)
+{
+	assert(bytesPerIndex == 2 || bytesPerIndex == 4);
 	*out_mesh ={0};
 	out_mesh->vertexBufferCount = layout.dataTypeCount;
 	out_mesh->triangleCount = faceCount;
 
 #ifdef GOBLIN_ENABLE_GL
 	GOBLIN_BEGIN_GL{
-		out_mesh->glIndexBufferType = GL_UNSIGNED_INT;
+		out_mesh->glIndexBufferType = (bytesPerIndex == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 		out_mesh->glVertexBufferHandles = new GLuint[layout.dataTypeCount];
 		// Vertex array object
 		glGenVertexArrays(1, &out_mesh->glVertexArrayObjectHandle);
@@ -689,40 +995,12 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 		for (unsigned int i=0; i<layout.dataTypeCount; ++i)
 		{
 			GLuint bufferHandle = 0;
-			glGenBuffers(1, &bufferHandle);
-			glBindBuffer(GL_ARRAY_BUFFER, bufferHandle);
-			switch (layout.dataTypes[i].type)
+			if (vertexStreams[i])
 			{
-				case VertexDataType::positions_3floats:
-					glBufferData(GL_ARRAY_BUFFER, vertexCount*3*sizeof(float), positions, GL_STATIC_DRAW);
-					glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 0, 0);
-					glEnableVertexAttribArray(i);
-					break;
-				case VertexDataType::normals_3floats:
-					glBufferData(GL_ARRAY_BUFFER, vertexCount*3*sizeof(float), normals, GL_STATIC_DRAW);
-					glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 0, 0);
-					glEnableVertexAttribArray(i);
-					break;
-				case VertexDataType::tangents_4floats:
-					glBufferData(GL_ARRAY_BUFFER, vertexCount*4*sizeof(float), tangents, GL_STATIC_DRAW);
-					glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, 0, 0);
-					glEnableVertexAttribArray(i);
-					break;
-				case VertexDataType::uvs_2floats:
-					glBufferData(GL_ARRAY_BUFFER, vertexCount*2*sizeof(float), uvs, GL_STATIC_DRAW);
-					glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, 0, 0);
-					glEnableVertexAttribArray(i);
-					break;
-				case VertexDataType::jointIndices_4ints:
-					glBufferData(GL_ARRAY_BUFFER, vertexCount*4*sizeof(unsigned int), boneIndices, GL_STATIC_DRAW);
-					glVertexAttribIPointer(i, 4, GL_UNSIGNED_INT, 0, 0);
-					glEnableVertexAttribArray(i);
-					break;
-				case VertexDataType::jointWeights_4floats:
-					glBufferData(GL_ARRAY_BUFFER, vertexCount*4*sizeof(float), boneWeights, GL_STATIC_DRAW);
-					glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, 0, 0);
-					glEnableVertexAttribArray(i);
-					break;
+				glGenBuffers(1, &bufferHandle);
+				glBindBuffer(GL_ARRAY_BUFFER, bufferHandle);
+				glBufferData(GL_ARRAY_BUFFER, vertexCount*getVertexFormatByteCount(layout.dataTypes[i].type), vertexStreams[i], GL_STATIC_DRAW);
+				setGLVertexAttribute(i, layout.dataTypes[i].type, 0, 0);
 			}
 			out_mesh->glVertexBufferHandles[i] = bufferHandle;
 		}
@@ -730,7 +1008,7 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 		// Index buffer
 		glGenBuffers(1, &out_mesh->glIndexBufferHandle);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, out_mesh->glIndexBufferHandle);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, faceCount*3*sizeof(unsigned int), faces, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, faceCount*3*bytesPerIndex, faces, GL_STATIC_DRAW);
 
 		// TODO: Rebind the previously bound mesh
 
@@ -742,6 +1020,7 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 		out_mesh->d3dVertexBuffers = new ID3D11Buffer*[layout.dataTypeCount];
 		out_mesh->d3dVertexBufferStrides = new unsigned int[layout.dataTypeCount];
 		out_mesh->d3dVertexBufferOffsets = new unsigned int[layout.dataTypeCount];
+		out_mesh->d3dIndexFormat = (bytesPerIndex == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 		D3D11_BUFFER_DESC bd ={};
 		bd.Usage = D3D11_USAGE_DEFAULT;
@@ -752,21 +1031,8 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 		// Create vertex buffers
 		for (unsigned int i=0; i<layout.dataTypeCount; ++i)
 		{
-			unsigned int bytesPerVertex = 0;
-			switch (layout.dataTypes[i].type)
-			{
-				case VertexDataType::positions_3floats:
-					bytesPerVertex = sizeof(Vec3);
-					InitData.pSysMem = positions;
-					break;
-				case VertexDataType::uvs_2floats:
-					bytesPerVertex = sizeof(Vec2);
-					InitData.pSysMem = uvs;
-					break;
-				default:
-					bytesPerVertex = 0;
-					InitData.pSysMem = 0;
-			}
+			unsigned int bytesPerVertex = getVertexFormatByteCount(layout.dataTypes[i].type);
+			InitData.pSysMem = vertexStreams[i];
 
 			if (InitData.pSysMem) {
 				bd.ByteWidth = bytesPerVertex*vertexCount;
@@ -782,7 +1048,7 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 
 		// Create index buffers
 		bd.Usage = D3D11_USAGE_DEFAULT;
-		bd.ByteWidth = sizeof(IndexedTriangle)*faceCount;
+		bd.ByteWidth = faceCount*3*bytesPerIndex;
 		bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 		InitData.pSysMem = faces;
 		HRESULT hr = rs->device->CreateBuffer(&bd, &InitData, &out_mesh->d3dIndexBuffer);
@@ -794,7 +1060,7 @@ void createMesh(RenderState* rs, Mesh* out_mesh, VertexLayout layout, unsigned i
 /* Calculates the tangents needed for tangent-space normal mapping.
 The corresponding bitangent is derived using btan = tan.w*cross(normal, tan).
 The w component of the tangent is either 1 or -1, and is used to correct the direction of the bitangent. */
-void fillVertexTangentArray(Vec4 *out_tangents, unsigned int faceCount, unsigned int vertexCount, IndexedTriangle *faces, Vec3 *positions, Vec2 *uvs, Vec3 *normals)
+void fillVertexTangentArray(Vec4 *out_tangents, unsigned int faceCount, unsigned int vertexCount, const IndexedTriangle *faces, const Vec3 *positions, const Vec2 *uvs, const Vec3 *normals)
 {
 	Vec3 zero ={0};
 	std::vector<Vec3> bitangents(vertexCount, zero);
@@ -840,6 +1106,174 @@ void fillVertexTangentArray(Vec4 *out_tangents, unsigned int faceCount, unsigned
 	}
 }
 
+// Vertex tangents are summed a block of this many vertices at a time, a multiple of floatLaneCount
+static const unsigned int tangentVertexBlockSize = 1024;
+
+/* What fillVertexTangentArrayParallel() shares with its ranges. The faces are split into faceRangeCount ranges,
+and each range's corners are sorted into the vertex blocks they belong to. Each block's corners are
+blockCorners[blockFirstCorner[b]] up to blockCorners[blockFirstCorner[b+1]], as face*3 + corner,
+in the order the faces are in the mesh. blockRangeCorners has a count for each block and face range,
+block by block, which then becomes where that range's corners in the block go. */
+struct VertexTangentRanges
+{
+	Vec4* tangentsOut;
+	const IndexedTriangle* faces;
+	const Vec3* positions;
+	const Vec2* uvs;
+	const Vec3* normals;
+	unsigned int faceCount;
+	unsigned int vertexCount;
+	unsigned int facesPerRange;
+	unsigned int faceRangeCount;
+	Vec3* faceTangents;
+	Vec3* faceBitangents;
+	unsigned int* blockRangeCorners;
+	unsigned int* blockFirstCorner;
+	unsigned int* blockCorners;
+};
+
+// Each face's tangent and bitangent, before they're added to its vertices, and how many corners each vertex block gets
+void fillFaceTangentRanges(void* parameter, unsigned int firstRange, unsigned int rangeCount)
+{
+	VertexTangentRanges* r = (VertexTangentRanges*)parameter;
+	for (unsigned int range=firstRange; range<firstRange+rangeCount; range++)
+	{
+		unsigned int endFace = (range+1 < r->faceRangeCount) ? (range+1)*r->facesPerRange : r->faceCount;
+		for (unsigned int i=range*r->facesPerRange; i<endFace; i++)
+		{
+			unsigned int a = r->faces[i].vertexIndex[0];
+			unsigned int b = r->faces[i].vertexIndex[1];
+			unsigned int c = r->faces[i].vertexIndex[2];
+			// Check if the loaded file's data is corrupt
+			assert(a < r->vertexCount && b < r->vertexCount && c < r->vertexCount);
+			Vec3 deltaPos1 = r->positions[b] - r->positions[a];
+			Vec3 deltaPos2 = r->positions[c] - r->positions[a];
+			Vec2 deltaUV1 = r->uvs[b] - r->uvs[a];
+			Vec2 deltaUV2 = r->uvs[c] - r->uvs[a];
+			float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+			r->faceTangents[i] = (deltaPos1*deltaUV2.y - deltaPos2*deltaUV1.y)*f;
+			r->faceBitangents[i] = (deltaPos2*deltaUV1.x - deltaPos1*deltaUV2.x)*f;
+			r->blockRangeCorners[(a/tangentVertexBlockSize)*r->faceRangeCount + range]++;
+			r->blockRangeCorners[(b/tangentVertexBlockSize)*r->faceRangeCount + range]++;
+			r->blockRangeCorners[(c/tangentVertexBlockSize)*r->faceRangeCount + range]++;
+		}
+	}
+}
+
+// Writes each range's corners where the counts say, so every block's corners are in face order
+void sortTangentCornerRanges(void* parameter, unsigned int firstRange, unsigned int rangeCount)
+{
+	VertexTangentRanges* r = (VertexTangentRanges*)parameter;
+	for (unsigned int range=firstRange; range<firstRange+rangeCount; range++)
+	{
+		unsigned int endFace = (range+1 < r->faceRangeCount) ? (range+1)*r->facesPerRange : r->faceCount;
+		for (unsigned int i=range*r->facesPerRange; i<endFace; i++) {
+			for (unsigned int j=0; j<3; j++) {
+				unsigned int& next = r->blockRangeCorners[(r->faces[i].vertexIndex[j]/tangentVertexBlockSize)*r->faceRangeCount + range];
+				r->blockCorners[next++] = i*3 + j;
+			}
+		}
+	}
+}
+
+/* Sums each vertex's face tangents a block at a time, then orthogonalizes them.
+A vertex's faces are added in order, which is the same order fillVertexTangentArray() adds them in. */
+void fillVertexTangentBlocks(void* parameter, unsigned int firstBlock, unsigned int blockCount)
+{
+	VertexTangentRanges* r = (VertexTangentRanges*)parameter;
+	for (unsigned int block=firstBlock; block<firstBlock+blockCount; block++)
+	{
+		unsigned int firstVertex = block*tangentVertexBlockSize;
+		unsigned int vertexCount = (r->vertexCount-firstVertex < tangentVertexBlockSize) ? r->vertexCount-firstVertex : tangentVertexBlockSize;
+		/* Each component's sums, and 0 past vertexCount. The rows are a cache line longer than the block,
+		since a vertex's sums exactly 4KB apart stall on each other as if they were the same address. */
+		alignas(32) float sums[6][tangentVertexBlockSize + 16] = {};
+		for (unsigned int k=r->blockFirstCorner[block]; k<r->blockFirstCorner[block+1]; k++)
+		{
+			unsigned int face = r->blockCorners[k]/3;
+			unsigned int v = r->faces[face].vertexIndex[r->blockCorners[k]%3] - firstVertex;
+			const Vec3& faceTangent = r->faceTangents[face];
+			const Vec3& faceBitangent = r->faceBitangents[face];
+			sums[0][v] += faceTangent.x; sums[1][v] += faceTangent.y; sums[2][v] += faceTangent.z;
+			sums[3][v] += faceBitangent.x; sums[4][v] += faceBitangent.y; sums[5][v] += faceBitangent.z;
+		}
+
+		// Gram-Schmidt orthogonalize and normalize floatLaneCount vertices at a time
+		for (unsigned int i=0; i<vertexCount; i+=floatLaneCount)
+		{
+			unsigned int count = (vertexCount-i < floatLaneCount) ? vertexCount-i : floatLaneCount;
+			Vec3Lanes t = {loadLanes(sums[0]+i), loadLanes(sums[1]+i), loadLanes(sums[2]+i)};
+			Vec3Lanes b = {loadLanes(sums[3]+i), loadLanes(sums[4]+i), loadLanes(sums[5]+i)};
+			Vec3Lanes n;
+			loadFloatLanes(&n.x, &r->normals[firstVertex+i].x, 3, 3, count);
+
+			FloatLanes nDotT = addLanes(addLanes(multiplyLanes(n.x, t.x), multiplyLanes(n.y, t.y)), multiplyLanes(n.z, t.z));
+			t.x = subtractLanes(t.x, multiplyLanes(n.x, nDotT));
+			t.y = subtractLanes(t.y, multiplyLanes(n.y, nDotT));
+			t.z = subtractLanes(t.z, multiplyLanes(n.z, nDotT));
+			FloatLanes tangentLength = sqrtLanes(addLanes(addLanes(multiplyLanes(t.x, t.x), multiplyLanes(t.y, t.y)), multiplyLanes(t.z, t.z)));
+			// normalize() leaves zero vectors as zero
+			t.x = zeroWhereZero(divideLanes(t.x, tangentLength), tangentLength);
+			t.y = zeroWhereZero(divideLanes(t.y, tangentLength), tangentLength);
+			t.z = zeroWhereZero(divideLanes(t.z, tangentLength), tangentLength);
+
+			// w is -1 where dot(cross(normal, tangent), bitangent) < 0
+			FloatLanes handedness = addLanes(addLanes(
+				multiplyLanes(subtractLanes(multiplyLanes(n.y, t.z), multiplyLanes(n.z, t.y)), b.x),
+				multiplyLanes(subtractLanes(multiplyLanes(n.z, t.x), multiplyLanes(n.x, t.z)), b.y)),
+				multiplyLanes(subtractLanes(multiplyLanes(n.x, t.y), multiplyLanes(n.y, t.x)), b.z));
+			FloatLanes tangentLanes[4] = {t.x, t.y, t.z, negateWhereNegative(setLanes(1), handedness)};
+			storeFloatLanes(&r->tangentsOut[firstVertex+i].x, 4, 4, count, tangentLanes);
+		}
+	}
+}
+
+void fillVertexTangentArrayParallel(Vec4 *out_tangents, unsigned int faceCount, unsigned int vertexCount, const IndexedTriangle *faces, const Vec3 *positions, const Vec2 *uvs, const Vec3 *normals, platform::ThreadPool* pool)
+{
+	// Smaller meshes are faster without the extra passes
+	static const unsigned int minParallelVertexCount = 8192;
+	if (!pool || vertexCount < minParallelVertexCount) {
+		fillVertexTangentArray(out_tangents, faceCount, vertexCount, faces, positions, uvs, normals);
+		return;
+	}
+
+	/* Each vertex block only reads its own corners, so no two ranges write the same vertex.
+	The corners are put in their blocks with a counting sort, which counts each block's corners in each face range.
+	There are at most maxFaceRanges ranges, so the counts stay small next to the mesh. */
+	static const unsigned int minFacesPerRange = 4096;
+	static const unsigned int maxFaceRanges = 64;
+	unsigned int facesPerRange = (faceCount + maxFaceRanges-1)/maxFaceRanges;
+	if (facesPerRange < minFacesPerRange) {
+		facesPerRange = minFacesPerRange;
+	}
+	unsigned int faceRangeCount = (faceCount + facesPerRange-1)/facesPerRange;
+	unsigned int blockCount = (vertexCount + tangentVertexBlockSize-1)/tangentVertexBlockSize;
+	std::vector<unsigned int> blockRangeCorners((size_t)blockCount*faceRangeCount, 0);
+	std::vector<unsigned int> blockFirstCorner(blockCount+1);
+	std::vector<unsigned int> blockCorners(3*(size_t)faceCount);
+	std::vector<Vec3> faceTangents(faceCount);
+	std::vector<Vec3> faceBitangents(faceCount);
+	VertexTangentRanges ranges = {out_tangents, faces, positions, uvs, normals,
+		faceCount, vertexCount, facesPerRange, faceRangeCount, faceTangents.data(), faceBitangents.data(),
+		blockRangeCorners.data(), blockFirstCorner.data(), blockCorners.data()};
+	goblinParallelFor(pool, faceRangeCount, 1, fillFaceTangentRanges, &ranges);
+
+	// Each count becomes where that range's corners in the block start
+	unsigned int cornerCount = 0;
+	for (unsigned int b=0; b<blockCount; b++) {
+		blockFirstCorner[b] = cornerCount;
+		for (unsigned int range=0; range<faceRangeCount; range++) {
+			unsigned int count = blockRangeCorners[b*faceRangeCount + range];
+			blockRangeCorners[b*faceRangeCount + range] = cornerCount;
+			cornerCount += count;
+		}
+	}
+	blockFirstCorner[blockCount] = cornerCount;
+
+	goblinParallelFor(pool, faceRangeCount, 1, sortTangentCornerRanges, &ranges);
+	goblinParallelFor(pool, blockCount, 4, fillVertexTangentBlocks, &ranges);
+}
+
 void createMeshPrimativeCube(RenderState* rs, Mesh* out_mesh, VertexLayout layout)
 {
 	Vec3 topLeftBack ={-1, 1, -1};
@@ -1138,9 +1572,91 @@ void createMeshPrimativeCone(RenderState* rs, Mesh* out_mesh, VertexLayout layou
 	delete[] faces;
 }
 
-bool createMeshFromGOBMESH(RenderState* rs, Mesh* out_mesh, VertexLayout layout, char* bytes, size_t byteCount)
+// Flags in the header of a version 2 .gobmesh file
+enum GOBMESHFlags
+{
+	gobmesh_hasUVs = 1,
+	gobmesh_hasNormals = 2,
+	gobmesh_hasTangents = 4,
+	gobmesh_hasJoints = 8,
+	gobmesh_shortIndices = 16,
+	gobmesh_wideJointIndices = 32
+};
+
+bool readGOBMESHVersion2(GOBMESHData* out_data, char* bytes, size_t byteCount)
+{
+	/* Version 2 file format:
+	Header
+	{
+	uint32 magic "GMS2"
+	uint32 number of faces
+	uint32 number of vertices
+	uint32 flags (GOBMESHFlags)
+	uint32 number of chunks
+	}
+	faces (3 uint16s per face, padded to a multiple of 4 bytes, with gobmesh_shortIndices; otherwise 3 uint32s)
+	vertex positions (3 float32s per vertex)
+	vertex UVs (2 float16s per vertex; optional)
+	vertex normals (2 snorm16s per vertex, octahedral encoded; optional)
+	vertex tangents (4 snorm16s per vertex, octahedral encoded, then the bitangent sign, then 0; optional)
+	vertex joint indices (jointsPerVertex uint8s per vertex, or uint16s with gobmesh_wideJointIndices; optional)
+	vertex joint weights (jointsPerVertex unorm16s per vertex, adding up to 65535; optional)
+	chunks (uint32 id, uint32 byte count, bytes padded to a multiple of 4)
+	All the arrays start on a multiple of 4 bytes.
+	*/
+	BinaryReader b(bytes, byteCount);
+	unsigned int magic = 0;
+	unsigned int flags = 0;
+	b.readInto(&magic, sizeof(magic));
+	if (magic != gobmeshVersion2Magic) {
+		return false;
+	}
+	out_data->version = 2;
+	b.readInto(&out_data->faceCount, sizeof(unsigned int));
+	b.readInto(&out_data->vertexCount, sizeof(unsigned int));
+	b.readInto(&flags, sizeof(flags));
+	b.readInto(&out_data->chunkCount, sizeof(unsigned int));
+
+	unsigned int vertexCount = out_data->vertexCount;
+	if (flags & gobmesh_shortIndices) {
+		size_t faceByteCount = out_data->faceCount*sizeof(IndexedTriangle16);
+		out_data->shortFaces = (IndexedTriangle16*)b.get((faceByteCount+3) & ~(size_t)3);
+	}
+	else {
+		out_data->faces = (IndexedTriangle*)b.get(out_data->faceCount*sizeof(IndexedTriangle));
+	}
+	out_data->positions = (Vec3*)b.get(vertexCount*sizeof(Vec3));
+	if (flags & gobmesh_hasUVs) {
+		out_data->halfUVs = (unsigned short*)b.get(vertexCount*2*sizeof(unsigned short));
+	}
+	if (flags & gobmesh_hasNormals) {
+		out_data->octahedralNormals = (short*)b.get(vertexCount*2*sizeof(short));
+	}
+	if (flags & gobmesh_hasTangents) {
+		out_data->octahedralTangents = (short*)b.get(vertexCount*4*sizeof(short));
+	}
+	if ((flags & gobmesh_hasJoints) && (flags & gobmesh_wideJointIndices)) {
+		out_data->wideJointIndices = (unsigned short*)b.get(vertexCount*jointsPerVertex*sizeof(unsigned short));
+		out_data->unormJointWeights = (unsigned short*)b.get(vertexCount*jointsPerVertex*sizeof(unsigned short));
+	}
+	else if (flags & gobmesh_hasJoints) {
+		out_data->shortJointIndices = (unsigned char*)b.get(vertexCount*jointsPerVertex*sizeof(unsigned char));
+		out_data->unormJointWeights = (unsigned short*)b.get(vertexCount*jointsPerVertex*sizeof(unsigned short));
+	}
+
+	// Check the chunks are all there, so findGOBMESHChunk() doesn't have to
+	out_data->chunks = (char*)b.get(0);
+	for (unsigned int i=0; i<out_data->chunkCount; i++) {
+		unsigned int chunkHeader[2] = {};
+		b.readInto(chunkHeader, sizeof(chunkHeader));
+		b.get(((size_t)chunkHeader[1]+3) & ~(size_t)3);
+	}
+	return b.atEnd();
+}
+
+bool readGOBMESH(GOBMESHData* out_data, char* bytes, size_t byteCount)
 {
-	/* .gobmesh File format:
+	/* Version 1 file format:
 	Header
 	{
 	uint32 number of faces
@@ -1157,56 +1673,394 @@ bool createMeshFromGOBMESH(RenderState* rs, Mesh* out_mesh, VertexLayout layout,
 	vertex bone weights (x floats per vertex; optional)
 	*/
 
-	bool success = true;
+	GOBMESHData zero = {};
+	*out_data = zero;
+
+	unsigned int magic = 0;
+	if (byteCount >= sizeof(magic)) {
+		memcpy(&magic, bytes, sizeof(magic));
+	}
+	if (magic == gobmeshVersion2Magic) {
+		if (!readGOBMESHVersion2(out_data, bytes, byteCount)) {
+			*out_data = zero;
+			return false;
+		}
+		return true;
+	}
+
+	out_data->version = 1;
 	BinaryReader b(bytes, byteCount);
-	unsigned int faceCount,
-		vertexCount;
-	bool hasUVs;
-	bool hasNormals;
-	bool hasSkeletonBindings;
-	static const int jointsPerVertex = 4;
+	bool hasUVs = false;
+	bool hasNormals = false;
+	bool hasSkeletonBindings = false;
 
-	b.readInto(&faceCount, sizeof(unsigned int));
-	b.readInto(&vertexCount, sizeof(unsigned int));
+	b.readInto(&out_data->faceCount, sizeof(unsigned int));
+	b.readInto(&out_data->vertexCount, sizeof(unsigned int));
 
 	b.readInto(&hasUVs, sizeof(bool));
 	b.readInto(&hasNormals, sizeof(bool));
 	b.readInto(&hasSkeletonBindings, sizeof(bool));
 
-	IndexedTriangle* faces = (IndexedTriangle*)b.get(faceCount*sizeof(IndexedTriangle));
-	Vec3* positions = (Vec3*)b.get(vertexCount*sizeof(Vec3));
-	Vec2* uvs = 0;
-	Vec3* normals = 0;
-	Vec4* tangents = 0;
-	unsigned int* jointIndices = 0;
-	float* jointWeights = 0;
-
+	unsigned int vertexCount = out_data->vertexCount;
+	out_data->faces = (IndexedTriangle*)b.get(out_data->faceCount*sizeof(IndexedTriangle));
+	out_data->positions = (Vec3*)b.get(vertexCount*sizeof(Vec3));
 	if (hasUVs) {
-		uvs = (Vec2*)b.get(vertexCount*sizeof(Vec2));
+		out_data->uvs = (Vec2*)b.get(vertexCount*sizeof(Vec2));
 	}
 	if (hasNormals) {
-		normals = (Vec3*)b.get(vertexCount*sizeof(Vec3));
-		// Tangents
-		tangents = new Vec4[vertexCount];
-		fillVertexTangentArray(tangents, faceCount, vertexCount, faces, positions, uvs, normals);
+		out_data->normals = (Vec3*)b.get(vertexCount*sizeof(Vec3));
 	}
 	if (hasSkeletonBindings) {
-		jointIndices = (unsigned int*)b.get(vertexCount*jointsPerVertex*sizeof(float));
-		jointWeights = (float*)b.get(vertexCount*jointsPerVertex*sizeof(float));
+		out_data->jointIndices = (unsigned int*)b.get(vertexCount*jointsPerVertex*sizeof(float));
+		out_data->jointWeights = (float*)b.get(vertexCount*jointsPerVertex*sizeof(float));
 	}
+	return b.atEnd();
+}
 
-	if (b.atEnd()) {
-		createMesh(rs, out_mesh, layout, faceCount, vertexCount, faces, positions, uvs, normals, tangents, jointIndices, jointWeights);
+char* findGOBMESHChunk(const GOBMESHData& data, unsigned int id, unsigned int* out_byteCount)
+{
+	char* chunk = data.chunks;
+	for (unsigned int i=0; i<data.chunkCount; i++)
+	{
+		unsigned int chunkHeader[2];
+		memcpy(chunkHeader, chunk, sizeof(chunkHeader));
+		if (chunkHeader[0] == id) {
+			*out_byteCount = chunkHeader[1];
+			return chunk + sizeof(chunkHeader);
+		}
+		chunk += sizeof(chunkHeader) + ((chunkHeader[1]+3) & ~3u);
+	}
+	*out_byteCount = 0;
+	return 0;
+}
+
+bool readGOBMESHLODs(const MeshLOD** out_lods, unsigned int* out_lodCount, MeshLOD* out_fullLOD, const GOBMESHData& data)
+{
+	unsigned int byteCount = 0;
+	char* bytes = findGOBMESHChunk(data, gobmeshLODChunkId, &byteCount);
+	bool valid = bytes && byteCount >= sizeof(MeshLOD) && byteCount % sizeof(MeshLOD) == 0;
+	const MeshLOD* lods = (const MeshLOD*)bytes;
+	for (unsigned int i=0; valid && i<byteCount/sizeof(MeshLOD); i++) {
+		valid = (lods[i].firstTriangle <= data.faceCount && lods[i].triangleCount <= data.faceCount - lods[i].firstTriangle);
+	}
+	if (!valid) {
+		*out_lods = 0;
+		*out_lodCount = 0;
+		if (out_fullLOD) {
+			MeshLOD fullLOD = {0, data.faceCount, 0};
+			*out_fullLOD = fullLOD;
+		}
+		return false;
+	}
+	*out_lods = lods;
+	*out_lodCount = byteCount / sizeof(MeshLOD);
+	if (out_fullLOD) {
+		*out_fullLOD = lods[0];
+	}
+	return true;
+}
+
+void decodeGOBMESHFaces(IndexedTriangle* out_faces, const GOBMESHData& data)
+{
+	if (data.faces) {
+		memcpy(out_faces, data.faces, data.faceCount*sizeof(IndexedTriangle));
+		return;
+	}
+	for (unsigned int i=0; i<data.faceCount; i++) {
+		for (unsigned int j=0; j<3; j++) {
+			out_faces[i].vertexIndex[j] = data.shortFaces[i].vertexIndex[j];
+		}
+	}
+}
+
+void createCPUMeshFromGOBMESH(CPUMesh* out_cpuMesh, const GOBMESHData& data)
+{
+	const MeshLOD* lods;
+	unsigned int lodCount;
+	MeshLOD fullLOD;
+	readGOBMESHLODs(&lods, &lodCount, &fullLOD, data);
+
+	CPUMesh cpuMesh;
+	cpuMesh.triangleCount = fullLOD.triangleCount;
+	cpuMesh.vertexCount = data.vertexCount;
+	cpuMesh.faces = new IndexedTriangle[cpuMesh.triangleCount];
+	cpuMesh.positions = new Vec3[cpuMesh.vertexCount];
+	if (data.faces) {
+		memcpy(cpuMesh.faces, data.faces + fullLOD.firstTriangle, cpuMesh.triangleCount*sizeof(IndexedTriangle));
 	}
 	else {
-		success = false;
+		for (unsigned int i=0; i<cpuMesh.triangleCount; i++) {
+			for (unsigned int j=0; j<3; j++) {
+				cpuMesh.faces[i].vertexIndex[j] = data.shortFaces[fullLOD.firstTriangle + i].vertexIndex[j];
+			}
+		}
 	}
+	memcpy(cpuMesh.positions, data.positions, cpuMesh.vertexCount*sizeof(Vec3));
+	*out_cpuMesh = cpuMesh;
+}
 
-	if (tangents) {
-		delete[] tangents;
+void destroyCPUMesh(CPUMesh* cpuMesh)
+{
+	delete[] cpuMesh->faces;
+	delete[] cpuMesh->positions;
+	CPUMesh zero = {};
+	*cpuMesh = zero;
+}
+
+bool decodeGOBMESHUVs(Vec2* out_uvs, const GOBMESHData& data)
+{
+	if (data.uvs) {
+		memcpy(out_uvs, data.uvs, data.vertexCount*sizeof(Vec2));
+		return true;
 	}
+	if (!data.halfUVs) {
+		return false;
+	}
+	for (unsigned int i=0; i<data.vertexCount; i++) {
+		out_uvs[i].x = halfToFloat(data.halfUVs[2*i]);
+		out_uvs[i].y = halfToFloat(data.halfUVs[2*i+1]);
+	}
+	return true;
+}
 
-	return success;
+bool decodeGOBMESHNormals(Vec3* out_normals, const GOBMESHData& data)
+{
+	if (data.normals) {
+		memcpy(out_normals, data.normals, data.vertexCount*sizeof(Vec3));
+		return true;
+	}
+	if (!data.octahedralNormals) {
+		return false;
+	}
+	for (unsigned int i=0; i<data.vertexCount; i++) {
+		Vec2 encoded = {snorm16ToFloat(data.octahedralNormals[2*i]), snorm16ToFloat(data.octahedralNormals[2*i+1])};
+		out_normals[i] = decodeOctahedral(encoded);
+	}
+	return true;
+}
+
+// Only version 2 files store tangents. For others, use fillVertexTangentArray().
+bool decodeGOBMESHTangents(Vec4* out_tangents, const GOBMESHData& data)
+{
+	if (!data.octahedralTangents) {
+		return false;
+	}
+	for (unsigned int i=0; i<data.vertexCount; i++) {
+		const short* encoded = &data.octahedralTangents[4*i];
+		Vec2 direction = {snorm16ToFloat(encoded[0]), snorm16ToFloat(encoded[1])};
+		out_tangents[i].xyz = decodeOctahedral(direction);
+		out_tangents[i].w = (encoded[2] < 0) ? -1.0f : 1.0f;
+	}
+	return true;
+}
+
+// The ith joint index, from whichever array the file has
+unsigned int getGOBMESHJointIndex(const GOBMESHData& data, unsigned int i)
+{
+	if (data.jointIndices) {
+		return data.jointIndices[i];
+	}
+	return data.wideJointIndices ? data.wideJointIndices[i] : data.shortJointIndices[i];
+}
+
+bool decodeGOBMESHJoints(unsigned int* out_jointIndices, float* out_jointWeights, const GOBMESHData& data)
+{
+	unsigned int count = data.vertexCount*jointsPerVertex;
+	if (data.jointIndices) {
+		memcpy(out_jointIndices, data.jointIndices, count*sizeof(unsigned int));
+		memcpy(out_jointWeights, data.jointWeights, count*sizeof(float));
+		return true;
+	}
+	if (!data.unormJointWeights) {
+		return false;
+	}
+	for (unsigned int i=0; i<count; i++) {
+		out_jointIndices[i] = getGOBMESHJointIndex(data, i);
+		out_jointWeights[i] = data.unormJointWeights[i] / 65535.0f;
+	}
+	return true;
+}
+
+/* Returns the vertex data in format, pointing into the file when it's stored that way,
+or converted into mod_converted when it isn't. Returns 0 if the file doesn't have it.
+tangents are used when the file has none. */
+const void* getGOBMESHVertexStream(const GOBMESHData& data, VertexDataType::Format format, const Vec4* tangents, std::vector<char>& mod_converted)
+{
+	unsigned int vertexCount = data.vertexCount;
+	switch (format)
+	{
+		case VertexDataType::positions_3floats:
+			return data.positions;
+		case VertexDataType::uvs_2floats:
+			if (data.uvs || !data.halfUVs) {
+				return data.uvs;
+			}
+			mod_converted.resize(vertexCount*sizeof(Vec2));
+			decodeGOBMESHUVs((Vec2*)mod_converted.data(), data);
+			return mod_converted.data();
+		case VertexDataType::normals_3floats:
+			if (data.normals || !data.octahedralNormals) {
+				return data.normals;
+			}
+			mod_converted.resize(vertexCount*sizeof(Vec3));
+			decodeGOBMESHNormals((Vec3*)mod_converted.data(), data);
+			return mod_converted.data();
+		case VertexDataType::tangents_4floats:
+			if (tangents) {
+				return tangents;
+			}
+			if (!data.octahedralTangents) {
+				return 0;
+			}
+			mod_converted.resize(vertexCount*sizeof(Vec4));
+			decodeGOBMESHTangents((Vec4*)mod_converted.data(), data);
+			return mod_converted.data();
+		case VertexDataType::jointIndices_4ints:
+		case VertexDataType::jointWeights_4floats:
+			if (data.jointIndices || !data.unormJointWeights) {
+				return (format == VertexDataType::jointIndices_4ints) ? (void*)data.jointIndices : (void*)data.jointWeights;
+			}
+			mod_converted.resize(vertexCount*jointsPerVertex*sizeof(float));
+			for (unsigned int i=0; i<vertexCount*jointsPerVertex; i++) {
+				if (format == VertexDataType::jointIndices_4ints) {
+					((unsigned int*)mod_converted.data())[i] = getGOBMESHJointIndex(data, i);
+				}
+				else {
+					((float*)mod_converted.data())[i] = data.unormJointWeights[i] / 65535.0f;
+				}
+			}
+			return mod_converted.data();
+
+		case VertexDataType::uvs_2halfs:
+			if (data.halfUVs || !data.uvs) {
+				return data.halfUVs;
+			}
+			mod_converted.resize(vertexCount*2*sizeof(unsigned short));
+			for (unsigned int i=0; i<vertexCount; i++) {
+				((unsigned short*)mod_converted.data())[2*i] = floatToHalf(data.uvs[i].x);
+				((unsigned short*)mod_converted.data())[2*i+1] = floatToHalf(data.uvs[i].y);
+			}
+			return mod_converted.data();
+		case VertexDataType::normals_2snorm16Octahedral:
+			if (data.octahedralNormals || !data.normals) {
+				return data.octahedralNormals;
+			}
+			mod_converted.resize(vertexCount*2*sizeof(short));
+			for (unsigned int i=0; i<vertexCount; i++) {
+				Vec2 encoded = encodeOctahedral(normalize(data.normals[i]));
+				((short*)mod_converted.data())[2*i] = floatToSnorm16(encoded.x);
+				((short*)mod_converted.data())[2*i+1] = floatToSnorm16(encoded.y);
+			}
+			return mod_converted.data();
+		case VertexDataType::tangents_4snorm16Octahedral:
+			if (!tangents) {
+				return data.octahedralTangents;
+			}
+			mod_converted.resize(vertexCount*4*sizeof(short));
+			for (unsigned int i=0; i<vertexCount; i++) {
+				Vec2 encoded = encodeOctahedral(tangents[i].xyz);
+				short* out_tangent = &((short*)mod_converted.data())[4*i];
+				out_tangent[0] = floatToSnorm16(encoded.x);
+				out_tangent[1] = floatToSnorm16(encoded.y);
+				out_tangent[2] = (tangents[i].w < 0) ? -32767 : 32767;
+				out_tangent[3] = 0;
+			}
+			return mod_converted.data();
+		case VertexDataType::jointIndices_4ubytes:
+			if (data.shortJointIndices || (!data.jointIndices && !data.wideJointIndices)) {
+				return data.shortJointIndices;
+			}
+			mod_converted.resize(vertexCount*jointsPerVertex*sizeof(unsigned char));
+			for (unsigned int i=0; i<vertexCount*jointsPerVertex; i++) {
+				// Skeletons with more than 256 joints need jointIndices_4ushorts
+				assert(getGOBMESHJointIndex(data, i) < 256);
+				((unsigned char*)mod_converted.data())[i] = (unsigned char)getGOBMESHJointIndex(data, i);
+			}
+			return mod_converted.data();
+		case VertexDataType::jointIndices_4ushorts:
+			if (data.wideJointIndices || (!data.jointIndices && !data.shortJointIndices)) {
+				return data.wideJointIndices;
+			}
+			mod_converted.resize(vertexCount*jointsPerVertex*sizeof(unsigned short));
+			for (unsigned int i=0; i<vertexCount*jointsPerVertex; i++) {
+				assert(getGOBMESHJointIndex(data, i) < 65536);
+				((unsigned short*)mod_converted.data())[i] = (unsigned short)getGOBMESHJointIndex(data, i);
+			}
+			return mod_converted.data();
+		case VertexDataType::jointWeights_4unorm16:
+			if (data.unormJointWeights || !data.jointWeights) {
+				return data.unormJointWeights;
+			}
+			mod_converted.resize(vertexCount*jointsPerVertex*sizeof(unsigned short));
+			for (unsigned int i=0; i<vertexCount*jointsPerVertex; i++) {
+				((unsigned short*)mod_converted.data())[i] = (unsigned short)round(clamp(data.jointWeights[i], 0, 1) * 65535.0f);
+			}
+			return mod_converted.data();
+		default:
+			return 0;
+	}
+}
+
+bool createMeshFromGOBMESH(RenderState* rs, Mesh* out_mesh, VertexLayout layout, char* bytes, size_t byteCount, CPUMesh* out_cpuMesh, platform::ThreadPool* pool)
+{
+	GOBMESHData data;
+	if (!readGOBMESH(&data, bytes, byteCount)) {
+		return false;
+	}
+	const MeshLOD* lods;
+	unsigned int lodCount;
+	MeshLOD fullLOD;
+	readGOBMESHLODs(&lods, &lodCount, &fullLOD, data);
+
+	// The converter stores tangents, so this is only for files written before it did
+	std::vector<Vec4> tangents;
+	if (!data.octahedralTangents && (data.uvs || data.halfUVs) && (data.normals || data.octahedralNormals))
+	{
+		std::vector<IndexedTriangle> faces;
+		std::vector<Vec2> uvs;
+		std::vector<Vec3> normals;
+		IndexedTriangle* fullFaces = data.faces;
+		if (!fullFaces) {
+			faces.resize(data.faceCount);
+			decodeGOBMESHFaces(faces.data(), data);
+			fullFaces = faces.data();
+		}
+		Vec2* fullUVs = data.uvs;
+		if (!fullUVs) {
+			uvs.resize(data.vertexCount);
+			decodeGOBMESHUVs(uvs.data(), data);
+			fullUVs = uvs.data();
+		}
+		Vec3* fullNormals = data.normals;
+		if (!fullNormals) {
+			normals.resize(data.vertexCount);
+			decodeGOBMESHNormals(normals.data(), data);
+			fullNormals = normals.data();
+		}
+		tangents.resize(data.vertexCount);
+		// The other levels only use the full mesh's vertices, and shouldn't change their tangents
+		fillVertexTangentArrayParallel(tangents.data(), fullLOD.triangleCount, data.vertexCount, fullFaces + fullLOD.firstTriangle, data.positions, fullUVs, fullNormals, pool);
+	}
+
+	// Each stream is kept in the file, or converted to the layout's format
+	std::vector<std::vector<char>> convertedStreams(layout.dataTypeCount);
+	std::vector<const void*> vertexStreams(layout.dataTypeCount);
+	for (unsigned int i=0; i<layout.dataTypeCount; ++i) {
+		vertexStreams[i] = getGOBMESHVertexStream(data, layout.dataTypes[i].type, tangents.empty() ? 0 : tangents.data(), convertedStreams[i]);
+	}
+
+	if (data.shortFaces) {
+		createMesh(rs, out_mesh, layout, data.faceCount, data.vertexCount, data.shortFaces, sizeof(unsigned short), vertexStreams.data());
+	}
+	else {
+		createMesh(rs, out_mesh, layout, data.faceCount, data.vertexCount, data.faces, sizeof(unsigned int), vertexStreams.data());
+	}
+	// The full mesh is first, so render() drawing the first triangleCount triangles draws it
+	out_mesh->triangleCount = fullLOD.firstTriangle + fullLOD.triangleCount;
+	if (out_cpuMesh) {
+		createCPUMeshFromGOBMESH(out_cpuMesh, data);
+	}
+	return true;
 }
 
 void destroyMesh(Mesh* mesh)
@@ -1243,7 +2097,7 @@ void bindMesh(RenderState* rs, Mesh& mesh)
 #ifdef GOBLIN_ENABLE_D3D
 		GOBLIN_BEGIN_D3D{
 		rs->deviceContext->IASetVertexBuffers(0, mesh.vertexBufferCount, &mesh.d3dVertexBuffers[0], mesh.d3dVertexBufferStrides, mesh.d3dVertexBufferOffsets);
-		rs->deviceContext->IASetIndexBuffer(mesh.d3dIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		rs->deviceContext->IASetIndexBuffer(mesh.d3dIndexBuffer, mesh.d3dIndexFormat, 0);
 		rs->deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	}GOBLIN_END_D3D;
 #endif
@@ -1352,6 +2206,24 @@ bool createShaderProgram(RenderState* rs, ShaderProgram* out_shader, VertexLayou
 				case VertexDataType::jointIndices_4ints:
 					inputLayout[i].Format = DXGI_FORMAT_R32G32B32A32_UINT;
 					break;
+				case VertexDataType::uvs_2halfs:
+					inputLayout[i].Format = DXGI_FORMAT_R16G16_FLOAT;
+					break;
+				case VertexDataType::normals_2snorm16Octahedral:
+					inputLayout[i].Format = DXGI_FORMAT_R16G16_SNORM;
+					break;
+				case VertexDataType::tangents_4snorm16Octahedral:
+					inputLayout[i].Format = DXGI_FORMAT_R16G16B16A16_SNORM;
+					break;
+				case VertexDataType::jointIndices_4ubytes:
+					inputLayout[i].Format = DXGI_FORMAT_R8G8B8A8_UINT;
+					break;
+				case VertexDataType::jointIndices_4ushorts:
+					inputLayout[i].Format = DXGI_FORMAT_R16G16B16A16_UINT;
+					break;
+				case VertexDataType::jointWeights_4unorm16:
+					inputLayout[i].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+					break;
 				default:
 					assert(false); // This type needs to be implemented
 			}
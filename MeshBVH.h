@@ -0,0 +1,706 @@
+#ifndef GOBLIN_MESH_BVH_HEADER
+#define GOBLIN_MESH_BVH_HEADER
+
+#include <assert.h>
+#include "Algebra.h"
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+namespace goblin {
+
+/* A bounding volume hierarchy over a mesh's triangles, for raycasts on the CPU, like picking and line of sight.
+Triangles are three vertex indices each, which is how an array of IndexedTriangle is laid out, so pass
+(const unsigned int*)faces. Only Algebra.h is needed, so the converter can build one into the .gobmesh file.
+To use the file's, and only build one when it doesn't have it:
+	unsigned int byteCount;
+	char* bytes = findGOBMESHChunk(data, gobmeshBVHChunkId, &byteCount);
+	if (!bytes || !readMeshBVH(&bvh, bytes, byteCount, cpuMesh.triangleCount)) {
+		buildMeshBVH(&bvh, cpuMesh.positions, (const unsigned int*)cpuMesh.faces, cpuMesh.triangleCount);
+	} */
+
+struct BVHNode
+{
+	Vec3 boundsMin;
+	// For leaves, their first triangle in MeshBVH::triangles.
+	// For other nodes, the first of their two children, which are next to each other.
+	unsigned int first;
+	Vec3 boundsMax;
+	// 0 for nodes that aren't leaves
+	unsigned int triangleCount;
+};
+
+struct MeshBVH
+{
+	unsigned int nodeCount;
+	unsigned int triangleCount;
+	// The root is first, and children always come after their parent
+	const BVHNode* nodes;
+	// The mesh's triangle indices, in the order the leaves use them
+	const unsigned int* triangles;
+	// 0 when nodes and triangles point into a file's bytes
+	char* memory;
+};
+
+// Leaves have up to this many triangles, unless the tree would get deeper than maxBVHDepth
+static const unsigned int maxBVHLeafTriangles = 8;
+static const unsigned int maxBVHDepth = 64;
+
+/* Splits the triangles with the surface area heuristic, trying 16 evenly spaced splits on each axis for each node.
+The nodes near the root are built first, and the subtrees under them are shared between threadCount threads.
+threadCount=0 uses one for each core. The result doesn't depend on how many threads are used. */
+void buildMeshBVH(MeshBVH* out_bvh, const Vec3* positions, const unsigned int* vertexIndices, unsigned int triangleCount, unsigned int threadCount = 0);
+void destroyMeshBVH(MeshBVH* bvh);
+
+static const unsigned int rayMissed = 0xFFFFFFFF;
+
+struct RayHit
+{
+	// In units of the ray direction's length
+	float distance;
+	// rayMissed if nothing was hit
+	unsigned int triangle;
+	// The hit is at (1-u-v)*a + u*b + v*c, where a, b and c are the triangle's corners
+	float u, v;
+};
+
+// Finds the closest triangle the ray hits within maxDistance. Triangles are hit from both sides.
+bool raycastMeshBVH(RayHit* out_hit, const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, Vec3 origin, Vec3 direction, float maxDistance = 1e30f);
+// True if the ray hits anything within maxDistance. Quicker than raycastMeshBVH(), since it stops at the first hit it finds.
+bool isRayBlockedByMeshBVH(const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, Vec3 origin, Vec3 direction, float maxDistance = 1e30f);
+/* Same as raycastMeshBVH() for each ray, but floatLaneCount rays go through the tree together,
+testing each node and triangle against all of them at once. That's quickest when the rays mostly go through
+the same nodes, like the pixels around a cursor, or rays from one place towards things near each other.
+Returns how many rays hit. */
+unsigned int raycastMeshBVHPackets(RayHit* out_hits, const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, const Vec3* origins, const Vec3* directions, unsigned int rayCount, float maxDistance = 1e30f);
+
+// The chunk in a .gobmesh file that holds its MeshBVH: "BVH "
+static const unsigned int gobmeshBVHChunkId = 0x20485642;
+
+/* A MeshBVH's bytes, as .gobmesh files store it:
+{uint32 nodeCount, uint32 triangleCount, BVHNode nodes[nodeCount], uint32 triangles[triangleCount]} */
+unsigned int getMeshBVHByteCount(const MeshBVH& bvh);
+void writeMeshBVH(char* out_bytes, const MeshBVH& bvh);
+/* Points out_bvh into the bytes, so keep them around while using it. The bytes need to be 4 byte aligned, like .gobmesh chunks.
+Returns false if they aren't a BVH over all meshTriangleCount triangles. */
+bool readMeshBVH(MeshBVH* out_bvh, char* bytes, unsigned int byteCount, unsigned int meshTriangleCount);
+
+// Implementation =============================================================
+
+static const unsigned int bvhBinCount = 16;
+// Subtrees with this many triangles or fewer are built as separate tasks
+static const unsigned int bvhTaskTriangles = 4096;
+
+void growBounds(Vec3* inout_boundsMin, Vec3* inout_boundsMax, Vec3 boundsMin, Vec3 boundsMax)
+{
+	inout_boundsMin->x = min(inout_boundsMin->x, boundsMin.x);
+	inout_boundsMin->y = min(inout_boundsMin->y, boundsMin.y);
+	inout_boundsMin->z = min(inout_boundsMin->z, boundsMin.z);
+	inout_boundsMax->x = max(inout_boundsMax->x, boundsMax.x);
+	inout_boundsMax->y = max(inout_boundsMax->y, boundsMax.y);
+	inout_boundsMax->z = max(inout_boundsMax->z, boundsMax.z);
+}
+
+// 0 for empty bounds
+float getBoundsArea(Vec3 boundsMin, Vec3 boundsMax)
+{
+	Vec3 size = boundsMax - boundsMin;
+	if (size.x < 0 || size.y < 0 || size.z < 0) {
+		return 0;
+	}
+	return 2*(size.x*size.y + size.y*size.z + size.z*size.x);
+}
+
+struct BVHBuildContext
+{
+	std::vector<Vec3> triangleMins;
+	std::vector<Vec3> triangleMaxs;
+	std::vector<Vec3> centroids;
+	// Split into the nodes' ranges as they're built. Tasks work on separate ranges, so they can share it.
+	std::vector<unsigned int> triangles;
+};
+
+struct BVHBuildTask
+{
+	unsigned int node;
+	unsigned int first;
+	unsigned int count;
+	unsigned int depth;
+	// The subtree, with its root first
+	std::vector<BVHNode> nodes;
+};
+
+inline unsigned int getBVHBin(float centroid, float centroidMin, float binScale)
+{
+	unsigned int bin = (unsigned int)((centroid - centroidMin)*binScale);
+	return (bin < bvhBinCount) ? bin : bvhBinCount-1;
+}
+
+/* Fills (*inout_nodes)[nodeIndex] with the count triangles from first, and builds the nodes under it.
+When out_tasks isn't 0, nodes with bvhTaskTriangles or fewer are left as tasks, to build on other threads. */
+void buildBVHNode(std::vector<BVHNode>* inout_nodes, unsigned int nodeIndex, unsigned int first, unsigned int count, unsigned int depth,
+	BVHBuildContext* context, std::vector<BVHBuildTask>* out_tasks)
+{
+	Vec3 boundsMin = {1e30f, 1e30f, 1e30f};
+	Vec3 boundsMax = {-1e30f, -1e30f, -1e30f};
+	Vec3 centroidMin = boundsMin;
+	Vec3 centroidMax = boundsMax;
+	for (unsigned int i=first; i<first+count; i++) {
+		unsigned int triangle = context->triangles[i];
+		growBounds(&boundsMin, &boundsMax, context->triangleMins[triangle], context->triangleMaxs[triangle]);
+		growBounds(&centroidMin, &centroidMax, context->centroids[triangle], context->centroids[triangle]);
+	}
+	// A leaf, until it's split
+	BVHNode node = {boundsMin, first, boundsMax, count};
+	(*inout_nodes)[nodeIndex] = node;
+	if (out_tasks && count <= bvhTaskTriangles) {
+		BVHBuildTask task = {nodeIndex, first, count, depth, std::vector<BVHNode>()};
+		out_tasks->push_back(task);
+		return;
+	}
+	if (count <= 1 || depth+1 >= maxBVHDepth) {
+		return;
+	}
+
+	// The split with the least area times triangles on each side
+	float bestCost = 1e30f;
+	unsigned int bestAxis = 0;
+	unsigned int bestSplit = 0;
+	for (unsigned int axis=0; axis<3; axis++)
+	{
+		float axisMin = (&centroidMin.x)[axis];
+		float extent = (&centroidMax.x)[axis] - axisMin;
+		if (extent <= 0) {
+			continue;
+		}
+		float binScale = bvhBinCount/extent;
+		Vec3 binMins[bvhBinCount];
+		Vec3 binMaxs[bvhBinCount];
+		unsigned int binCounts[bvhBinCount];
+		for (unsigned int b=0; b<bvhBinCount; b++) {
+			binMins[b] = Vec3{1e30f, 1e30f, 1e30f};
+			binMaxs[b] = Vec3{-1e30f, -1e30f, -1e30f};
+			binCounts[b] = 0;
+		}
+		for (unsigned int i=first; i<first+count; i++) {
+			unsigned int triangle = context->triangles[i];
+			unsigned int b = getBVHBin((&context->centroids[triangle].x)[axis], axisMin, binScale);
+			growBounds(&binMins[b], &binMaxs[b], context->triangleMins[triangle], context->triangleMaxs[triangle]);
+			binCounts[b]++;
+		}
+
+		// Sweep from the right, so each split knows its right side, then from the left
+		float rightAreas[bvhBinCount];
+		unsigned int rightCounts[bvhBinCount];
+		Vec3 sweepMin = {1e30f, 1e30f, 1e30f};
+		Vec3 sweepMax = {-1e30f, -1e30f, -1e30f};
+		unsigned int sweepCount = 0;
+		for (unsigned int b=bvhBinCount-1; b>0; b--) {
+			growBounds(&sweepMin, &sweepMax, binMins[b], binMaxs[b]);
+			sweepCount += binCounts[b];
+			rightAreas[b] = getBoundsArea(sweepMin, sweepMax);
+			rightCounts[b] = sweepCount;
+		}
+		sweepMin = Vec3{1e30f, 1e30f, 1e30f};
+		sweepMax = Vec3{-1e30f, -1e30f, -1e30f};
+		sweepCount = 0;
+		for (unsigned int b=0; b<bvhBinCount-1; b++)
+		{
+			growBounds(&sweepMin, &sweepMax, binMins[b], binMaxs[b]);
+			sweepCount += binCounts[b];
+			if (sweepCount == 0 || rightCounts[b+1] == 0) {
+				continue;
+			}
+			float cost = getBoundsArea(sweepMin, sweepMax)*sweepCount + rightAreas[b+1]*rightCounts[b+1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b+1;
+			}
+		}
+	}
+
+	// Costs are in triangle tests, counting a node test as one
+	float area = getBoundsArea(boundsMin, boundsMax);
+	float splitCost = (area > 0) ? 1 + bestCost/area : 1e30f;
+	unsigned int leftCount;
+	if (bestCost < 1e30f && (splitCost < count || count > maxBVHLeafTriangles))
+	{
+		float axisMin = (&centroidMin.x)[bestAxis];
+		float binScale = bvhBinCount/((&centroidMax.x)[bestAxis] - axisMin);
+		unsigned int* triangles = context->triangles.data();
+		unsigned int* middle = std::partition(triangles + first, triangles + first + count, [&](unsigned int triangle) {
+			return getBVHBin((&context->centroids[triangle].x)[bestAxis], axisMin, binScale) < bestSplit;
+		});
+		leftCount = (unsigned int)(middle - (triangles + first));
+	}
+	else if (count > maxBVHLeafTriangles) {
+		// The centroids are all in one place, so any split is as good as another
+		leftCount = count/2;
+	}
+	else {
+		return;
+	}
+
+	unsigned int child = inout_nodes->size();
+	inout_nodes->resize(child+2);
+	(*inout_nodes)[nodeIndex].first = child;
+	(*inout_nodes)[nodeIndex].triangleCount = 0;
+	buildBVHNode(inout_nodes, child, first, leftCount, depth+1, context, out_tasks);
+	buildBVHNode(inout_nodes, child+1, first+leftCount, count-leftCount, depth+1, context, out_tasks);
+}
+
+void buildBVHTasks(std::vector<BVHBuildTask>* inout_tasks, std::atomic<unsigned int>* inout_nextTask, BVHBuildContext* context)
+{
+	for (unsigned int i=(*inout_nextTask)++; i<inout_tasks->size(); i=(*inout_nextTask)++) {
+		BVHBuildTask& task = (*inout_tasks)[i];
+		task.nodes.resize(1);
+		buildBVHNode(&task.nodes, 0, task.first, task.count, task.depth, context, 0);
+	}
+}
+
+void buildMeshBVH(MeshBVH* out_bvh, const Vec3* positions, const unsigned int* vertexIndices, unsigned int triangleCount, unsigned int threadCount)
+{
+	MeshBVH bvh = {};
+	if (triangleCount == 0) {
+		*out_bvh = bvh;
+		return;
+	}
+
+	BVHBuildContext context;
+	context.triangleMins.resize(triangleCount);
+	context.triangleMaxs.resize(triangleCount);
+	context.centroids.resize(triangleCount);
+	context.triangles.resize(triangleCount);
+	for (unsigned int i=0; i<triangleCount; i++) {
+		Vec3 a = positions[vertexIndices[3*i]];
+		Vec3 b = positions[vertexIndices[3*i+1]];
+		Vec3 c = positions[vertexIndices[3*i+2]];
+		context.triangleMins[i] = Vec3{min(a.x, min(b.x, c.x)), min(a.y, min(b.y, c.y)), min(a.z, min(b.z, c.z))};
+		context.triangleMaxs[i] = Vec3{max(a.x, max(b.x, c.x)), max(a.y, max(b.y, c.y)), max(a.z, max(b.z, c.z))};
+		context.centroids[i] = (context.triangleMins[i] + context.triangleMaxs[i])*0.5f;
+		context.triangles[i] = i;
+	}
+
+	// The nodes above the tasks, then the tasks, which are the same with any number of threads
+	std::vector<BVHNode> nodes(1);
+	std::vector<BVHBuildTask> tasks;
+	buildBVHNode(&nodes, 0, 0, triangleCount, 0, &context, &tasks);
+
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount > tasks.size()) {
+		threadCount = tasks.size();
+	}
+	std::atomic<unsigned int> nextTask(0);
+	std::vector<std::thread> helpers;
+	for (unsigned int i=1; i<threadCount; i++) {
+		helpers.push_back(std::thread(buildBVHTasks, &tasks, &nextTask, &context));
+	}
+	buildBVHTasks(&tasks, &nextTask, &context);
+	for (unsigned int i=0; i<helpers.size(); i++) {
+		helpers[i].join();
+	}
+
+	// Each subtree's root goes in its task's node, and the rest after the nodes so far
+	for (unsigned int i=0; i<tasks.size(); i++)
+	{
+		unsigned int offset = nodes.size() - 1;
+		for (unsigned int j=0; j<tasks[i].nodes.size(); j++)
+		{
+			BVHNode node = tasks[i].nodes[j];
+			if (node.triangleCount == 0) {
+				node.first += offset;
+			}
+			if (j == 0) {
+				nodes[tasks[i].node] = node;
+			}
+			else {
+				nodes.push_back(node);
+			}
+		}
+	}
+
+	bvh.nodeCount = nodes.size();
+	bvh.triangleCount = triangleCount;
+	bvh.memory = new char[bvh.nodeCount*sizeof(BVHNode) + triangleCount*sizeof(unsigned int)];
+	memcpy(bvh.memory, nodes.data(), bvh.nodeCount*sizeof(BVHNode));
+	memcpy(bvh.memory + bvh.nodeCount*sizeof(BVHNode), context.triangles.data(), triangleCount*sizeof(unsigned int));
+	bvh.nodes = (const BVHNode*)bvh.memory;
+	bvh.triangles = (const unsigned int*)(bvh.memory + bvh.nodeCount*sizeof(BVHNode));
+	*out_bvh = bvh;
+}
+
+void destroyMeshBVH(MeshBVH* bvh)
+{
+	delete[] bvh->memory;
+	MeshBVH zero = {};
+	*bvh = zero;
+}
+
+// Directions with a 0 component would divide by 0, so a tiny one is used instead, which keeps the slab distances finite
+Vec3 getInverseRayDirection(Vec3 direction)
+{
+	Vec3 inverse;
+	for (unsigned int axis=0; axis<3; axis++) {
+		float d = (&direction.x)[axis];
+		if (fabsf(d) < 1e-20f) {
+			d = (d < 0) ? -1e-20f : 1e-20f;
+		}
+		(&inverse.x)[axis] = 1/d;
+	}
+	return inverse;
+}
+
+// The distance where the ray enters the node's bounds, or 1e30 if it misses them before maxDistance
+inline float intersectBVHBounds(const BVHNode& node, Vec3 origin, Vec3 inverseDirection, float maxDistance)
+{
+	float x1 = (node.boundsMin.x - origin.x)*inverseDirection.x;
+	float x2 = (node.boundsMax.x - origin.x)*inverseDirection.x;
+	float y1 = (node.boundsMin.y - origin.y)*inverseDirection.y;
+	float y2 = (node.boundsMax.y - origin.y)*inverseDirection.y;
+	float z1 = (node.boundsMin.z - origin.z)*inverseDirection.z;
+	float z2 = (node.boundsMax.z - origin.z)*inverseDirection.z;
+	float enter = max(max(min(x1, x2), min(y1, y2)), max(min(z1, z2), 0.0f));
+	float exit = min(min(max(x1, x2), max(y1, y2)), min(max(z1, z2), maxDistance));
+	return (enter <= exit) ? enter : 1e30f;
+}
+
+// Möller and Trumbore. Replaces inout_hit if the ray hits the triangle closer than it.
+inline bool intersectTriangle(RayHit* inout_hit, unsigned int triangle, const Vec3* positions, const unsigned int* vertexIndices, Vec3 origin, Vec3 direction)
+{
+	Vec3 a = positions[vertexIndices[3*triangle]];
+	Vec3 edge1 = positions[vertexIndices[3*triangle+1]] - a;
+	Vec3 edge2 = positions[vertexIndices[3*triangle+2]] - a;
+	Vec3 p = cross(direction, edge2);
+	float determinant = dot(edge1, p);
+	// Parallel to the triangle
+	if (determinant == 0) {
+		return false;
+	}
+	float inverseDeterminant = 1/determinant;
+	Vec3 toOrigin = origin - a;
+	float u = dot(toOrigin, p)*inverseDeterminant;
+	if (u < 0 || u > 1) {
+		return false;
+	}
+	Vec3 q = cross(toOrigin, edge1);
+	float v = dot(direction, q)*inverseDeterminant;
+	if (v < 0 || u + v > 1) {
+		return false;
+	}
+	float distance = dot(edge2, q)*inverseDeterminant;
+	if (distance < 0 || distance >= inout_hit->distance) {
+		return false;
+	}
+	inout_hit->distance = distance;
+	inout_hit->triangle = triangle;
+	inout_hit->u = u;
+	inout_hit->v = v;
+	return true;
+}
+
+bool traceMeshBVH(RayHit* inout_hit, const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, Vec3 origin, Vec3 direction, bool stopAtAnyHit)
+{
+	if (bvh.nodeCount == 0) {
+		return false;
+	}
+	Vec3 inverseDirection = getInverseRayDirection(direction);
+	if (intersectBVHBounds(bvh.nodes[0], origin, inverseDirection, inout_hit->distance) == 1e30f) {
+		return false;
+	}
+
+	// Children waiting to be visited, with where the ray enters them
+	unsigned int stack[maxBVHDepth];
+	float stackDistances[maxBVHDepth];
+	unsigned int stackSize = 0;
+	unsigned int nodeIndex = 0;
+	bool hit = false;
+	while (true)
+	{
+		const BVHNode& node = bvh.nodes[nodeIndex];
+		if (node.triangleCount > 0)
+		{
+			for (unsigned int i=node.first; i<node.first+node.triangleCount; i++) {
+				if (intersectTriangle(inout_hit, bvh.triangles[i], positions, vertexIndices, origin, direction)) {
+					hit = true;
+					if (stopAtAnyHit) {
+						return true;
+					}
+				}
+			}
+		}
+		else
+		{
+			// The nearer child first, and the other one later, if nothing closer has been hit by then
+			unsigned int nearChild = node.first;
+			unsigned int farChild = node.first+1;
+			float nearDistance = intersectBVHBounds(bvh.nodes[nearChild], origin, inverseDirection, inout_hit->distance);
+			float farDistance = intersectBVHBounds(bvh.nodes[farChild], origin, inverseDirection, inout_hit->distance);
+			if (farDistance < nearDistance) {
+				std::swap(nearChild, farChild);
+				std::swap(nearDistance, farDistance);
+			}
+			if (nearDistance != 1e30f) {
+				if (farDistance != 1e30f) {
+					stack[stackSize] = farChild;
+					stackDistances[stackSize] = farDistance;
+					stackSize++;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		while (stackSize > 0 && stackDistances[stackSize-1] >= inout_hit->distance) {
+			stackSize--;
+		}
+		if (stackSize == 0) {
+			break;
+		}
+		stackSize--;
+		nodeIndex = stack[stackSize];
+	}
+	return hit;
+}
+
+bool raycastMeshBVH(RayHit* out_hit, const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, Vec3 origin, Vec3 direction, float maxDistance)
+{
+	RayHit hit = {maxDistance, rayMissed, 0, 0};
+	bool found = traceMeshBVH(&hit, bvh, positions, vertexIndices, origin, direction, false);
+	*out_hit = hit;
+	return found;
+}
+
+bool isRayBlockedByMeshBVH(const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, Vec3 origin, Vec3 direction, float maxDistance)
+{
+	RayHit hit = {maxDistance, rayMissed, 0, 0};
+	return traceMeshBVH(&hit, bvh, positions, vertexIndices, origin, direction, true);
+}
+
+static const unsigned int allLanesMask = (1u << floatLaneCount) - 1;
+
+// Bit i is set where ray i enters the node's bounds before closest, which is also written to out_enter
+inline unsigned int intersectBVHBoundsLanes(FloatLanes* out_enter, const BVHNode& node, const Vec3Lanes& origin, const Vec3Lanes& inverseDirection, FloatLanes closest)
+{
+	FloatLanes x1 = multiplyLanes(subtractLanes(setLanes(node.boundsMin.x), origin.x), inverseDirection.x);
+	FloatLanes x2 = multiplyLanes(subtractLanes(setLanes(node.boundsMax.x), origin.x), inverseDirection.x);
+	FloatLanes y1 = multiplyLanes(subtractLanes(setLanes(node.boundsMin.y), origin.y), inverseDirection.y);
+	FloatLanes y2 = multiplyLanes(subtractLanes(setLanes(node.boundsMax.y), origin.y), inverseDirection.y);
+	FloatLanes z1 = multiplyLanes(subtractLanes(setLanes(node.boundsMin.z), origin.z), inverseDirection.z);
+	FloatLanes z2 = multiplyLanes(subtractLanes(setLanes(node.boundsMax.z), origin.z), inverseDirection.z);
+	FloatLanes enter = maxLanes(maxLanes(minLanes(x1, x2), minLanes(y1, y2)), maxLanes(minLanes(z1, z2), setLanes(0)));
+	FloatLanes exit = minLanes(minLanes(maxLanes(x1, x2), maxLanes(y1, y2)), minLanes(maxLanes(z1, z2), closest));
+	*out_enter = enter;
+	return ~lessThanLanesMask(exit, enter) & allLanesMask;
+}
+
+// The smallest of the lanes that are set in mask
+inline float getMinimumLane(FloatLanes lanes, unsigned int mask)
+{
+	alignas(32) float values[floatLaneCount];
+	storeLanes(values, lanes);
+	float minimum = 1e30f;
+	for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+		if (mask & (1u << lane)) {
+			minimum = min(minimum, values[lane]);
+		}
+	}
+	return minimum;
+}
+
+// Traces up to floatLaneCount rays together, and returns how many hit
+unsigned int raycastMeshBVHPacket(RayHit* out_hits, const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, const Vec3* origins, const Vec3* directions, unsigned int rayCount, float maxDistance)
+{
+	// Lanes past rayCount repeat the last ray, and aren't written out
+	Vec3 inverseDirections[floatLaneCount];
+	for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+		inverseDirections[lane] = getInverseRayDirection(directions[(lane < rayCount) ? lane : rayCount-1]);
+	}
+	Vec3Lanes origin, direction, inverseDirection;
+	loadFloatLanes((FloatLanes*)&origin, (const float*)origins, 3, 3, rayCount);
+	loadFloatLanes((FloatLanes*)&direction, (const float*)directions, 3, 3, rayCount);
+	loadFloatLanes((FloatLanes*)&inverseDirection, (const float*)inverseDirections, 3, 3, floatLaneCount);
+
+	alignas(32) float closest[floatLaneCount];
+	unsigned int triangles[floatLaneCount];
+	float us[floatLaneCount];
+	float vs[floatLaneCount];
+	for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+		closest[lane] = maxDistance;
+		triangles[lane] = rayMissed;
+		us[lane] = 0;
+		vs[lane] = 0;
+	}
+	FloatLanes closestLanes = loadLanes(closest);
+	FloatLanes zero = setLanes(0);
+	FloatLanes one = setLanes(1);
+
+	unsigned int stack[maxBVHDepth];
+	unsigned int stackSize = 0;
+	unsigned int nodeIndex = 0;
+	FloatLanes enter;
+	bool visiting = (bvh.nodeCount > 0 && intersectBVHBoundsLanes(&enter, bvh.nodes[0], origin, inverseDirection, closestLanes) != 0);
+	while (visiting)
+	{
+		const BVHNode& node = bvh.nodes[nodeIndex];
+		if (node.triangleCount > 0)
+		{
+			for (unsigned int i=node.first; i<node.first+node.triangleCount; i++)
+			{
+				// Möller and Trumbore, as in intersectTriangle()
+				unsigned int triangle = bvh.triangles[i];
+				Vec3 a = positions[vertexIndices[3*triangle]];
+				Vec3 edge1 = positions[vertexIndices[3*triangle+1]] - a;
+				Vec3 edge2 = positions[vertexIndices[3*triangle+2]] - a;
+				Vec3Lanes e1 = {setLanes(edge1.x), setLanes(edge1.y), setLanes(edge1.z)};
+				Vec3Lanes e2 = {setLanes(edge2.x), setLanes(edge2.y), setLanes(edge2.z)};
+				Vec3Lanes p = {
+					subtractLanes(multiplyLanes(direction.y, e2.z), multiplyLanes(direction.z, e2.y)),
+					subtractLanes(multiplyLanes(direction.z, e2.x), multiplyLanes(direction.x, e2.z)),
+					subtractLanes(multiplyLanes(direction.x, e2.y), multiplyLanes(direction.y, e2.x))};
+				FloatLanes determinant = addLanes(addLanes(multiplyLanes(e1.x, p.x), multiplyLanes(e1.y, p.y)), multiplyLanes(e1.z, p.z));
+				FloatLanes inverseDeterminant = divideLanes(one, determinant);
+				Vec3Lanes toOrigin = {subtractLanes(origin.x, setLanes(a.x)), subtractLanes(origin.y, setLanes(a.y)), subtractLanes(origin.z, setLanes(a.z))};
+				FloatLanes u = multiplyLanes(addLanes(addLanes(multiplyLanes(toOrigin.x, p.x), multiplyLanes(toOrigin.y, p.y)), multiplyLanes(toOrigin.z, p.z)), inverseDeterminant);
+				Vec3Lanes q = {
+					subtractLanes(multiplyLanes(toOrigin.y, e1.z), multiplyLanes(toOrigin.z, e1.y)),
+					subtractLanes(multiplyLanes(toOrigin.z, e1.x), multiplyLanes(toOrigin.x, e1.z)),
+					subtractLanes(multiplyLanes(toOrigin.x, e1.y), multiplyLanes(toOrigin.y, e1.x))};
+				FloatLanes v = multiplyLanes(addLanes(addLanes(multiplyLanes(direction.x, q.x), multiplyLanes(direction.y, q.y)), multiplyLanes(direction.z, q.z)), inverseDeterminant);
+				FloatLanes distance = multiplyLanes(addLanes(addLanes(multiplyLanes(e2.x, q.x), multiplyLanes(e2.y, q.y)), multiplyLanes(e2.z, q.z)), inverseDeterminant);
+
+				unsigned int hitMask = (lessThanLanesMask(determinant, zero) | lessThanLanesMask(zero, determinant))
+					& ~lessThanLanesMask(u, zero) & ~lessThanLanesMask(v, zero) & ~lessThanLanesMask(one, addLanes(u, v))
+					& ~lessThanLanesMask(distance, zero) & lessThanLanesMask(distance, closestLanes) & allLanesMask;
+				if (hitMask == 0) {
+					continue;
+				}
+				alignas(32) float hitDistances[floatLaneCount];
+				alignas(32) float hitUs[floatLaneCount];
+				alignas(32) float hitVs[floatLaneCount];
+				storeLanes(hitDistances, distance);
+				storeLanes(hitUs, u);
+				storeLanes(hitVs, v);
+				for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+					if (hitMask & (1u << lane)) {
+						closest[lane] = hitDistances[lane];
+						triangles[lane] = triangle;
+						us[lane] = hitUs[lane];
+						vs[lane] = hitVs[lane];
+					}
+				}
+				closestLanes = loadLanes(closest);
+			}
+		}
+		else
+		{
+			FloatLanes firstEnter, secondEnter;
+			unsigned int firstMask = intersectBVHBoundsLanes(&firstEnter, bvh.nodes[node.first], origin, inverseDirection, closestLanes);
+			unsigned int secondMask = intersectBVHBoundsLanes(&secondEnter, bvh.nodes[node.first+1], origin, inverseDirection, closestLanes);
+			if (firstMask && secondMask) {
+				// The child that one of the rays reaches first goes first
+				bool secondIsNearer = getMinimumLane(secondEnter, secondMask) < getMinimumLane(firstEnter, firstMask);
+				stack[stackSize++] = secondIsNearer ? node.first : node.first+1;
+				nodeIndex = secondIsNearer ? node.first+1 : node.first;
+				continue;
+			}
+			if (firstMask || secondMask) {
+				nodeIndex = firstMask ? node.first : node.first+1;
+				continue;
+			}
+		}
+
+		// Skip waiting nodes that every ray has since hit something closer than
+		visiting = false;
+		while (stackSize > 0) {
+			stackSize--;
+			nodeIndex = stack[stackSize];
+			if (intersectBVHBoundsLanes(&enter, bvh.nodes[nodeIndex], origin, inverseDirection, closestLanes) != 0) {
+				visiting = true;
+				break;
+			}
+		}
+	}
+
+	unsigned int hitCount = 0;
+	for (unsigned int lane=0; lane<rayCount; lane++) {
+		RayHit hit = {closest[lane], triangles[lane], us[lane], vs[lane]};
+		out_hits[lane] = hit;
+		hitCount += (triangles[lane] != rayMissed) ? 1 : 0;
+	}
+	return hitCount;
+}
+
+unsigned int raycastMeshBVHPackets(RayHit* out_hits, const MeshBVH& bvh, const Vec3* positions, const unsigned int* vertexIndices, const Vec3* origins, const Vec3* directions, unsigned int rayCount, float maxDistance)
+{
+	unsigned int hitCount = 0;
+	for (unsigned int first=0; first<rayCount; first+=floatLaneCount) {
+		unsigned int count = (rayCount-first < floatLaneCount) ? rayCount-first : floatLaneCount;
+		hitCount += raycastMeshBVHPacket(out_hits+first, bvh, positions, vertexIndices, origins+first, directions+first, count, maxDistance);
+	}
+	return hitCount;
+}
+
+unsigned int getMeshBVHByteCount(const MeshBVH& bvh)
+{
+	return 2*sizeof(unsigned int) + bvh.nodeCount*sizeof(BVHNode) + bvh.triangleCount*sizeof(unsigned int);
+}
+
+void writeMeshBVH(char* out_bytes, const MeshBVH& bvh)
+{
+	unsigned int counts[2] = {bvh.nodeCount, bvh.triangleCount};
+	memcpy(out_bytes, counts, sizeof(counts));
+	memcpy(out_bytes + sizeof(counts), bvh.nodes, bvh.nodeCount*sizeof(BVHNode));
+	memcpy(out_bytes + sizeof(counts) + bvh.nodeCount*sizeof(BVHNode), bvh.triangles, bvh.triangleCount*sizeof(unsigned int));
+}
+
+bool readMeshBVH(MeshBVH* out_bvh, char* bytes, unsigned int byteCount, unsigned int meshTriangleCount)
+{
+	MeshBVH bvh = {};
+	*out_bvh = bvh;
+	if (byteCount < 2*sizeof(unsigned int)) {
+		return false;
+	}
+	unsigned int counts[2];
+	memcpy(counts, bytes, sizeof(counts));
+	bvh.nodeCount = counts[0];
+	bvh.triangleCount = counts[1];
+	if (bvh.triangleCount != meshTriangleCount || (bvh.nodeCount == 0) != (bvh.triangleCount == 0)
+		|| bvh.nodeCount > (byteCount - sizeof(counts))/sizeof(BVHNode)
+		|| getMeshBVHByteCount(bvh) != byteCount) {
+		return false;
+	}
+	bvh.nodes = (const BVHNode*)(bytes + sizeof(counts));
+	bvh.triangles = (const unsigned int*)(bytes + sizeof(counts) + bvh.nodeCount*sizeof(BVHNode));
+
+	// Traversal trusts the nodes, so check they can't send it out of the arrays, around in circles, or deeper than its stack
+	std::vector<unsigned int> depths(bvh.nodeCount, 0);
+	for (unsigned int i=0; i<bvh.nodeCount; i++)
+	{
+		const BVHNode& node = bvh.nodes[i];
+		if (node.triangleCount > 0) {
+			if (node.first > bvh.triangleCount || node.triangleCount > bvh.triangleCount - node.first) {
+				return false;
+			}
+		}
+		else {
+			if (node.first <= i || node.first >= bvh.nodeCount-1 || depths[i]+1 >= maxBVHDepth) {
+				return false;
+			}
+			depths[node.first] = depths[node.first+1] = depths[i]+1;
+		}
+	}
+	for (unsigned int i=0; i<bvh.triangleCount; i++) {
+		if (bvh.triangles[i] >= meshTriangleCount) {
+			return false;
+		}
+	}
+	*out_bvh = bvh;
+	return true;
+}
+
+} // namespace
+#endif // header include guard
@@ -20,9 +20,13 @@ struct Skeleton
 	Joint* joints;
 	unsigned int jointCount;
 	unsigned int rootJointIndex;
+	bool referencesBytes; // The joints point into the file's bytes instead of being allocated
 };
 
-void createSkeletonFromGOBSKEL(Skeleton* out_skeleton, char* bytes, size_t byteCount);
+/* With copyBytes false, the joints point straight into bytes, which have to stay
+loaded until the skeleton is destroyed. Made for memory mapped files (platform::mapFile()).
+Bytes that aren't 4 byte aligned are copied anyway. */
+void createSkeletonFromGOBSKEL(Skeleton* out_skeleton, char* bytes, size_t byteCount, bool copyBytes = true);
 void destroySkeleton(Skeleton* skeleton);
 
 /* Contains a list of joints, each of which has it's own timeline.
@@ -56,11 +60,58 @@ struct SkeletonAnimation
 	unsigned int keysPerSecond;
 	unsigned int jointCount;
 	JointAnimation* jointAnimations;
+	bool referencesBytes; // The keys point into the file's bytes instead of being allocated
 };
 
-void createSkeletonAnimationFromGOBSKELANIM(SkeletonAnimation* out_animation, char* bytes, size_t byteCount);
+/* With copyBytes false, a version 1 file's keys aren't copied. They point straight into bytes,
+which have to stay loaded until the animation is destroyed, and the only allocation is the array of joints.
+Version 2 files and bytes that aren't 4 byte aligned are always copied. */
+void createSkeletonAnimationFromGOBSKELANIM(SkeletonAnimation* out_animation, char* bytes, size_t byteCount, bool copyBytes = true);
 void destroySkeletonAnimation(SkeletonAnimation* animation);
 
+/* An animation loaded from a version 2 .gobskelanim file, kept in its compressed form.
+Channels can be stored as raw floats, as a single constant value, or quantized:
+rotations as 48 bit "smallest three" quaternions, and scales and translations
+as 16 bits per component within the channel's range.
+Keys are decoded as they are sampled. */
+struct CompressedSkeletonAnimation
+{
+	enum Encoding {
+		encoding_raw,
+		encoding_constant,
+		encoding_quantized
+	};
+
+	struct Channel {
+		unsigned int keyCount;
+		unsigned int encoding;
+		float* keyTimes; // Constant channels don't have key times
+		// Vec3 or Quaternion for raw and constant channels.
+		// 3 unsigned shorts per key for quantized channels.
+		void* keyValues;
+		// The range quantized Vec3 keys are spread over
+		Vec3 rangeMin;
+		Vec3 rangeExtent;
+	};
+
+	struct JointAnimation {
+		Channel scale;
+		Channel rotation;
+		Channel translation;
+	};
+
+	float duration;
+	unsigned int jointCount;
+	JointAnimation* jointAnimations;
+	char* bytes; // A copy of the file that the channels point into, or 0 if they point into the caller's bytes
+};
+
+/* Returns false if the bytes aren't a version 2 .gobskelanim file.
+With copyBytes false, the channels point into bytes, which have to stay loaded
+until the animation is destroyed. */
+bool createCompressedSkeletonAnimationFromGOBSKELANIM(CompressedSkeletonAnimation* out_animation, char* bytes, size_t byteCount, bool copyBytes = true);
+void destroyCompressedSkeletonAnimation(CompressedSkeletonAnimation* animation);
+
 // A "JointPose" is a relative offset from a joint's parent.
 
 /* Search an array of floats to find the closest indices that 
@@ -74,13 +125,114 @@ void findAnimationKeys(
 	float* arrayOfTimes,
 	unsigned int numberOfTimes);
 
+/* Same result as findAnimationKeys(), but starts looking from the key in inout_hint
+and updates it with the key that was found. When time moves forward a little each
+frame, the keys are usually found in the first step or two instead of searching. */
+void findAnimationKeysFromHint(
+	unsigned int* out_firstKey,
+	unsigned int* out_secondKey,
+	unsigned int* inout_hint,
+	float time,
+	float* arrayOfTimes,
+	unsigned int numberOfTimes);
+
+/* Remembers which keys each joint's channels were between the last time
+an animation was sampled. Keep one per playing instance of an animation.
+The cursor only speeds up searching; sampling at any time is still correct. */
+struct SkeletonAnimationCursor
+{
+	struct JointKeys {
+		unsigned int scaleKey;
+		unsigned int rotateKey;
+		unsigned int translateKey;
+	};
+
+	JointKeys* jointKeys;
+	unsigned int jointCount;
+};
+
+void createSkeletonAnimationCursor(SkeletonAnimationCursor* out_cursor, const SkeletonAnimation& animation);
+void destroySkeletonAnimationCursor(SkeletonAnimationCursor* cursor);
+
 /* Fills an array with the pose of each joint in the animation, relative to its parent joint.
 Time is clamped to [start of animation, end of animation].
-Length of out_jointTransformsArray must be at least the number of joints in the animation. */
+Length of out_jointTransformsArray must be at least the number of joints in the animation.
+Pass a cursor created for this animation to make forward playback avoid searching for keys. */
 void sampleSkeletonAnimation(
 	Transform* out_jointTransformsArray,
 	float time,
-	const SkeletonAnimation& animation);
+	const SkeletonAnimation& animation,
+	SkeletonAnimationCursor* cursor = 0);
+
+// Same as sampleSkeletonAnimation(), but for compressed animations.
+void sampleCompressedSkeletonAnimation(
+	Transform* out_jointTransformsArray,
+	float time,
+	const CompressedSkeletonAnimation& animation);
+
+/* A SkeletonAnimation compiled into a single block of memory for faster sampling.
+Each channel keeps the keys of every joint next to each other, and splits the key values
+into one array per component, so the sampler can interpolate many joints in one loop.
+Channels without keys are baked as a single identity key.
+Sampling gives the same result as sampleSkeletonAnimation() on the source animation. */
+struct BakedSkeletonAnimation
+{
+	struct Channel {
+		unsigned int* firstKeys; // Index of each joint's first key in the arrays below
+		unsigned int* keyCounts; // Number of keys for each joint
+		float* keyTimes;
+		// x, y, z for scale and translation. w, x, y, z for rotation.
+		float* values[4];
+		unsigned int totalKeyCount;
+	};
+
+	float duration;
+	unsigned int jointCount;
+	Channel scale;
+	Channel rotation;
+	Channel translation;
+	char* memory;
+};
+
+void createBakedSkeletonAnimation(BakedSkeletonAnimation* out_baked, const SkeletonAnimation& animation);
+void destroyBakedSkeletonAnimation(BakedSkeletonAnimation* baked);
+// A cursor for sampling a baked animation. A cursor created for the source animation works too.
+void createSkeletonAnimationCursor(SkeletonAnimationCursor* out_cursor, const BakedSkeletonAnimation& animation);
+
+/* Same as sampleSkeletonAnimation(), but for baked animations.
+Pass a cursor created for this animation to make forward playback avoid searching for keys. */
+void sampleBakedSkeletonAnimation(
+	Transform* out_jointTransformsArray,
+	float time,
+	const BakedSkeletonAnimation& animation,
+	SkeletonAnimationCursor* cursor = 0);
+
+/* An animation resampled so every joint has a key at a fixed number of frames per second.
+Finding the keys for a time is index arithmetic, so sampling never searches, and key times
+don't need to be stored. Each frame keeps all of its joints' values next to each other.
+The last frame is always at the end of the animation, so it can be closer to the frame before it than the others are. */
+struct UniformSkeletonAnimation
+{
+	float duration;
+	unsigned int framesPerSecond;
+	unsigned int frameCount;
+	unsigned int jointCount;
+	// [frameCount*jointCount], indexed by frame*jointCount + joint
+	Vec3* scales;
+	Quaternion* rotations;
+	Vec3* translations;
+};
+
+/* Samples the animation at each frame of the new rate, and at its end.
+Keys that don't land on a frame are lost, so use a rate at least as high as the source's. */
+void createUniformSkeletonAnimation(UniformSkeletonAnimation* out_uniform, const SkeletonAnimation& animation, unsigned int framesPerSecond = 30);
+void destroyUniformSkeletonAnimation(UniformSkeletonAnimation* uniform);
+
+// Same as sampleSkeletonAnimation(), but for uniform animations.
+void sampleUniformSkeletonAnimation(
+	Transform* out_jointTransformsArray,
+	float time,
+	const UniformSkeletonAnimation& animation);
 
 /* Builds an array of transforms that contain only the difference in 
 position, rotation, and scale between the reference pose and the target pose.
@@ -104,9 +256,21 @@ void additiveBlendSkeletonPoses(
 	float addWeight);
 
 /* Convenience shortcut for sampling the animations,
-getting the difference poses, and additive blending. */
+getting the difference poses, and additive blending.
+Allocates its temporary poses on the heap; per-frame code should use the FrameArena version. */
+void blendSkeletonAnimation(
+	Transform *out_blendedJointPoses,
+	SkeletonAnimation* animation,
+	float animationTime,
+	float weight,
+	SkeletonAnimation *referencePose = 0,
+	float referencePoseTime = 0);
+
+/* Same as above, but the temporary poses come from scratch and are popped before returning,
+so it never allocates. */
 void blendSkeletonAnimation(
 	Transform *out_blendedJointPoses,
+	FrameArena* scratch,
 	SkeletonAnimation* animation,
 	float animationTime,
 	float weight,
@@ -133,11 +297,92 @@ void buildSkinningMatrix(
 	Skeleton& skeleton);
 
 
+/* An animated character for evaluating many skeletons at once.
+The first animation is sampled as the base pose. Each animation after it is sampled and
+blended over the pose so far with lerpBlendSkeletonPoses(), using its weight.
+Every animation must have the same number of joints as the skeleton. */
+struct SkeletonInstance
+{
+	Skeleton* skeleton;
+	SkeletonAnimation** animations;
+	float* animationTimes;
+	float* animationWeights; // The first animation's weight isn't used
+	unsigned int animationCount;
+};
+
+/* Fills out_offsets with where each instance's skinning matrices start in a shared array,
+so every instance's matrices are packed one after another.
+Returns the total number of matrices. */
+unsigned int getSkinningMatrixOffsets(
+	unsigned int* out_offsets,
+	const SkeletonInstance* instances,
+	unsigned int instanceCount);
+
+/* Samples, blends, converts to model space, and builds the skinning matrices for a range of instances.
+Instance i's matrices are written to out_matrices starting at matrixOffsets[i].
+Ranges that don't overlap can be evaluated on different threads at the same time,
+which makes this the function to call from a job system.
+Temporary poses come from scratch when given (one arena per thread), otherwise from the heap. */
+void evaluateSkeletonInstanceRange(
+	Matrix4x4* out_matrices,
+	const unsigned int* matrixOffsets,
+	const SkeletonInstance* instances,
+	unsigned int firstInstance,
+	unsigned int instanceCount,
+	FrameArena* scratch = 0);
+
+/* Evaluates every instance with platform::parallelFor(), spread across pool's threads and the calling thread.
+With no pool, every instance is evaluated on the calling thread.
+Threads take small batches of instances as they finish, so uneven instances still balance out.
+Temporary poses come from each thread's platform::getThreadScratchArena(), so once the calling thread
+has one too, this doesn't touch the heap. */
+void evaluateSkeletonInstances(
+	Matrix4x4* out_matrices,
+	const unsigned int* matrixOffsets,
+	const SkeletonInstance* instances,
+	unsigned int instanceCount,
+	platform::ThreadPool* pool = 0);
+
+
 
+/* Skins vertices on the CPU, the same way a skinning vertex shader would,
+for collision, raycasts, or servers that don't have a GPU.
+Each vertex is transformed by the weighted sum of its jointsPerVertex skinning matrices,
+which come from buildSkinningMatrix().
+Normals and tangents use the same matrix without translation, and are renormalized.
+Tangents keep their w. Normals and tangents are optional; pass 0 for the ones you don't need.
+Only the vertices in [firstVertex, firstVertex+vertexCount) are written, at the same indices. */
+void skinVertices(
+	Vec3* out_positions,
+	Vec3* out_normals,
+	Vec4* out_tangents,
+	const Matrix4x4* skinningMatrices,
+	const Vec3* positions,
+	const Vec3* normals,
+	const Vec4* tangents,
+	const unsigned int* jointIndices,
+	const float* jointWeights,
+	unsigned int firstVertex,
+	unsigned int vertexCount);
+
+/* Same as skinVertices() for all vertices, split into ranges with platform::parallelFor()
+across pool's threads and the calling thread. With no pool, they're all skinned on the calling thread. */
+void skinVerticesParallel(
+	Vec3* out_positions,
+	Vec3* out_normals,
+	Vec4* out_tangents,
+	const Matrix4x4* skinningMatrices,
+	const Vec3* positions,
+	const Vec3* normals,
+	const Vec4* tangents,
+	const unsigned int* jointIndices,
+	const float* jointWeights,
+	unsigned int vertexCount,
+	platform::ThreadPool* pool = 0);
 
 // Implementation =============================================================
 
-void createSkeletonFromGOBSKEL(Skeleton* out_skeleton, char* bytes, size_t byteCount)
+void createSkeletonFromGOBSKEL(Skeleton* out_skeleton, char* bytes, size_t byteCount, bool copyBytes)
 {
 	/*
 	The joints must be ordered so that every joint comes after its
@@ -154,9 +399,28 @@ void createSkeletonFromGOBSKEL(Skeleton* out_skeleton, char* bytes, size_t byteC
 	}
 	*/
 	BinaryReader b(bytes, byteCount);
+	Skeleton zero={};
+	*out_skeleton = zero;
 
 	b.readInto(&out_skeleton->jointCount, sizeof(out_skeleton->jointCount));
 	b.readInto(&out_skeleton->rootJointIndex, sizeof(out_skeleton->rootJointIndex));
+
+	// Joints are laid out in the file the same way they are in memory
+	static_assert(sizeof(Skeleton::Joint) == sizeof(unsigned int) + sizeof(Matrix4x4), "Skeleton joints must match the file layout");
+	if (!copyBytes && ((size_t)bytes % alignof(Skeleton::Joint)) == 0)
+	{
+		out_skeleton->joints = (Skeleton::Joint*)b.get(out_skeleton->jointCount*sizeof(Skeleton::Joint));
+		if (!out_skeleton->joints) {
+			*out_skeleton = zero;
+			return;
+		}
+		out_skeleton->referencesBytes = true;
+		for (unsigned int i=0; i<out_skeleton->jointCount; i++) {
+			assert(out_skeleton->joints[i].parentIndex < out_skeleton->jointCount);
+		}
+		return;
+	}
+
 	out_skeleton->joints = new Skeleton::Joint[out_skeleton->jointCount];
 
 	for (unsigned int i=0; i<out_skeleton->jointCount; i++)
@@ -175,13 +439,50 @@ void destroySkeleton(Skeleton* skeleton)
 	if (skeleton->jointCount == 0) {
 		return;
 	}
-	delete[] skeleton->joints;
+	if (!skeleton->referencesBytes) {
+		delete[] skeleton->joints;
+	}
 	Skeleton zero={};
 	*skeleton = zero;
 }
 
-void createSkeletonAnimationFromGOBSKELANIM(SkeletonAnimation* out_animation, char* bytes, size_t byteCount)
+// The first four bytes of a version 2 .gobskelanim file: "GSA2".
+// Version 1 files start with the duration instead.
+static const unsigned int gobskelanimVersion2Magic = 0x32415347;
+
+void decodeCompressedSkeletonAnimation(SkeletonAnimation* out_animation, const CompressedSkeletonAnimation& compressed);
+bool readCompressedSkeletonAnimation(CompressedSkeletonAnimation* out_animation, char* bytes, size_t byteCount);
+
+bool readSkeletonAnimationInPlace(SkeletonAnimation* out_animation, char* bytes, size_t byteCount);
+
+void createSkeletonAnimationFromGOBSKELANIM(SkeletonAnimation* out_animation, char* bytes, size_t byteCount, bool copyBytes)
 {
+	// Version 2 files are decoded into plain keys
+	unsigned int magic = 0;
+	if (byteCount >= sizeof(magic)) {
+		memcpy(&magic, bytes, sizeof(magic));
+	}
+	if (magic == gobskelanimVersion2Magic) {
+		CompressedSkeletonAnimation compressed = {};
+		if (readCompressedSkeletonAnimation(&compressed, bytes, byteCount)) {
+			decodeCompressedSkeletonAnimation(out_animation, compressed);
+		}
+		else {
+			SkeletonAnimation zero={};
+			*out_animation = zero;
+		}
+		delete[] compressed.jointAnimations;
+		return;
+	}
+
+	if (!copyBytes && ((size_t)bytes % sizeof(float)) == 0) {
+		if (!readSkeletonAnimationInPlace(out_animation, bytes, byteCount)) {
+			SkeletonAnimation zero={};
+			*out_animation = zero;
+		}
+		return;
+	}
+
 	/* File format
 	Header {
 	float32 duration
@@ -203,6 +504,8 @@ void createSkeletonAnimationFromGOBSKELANIM(SkeletonAnimation* out_animation, ch
 	*/
 
 	BinaryReader b(bytes, byteCount);
+	SkeletonAnimation zero={};
+	*out_animation = zero;
 
 	b.readInto(&out_animation->duration, sizeof(out_animation->duration));
 	b.readInto(&out_animation->jointCount, sizeof(out_animation->jointCount));
@@ -240,12 +543,55 @@ void createSkeletonAnimationFromGOBSKELANIM(SkeletonAnimation* out_animation, ch
 	}
 }
 
+// Reads a version 1 file with the keys pointing into bytes. Returns false if the file is cut short.
+bool readSkeletonAnimationInPlace(SkeletonAnimation* out_animation, char* bytes, size_t byteCount)
+{
+	BinaryReader b(bytes, byteCount);
+	SkeletonAnimation zero={};
+	*out_animation = zero;
+	out_animation->referencesBytes = true;
+
+	b.readInto(&out_animation->duration, sizeof(out_animation->duration));
+	b.readInto(&out_animation->jointCount, sizeof(out_animation->jointCount));
+	// Every joint has at least its three key counts
+	if (out_animation->jointCount > byteCount/(3*sizeof(unsigned int))) {
+		return false;
+	}
+
+	// Zeroed, so key counts past the end of the file read as 0
+	out_animation->jointAnimations = new SkeletonAnimation::JointAnimation[out_animation->jointCount]();
+	bool success = true;
+	for (unsigned int i=0; i<out_animation->jointCount && success; i++)
+	{
+		SkeletonAnimation::JointAnimation &joint = out_animation->jointAnimations[i];
+
+		b.readInto(&joint.scaleKeyCount, sizeof(joint.scaleKeyCount));
+		joint.scaleKeyTimes = (float*)b.get(joint.scaleKeyCount*sizeof(float));
+		joint.scaleKeyValues = (Vec3*)b.get(joint.scaleKeyCount*sizeof(Vec3));
+
+		b.readInto(&joint.rotateKeyCount, sizeof(joint.rotateKeyCount));
+		joint.rotateKeyTimes = (float*)b.get(joint.rotateKeyCount*sizeof(float));
+		joint.rotateKeyValues = (Quaternion*)b.get(joint.rotateKeyCount*sizeof(Quaternion));
+
+		b.readInto(&joint.translateKeyCount, sizeof(joint.translateKeyCount));
+		joint.translateKeyTimes = (float*)b.get(joint.translateKeyCount*sizeof(float));
+		joint.translateKeyValues = (Vec3*)b.get(joint.translateKeyCount*sizeof(Vec3));
+
+		success = joint.scaleKeyValues && joint.rotateKeyValues && joint.translateKeyValues;
+	}
+	if (!success) {
+		delete[] out_animation->jointAnimations;
+		*out_animation = zero;
+	}
+	return success;
+}
+
 void destroySkeletonAnimation(SkeletonAnimation *animation)
 {
 	if (animation->jointCount == 0) {
 		return;
 	}
-	for (unsigned int i=0; i<animation->jointCount; i++)
+	for (unsigned int i=0; i<animation->jointCount && !animation->referencesBytes; i++)
 	{
 		SkeletonAnimation::JointAnimation &joint = animation->jointAnimations[i];
 		delete[] joint.scaleKeyTimes;
@@ -260,31 +606,375 @@ void destroySkeletonAnimation(SkeletonAnimation *animation)
 	*animation = zero;
 }
 
+// Returns the index of the first key after start with a time greater than the specified time,
+// or numberOfTimes if there is none.
+unsigned int findFirstKeyAfterTime(float time, float* arrayOfTimes, unsigned int start, unsigned int numberOfTimes)
+{
+	unsigned int low = start;
+	unsigned int high = numberOfTimes;
+	while (low < high) {
+		unsigned int middle = low + (high-low)/2;
+		if (arrayOfTimes[middle] > time) {
+			high = middle;
+		}
+		else {
+			low = middle+1;
+		}
+	}
+	return low;
+}
+
+bool readCompressedChannel(CompressedSkeletonAnimation::Channel* out_channel, BinaryReader& b, size_t valueByteCount, bool isQuaternion)
+{
+	CompressedSkeletonAnimation::Channel channel = {};
+	b.readInto(&channel.keyCount, sizeof(channel.keyCount));
+	b.readInto(&channel.encoding, sizeof(channel.encoding));
+	if (channel.keyCount == 0) {
+		*out_channel = channel;
+		return true;
+	}
+
+	switch (channel.encoding)
+	{
+		case CompressedSkeletonAnimation::encoding_constant:
+			channel.keyCount = 1;
+			channel.keyValues = b.get(valueByteCount);
+			break;
+		case CompressedSkeletonAnimation::encoding_raw:
+			channel.keyTimes = (float*)b.get(channel.keyCount*sizeof(float));
+			channel.keyValues = b.get(channel.keyCount*valueByteCount);
+			break;
+		case CompressedSkeletonAnimation::encoding_quantized:
+		{
+			channel.keyTimes = (float*)b.get(channel.keyCount*sizeof(float));
+			if (!isQuaternion) {
+				b.readInto(&channel.rangeMin, sizeof(channel.rangeMin));
+				b.readInto(&channel.rangeExtent, sizeof(channel.rangeExtent));
+			}
+			size_t quantizedByteCount = channel.keyCount*3*sizeof(unsigned short);
+			channel.keyValues = b.get(quantizedByteCount);
+			// Keys are padded to keep the next channel 4 byte aligned
+			b.get(((quantizedByteCount + 3) & ~size_t(3)) - quantizedByteCount);
+		} break;
+		default:
+			return false;
+	}
+
+	*out_channel = channel;
+	return channel.keyValues != 0;
+}
+
+// Points the animation's channels into bytes without copying them
+bool readCompressedSkeletonAnimation(CompressedSkeletonAnimation* out_animation, char* bytes, size_t byteCount)
+{
+	/* Version 2 file format
+	Header {
+	uint32 magic "GSA2"
+	float32 duration
+	uint32 joint count
+	}
+	for each joint, for the scale, rotation, and translation channels {
+	uint32 number of keys
+	uint32 encoding (0 raw, 1 constant, 2 quantized)
+	constant: value (Vector3 or Quaternion)
+	raw: float32 key times [number of keys], key values [number of keys] (Vector3 or Quaternion)
+	quantized: float32 key times [number of keys]
+		Vector3 channels: float32[3] range minimum, float32[3] range extent
+		uint16[3] key values [number of keys], padded to a multiple of 4 bytes
+	}
+	*/
+	BinaryReader b(bytes, byteCount);
+
+	unsigned int magic = 0;
+	b.readInto(&magic, sizeof(magic));
+	if (magic != gobskelanimVersion2Magic) {
+		return false;
+	}
+
+	CompressedSkeletonAnimation animation = {};
+	b.readInto(&animation.duration, sizeof(animation.duration));
+	b.readInto(&animation.jointCount, sizeof(animation.jointCount));
+	// Every joint has at least a key count and encoding for each of its three channels
+	if (animation.jointCount > byteCount/(6*sizeof(unsigned int))) {
+		animation.jointCount = 0;
+		*out_animation = animation;
+		return false;
+	}
+	animation.jointAnimations = new CompressedSkeletonAnimation::JointAnimation[animation.jointCount];
+
+	bool success = true;
+	for (unsigned int i=0; i<animation.jointCount && success; i++)
+	{
+		CompressedSkeletonAnimation::JointAnimation &joint = animation.jointAnimations[i];
+		success = readCompressedChannel(&joint.scale, b, sizeof(Vec3), false)
+			&& readCompressedChannel(&joint.rotation, b, sizeof(Quaternion), true)
+			&& readCompressedChannel(&joint.translation, b, sizeof(Vec3), false);
+	}
+
+	*out_animation = animation;
+	return success;
+}
+
+bool createCompressedSkeletonAnimationFromGOBSKELANIM(CompressedSkeletonAnimation* out_animation, char* bytes, size_t byteCount, bool copyBytes)
+{
+	if (!copyBytes && ((size_t)bytes % sizeof(float)) == 0) {
+		if (!readCompressedSkeletonAnimation(out_animation, bytes, byteCount)) {
+			delete[] out_animation->jointAnimations;
+			CompressedSkeletonAnimation zero={};
+			*out_animation = zero;
+			return false;
+		}
+		out_animation->bytes = 0;
+		return true;
+	}
+
+	// Keep a copy of the file so the caller can release theirs
+	char* copy = new char[byteCount];
+	memcpy(copy, bytes, byteCount);
+	if (!readCompressedSkeletonAnimation(out_animation, copy, byteCount)) {
+		delete[] out_animation->jointAnimations;
+		delete[] copy;
+		CompressedSkeletonAnimation zero={};
+		*out_animation = zero;
+		return false;
+	}
+	out_animation->bytes = copy;
+	return true;
+}
+
+void destroyCompressedSkeletonAnimation(CompressedSkeletonAnimation* animation)
+{
+	delete[] animation->jointAnimations;
+	delete[] animation->bytes;
+	CompressedSkeletonAnimation zero={};
+	*animation = zero;
+}
+
+// Unpacks a quaternion stored as the index of its largest component in 2 bits,
+// followed by the other three components in 15 bits each.
+Quaternion decodeSmallestThreeQuaternion(const unsigned short* packed)
+{
+	unsigned long long bits = ((unsigned long long)packed[0] << 32) | ((unsigned long long)packed[1] << 16) | (unsigned long long)packed[2];
+	unsigned int largestIndex = (unsigned int)(bits >> 45) & 3;
+	// The three smaller components are in [-1/sqrt(2), 1/sqrt(2)]
+	const float range = 0.70710678f;
+	float smallComponents[3];
+	for (unsigned int i=0; i<3; i++) {
+		unsigned int quantized = (unsigned int)(bits >> (30 - 15*i)) & 0x7FFF;
+		smallComponents[i] = (float(quantized)/32767.0f*2 - 1)*range;
+	}
+	float largest = sqrtf(max(0, 1 - square(smallComponents[0]) - square(smallComponents[1]) - square(smallComponents[2])));
+
+	float components[4];
+	unsigned int smallIndex = 0;
+	for (unsigned int i=0; i<4; i++) {
+		components[i] = (i == largestIndex) ? largest : smallComponents[smallIndex++];
+	}
+	Quaternion q = {components[0], components[1], components[2], components[3]};
+	return q;
+}
+
+Vec3 decodeCompressedVec3Key(const CompressedSkeletonAnimation::Channel& channel, unsigned int key)
+{
+	if (channel.encoding == CompressedSkeletonAnimation::encoding_quantized) {
+		const unsigned short* quantized = (const unsigned short*)channel.keyValues + key*3;
+		Vec3 v = {
+			channel.rangeMin.x + channel.rangeExtent.x*(float(quantized[0])/65535.0f),
+			channel.rangeMin.y + channel.rangeExtent.y*(float(quantized[1])/65535.0f),
+			channel.rangeMin.z + channel.rangeExtent.z*(float(quantized[2])/65535.0f)
+		};
+		return v;
+	}
+	return ((const Vec3*)channel.keyValues)[key];
+}
+
+Quaternion decodeCompressedQuaternionKey(const CompressedSkeletonAnimation::Channel& channel, unsigned int key)
+{
+	if (channel.encoding == CompressedSkeletonAnimation::encoding_quantized) {
+		return decodeSmallestThreeQuaternion((const unsigned short*)channel.keyValues + key*3);
+	}
+	return ((const Quaternion*)channel.keyValues)[key];
+}
+
+void findCompressedChannelKeys(unsigned int* out_firstKey, unsigned int* out_secondKey, float* out_lerpTime, float time, const CompressedSkeletonAnimation::Channel& channel)
+{
+	*out_lerpTime = 0;
+	if (channel.encoding == CompressedSkeletonAnimation::encoding_constant) {
+		*out_firstKey = *out_secondKey = 0;
+		return;
+	}
+	findAnimationKeys(out_firstKey, out_secondKey, time, channel.keyTimes, channel.keyCount);
+	if (*out_firstKey != *out_secondKey) {
+		*out_lerpTime = inverseLerp(channel.keyTimes[*out_firstKey], channel.keyTimes[*out_secondKey], time);
+	}
+}
+
+void sampleCompressedSkeletonAnimation(Transform* out_jointTransformsArray, float time, const CompressedSkeletonAnimation& animation)
+{
+	for (unsigned int i=0; i<animation.jointCount; i++)
+	{
+		const CompressedSkeletonAnimation::JointAnimation& joint = animation.jointAnimations[i];
+		Transform jointTransform = Transform::identity;
+		unsigned int firstKey, secondKey;
+		float lerpTime;
+
+		// Rotation
+		if (joint.rotation.keyCount > 0) {
+			findCompressedChannelKeys(&firstKey, &secondKey, &lerpTime, time, joint.rotation);
+			jointTransform.rotation = decodeCompressedQuaternionKey(joint.rotation, firstKey);
+			if (firstKey != secondKey) {
+				jointTransform.rotation = lerp(jointTransform.rotation, decodeCompressedQuaternionKey(joint.rotation, secondKey), lerpTime);
+			}
+		}
+
+		// Position
+		if (joint.translation.keyCount > 0) {
+			findCompressedChannelKeys(&firstKey, &secondKey, &lerpTime, time, joint.translation);
+			jointTransform.position = decodeCompressedVec3Key(joint.translation, firstKey);
+			if (firstKey != secondKey) {
+				jointTransform.position = lerp(jointTransform.position, decodeCompressedVec3Key(joint.translation, secondKey), lerpTime);
+			}
+		}
+
+		// Scale
+		if (joint.scale.keyCount > 0) {
+			findCompressedChannelKeys(&firstKey, &secondKey, &lerpTime, time, joint.scale);
+			jointTransform.scale = decodeCompressedVec3Key(joint.scale, firstKey);
+			if (firstKey != secondKey) {
+				jointTransform.scale = lerp(jointTransform.scale, decodeCompressedVec3Key(joint.scale, secondKey), lerpTime);
+			}
+		}
+
+		out_jointTransformsArray[i] = jointTransform;
+	}
+}
+
+// Copies a compressed channel into plain key arrays.
+// Constant channels become one key at time 0.
+void decodeCompressedVec3Channel(unsigned int* out_keyCount, float** out_keyTimes, Vec3** out_keyValues, const CompressedSkeletonAnimation::Channel& channel)
+{
+	*out_keyCount = channel.keyCount;
+	*out_keyTimes = new float[channel.keyCount];
+	*out_keyValues = new Vec3[channel.keyCount];
+	for (unsigned int k=0; k<channel.keyCount; k++) {
+		(*out_keyTimes)[k] = channel.keyTimes ? channel.keyTimes[k] : 0;
+		(*out_keyValues)[k] = decodeCompressedVec3Key(channel, k);
+	}
+}
+
+void decodeCompressedQuaternionChannel(unsigned int* out_keyCount, float** out_keyTimes, Quaternion** out_keyValues, const CompressedSkeletonAnimation::Channel& channel)
+{
+	*out_keyCount = channel.keyCount;
+	*out_keyTimes = new float[channel.keyCount];
+	*out_keyValues = new Quaternion[channel.keyCount];
+	for (unsigned int k=0; k<channel.keyCount; k++) {
+		(*out_keyTimes)[k] = channel.keyTimes ? channel.keyTimes[k] : 0;
+		(*out_keyValues)[k] = decodeCompressedQuaternionKey(channel, k);
+	}
+}
+
+void decodeCompressedSkeletonAnimation(SkeletonAnimation* out_animation, const CompressedSkeletonAnimation& compressed)
+{
+	SkeletonAnimation animation = {};
+	animation.duration = compressed.duration;
+	animation.jointCount = compressed.jointCount;
+	animation.jointAnimations = new SkeletonAnimation::JointAnimation[compressed.jointCount];
+	for (unsigned int i=0; i<compressed.jointCount; i++)
+	{
+		SkeletonAnimation::JointAnimation &joint = animation.jointAnimations[i];
+		const CompressedSkeletonAnimation::JointAnimation &compressedJoint = compressed.jointAnimations[i];
+		decodeCompressedVec3Channel(&joint.scaleKeyCount, &joint.scaleKeyTimes, &joint.scaleKeyValues, compressedJoint.scale);
+		decodeCompressedQuaternionChannel(&joint.rotateKeyCount, &joint.rotateKeyTimes, &joint.rotateKeyValues, compressedJoint.rotation);
+		decodeCompressedVec3Channel(&joint.translateKeyCount, &joint.translateKeyTimes, &joint.translateKeyValues, compressedJoint.translation);
+	}
+	*out_animation = animation;
+}
+
 void findAnimationKeys(unsigned int* out_firstKey, unsigned int* out_secondKey, float time, float* arrayOfTimes, unsigned int numberOfTimes)
 {
-	// TODO: binary search instead of linear
-	for (unsigned int i=0; i<numberOfTimes; i++) {
-		if (arrayOfTimes[i] > time && i>0) {
-			*out_secondKey = i;
-			*out_firstKey = i-1;
-			return;
+	// The first key is never used as the second key, so start at 1
+	unsigned int key = findFirstKeyAfterTime(time, arrayOfTimes, 1, numberOfTimes);
+	if (key < numberOfTimes) {
+		*out_secondKey = key;
+		*out_firstKey = key-1;
+		return;
+	}
+	*out_firstKey = *out_secondKey = numberOfTimes-1;
+}
+
+void findAnimationKeysFromHint(unsigned int* out_firstKey, unsigned int* out_secondKey, unsigned int* inout_hint, float time, float* arrayOfTimes, unsigned int numberOfTimes)
+{
+	// How many keys to step forward before giving up and doing a binary search
+	static const unsigned int maxSteps = 4;
+
+	unsigned int key = *inout_hint;
+	// The hint is only usable if the time hasn't moved back before it
+	if (key >= 1 && key <= numberOfTimes && (key == 1 || arrayOfTimes[key-1] <= time)) {
+		unsigned int steps = 0;
+		while (key < numberOfTimes && arrayOfTimes[key] <= time && steps < maxSteps) {
+			++key;
+			++steps;
+		}
+		if (key < numberOfTimes && arrayOfTimes[key] <= time) {
+			key = findFirstKeyAfterTime(time, arrayOfTimes, key, numberOfTimes);
 		}
 	}
+	else {
+		key = findFirstKeyAfterTime(time, arrayOfTimes, 1, numberOfTimes);
+	}
+	*inout_hint = key;
+
+	if (key < numberOfTimes) {
+		*out_secondKey = key;
+		*out_firstKey = key-1;
+		return;
+	}
 	*out_firstKey = *out_secondKey = numberOfTimes-1;
 }
 
-void sampleSkeletonAnimation(Transform* out_jointTransformsArray, float time, const SkeletonAnimation& animation)
+void createSkeletonAnimationCursor(SkeletonAnimationCursor* out_cursor, const SkeletonAnimation& animation)
+{
+	out_cursor->jointCount = animation.jointCount;
+	out_cursor->jointKeys = new SkeletonAnimationCursor::JointKeys[animation.jointCount];
+	for (unsigned int i=0; i<animation.jointCount; i++) {
+		SkeletonAnimationCursor::JointKeys start = {1, 1, 1};
+		out_cursor->jointKeys[i] = start;
+	}
+}
+
+void destroySkeletonAnimationCursor(SkeletonAnimationCursor* cursor)
 {
+	delete[] cursor->jointKeys;
+	SkeletonAnimationCursor zero={};
+	*cursor = zero;
+}
+
+// Uses the cursor's hint for the channel if there is one
+void findChannelKeys(unsigned int* out_firstKey, unsigned int* out_secondKey, unsigned int* hint, float time, float* arrayOfTimes, unsigned int numberOfTimes)
+{
+	if (hint) {
+		findAnimationKeysFromHint(out_firstKey, out_secondKey, hint, time, arrayOfTimes, numberOfTimes);
+	}
+	else {
+		findAnimationKeys(out_firstKey, out_secondKey, time, arrayOfTimes, numberOfTimes);
+	}
+}
+
+void sampleSkeletonAnimation(Transform* out_jointTransformsArray, float time, const SkeletonAnimation& animation, SkeletonAnimationCursor* cursor)
+{
+	assert(!cursor || cursor->jointCount == animation.jointCount);
+
 	for (unsigned int i=0; i<animation.jointCount; i++)
 	{
 		Transform jointTransform = Transform::identity;
+		SkeletonAnimationCursor::JointKeys* hints = cursor ? &cursor->jointKeys[i] : 0;
 
 		// Rotation
 		if (animation.jointAnimations[i].rotateKeyCount > 0)
 		{
 			// search for the keys we are currently between
 			unsigned int firstKey, secondKey;
-			findAnimationKeys(&firstKey, &secondKey, time, animation.jointAnimations[i].rotateKeyTimes, animation.jointAnimations[i].rotateKeyCount);
+			findChannelKeys(&firstKey, &secondKey, hints ? &hints->rotateKey : 0, time, animation.jointAnimations[i].rotateKeyTimes, animation.jointAnimations[i].rotateKeyCount);
 
 			if (firstKey == secondKey) {
 				// Use one key in the animation
@@ -302,7 +992,7 @@ void sampleSkeletonAnimation(Transform* out_jointTransformsArray, float time, co
 		// Position
 		if (animation.jointAnimations[i].translateKeyCount > 0) {
 			unsigned int firstKey, secondKey;
-			findAnimationKeys(&firstKey, &secondKey, time, animation.jointAnimations[i].translateKeyTimes, animation.jointAnimations[i].translateKeyCount);
+			findChannelKeys(&firstKey, &secondKey, hints ? &hints->translateKey : 0, time, animation.jointAnimations[i].translateKeyTimes, animation.jointAnimations[i].translateKeyCount);
 
 			if (firstKey == secondKey) {
 				jointTransform.position = animation.jointAnimations[i].translateKeyValues[firstKey];
@@ -316,7 +1006,7 @@ void sampleSkeletonAnimation(Transform* out_jointTransformsArray, float time, co
 		// Scale
 		if (animation.jointAnimations[i].scaleKeyCount > 0) {
 			unsigned int firstKey, secondKey;
-			findAnimationKeys(&firstKey, &secondKey, time, animation.jointAnimations[i].scaleKeyTimes, animation.jointAnimations[i].scaleKeyCount);
+			findChannelKeys(&firstKey, &secondKey, hints ? &hints->scaleKey : 0, time, animation.jointAnimations[i].scaleKeyTimes, animation.jointAnimations[i].scaleKeyCount);
 
 			if (firstKey == secondKey) {
 				jointTransform.scale = animation.jointAnimations[i].scaleKeyValues[firstKey];
@@ -331,6 +1021,384 @@ void sampleSkeletonAnimation(Transform* out_jointTransformsArray, float time, co
 	}
 }
 
+// Carves an array out of a block of memory, keeping each array 16 byte aligned.
+// With a null block, only counts the bytes that would be needed.
+void* takeBakedArray(char* memory, size_t* inout_offset, size_t byteCount)
+{
+	size_t offset = (*inout_offset + 15) & ~size_t(15);
+	*inout_offset = offset + byteCount;
+	return memory ? memory + offset : 0;
+}
+
+void takeBakedChannel(BakedSkeletonAnimation::Channel* out_channel, char* memory, size_t* inout_offset, unsigned int jointCount, unsigned int totalKeyCount, unsigned int componentCount)
+{
+	out_channel->totalKeyCount = totalKeyCount;
+	out_channel->firstKeys = (unsigned int*)takeBakedArray(memory, inout_offset, jointCount*sizeof(unsigned int));
+	out_channel->keyCounts = (unsigned int*)takeBakedArray(memory, inout_offset, jointCount*sizeof(unsigned int));
+	out_channel->keyTimes = (float*)takeBakedArray(memory, inout_offset, totalKeyCount*sizeof(float));
+	for (unsigned int i=0; i<4; i++) {
+		out_channel->values[i] = (i < componentCount) ? (float*)takeBakedArray(memory, inout_offset, totalKeyCount*sizeof(float)) : 0;
+	}
+}
+
+void createBakedSkeletonAnimation(BakedSkeletonAnimation* out_baked, const SkeletonAnimation& animation)
+{
+	unsigned int jointCount = animation.jointCount;
+
+	// Channels without keys still take up one key for the identity value
+	unsigned int scaleKeyCount = 0;
+	unsigned int rotateKeyCount = 0;
+	unsigned int translateKeyCount = 0;
+	for (unsigned int i=0; i<jointCount; i++) {
+		SkeletonAnimation::JointAnimation &joint = animation.jointAnimations[i];
+		scaleKeyCount += joint.scaleKeyCount > 0 ? joint.scaleKeyCount : 1;
+		rotateKeyCount += joint.rotateKeyCount > 0 ? joint.rotateKeyCount : 1;
+		translateKeyCount += joint.translateKeyCount > 0 ? joint.translateKeyCount : 1;
+	}
+
+	// Measure the memory needed for all of the arrays, then allocate it once.
+	BakedSkeletonAnimation baked = {};
+	size_t byteCount = 0;
+	takeBakedChannel(&baked.scale, 0, &byteCount, jointCount, scaleKeyCount, 3);
+	takeBakedChannel(&baked.rotation, 0, &byteCount, jointCount, rotateKeyCount, 4);
+	takeBakedChannel(&baked.translation, 0, &byteCount, jointCount, translateKeyCount, 3);
+	// new[] only guarantees alignment for the largest built-in type, so leave room to align to 16
+	baked.memory = new char[byteCount + 15];
+	char* alignedMemory = (char*)(((size_t)baked.memory + 15) & ~size_t(15));
+	size_t offset = 0;
+	takeBakedChannel(&baked.scale, alignedMemory, &offset, jointCount, scaleKeyCount, 3);
+	takeBakedChannel(&baked.rotation, alignedMemory, &offset, jointCount, rotateKeyCount, 4);
+	takeBakedChannel(&baked.translation, alignedMemory, &offset, jointCount, translateKeyCount, 3);
+	baked.duration = animation.duration;
+	baked.jointCount = jointCount;
+
+	unsigned int scaleKey = 0;
+	unsigned int rotateKey = 0;
+	unsigned int translateKey = 0;
+	for (unsigned int i=0; i<jointCount; i++)
+	{
+		SkeletonAnimation::JointAnimation &joint = animation.jointAnimations[i];
+
+		// Scale
+		baked.scale.firstKeys[i] = scaleKey;
+		if (joint.scaleKeyCount > 0) {
+			baked.scale.keyCounts[i] = joint.scaleKeyCount;
+			for (unsigned int k=0; k<joint.scaleKeyCount; k++, scaleKey++) {
+				baked.scale.keyTimes[scaleKey] = joint.scaleKeyTimes[k];
+				baked.scale.values[0][scaleKey] = joint.scaleKeyValues[k].x;
+				baked.scale.values[1][scaleKey] = joint.scaleKeyValues[k].y;
+				baked.scale.values[2][scaleKey] = joint.scaleKeyValues[k].z;
+			}
+		}
+		else {
+			baked.scale.keyCounts[i] = 1;
+			baked.scale.keyTimes[scaleKey] = 0;
+			baked.scale.values[0][scaleKey] = Transform::identity.scale.x;
+			baked.scale.values[1][scaleKey] = Transform::identity.scale.y;
+			baked.scale.values[2][scaleKey] = Transform::identity.scale.z;
+			scaleKey++;
+		}
+
+		// Rotation
+		baked.rotation.firstKeys[i] = rotateKey;
+		if (joint.rotateKeyCount > 0) {
+			baked.rotation.keyCounts[i] = joint.rotateKeyCount;
+			for (unsigned int k=0; k<joint.rotateKeyCount; k++, rotateKey++) {
+				baked.rotation.keyTimes[rotateKey] = joint.rotateKeyTimes[k];
+				baked.rotation.values[0][rotateKey] = joint.rotateKeyValues[k].w;
+				baked.rotation.values[1][rotateKey] = joint.rotateKeyValues[k].x;
+				baked.rotation.values[2][rotateKey] = joint.rotateKeyValues[k].y;
+				baked.rotation.values[3][rotateKey] = joint.rotateKeyValues[k].z;
+			}
+		}
+		else {
+			baked.rotation.keyCounts[i] = 1;
+			baked.rotation.keyTimes[rotateKey] = 0;
+			baked.rotation.values[0][rotateKey] = Quaternion::identity.w;
+			baked.rotation.values[1][rotateKey] = Quaternion::identity.x;
+			baked.rotation.values[2][rotateKey] = Quaternion::identity.y;
+			baked.rotation.values[3][rotateKey] = Quaternion::identity.z;
+			rotateKey++;
+		}
+
+		// Translation
+		baked.translation.firstKeys[i] = translateKey;
+		if (joint.translateKeyCount > 0) {
+			baked.translation.keyCounts[i] = joint.translateKeyCount;
+			for (unsigned int k=0; k<joint.translateKeyCount; k++, translateKey++) {
+				baked.translation.keyTimes[translateKey] = joint.translateKeyTimes[k];
+				baked.translation.values[0][translateKey] = joint.translateKeyValues[k].x;
+				baked.translation.values[1][translateKey] = joint.translateKeyValues[k].y;
+				baked.translation.values[2][translateKey] = joint.translateKeyValues[k].z;
+			}
+		}
+		else {
+			baked.translation.keyCounts[i] = 1;
+			baked.translation.keyTimes[translateKey] = 0;
+			baked.translation.values[0][translateKey] = Transform::identity.position.x;
+			baked.translation.values[1][translateKey] = Transform::identity.position.y;
+			baked.translation.values[2][translateKey] = Transform::identity.position.z;
+			translateKey++;
+		}
+	}
+
+	*out_baked = baked;
+}
+
+void destroyBakedSkeletonAnimation(BakedSkeletonAnimation* baked)
+{
+	delete[] baked->memory;
+	BakedSkeletonAnimation zero={};
+	*baked = zero;
+}
+
+void createSkeletonAnimationCursor(SkeletonAnimationCursor* out_cursor, const BakedSkeletonAnimation& animation)
+{
+	out_cursor->jointCount = animation.jointCount;
+	out_cursor->jointKeys = new SkeletonAnimationCursor::JointKeys[animation.jointCount];
+	for (unsigned int i=0; i<animation.jointCount; i++) {
+		SkeletonAnimationCursor::JointKeys start = {1, 1, 1};
+		out_cursor->jointKeys[i] = start;
+	}
+}
+
+// The baked sampler works on this many joints at a time, so its scratch arrays fit on the stack.
+static const unsigned int bakedSampleBlockSize = 64;
+
+/* Finds the keys and interpolation time of each joint in a block.
+Keys are indices into the channel's arrays. When a joint only uses one key,
+its lerp time is 0 and useFirstKey is set so the key's value is used unchanged.
+hints is the block's first cursor hint for the channel, with the next joint's hintStride unsigned ints after it, or 0 without a cursor. */
+void findBakedChannelKeys(
+	unsigned int* out_firstKeys,
+	unsigned int* out_secondKeys,
+	float* out_lerpTimes,
+	unsigned int* out_useFirstKey,
+	unsigned int* hints,
+	unsigned int hintStride,
+	float time,
+	const BakedSkeletonAnimation::Channel& channel,
+	unsigned int firstJoint,
+	unsigned int jointCount)
+{
+	for (unsigned int j=0; j<jointCount; j++)
+	{
+		unsigned int jointFirstKey = channel.firstKeys[firstJoint+j];
+		float* keyTimes = channel.keyTimes + jointFirstKey;
+		unsigned int firstKey, secondKey;
+		findChannelKeys(&firstKey, &secondKey, hints ? hints + j*hintStride : 0, time, keyTimes, channel.keyCounts[firstJoint+j]);
+		out_firstKeys[j] = jointFirstKey + firstKey;
+		out_secondKeys[j] = jointFirstKey + secondKey;
+		out_useFirstKey[j] = (firstKey == secondKey);
+		out_lerpTimes[j] = (firstKey == secondKey) ? 0 : inverseLerp(keyTimes[firstKey], keyTimes[secondKey], time);
+	}
+}
+
+// Interpolates the keys found for a block of joints, one component at a time.
+// Does the same math as lerp(Vec3, Vec3, float).
+void lerpBakedVec3Channel(
+	float* out_x, float* out_y, float* out_z,
+	const BakedSkeletonAnimation::Channel& channel,
+	const unsigned int* firstKeys,
+	const unsigned int* secondKeys,
+	const float* lerpTimes,
+	const unsigned int* useFirstKey,
+	unsigned int jointCount)
+{
+	float* outComponents[3] = {out_x, out_y, out_z};
+	for (unsigned int c=0; c<3; c++)
+	{
+		float a[bakedSampleBlockSize];
+		float b[bakedSampleBlockSize];
+		const float* values = channel.values[c];
+		float* out = outComponents[c];
+		// Gather the key values, then interpolate in a loop without indirection
+		for (unsigned int j=0; j<jointCount; j++) {
+			a[j] = values[firstKeys[j]];
+			b[j] = values[secondKeys[j]];
+		}
+		for (unsigned int j=0; j<jointCount; j++) {
+			float t = lerpTimes[j];
+			float lerped = a[j]*(1-t) + b[j]*t;
+			out[j] = useFirstKey[j] ? a[j] : lerped;
+		}
+	}
+}
+
+// Does the same math as lerp(Quaternion, Quaternion, float).
+void lerpBakedQuaternionChannel(
+	float* out_w, float* out_x, float* out_y, float* out_z,
+	const BakedSkeletonAnimation::Channel& channel,
+	const unsigned int* firstKeys,
+	const unsigned int* secondKeys,
+	const float* lerpTimes,
+	const unsigned int* useFirstKey,
+	unsigned int jointCount)
+{
+	float aw[bakedSampleBlockSize], ax[bakedSampleBlockSize], ay[bakedSampleBlockSize], az[bakedSampleBlockSize];
+	float bw[bakedSampleBlockSize], bx[bakedSampleBlockSize], by[bakedSampleBlockSize], bz[bakedSampleBlockSize];
+	for (unsigned int j=0; j<jointCount; j++) {
+		aw[j] = channel.values[0][firstKeys[j]];
+		ax[j] = channel.values[1][firstKeys[j]];
+		ay[j] = channel.values[2][firstKeys[j]];
+		az[j] = channel.values[3][firstKeys[j]];
+		bw[j] = channel.values[0][secondKeys[j]];
+		bx[j] = channel.values[1][secondKeys[j]];
+		by[j] = channel.values[2][secondKeys[j]];
+		bz[j] = channel.values[3][secondKeys[j]];
+	}
+	for (unsigned int j=0; j<jointCount; j++)
+	{
+		float t = lerpTimes[j];
+		// Take the shortest path
+		float sign = (aw[j]*bw[j] + ax[j]*bx[j] + ay[j]*by[j] + az[j]*bz[j] < 0) ? -1.0f : 1.0f;
+		float w = aw[j]*(1-t) + (bw[j]*sign)*t;
+		float x = ax[j]*(1-t) + (bx[j]*sign)*t;
+		float y = ay[j]*(1-t) + (by[j]*sign)*t;
+		float z = az[j]*(1-t) + (bz[j]*sign)*t;
+		float l = sqrtf(w*w + x*x + y*y + z*z);
+		// Divide instead of multiplying by an inverse to match normalize()
+		if (l == 0) {
+			w = x = y = z = 0;
+			l = 1;
+		}
+		out_w[j] = useFirstKey[j] ? aw[j] : w/l;
+		out_x[j] = useFirstKey[j] ? ax[j] : x/l;
+		out_y[j] = useFirstKey[j] ? ay[j] : y/l;
+		out_z[j] = useFirstKey[j] ? az[j] : z/l;
+	}
+}
+
+void sampleBakedSkeletonAnimation(Transform* out_jointTransformsArray, float time, const BakedSkeletonAnimation& animation, SkeletonAnimationCursor* cursor)
+{
+	assert(!cursor || cursor->jointCount == animation.jointCount);
+	static const unsigned int hintStride = sizeof(SkeletonAnimationCursor::JointKeys)/sizeof(unsigned int);
+	unsigned int firstKeys[bakedSampleBlockSize];
+	unsigned int secondKeys[bakedSampleBlockSize];
+	unsigned int useFirstKey[bakedSampleBlockSize];
+	float lerpTimes[bakedSampleBlockSize];
+	float components[4][bakedSampleBlockSize];
+
+	for (unsigned int firstJoint=0; firstJoint<animation.jointCount; firstJoint+=bakedSampleBlockSize)
+	{
+		unsigned int jointCount = animation.jointCount - firstJoint;
+		if (jointCount > bakedSampleBlockSize) {
+			jointCount = bakedSampleBlockSize;
+		}
+		Transform* out = out_jointTransformsArray + firstJoint;
+		SkeletonAnimationCursor::JointKeys* hints = cursor ? &cursor->jointKeys[firstJoint] : 0;
+
+		// Rotation
+		findBakedChannelKeys(firstKeys, secondKeys, lerpTimes, useFirstKey, hints ? &hints->rotateKey : 0, hintStride, time, animation.rotation, firstJoint, jointCount);
+		lerpBakedQuaternionChannel(components[0], components[1], components[2], components[3], animation.rotation, firstKeys, secondKeys, lerpTimes, useFirstKey, jointCount);
+		for (unsigned int j=0; j<jointCount; j++) {
+			Quaternion rotation = {components[0][j], components[1][j], components[2][j], components[3][j]};
+			out[j].rotation = rotation;
+		}
+
+		// Position
+		findBakedChannelKeys(firstKeys, secondKeys, lerpTimes, useFirstKey, hints ? &hints->translateKey : 0, hintStride, time, animation.translation, firstJoint, jointCount);
+		lerpBakedVec3Channel(components[0], components[1], components[2], animation.translation, firstKeys, secondKeys, lerpTimes, useFirstKey, jointCount);
+		for (unsigned int j=0; j<jointCount; j++) {
+			Vec3 position = {components[0][j], components[1][j], components[2][j]};
+			out[j].position = position;
+		}
+
+		// Scale
+		findBakedChannelKeys(firstKeys, secondKeys, lerpTimes, useFirstKey, hints ? &hints->scaleKey : 0, hintStride, time, animation.scale, firstJoint, jointCount);
+		lerpBakedVec3Channel(components[0], components[1], components[2], animation.scale, firstKeys, secondKeys, lerpTimes, useFirstKey, jointCount);
+		for (unsigned int j=0; j<jointCount; j++) {
+			Vec3 scale = {components[0][j], components[1][j], components[2][j]};
+			out[j].scale = scale;
+		}
+	}
+}
+
+void createUniformSkeletonAnimation(UniformSkeletonAnimation* out_uniform, const SkeletonAnimation& animation, unsigned int framesPerSecond)
+{
+	assert(framesPerSecond > 0);
+	// The frame at time 0, every frame after it up to the end of the animation,
+	// and one more at the end if the frames don't land on it
+	float endFrameTime = max(animation.duration, 0)*framesPerSecond;
+	unsigned int frameCount = (unsigned int)endFrameTime + 1;
+	if (float(frameCount-1) < endFrameTime) {
+		frameCount++;
+	}
+	unsigned int jointCount = animation.jointCount;
+
+	UniformSkeletonAnimation uniform = {};
+	uniform.duration = animation.duration;
+	uniform.framesPerSecond = framesPerSecond;
+	uniform.frameCount = frameCount;
+	uniform.jointCount = jointCount;
+	uniform.scales = new Vec3[frameCount*jointCount];
+	uniform.rotations = new Quaternion[frameCount*jointCount];
+	uniform.translations = new Vec3[frameCount*jointCount];
+
+	// Frames are sampled in order, so a cursor saves searching for keys
+	SkeletonAnimationCursor cursor;
+	createSkeletonAnimationCursor(&cursor, animation);
+	std::vector<Transform> frame(jointCount);
+	for (unsigned int f=0; f<frameCount; f++)
+	{
+		if (jointCount == 0) {
+			break;
+		}
+		float time = (f == frameCount-1) ? animation.duration : float(f)/float(framesPerSecond);
+		sampleSkeletonAnimation(&frame[0], time, animation, &cursor);
+		for (unsigned int j=0; j<jointCount; j++) {
+			uniform.scales[f*jointCount + j] = frame[j].scale;
+			uniform.rotations[f*jointCount + j] = frame[j].rotation;
+			uniform.translations[f*jointCount + j] = frame[j].position;
+		}
+	}
+	destroySkeletonAnimationCursor(&cursor);
+
+	*out_uniform = uniform;
+}
+
+void destroyUniformSkeletonAnimation(UniformSkeletonAnimation* uniform)
+{
+	delete[] uniform->scales;
+	delete[] uniform->rotations;
+	delete[] uniform->translations;
+	UniformSkeletonAnimation zero={};
+	*uniform = zero;
+}
+
+void sampleUniformSkeletonAnimation(Transform* out_jointTransformsArray, float time, const UniformSkeletonAnimation& animation)
+{
+	if (animation.frameCount == 0) {
+		return;
+	}
+	unsigned int lastFrame = animation.frameCount-1;
+	float frameTime = max(time, 0)*animation.framesPerSecond;
+	unsigned int firstFrame = (frameTime < float(lastFrame)) ? (unsigned int)frameTime : lastFrame;
+	unsigned int secondFrame = firstFrame;
+	float lerpTime = 0;
+	if (firstFrame < lastFrame) {
+		secondFrame = firstFrame+1;
+		// The last frame is at the end of the animation, which can be less than a frame after the one before it
+		float secondFrameTime = (secondFrame == lastFrame) ? animation.duration*animation.framesPerSecond : float(secondFrame);
+		lerpTime = clamp((frameTime - float(firstFrame))/(secondFrameTime - float(firstFrame)), 0, 1);
+	}
+
+	unsigned int jointCount = animation.jointCount;
+	const Vec3* scalesA = animation.scales + firstFrame*jointCount;
+	const Vec3* scalesB = animation.scales + secondFrame*jointCount;
+	const Quaternion* rotationsA = animation.rotations + firstFrame*jointCount;
+	const Quaternion* rotationsB = animation.rotations + secondFrame*jointCount;
+	const Vec3* translationsA = animation.translations + firstFrame*jointCount;
+	const Vec3* translationsB = animation.translations + secondFrame*jointCount;
+
+	for (unsigned int j=0; j<jointCount; j++)
+	{
+		out_jointTransformsArray[j].scale = lerp(scalesA[j], scalesB[j], lerpTime);
+		out_jointTransformsArray[j].rotation = lerp(rotationsA[j], rotationsB[j], lerpTime);
+		out_jointTransformsArray[j].position = lerp(translationsA[j], translationsB[j], lerpTime);
+	}
+}
+
 void buildDifferenceSkeletonPose(Transform *out_differenceJointPoses, Transform *referenceJointPoses, Transform *targetJointPoses, unsigned int jointCount)
 {
 	for (unsigned int i=0; i<jointCount; i++)
@@ -357,10 +1425,7 @@ void additiveBlendSkeletonPoses(Transform *out_blendedJointPoses, Transform *bas
 
 void lerpBlendSkeletonPoses(Transform *out_blendedJointPoses, Transform *jointPosesA, Transform *jointPosesB, unsigned int jointCount, float t)
 {
-	for (unsigned int i=0; i<jointCount; i++)
-	{
-		out_blendedJointPoses[i] = lerp(jointPosesA[i], jointPosesB[i], t);
-	}
+	lerpTransformsN(out_blendedJointPoses, jointPosesA, jointPosesB, t, jointCount);
 }
 
 void blendSkeletonAnimation(Transform *out_blendedJointPoses, SkeletonAnimation* animation, float animationTime, float weight, SkeletonAnimation *referencePose, float referencePoseTime)
@@ -376,23 +1441,283 @@ void blendSkeletonAnimation(Transform *out_blendedJointPoses, SkeletonAnimation*
 	additiveBlendSkeletonPoses(out_blendedJointPoses, out_blendedJointPoses, &jointTransforms[0], jointCount, weight);
 }
 
+void blendSkeletonAnimation(Transform *out_blendedJointPoses, FrameArena* scratch, SkeletonAnimation* animation, float animationTime, float weight, SkeletonAnimation *referencePose, float referencePoseTime)
+{
+	unsigned int jointCount = animation->jointCount;
+	size_t marker = getFrameArenaMarker(scratch);
+	Transform* jointTransforms = pushFrameArenaArray<Transform>(scratch, jointCount);
+	sampleSkeletonAnimation(jointTransforms, animationTime, *animation);
+	if (referencePose) {
+		Transform* jointTransformsReferencePose = pushFrameArenaArray<Transform>(scratch, jointCount);
+		sampleSkeletonAnimation(jointTransformsReferencePose, referencePoseTime, *referencePose);
+		buildDifferenceSkeletonPose(jointTransforms, jointTransformsReferencePose, jointTransforms, jointCount);
+	}
+	additiveBlendSkeletonPoses(out_blendedJointPoses, out_blendedJointPoses, jointTransforms, jointCount, weight);
+	popFrameArenaToMarker(scratch, marker);
+}
+
+
+// How many joints are gathered up for the array kernels at once
+static const unsigned int jointKernelBatchSize = 32;
 
 void jointPosesToModelSpace(Transform *out_modelSpaceJoints, Transform *jointPoses, Skeleton& skeleton)
 {
+	Transform parentTransforms[jointKernelBatchSize];
 	// i=1 to skip the root joint
-	for (unsigned int i=1; i<skeleton.jointCount; ++i)
+	unsigned int i = 1;
+	while (i < skeleton.jointCount)
 	{
-		Transform parentTransform = jointPoses[skeleton.joints[i].parentIndex];
-		out_modelSpaceJoints[i] = concatenateTransforms(parentTransform, jointPoses[i]);
+		/* Joints can be concatenated together when none of them are the parent of another.
+		Since parents come first, that's a run of joints whose parents are all before the run. */
+		unsigned int batchCount = 0;
+		while (i+batchCount < skeleton.jointCount
+			&& batchCount < jointKernelBatchSize
+			&& skeleton.joints[i+batchCount].parentIndex < i)
+		{
+			parentTransforms[batchCount] = jointPoses[skeleton.joints[i+batchCount].parentIndex];
+			batchCount++;
+		}
+		concatenateTransformsN(out_modelSpaceJoints+i, parentTransforms, jointPoses+i, batchCount);
+		i += batchCount;
 	}
 }
 
 // Version that takes joints in model space
 void buildSkinningMatrix(Matrix4x4* out_matrixArray, Transform* modelSpaceJoints, Skeleton& skeleton)
 {
-	for (unsigned int i=0; i<skeleton.jointCount; i++) {
-		out_matrixArray[i] = transformToMatrix4x4(modelSpaceJoints[i]) * skeleton.joints[i].modelSpaceBindPoseInverse;
+	Matrix4x4 bindPoseInverses[jointKernelBatchSize];
+	for (unsigned int i=0; i<skeleton.jointCount; i+=jointKernelBatchSize)
+	{
+		unsigned int batchCount = skeleton.jointCount-i;
+		if (batchCount > jointKernelBatchSize) {
+			batchCount = jointKernelBatchSize;
+		}
+		for (unsigned int j=0; j<batchCount; j++) {
+			bindPoseInverses[j] = skeleton.joints[i+j].modelSpaceBindPoseInverse;
+		}
+		transformsToMatrices4x4N(out_matrixArray+i, modelSpaceJoints+i, batchCount);
+		mat4MulN(out_matrixArray+i, out_matrixArray+i, bindPoseInverses, batchCount);
+	}
+}
+
+unsigned int getSkinningMatrixOffsets(unsigned int* out_offsets, const SkeletonInstance* instances, unsigned int instanceCount)
+{
+	unsigned int matrixCount = 0;
+	for (unsigned int i=0; i<instanceCount; i++) {
+		out_offsets[i] = matrixCount;
+		matrixCount += instances[i].skeleton->jointCount;
+	}
+	return matrixCount;
+}
+
+// jointPoses and layerPoses are scratch space, with room for the instance's joints
+void evaluateSkeletonInstance(Matrix4x4* out_matrices, const SkeletonInstance& instance, Transform* jointPoses, Transform* layerPoses)
+{
+	Skeleton& skeleton = *instance.skeleton;
+	unsigned int jointCount = skeleton.jointCount;
+
+	if (instance.animationCount == 0) {
+		for (unsigned int j=0; j<jointCount; j++) {
+			jointPoses[j] = Transform::identity;
+		}
+	}
+	for (unsigned int a=0; a<instance.animationCount; a++)
+	{
+		assert(instance.animations[a]->jointCount == jointCount);
+		if (a == 0) {
+			sampleSkeletonAnimation(jointPoses, instance.animationTimes[a], *instance.animations[a]);
+		}
+		else {
+			sampleSkeletonAnimation(layerPoses, instance.animationTimes[a], *instance.animations[a]);
+			lerpBlendSkeletonPoses(jointPoses, jointPoses, layerPoses, jointCount, instance.animationWeights[a]);
+		}
+	}
+
+	jointPosesToModelSpace(jointPoses, jointPoses, skeleton);
+	buildSkinningMatrix(out_matrices, jointPoses, skeleton);
+}
+
+void evaluateSkeletonInstanceRange(Matrix4x4* out_matrices, const unsigned int* matrixOffsets, const SkeletonInstance* instances, unsigned int firstInstance, unsigned int instanceCount, FrameArena* scratch)
+{
+	unsigned int maxJointCount = 0;
+	for (unsigned int i=firstInstance; i<firstInstance+instanceCount; i++) {
+		if (instances[i].skeleton->jointCount > maxJointCount) {
+			maxJointCount = instances[i].skeleton->jointCount;
+		}
 	}
+	if (maxJointCount == 0) {
+		return;
+	}
+
+	if (scratch) {
+		size_t marker = getFrameArenaMarker(scratch);
+		Transform* jointPoses = pushFrameArenaArray<Transform>(scratch, maxJointCount);
+		Transform* layerPoses = pushFrameArenaArray<Transform>(scratch, maxJointCount);
+		for (unsigned int i=firstInstance; i<firstInstance+instanceCount; i++) {
+			evaluateSkeletonInstance(out_matrices + matrixOffsets[i], instances[i], jointPoses, layerPoses);
+		}
+		popFrameArenaToMarker(scratch, marker);
+		return;
+	}
+
+	std::vector<Transform> jointPoses(maxJointCount);
+	std::vector<Transform> layerPoses(maxJointCount);
+	for (unsigned int i=firstInstance; i<firstInstance+instanceCount; i++) {
+		evaluateSkeletonInstance(out_matrices + matrixOffsets[i], instances[i], &jointPoses[0], &layerPoses[0]);
+	}
+}
+
+struct SkeletonInstanceBatch
+{
+	Matrix4x4* matrices;
+	const unsigned int* matrixOffsets;
+	const SkeletonInstance* instances;
+};
+
+void evaluateSkeletonInstanceBatch(void* parameter, unsigned int first, unsigned int count)
+{
+	SkeletonInstanceBatch* batch = (SkeletonInstanceBatch*)parameter;
+	evaluateSkeletonInstanceRange(batch->matrices, batch->matrixOffsets, batch->instances, first, count, goblinThreadScratchArena());
+}
+
+void evaluateSkeletonInstances(Matrix4x4* out_matrices, const unsigned int* matrixOffsets, const SkeletonInstance* instances, unsigned int instanceCount, platform::ThreadPool* pool)
+{
+	// Small enough to balance uneven instances, big enough to be worth a job
+	static const unsigned int instancesPerBatch = 16;
+	SkeletonInstanceBatch batch = {out_matrices, matrixOffsets, instances};
+	goblinParallelFor(pool, instanceCount, instancesPerBatch, evaluateSkeletonInstanceBatch, &batch);
+}
+
+static inline Vec3 normalizeSkinnedDirection(float x, float y, float z)
+{
+	Vec3 v = {x, y, z};
+	float length = sqrtf(x*x + y*y + z*z);
+	if (length > 0) {
+		v = v/length;
+	}
+	return v;
+}
+
+void skinVertices(Vec3* out_positions, Vec3* out_normals, Vec4* out_tangents, const Matrix4x4* skinningMatrices, const Vec3* positions, const Vec3* normals, const Vec4* tangents, const unsigned int* jointIndices, const float* jointWeights, unsigned int firstVertex, unsigned int vertexCount)
+{
+	for (unsigned int v=firstVertex; v<firstVertex+vertexCount; v++)
+	{
+		const unsigned int* joints = jointIndices + v*jointsPerVertex;
+		const float* weights = jointWeights + v*jointsPerVertex;
+
+#if defined(GOBLIN_SIMD_AVX) || defined(GOBLIN_SIMD_SSE)
+		// Blend the top three rows of the joints' matrices, then transpose them into columns
+		__m128 rows[4];
+		for (unsigned int r=0; r<3; r++) {
+			rows[r] = _mm_setzero_ps();
+		}
+		for (unsigned int j=0; j<jointsPerVertex; j++)
+		{
+			if (weights[j] == 0) {
+				continue;
+			}
+			const Matrix4x4& m = skinningMatrices[joints[j]];
+			__m128 weight = _mm_set1_ps(weights[j]);
+			for (unsigned int r=0; r<3; r++) {
+				rows[r] = _mm_add_ps(rows[r], _mm_mul_ps(weight, _mm_loadu_ps(m.c[r])));
+			}
+		}
+		rows[3] = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+		// rows now holds the columns
+		alignas(16) float result[4];
+
+		__m128 p = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(rows[0], _mm_set1_ps(positions[v].x)),
+			_mm_mul_ps(rows[1], _mm_set1_ps(positions[v].y))),
+			_mm_mul_ps(rows[2], _mm_set1_ps(positions[v].z))),
+			rows[3]);
+		_mm_store_ps(result, p);
+		out_positions[v].x = result[0];
+		out_positions[v].y = result[1];
+		out_positions[v].z = result[2];
+
+		if (normals && out_normals) {
+			__m128 n = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(rows[0], _mm_set1_ps(normals[v].x)),
+				_mm_mul_ps(rows[1], _mm_set1_ps(normals[v].y))),
+				_mm_mul_ps(rows[2], _mm_set1_ps(normals[v].z)));
+			_mm_store_ps(result, n);
+			out_normals[v] = normalizeSkinnedDirection(result[0], result[1], result[2]);
+		}
+		if (tangents && out_tangents) {
+			__m128 t = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(rows[0], _mm_set1_ps(tangents[v].x)),
+				_mm_mul_ps(rows[1], _mm_set1_ps(tangents[v].y))),
+				_mm_mul_ps(rows[2], _mm_set1_ps(tangents[v].z)));
+			_mm_store_ps(result, t);
+			float w = tangents[v].w;
+			out_tangents[v].xyz = normalizeSkinnedDirection(result[0], result[1], result[2]);
+			out_tangents[v].w = w;
+		}
+#else
+		float m[3][4] = {};
+		for (unsigned int j=0; j<jointsPerVertex; j++)
+		{
+			if (weights[j] == 0) {
+				continue;
+			}
+			const Matrix4x4& joint = skinningMatrices[joints[j]];
+			for (unsigned int r=0; r<3; r++) {
+				for (unsigned int c=0; c<4; c++) {
+					m[r][c] += weights[j]*joint.c[r][c];
+				}
+			}
+		}
+
+		Vec3 p = positions[v];
+		out_positions[v].x = m[0][0]*p.x + m[0][1]*p.y + m[0][2]*p.z + m[0][3];
+		out_positions[v].y = m[1][0]*p.x + m[1][1]*p.y + m[1][2]*p.z + m[1][3];
+		out_positions[v].z = m[2][0]*p.x + m[2][1]*p.y + m[2][2]*p.z + m[2][3];
+		if (normals && out_normals) {
+			Vec3 n = normals[v];
+			out_normals[v] = normalizeSkinnedDirection(
+				m[0][0]*n.x + m[0][1]*n.y + m[0][2]*n.z,
+				m[1][0]*n.x + m[1][1]*n.y + m[1][2]*n.z,
+				m[2][0]*n.x + m[2][1]*n.y + m[2][2]*n.z);
+		}
+		if (tangents && out_tangents) {
+			Vec4 t = tangents[v];
+			out_tangents[v].xyz = normalizeSkinnedDirection(
+				m[0][0]*t.x + m[0][1]*t.y + m[0][2]*t.z,
+				m[1][0]*t.x + m[1][1]*t.y + m[1][2]*t.z,
+				m[2][0]*t.x + m[2][1]*t.y + m[2][2]*t.z);
+			out_tangents[v].w = t.w;
+		}
+#endif
+	}
+}
+
+struct SkinVerticesRanges
+{
+	Vec3* positionsOut;
+	Vec3* normalsOut;
+	Vec4* tangentsOut;
+	const Matrix4x4* skinningMatrices;
+	const Vec3* positions;
+	const Vec3* normals;
+	const Vec4* tangents;
+	const unsigned int* jointIndices;
+	const float* jointWeights;
+};
+
+void skinVertexRange(void* parameter, unsigned int first, unsigned int count)
+{
+	SkinVerticesRanges* r = (SkinVerticesRanges*)parameter;
+	skinVertices(r->positionsOut, r->normalsOut, r->tangentsOut, r->skinningMatrices, r->positions, r->normals, r->tangents, r->jointIndices, r->jointWeights, first, count);
+}
+
+void skinVerticesParallel(Vec3* out_positions, Vec3* out_normals, Vec4* out_tangents, const Matrix4x4* skinningMatrices, const Vec3* positions, const Vec3* normals, const Vec4* tangents, const unsigned int* jointIndices, const float* jointWeights, unsigned int vertexCount, platform::ThreadPool* pool)
+{
+	// Every vertex is the same amount of work, and this many is worth a job
+	static const unsigned int verticesPerRange = 1024;
+	SkinVerticesRanges ranges = {out_positions, out_normals, out_tangents, skinningMatrices, positions, normals, tangents, jointIndices, jointWeights};
+	goblinParallelFor(pool, vertexCount, verticesPerRange, skinVertexRange, &ranges);
 }
 
 } // namespace
@@ -0,0 +1,557 @@
+#ifndef GOBLIN_VISIBILITY_HEADER
+#define GOBLIN_VISIBILITY_HEADER
+
+#include "Goblin3D.h"
+#include <assert.h>
+#include <math.h>
+
+namespace goblin {
+
+/* Planes facing into the frustum, so a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+The normals are unit length, so that's also p's distance from the plane. */
+struct Frustum
+{
+	enum {leftPlane, rightPlane, bottomPlane, topPlane, nearPlane, farPlane, planeCount};
+	Vec4 planes[planeCount];
+};
+
+/* The frustum of a projection*view matrix, in world space, or of a projection*view*model matrix, in model space.
+Uses the GL clip space, from -w to w, that makePerspectiveProjectionMatrix() and makeOrthographicProjectionMatrix() make. */
+void getFrustumPlanes(Frustum* out_frustum, const Matrix4x4& viewProjection);
+// False only if the sphere is completely outside
+bool isSphereInFrustum(const Frustum& frustum, Vec3 center, float radius);
+// False only if the box is completely outside. extents are half the box's size on each axis.
+bool isBoxInFrustum(const Frustum& frustum, Vec3 center, Vec3 extents);
+
+/* The bounds of many objects, with an array for each component, so floatLaneCount objects are tested at once.
+The arrays don't need to be aligned. */
+struct BoundingSphereArrays
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* radius;
+	unsigned int count;
+};
+struct BoundingBoxArrays
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	// Half the box's size on each axis
+	const float* extentX;
+	const float* extentY;
+	const float* extentZ;
+	unsigned int count;
+};
+
+/* Writes the indices of the objects that aren't completely outside the frustum to out_visibleIndices,
+which needs room for all of them, in order, and returns how many there are. */
+unsigned int cullSpheres(unsigned int* out_visibleIndices, const BoundingSphereArrays& spheres, const Frustum& frustum);
+unsigned int cullBoxes(unsigned int* out_visibleIndices, const BoundingBoxArrays& boxes, const Frustum& frustum);
+
+/* A small depth buffer that the CPU draws the biggest occluders into, like walls and terrain,
+so objects hidden behind them can be skipped before they're drawn.
+Each level after the first is half the size, and holds the farthest depth of the pixels it covers,
+so an object only needs to check a few pixels of the level its size on screen matches.
+Depths are z/w in the GL clip space, from -1 at the near plane to 1 at the far one. */
+static const unsigned int maxOcclusionBufferLevels = 16;
+struct OcclusionBuffer
+{
+	unsigned int levelCount;
+	unsigned int levelWidths[maxOcclusionBufferLevels];
+	unsigned int levelHeights[maxOcclusionBufferLevels];
+	float* levels[maxOcclusionBufferLevels]; // Row by row, from the bottom of the screen
+	Matrix4x4 viewProjection;
+};
+
+// Something around 256x128 is enough, since occluders are big. Smaller sizes are quicker to draw into.
+void createOcclusionBuffer(OcclusionBuffer* out_buffer, unsigned int width, unsigned int height);
+void destroyOcclusionBuffer(OcclusionBuffer* buffer);
+// Sets every depth to the far plane, for drawing occluders seen through viewProjection
+void clearOcclusionBuffer(OcclusionBuffer* buffer, const Matrix4x4& viewProjection);
+/* Draws the triangles into the first level, keeping the nearest depth. Both sides of triangles are drawn.
+Triangles that cross the near plane are skipped, which only means less is hidden. */
+void drawOccluder(OcclusionBuffer* buffer, const Matrix4x4& model, const Vec3* positions, const IndexedTriangle* faces, unsigned int faceCount);
+// Fills the levels after the first from it. Call after drawing the occluders, before testing against them.
+void updateOcclusionBufferLevels(OcclusionBuffer* buffer);
+// True if the box is completely behind the occluders. Boxes crossing the near plane never are.
+bool isBoxOccluded(const OcclusionBuffer& buffer, Vec3 center, Vec3 extents);
+/* Removes the indices of occluded boxes from inout_indices, keeping the rest in order, and returns how many are left.
+Use after cullBoxes(), on the indices it wrote. */
+unsigned int cullOccludedBoxes(unsigned int* inout_indices, unsigned int indexCount, const BoundingBoxArrays& boxes, const OcclusionBuffer& buffer);
+
+static const unsigned int maxMeshletVertices = 64;
+static const unsigned int maxMeshletTriangles = 124;
+
+/* A run of triangles in a mesh's index buffer, made by the converter to be culled on its own.
+Each one is drawn with renderRange(rs, firstTriangle, triangleCount), or a list of them with renderRanges(). */
+struct Meshlet
+{
+	// Bounding sphere
+	Vec3 center;
+	float radius;
+	// Every triangle faces away from a camera at c when
+	// dot(center - c, coneAxis) >= coneCutoff*length(center - c) + radius.
+	// A coneCutoff of 1 never culls.
+	Vec3 coneAxis;
+	float coneCutoff;
+	unsigned int firstTriangle;
+	unsigned int triangleCount;
+	unsigned int vertexCount;
+};
+
+// The chunk in a .gobmesh file that holds its Meshlets: "MSHL"
+static const unsigned int gobmeshMeshletChunkId = 0x4C48534D;
+
+// Points out_meshlets into the file's bytes. Returns false if the file doesn't have meshlets.
+bool readGOBMESHMeshlets(const Meshlet** out_meshlets, unsigned int* out_meshletCount, const GOBMESHData& data);
+
+// Triangle counts from cullMeshlets(), added to across calls, for seeing how well culling is doing
+struct MeshletCullStats
+{
+	unsigned int meshletCount;
+	unsigned int visibleMeshletCount;
+	unsigned int triangleCount;
+	unsigned int visibleTriangleCount;
+	unsigned int frustumCulledTriangleCount;
+	unsigned int coneCulledTriangleCount;
+};
+
+/* Writes the triangle ranges of the meshlets that may be visible to out_ranges, which needs room for meshletCount,
+and returns how many there are. Meshlets that are next to each other in the index buffer share one range.
+frustum and cameraPosition must be in the meshlets' space, which is model space, so use getFrustumPlanes()
+with projection*view*model, and the camera position transformed by the model's inverse.
+Cone culling assumes back faces are culled when drawing. stats can be 0. */
+unsigned int cullMeshlets(TriangleRange* out_ranges, const Meshlet* meshlets, unsigned int meshletCount, const Frustum& frustum, Vec3 cameraPosition, MeshletCullStats* inout_stats = 0);
+
+/* Picks the least detailed of a mesh's levels whose error, seen from distance away, covers at most maxPixelError pixels,
+with the fieldOfViewRadians and height that were given to makePerspectiveProjectionMatrix().
+distance is from the camera to the closest point of the mesh's bounds, in model space units like the levels' errors,
+so divide it by the model's scale. Returns an index into lods, or 0 when lodCount is 0. */
+unsigned int selectMeshLOD(const MeshLOD* lods, unsigned int lodCount, float distance, float fieldOfViewRadians, float height, float maxPixelError = 1);
+
+// Implementation =============================================================
+
+void getFrustumPlanes(Frustum* out_frustum, const Matrix4x4& viewProjection)
+{
+	// Gribb and Hartmann: a clip space point is inside when -w <= x <= w, and the same for y and z,
+	// so each plane is the bottom row plus or minus one of the others
+	const Matrix4x4& m = viewProjection;
+	for (unsigned int i=0; i<3; i++)
+	{
+		Vec4 plusPlane = {m[3][0] + m[i][0], m[3][1] + m[i][1], m[3][2] + m[i][2], m[3][3] + m[i][3]};
+		Vec4 minusPlane = {m[3][0] - m[i][0], m[3][1] - m[i][1], m[3][2] - m[i][2], m[3][3] - m[i][3]};
+		out_frustum->planes[2*i] = plusPlane;
+		out_frustum->planes[2*i+1] = minusPlane;
+	}
+	for (unsigned int i=0; i<Frustum::planeCount; i++)
+	{
+		float normalLength = length(out_frustum->planes[i].xyz);
+		if (normalLength > 0) {
+			out_frustum->planes[i] *= 1/normalLength;
+		}
+	}
+}
+
+bool isSphereInFrustum(const Frustum& frustum, Vec3 center, float radius)
+{
+	for (unsigned int i=0; i<Frustum::planeCount; i++) {
+		if (dot(frustum.planes[i].xyz, center) + frustum.planes[i].w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool isBoxInFrustum(const Frustum& frustum, Vec3 center, Vec3 extents)
+{
+	for (unsigned int i=0; i<Frustum::planeCount; i++)
+	{
+		Vec4 plane = frustum.planes[i];
+		// How far the box reaches towards the plane from its center
+		float reach = fabsf(plane.x)*extents.x + fabsf(plane.y)*extents.y + fabsf(plane.z)*extents.z;
+		if (dot(plane.xyz, center) + plane.w < -reach) {
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned int cullSpheres(unsigned int* out_visibleIndices, const BoundingSphereArrays& spheres, const Frustum& frustum)
+{
+	FloatLanes planeX[Frustum::planeCount], planeY[Frustum::planeCount], planeZ[Frustum::planeCount], planeW[Frustum::planeCount];
+	for (unsigned int p=0; p<Frustum::planeCount; p++) {
+		planeX[p] = setLanes(frustum.planes[p].x);
+		planeY[p] = setLanes(frustum.planes[p].y);
+		planeZ[p] = setLanes(frustum.planes[p].z);
+		planeW[p] = setLanes(frustum.planes[p].w);
+	}
+	FloatLanes zero = setLanes(0);
+
+	unsigned int visibleCount = 0;
+	unsigned int i = 0;
+	for (; i+floatLaneCount <= spheres.count; i += floatLaneCount)
+	{
+		FloatLanes x = loadUnalignedLanes(spheres.centerX + i);
+		FloatLanes y = loadUnalignedLanes(spheres.centerY + i);
+		FloatLanes z = loadUnalignedLanes(spheres.centerZ + i);
+		FloatLanes negativeRadius = subtractLanes(zero, loadUnalignedLanes(spheres.radius + i));
+		unsigned int outside = 0;
+		for (unsigned int p=0; p<Frustum::planeCount; p++) {
+			FloatLanes distance = addLanes(addLanes(addLanes(
+				multiplyLanes(planeX[p], x), multiplyLanes(planeY[p], y)), multiplyLanes(planeZ[p], z)), planeW[p]);
+			outside |= lessThanLanesMask(distance, negativeRadius);
+		}
+		for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+			if (!(outside & (1u << lane))) {
+				out_visibleIndices[visibleCount++] = i + lane;
+			}
+		}
+	}
+	// The ones that don't fill all the lanes
+	for (; i<spheres.count; i++) {
+		Vec3 center = {spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]};
+		if (isSphereInFrustum(frustum, center, spheres.radius[i])) {
+			out_visibleIndices[visibleCount++] = i;
+		}
+	}
+	return visibleCount;
+}
+
+unsigned int cullBoxes(unsigned int* out_visibleIndices, const BoundingBoxArrays& boxes, const Frustum& frustum)
+{
+	FloatLanes planeX[Frustum::planeCount], planeY[Frustum::planeCount], planeZ[Frustum::planeCount], planeW[Frustum::planeCount];
+	FloatLanes absPlaneX[Frustum::planeCount], absPlaneY[Frustum::planeCount], absPlaneZ[Frustum::planeCount];
+	for (unsigned int p=0; p<Frustum::planeCount; p++) {
+		planeX[p] = setLanes(frustum.planes[p].x);
+		planeY[p] = setLanes(frustum.planes[p].y);
+		planeZ[p] = setLanes(frustum.planes[p].z);
+		planeW[p] = setLanes(frustum.planes[p].w);
+		absPlaneX[p] = setLanes(fabsf(frustum.planes[p].x));
+		absPlaneY[p] = setLanes(fabsf(frustum.planes[p].y));
+		absPlaneZ[p] = setLanes(fabsf(frustum.planes[p].z));
+	}
+	FloatLanes zero = setLanes(0);
+
+	unsigned int visibleCount = 0;
+	unsigned int i = 0;
+	for (; i+floatLaneCount <= boxes.count; i += floatLaneCount)
+	{
+		FloatLanes x = loadUnalignedLanes(boxes.centerX + i);
+		FloatLanes y = loadUnalignedLanes(boxes.centerY + i);
+		FloatLanes z = loadUnalignedLanes(boxes.centerZ + i);
+		FloatLanes extentX = loadUnalignedLanes(boxes.extentX + i);
+		FloatLanes extentY = loadUnalignedLanes(boxes.extentY + i);
+		FloatLanes extentZ = loadUnalignedLanes(boxes.extentZ + i);
+		unsigned int outside = 0;
+		for (unsigned int p=0; p<Frustum::planeCount; p++) {
+			FloatLanes distance = addLanes(addLanes(addLanes(
+				multiplyLanes(planeX[p], x), multiplyLanes(planeY[p], y)), multiplyLanes(planeZ[p], z)), planeW[p]);
+			FloatLanes reach = addLanes(addLanes(
+				multiplyLanes(absPlaneX[p], extentX), multiplyLanes(absPlaneY[p], extentY)), multiplyLanes(absPlaneZ[p], extentZ));
+			outside |= lessThanLanesMask(distance, subtractLanes(zero, reach));
+		}
+		for (unsigned int lane=0; lane<floatLaneCount; lane++) {
+			if (!(outside & (1u << lane))) {
+				out_visibleIndices[visibleCount++] = i + lane;
+			}
+		}
+	}
+	for (; i<boxes.count; i++) {
+		Vec3 center = {boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]};
+		Vec3 extents = {boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]};
+		if (isBoxInFrustum(frustum, center, extents)) {
+			out_visibleIndices[visibleCount++] = i;
+		}
+	}
+	return visibleCount;
+}
+
+void createOcclusionBuffer(OcclusionBuffer* out_buffer, unsigned int width, unsigned int height)
+{
+	OcclusionBuffer buffer = {};
+	width = (width > 0) ? width : 1;
+	height = (height > 0) ? height : 1;
+	// Down to a single pixel
+	while (buffer.levelCount < maxOcclusionBufferLevels)
+	{
+		buffer.levelWidths[buffer.levelCount] = width;
+		buffer.levelHeights[buffer.levelCount] = height;
+		buffer.levels[buffer.levelCount] = new float[width*height];
+		buffer.levelCount++;
+		if (width == 1 && height == 1) {
+			break;
+		}
+		width = (width+1)/2;
+		height = (height+1)/2;
+	}
+	buffer.viewProjection = Matrix4x4::identity;
+	*out_buffer = buffer;
+}
+
+void destroyOcclusionBuffer(OcclusionBuffer* buffer)
+{
+	for (unsigned int i=0; i<buffer->levelCount; i++) {
+		delete[] buffer->levels[i];
+	}
+	OcclusionBuffer zero = {};
+	*buffer = zero;
+}
+
+void clearOcclusionBuffer(OcclusionBuffer* buffer, const Matrix4x4& viewProjection)
+{
+	buffer->viewProjection = viewProjection;
+	for (unsigned int i=0; i<buffer->levelCount; i++) {
+		unsigned int pixelCount = buffer->levelWidths[i]*buffer->levelHeights[i];
+		for (unsigned int j=0; j<pixelCount; j++) {
+			buffer->levels[i][j] = 1;
+		}
+	}
+}
+
+void drawOccluder(OcclusionBuffer* buffer, const Matrix4x4& model, const Vec3* positions, const IndexedTriangle* faces, unsigned int faceCount)
+{
+	Matrix4x4 modelViewProjection = buffer->viewProjection*model;
+	unsigned int width = buffer->levelWidths[0];
+	unsigned int height = buffer->levelHeights[0];
+	float* depths = buffer->levels[0];
+
+	for (unsigned int i=0; i<faceCount; i++)
+	{
+		// Window coordinates, with pixel centers at half pixels
+		Vec3 corners[3];
+		bool crossesNearPlane = false;
+		for (unsigned int j=0; j<3; j++)
+		{
+			Vec4 clip = modelViewProjection*positions[faces[i].vertexIndex[j]];
+			if (clip.w <= 0 || clip.z < -clip.w) {
+				crossesNearPlane = true;
+				break;
+			}
+			corners[j].x = (clip.x/clip.w*0.5f + 0.5f)*width;
+			corners[j].y = (clip.y/clip.w*0.5f + 0.5f)*height;
+			corners[j].z = clip.z/clip.w;
+		}
+		if (crossesNearPlane) {
+			continue;
+		}
+
+		// Edge functions, made positive inside by flipping clockwise triangles
+		float area = (corners[1].x - corners[0].x)*(corners[2].y - corners[0].y) - (corners[2].x - corners[0].x)*(corners[1].y - corners[0].y);
+		if (area == 0) {
+			continue;
+		}
+		if (area < 0) {
+			Vec3 swap = corners[1];
+			corners[1] = corners[2];
+			corners[2] = swap;
+			area = -area;
+		}
+		float minX = min(corners[0].x, min(corners[1].x, corners[2].x));
+		float maxX = max(corners[0].x, max(corners[1].x, corners[2].x));
+		float minY = min(corners[0].y, min(corners[1].y, corners[2].y));
+		float maxY = max(corners[0].y, max(corners[1].y, corners[2].y));
+		int startX = (int)max(0.0f, ceilf(minX - 0.5f));
+		int endX = (int)min((float)width - 1, floorf(maxX - 0.5f));
+		int startY = (int)max(0.0f, ceilf(minY - 0.5f));
+		int endY = (int)min((float)height - 1, floorf(maxY - 0.5f));
+
+		for (int y=startY; y<=endY; y++)
+		{
+			float pixelY = y + 0.5f;
+			for (int x=startX; x<=endX; x++)
+			{
+				float pixelX = x + 0.5f;
+				// Each is twice the area of the triangle between the pixel and the edge opposite a corner
+				float weight0 = (corners[2].x - corners[1].x)*(pixelY - corners[1].y) - (corners[2].y - corners[1].y)*(pixelX - corners[1].x);
+				float weight1 = (corners[0].x - corners[2].x)*(pixelY - corners[2].y) - (corners[0].y - corners[2].y)*(pixelX - corners[2].x);
+				float weight2 = (corners[1].x - corners[0].x)*(pixelY - corners[0].y) - (corners[1].y - corners[0].y)*(pixelX - corners[0].x);
+				if (weight0 < 0 || weight1 < 0 || weight2 < 0) {
+					continue;
+				}
+				// z/w is linear across the screen, so it's interpolated without perspective correction
+				float depth = (weight0*corners[0].z + weight1*corners[1].z + weight2*corners[2].z)/area;
+				float& pixel = depths[y*width + x];
+				pixel = min(pixel, depth);
+			}
+		}
+	}
+}
+
+void updateOcclusionBufferLevels(OcclusionBuffer* buffer)
+{
+	for (unsigned int level=1; level<buffer->levelCount; level++)
+	{
+		const float* source = buffer->levels[level-1];
+		unsigned int sourceWidth = buffer->levelWidths[level-1];
+		unsigned int sourceHeight = buffer->levelHeights[level-1];
+		float* destination = buffer->levels[level];
+		for (unsigned int y=0; y<buffer->levelHeights[level]; y++)
+		{
+			// Odd sizes have a last row or column with nothing next to it
+			unsigned int y0 = 2*y;
+			unsigned int y1 = (2*y+1 < sourceHeight) ? 2*y+1 : y0;
+			for (unsigned int x=0; x<buffer->levelWidths[level]; x++)
+			{
+				unsigned int x0 = 2*x;
+				unsigned int x1 = (2*x+1 < sourceWidth) ? 2*x+1 : x0;
+				destination[y*buffer->levelWidths[level] + x] = max(
+					max(source[y0*sourceWidth + x0], source[y0*sourceWidth + x1]),
+					max(source[y1*sourceWidth + x0], source[y1*sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+bool isBoxOccluded(const OcclusionBuffer& buffer, Vec3 center, Vec3 extents)
+{
+	unsigned int width = buffer.levelWidths[0];
+	unsigned int height = buffer.levelHeights[0];
+	// The projection is linear before dividing by w, so the corners are sums of the projected center and axes
+	const Matrix4x4& m = buffer.viewProjection;
+	Vec4 clipCenter = m*center;
+	Vec4 clipAxes[3];
+	for (unsigned int axis=0; axis<3; axis++) {
+		Vec4 column = {m[0][axis], m[1][axis], m[2][axis], m[3][axis]};
+		clipAxes[axis] = column*(&extents.x)[axis];
+	}
+	float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f, nearestDepth = 1e30f;
+	for (unsigned int i=0; i<8; i++)
+	{
+		Vec4 clip = clipCenter;
+		for (unsigned int axis=0; axis<3; axis++) {
+			float side = (i & (1 << axis)) ? 1.0f : -1.0f;
+			clip.x += side*clipAxes[axis].x;
+			clip.y += side*clipAxes[axis].y;
+			clip.z += side*clipAxes[axis].z;
+			clip.w += side*clipAxes[axis].w;
+		}
+		if (clip.w <= 0 || clip.z < -clip.w) {
+			return false;
+		}
+		float inverseW = 1/clip.w;
+		float x = (clip.x*inverseW*0.5f + 0.5f)*width;
+		float y = (clip.y*inverseW*0.5f + 0.5f)*height;
+		minX = min(minX, x);
+		maxX = max(maxX, x);
+		minY = min(minY, y);
+		maxY = max(maxY, y);
+		nearestDepth = min(nearestDepth, clip.z*inverseW);
+	}
+	// Off the screen isn't occluded, and the frustum test is what removes it
+	if (maxX < 0 || maxY < 0 || minX > width || minY > height) {
+		return false;
+	}
+	int startX = (int)max(0.0f, floorf(minX));
+	int endX = (int)min((float)width - 1, floorf(maxX));
+	int startY = (int)max(0.0f, floorf(minY));
+	int endY = (int)min((float)height - 1, floorf(maxY));
+
+	// The first level where the box covers at most 3x3 pixels
+	unsigned int level = 0;
+	unsigned int size = (unsigned int)max(endX - startX, endY - startY);
+	while ((size >> level) > 1 && level+1 < buffer.levelCount) {
+		level++;
+	}
+	const float* depths = buffer.levels[level];
+	unsigned int levelWidth = buffer.levelWidths[level];
+	for (int y=startY >> level; y<=(endY >> level); y++) {
+		for (int x=startX >> level; x<=(endX >> level); x++) {
+			if (depths[y*levelWidth + x] >= nearestDepth) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+unsigned int cullOccludedBoxes(unsigned int* inout_indices, unsigned int indexCount, const BoundingBoxArrays& boxes, const OcclusionBuffer& buffer)
+{
+	unsigned int keptCount = 0;
+	for (unsigned int i=0; i<indexCount; i++)
+	{
+		unsigned int index = inout_indices[i];
+		Vec3 center = {boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]};
+		Vec3 extents = {boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]};
+		if (!isBoxOccluded(buffer, center, extents)) {
+			inout_indices[keptCount++] = index;
+		}
+	}
+	return keptCount;
+}
+
+bool readGOBMESHMeshlets(const Meshlet** out_meshlets, unsigned int* out_meshletCount, const GOBMESHData& data)
+{
+	unsigned int byteCount = 0;
+	char* bytes = findGOBMESHChunk(data, gobmeshMeshletChunkId, &byteCount);
+	if (!bytes || byteCount % sizeof(Meshlet) != 0) {
+		*out_meshlets = 0;
+		*out_meshletCount = 0;
+		return false;
+	}
+	*out_meshlets = (const Meshlet*)bytes;
+	*out_meshletCount = byteCount / sizeof(Meshlet);
+	return true;
+}
+
+unsigned int cullMeshlets(TriangleRange* out_ranges, const Meshlet* meshlets, unsigned int meshletCount, const Frustum& frustum, Vec3 cameraPosition, MeshletCullStats* inout_stats)
+{
+	MeshletCullStats stats = {};
+	unsigned int rangeCount = 0;
+	for (unsigned int i=0; i<meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		stats.triangleCount += meshlet.triangleCount;
+		if (!isSphereInFrustum(frustum, meshlet.center, meshlet.radius)) {
+			stats.frustumCulledTriangleCount += meshlet.triangleCount;
+			continue;
+		}
+		Vec3 cameraToCenter = meshlet.center - cameraPosition;
+		if (dot(cameraToCenter, meshlet.coneAxis) >= meshlet.coneCutoff*length(cameraToCenter) + meshlet.radius) {
+			stats.coneCulledTriangleCount += meshlet.triangleCount;
+			continue;
+		}
+
+		stats.visibleMeshletCount++;
+		stats.visibleTriangleCount += meshlet.triangleCount;
+		if (rangeCount > 0 && out_ranges[rangeCount-1].firstTriangle + out_ranges[rangeCount-1].triangleCount == meshlet.firstTriangle) {
+			out_ranges[rangeCount-1].triangleCount += meshlet.triangleCount;
+		}
+		else {
+			out_ranges[rangeCount].firstTriangle = meshlet.firstTriangle;
+			out_ranges[rangeCount].triangleCount = meshlet.triangleCount;
+			rangeCount++;
+		}
+	}
+	stats.meshletCount = meshletCount;
+
+	if (inout_stats) {
+		inout_stats->meshletCount += stats.meshletCount;
+		inout_stats->visibleMeshletCount += stats.visibleMeshletCount;
+		inout_stats->triangleCount += stats.triangleCount;
+		inout_stats->visibleTriangleCount += stats.visibleTriangleCount;
+		inout_stats->frustumCulledTriangleCount += stats.frustumCulledTriangleCount;
+		inout_stats->coneCulledTriangleCount += stats.coneCulledTriangleCount;
+	}
+	return rangeCount;
+}
+
+unsigned int selectMeshLOD(const MeshLOD* lods, unsigned int lodCount, float distance, float fieldOfViewRadians, float height, float maxPixelError)
+{
+	if (distance <= 0) {
+		return 0;
+	}
+	// At distance, the view is 2*distance*tan(fieldOfView/2) units tall
+	float pixelsPerUnit = height / (2*distance*tanf(fieldOfViewRadians / 2.0f));
+	// Errors only grow from one level to the next, so the first that fits, from the least detailed, is the one
+	for (unsigned int i=lodCount; i>1; i--) {
+		if (lods[i-1].error*pixelsPerUnit <= maxPixelError) {
+			return i-1;
+		}
+	}
+	return 0;
+}
+
+} // namespace
+#endif // header include guard
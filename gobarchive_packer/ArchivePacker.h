@@ -0,0 +1,275 @@
+#ifndef GOBARCHIVE_PACKER_ARCHIVE_PACKER_HEADER
+#define GOBARCHIVE_PACKER_ARCHIVE_PACKER_HEADER
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+/* Packs every file in a directory into a .gobarchive for platform::FileSystem.
+Entries are named by their path relative to the directory, with '/' separators,
+which is the name loadFile() is given. */
+
+// Must match GamePlatform.h
+static const uint32_t archiveMagic = 0x43524147; // "GARC"
+static const uint32_t archiveVersion = 1;
+
+struct ArchiveHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t slotCount;
+};
+
+struct ArchiveEntry
+{
+	uint64_t nameHash;
+	uint64_t offset;
+	uint32_t storedByteCount;
+	uint32_t byteCount;
+	uint32_t nameOffset;
+	uint32_t flags;
+};
+
+enum ArchiveEntryFlags {
+	entry_used = 1,
+	entry_compressed = 2
+};
+
+struct PackOptions
+{
+	bool compress;
+	// Only keep compressed data that is at most this fraction of the original
+	float minCompressionRatio;
+};
+
+struct PackedFile
+{
+	std::string name;
+	std::vector<char> storedBytes;
+	uint32_t byteCount;
+	bool compressed;
+};
+
+// FNV-1a
+uint64_t hashArchiveName(const char* name)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const char* c = name; *c; c++) {
+		hash ^= (uint8_t)*c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void writeLZ4Length(std::vector<char>& mod_out, size_t length)
+{
+	while (length >= 255) {
+		mod_out.push_back((char)255);
+		length -= 255;
+	}
+	mod_out.push_back((char)length);
+}
+
+void writeLZ4Sequence(std::vector<char>& mod_out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchCount)
+{
+	size_t tokenPosition = mod_out.size();
+	mod_out.push_back(0);
+	uint8_t token = (uint8_t)(std::min(literalCount, (size_t)15) << 4);
+	if (literalCount >= 15) {
+		writeLZ4Length(mod_out, literalCount-15);
+	}
+	mod_out.insert(mod_out.end(), literals, literals+literalCount);
+
+	// The last sequence is only literals
+	if (matchCount > 0) {
+		mod_out.push_back((char)(offset & 0xFF));
+		mod_out.push_back((char)(offset >> 8));
+		size_t extraMatch = matchCount-4;
+		token |= (uint8_t)std::min(extraMatch, (size_t)15);
+		if (extraMatch >= 15) {
+			writeLZ4Length(mod_out, extraMatch-15);
+		}
+	}
+	mod_out[tokenPosition] = (char)token;
+}
+
+/* Greedy LZ4 block compression: finds earlier copies of each 4 bytes with a hash table.
+Follows the LZ4 rule that the last 12 bytes don't start a match,
+and the last 5 bytes are always literals. */
+void compressLZ4Block(std::vector<char>* out_compressed, const char* bytes, size_t byteCount)
+{
+	const uint8_t* input = (const uint8_t*)bytes;
+	const size_t hashBits = 16;
+	const size_t maxOffset = 65535;
+	std::vector<int64_t> lastPositions((size_t)1 << hashBits, -1);
+	out_compressed->clear();
+
+	size_t literalStart = 0;
+	size_t position = 0;
+	size_t matchLimit = (byteCount > 12) ? byteCount-12 : 0;
+	while (position < matchLimit)
+	{
+		uint32_t sequence;
+		memcpy(&sequence, input+position, 4);
+		size_t hash = (sequence * 2654435761u) >> (32-hashBits);
+		int64_t candidate = lastPositions[hash];
+		lastPositions[hash] = (int64_t)position;
+
+		if (candidate >= 0 && position-(size_t)candidate <= maxOffset && memcmp(input+candidate, input+position, 4) == 0)
+		{
+			size_t matchCount = 4;
+			while (position+matchCount < byteCount-5 && input[candidate+matchCount] == input[position+matchCount]) {
+				matchCount++;
+			}
+			writeLZ4Sequence(*out_compressed, input+literalStart, position-literalStart, position-(size_t)candidate, matchCount);
+			position += matchCount;
+			literalStart = position;
+		}
+		else {
+			position++;
+		}
+	}
+	writeLZ4Sequence(*out_compressed, input+literalStart, byteCount-literalStart, 0, 0);
+}
+
+bool readWholeFile(std::vector<char>* out_bytes, const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ifstream::in|std::ifstream::binary|std::ifstream::ate);
+	if (!file) {
+		return false;
+	}
+	std::streampos fileSize = file.tellg();
+	file.seekg(std::ifstream::beg);
+	out_bytes->resize((size_t)fileSize);
+	file.read(out_bytes->data(), fileSize);
+	return (bool)file;
+}
+
+void writePadding(std::ofstream& file, uint64_t* inout_offset, uint64_t alignment)
+{
+	static const char zeros[16] = {};
+	uint64_t padding = (alignment - (*inout_offset % alignment)) % alignment;
+	file.write(zeros, padding);
+	*inout_offset += padding;
+}
+
+bool packDirectory(std::string directoryName, std::string outputFileName, const PackOptions& options)
+{
+	std::filesystem::path directory(directoryName);
+	if (!std::filesystem::is_directory(directory)) {
+		std::cout << "Error: " << directoryName << " is not a directory.\n";
+		return false;
+	}
+
+	// Sorted, so the same directory always packs the same way
+	std::vector<std::filesystem::path> paths;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory)) {
+		if (entry.is_regular_file()) {
+			paths.push_back(entry.path());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<PackedFile> files;
+	size_t totalByteCount = 0;
+	size_t totalStoredByteCount = 0;
+	for (size_t i=0; i<paths.size(); i++)
+	{
+		PackedFile packed;
+		packed.name = paths[i].lexically_relative(directory).generic_string();
+		packed.compressed = false;
+		if (!readWholeFile(&packed.storedBytes, paths[i])) {
+			std::cout << "Error: couldn't read " << paths[i].string() << '\n';
+			return false;
+		}
+		// Entries store sizes in 32 bits
+		if (packed.storedBytes.size() > UINT32_MAX) {
+			std::cout << "Error: " << paths[i].string() << " is too big to pack\n";
+			return false;
+		}
+		packed.byteCount = (uint32_t)packed.storedBytes.size();
+
+		if (options.compress && packed.byteCount > 0)
+		{
+			std::vector<char> compressed;
+			compressLZ4Block(&compressed, packed.storedBytes.data(), packed.storedBytes.size());
+			if (compressed.size() <= packed.storedBytes.size()*options.minCompressionRatio) {
+				packed.storedBytes.swap(compressed);
+				packed.compressed = true;
+			}
+		}
+		totalByteCount += packed.byteCount;
+		totalStoredByteCount += packed.storedBytes.size();
+		files.push_back(packed);
+	}
+
+	// At most half full, so probing stays short
+	uint32_t slotCount = 16;
+	while (slotCount < files.size()*2) {
+		slotCount *= 2;
+	}
+	std::vector<ArchiveEntry> slots(slotCount);
+	memset(slots.data(), 0, slots.size()*sizeof(ArchiveEntry));
+
+	std::string names;
+	std::vector<uint32_t> fileSlots(files.size());
+	for (size_t i=0; i<files.size(); i++)
+	{
+		uint64_t hash = hashArchiveName(files[i].name.c_str());
+		uint32_t slot = (uint32_t)hash & (slotCount-1);
+		while (slots[slot].flags & entry_used) {
+			slot = (slot+1) & (slotCount-1);
+		}
+		ArchiveEntry& entry = slots[slot];
+		entry.nameHash = hash;
+		entry.storedByteCount = (uint32_t)files[i].storedBytes.size();
+		entry.byteCount = files[i].byteCount;
+		entry.nameOffset = (uint32_t)names.size();
+		entry.flags = entry_used | (files[i].compressed ? entry_compressed : 0);
+		names.append(files[i].name);
+		names.push_back('\0');
+		fileSlots[i] = slot;
+	}
+
+	// Lay out the data after the table and names, each file 16 byte aligned
+	uint64_t offset = sizeof(ArchiveHeader) + slotCount*sizeof(ArchiveEntry) + names.size();
+	for (size_t i=0; i<files.size(); i++) {
+		offset = (offset+15) & ~(uint64_t)15;
+		slots[fileSlots[i]].offset = offset;
+		offset += files[i].storedBytes.size();
+	}
+
+	std::ofstream file(outputFileName.c_str(), std::ofstream::out|std::ofstream::binary|std::ofstream::trunc);
+	if (!file) {
+		std::cout << "Error: couldn't write " << outputFileName << '\n';
+		return false;
+	}
+	ArchiveHeader header = {archiveMagic, archiveVersion, (uint32_t)files.size(), slotCount};
+	file.write((char*)&header, sizeof(header));
+	file.write((char*)slots.data(), slots.size()*sizeof(ArchiveEntry));
+	file.write(names.data(), names.size());
+	uint64_t writtenOffset = sizeof(ArchiveHeader) + slotCount*sizeof(ArchiveEntry) + names.size();
+	for (size_t i=0; i<files.size(); i++) {
+		writePadding(file, &writtenOffset, 16);
+		file.write(files[i].storedBytes.data(), files[i].storedBytes.size());
+		writtenOffset += files[i].storedBytes.size();
+	}
+	// A full disk only shows up as a failed write
+	file.close();
+	if (!file) {
+		std::cout << "Error: couldn't write all of " << outputFileName << '\n';
+		std::filesystem::remove(outputFileName);
+		return false;
+	}
+
+	std::cout << outputFileName << ": " << files.size() << " files, "
+		<< totalByteCount << " -> " << totalStoredByteCount << " bytes of data\n";
+	return true;
+}
+
+#endif // header include guard
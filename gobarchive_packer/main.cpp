@@ -0,0 +1,39 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ArchivePacker.h"
+
+void printUsage()
+{
+	std::cout << "Usage: gobarchive_packer [options] <directory> <output.gobarchive>\n"
+		"Options:\n"
+		"  -compress  Compress files that shrink by at least 10%\n";
+}
+
+int main(int argCount, const char* args[])
+{
+	PackOptions options = {};
+	options.minCompressionRatio = 0.9f;
+	std::vector<std::string> fileNames;
+
+	for (int i=1; i<argCount; ++i)
+	{
+		std::string arg = args[i];
+		if (arg == "-compress") {
+			options.compress = true;
+		}
+		else if (arg.size() > 1 && arg[0] == '-') {
+			printUsage();
+			return 1;
+		}
+		else {
+			fileNames.push_back(arg);
+		}
+	}
+	if (fileNames.size() != 2) {
+		printUsage();
+		return 1;
+	}
+
+	return packDirectory(fileNames[0], fileNames[1], options) ? 0 : 1;
+}
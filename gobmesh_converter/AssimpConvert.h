@@ -2,6 +2,9 @@
 #include "assimp/cimport.h"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
+#include "assimp/DefaultIOSystem.h"
+#include <set>
+#include <filesystem>
 
 
 Matrix4x4 getMatrix4x4(aiMatrix4x4 m)
@@ -36,7 +39,7 @@ Quaternion getQuaternion(aiQuaternion q)
 	return r;
 }
 
-// Looks like assimp automatically optimizes the mesh for us!
+// Faces and vertices are in Assimp's order; optimizeMesh() in MeshOptimize.h reorders them for rendering.
 // Can be called multiple times on the same output mesh, and it will append the new assetMesh at the end of the old one, merging them.
 void convertAssimpMesh(Mesh* out_mesh, const aiMesh* assetMesh, Skeleton* skeleton, Matrix4x4 transform)
 {
@@ -210,6 +213,147 @@ void convertAssimpAnimation(SkeletonAnimation* out_animation, aiAnimation* assim
 }
 
 
+// Distance between two scale or translation keys
+float keyDifference(Vec3 a, Vec3 b)
+{
+	return length(a-b);
+}
+
+// Angle between two rotation keys
+float keyDifference(Quaternion a, Quaternion b)
+{
+	float halfAngleCosine = clamp(fabsf(dot(normalize(a), normalize(b))), 0, 1);
+	return 2*acosf(halfAngleCosine);
+}
+
+/* Removes keys that interpolating between the remaining keys reproduces within tolerance.
+Keys are dropped greedily: a span of keys is extended for as long as every key inside
+it can be rebuilt by the span's end keys, the same way SkeletonAnimation.h samples them.
+The first and last key are always kept, unless the whole channel is one constant value. */
+template<typename T>
+void reduceChannelKeys(std::vector<float>* inout_times, std::vector<T>* inout_values, float tolerance)
+{
+	std::vector<float>& times = *inout_times;
+	std::vector<T>& values = *inout_values;
+	uint keyCount = values.size();
+	if (keyCount < 2) {
+		return;
+	}
+
+	// A constant channel only needs one key
+	bool constant = true;
+	for (uint i=1; i<keyCount && constant; i++) {
+		constant = keyDifference(values[0], values[i]) <= tolerance;
+	}
+	if (constant) {
+		times.resize(1);
+		values.resize(1);
+		return;
+	}
+
+	std::vector<float> keptTimes(1, times[0]);
+	std::vector<T> keptValues(1, values[0]);
+	uint spanStart = 0;
+	for (uint spanEnd=2; spanEnd<keyCount; spanEnd++)
+	{
+		bool spanFits = true;
+		for (uint i=spanStart+1; i<spanEnd && spanFits; i++) {
+			float t = inverseLerp(times[spanStart], times[spanEnd], times[i]);
+			spanFits = keyDifference(lerp(values[spanStart], values[spanEnd], t), values[i]) <= tolerance;
+		}
+		if (!spanFits) {
+			// The key before the end is needed
+			spanStart = spanEnd-1;
+			keptTimes.push_back(times[spanStart]);
+			keptValues.push_back(values[spanStart]);
+		}
+	}
+	keptTimes.push_back(times[keyCount-1]);
+	keptValues.push_back(values[keyCount-1]);
+
+	times.swap(keptTimes);
+	values.swap(keptValues);
+}
+
+/* Drops keys that can be rebuilt by interpolation, keeping the error in model space within tolerance.
+A joint's local error moves every joint below it, so rotation and scale tolerances are scaled by its
+reach: the distance in the bind pose from the joint to its furthest descendant, or to its parent for
+joints without children. Translation errors move descendants 1:1.
+The errors of the animated joints along a chain add up, so the tolerance is split between them:
+each joint gets tolerance/(number of animated joints on the longest chain through it), shared
+between its three channels. The error summed down any chain then stays within tolerance. */
+void reduceAnimationKeys(SkeletonAnimation* animation, const Skeleton& skeleton, float tolerance, std::ostream& log = std::cout)
+{
+	uint jointCount = skeleton.joints.size();
+	if (jointCount == 0) {
+		return;
+	}
+
+	// Model space bind pose joint positions
+	std::vector<Vec3> bindPositions(jointCount);
+	for (uint i=0; i<jointCount; i++) {
+		Matrix4x4 bindMatrix = inverse(skeleton.joints[i].inverseBindMatrix);
+		Vec3 position = {bindMatrix[0][3], bindMatrix[1][3], bindMatrix[2][3]};
+		bindPositions[i] = position;
+	}
+
+	// Joints come after their parents, so walking backwards visits children first
+	std::vector<float> reach(jointCount, 0.0f);
+	std::vector<bool> hasChildren(jointCount, false);
+	for (uint i=jointCount; i-- > 1;) {
+		uint parent = skeleton.joints[i].parentIndex;
+		if (!hasChildren[i]) {
+			reach[i] = length(bindPositions[i] - bindPositions[parent]);
+		}
+		hasChildren[parent] = true;
+		float parentReach = reach[i] + length(bindPositions[i] - bindPositions[parent]);
+		reach[parent] = goblin::max(reach[parent], parentReach);
+	}
+
+	// Only joints with more than one key in a channel lose anything when keys are dropped
+	std::vector<uint> animated(jointCount, 0);
+	for (uint i=0; i<animation->joints.size() && i<jointCount; i++) {
+		const JointAnimation& joint = animation->joints[i];
+		animated[i] = (joint.scaleKeys.size() > 1 || joint.rotationKeys.size() > 1 || joint.translationKeys.size() > 1) ? 1 : 0;
+	}
+
+	// Animated joints from the root down to each joint, and from each joint down to its furthest leaf
+	std::vector<uint> animatedAbove(jointCount, 0);
+	std::vector<uint> animatedBelow(jointCount, 0);
+	for (uint i=0; i<jointCount; i++) {
+		animatedAbove[i] = animated[i] + ((i > 0) ? animatedAbove[skeleton.joints[i].parentIndex] : 0);
+	}
+	for (uint i=jointCount; i-- > 0;) {
+		animatedBelow[i] += animated[i];
+		if (i > 0) {
+			uint parent = skeleton.joints[i].parentIndex;
+			animatedBelow[parent] = std::max(animatedBelow[parent], animatedBelow[i]);
+		}
+	}
+
+	size_t keysBefore = 0;
+	size_t keysAfter = 0;
+	for (uint i=0; i<animation->joints.size() && i<jointCount; i++)
+	{
+		JointAnimation& joint = animation->joints[i];
+		keysBefore += joint.scaleKeys.size() + joint.rotationKeys.size() + joint.translationKeys.size();
+
+		// The joint itself is counted both above and below
+		uint chainLength = std::max(animatedAbove[i] + animatedBelow[i] - animated[i], 1u);
+		float channelTolerance = tolerance/(3*chainLength);
+		// Avoid dividing by 0 for joints that are all in the same place
+		float jointReach = goblin::max(reach[i], 0.0001f);
+
+		reduceChannelKeys(&joint.translateKeyTimes, &joint.translationKeys, channelTolerance);
+		reduceChannelKeys(&joint.roateKeyTimes, &joint.rotationKeys, channelTolerance/jointReach);
+		reduceChannelKeys(&joint.scaleKeyTimes, &joint.scaleKeys, channelTolerance/jointReach);
+
+		keysAfter += joint.scaleKeys.size() + joint.rotationKeys.size() + joint.translationKeys.size();
+	}
+
+	log << "Reduced animation '" << animation->name << "' from " << keysBefore << " to " << keysAfter << " keys.\n";
+}
+
 aiNode* getSkeleton(const aiScene* scene)
 {
 	aiNode* root = scene->mRootNode;
@@ -222,4 +366,56 @@ aiNode* getSkeleton(const aiScene* scene)
 		}
 	}
 	return 0;
-}
\ No newline at end of file
+}
+
+std::string getNormalFileName(const std::filesystem::path& fileName)
+{
+	return fileName.lexically_normal().generic_string();
+}
+
+// Records every file the importer opens, like an .obj's .mtl or a .gltf's .bin, for build cache keys
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+	RecordingIOSystem(std::set<std::string>* out_openedFileNames) : openedFileNames(out_openedFileNames) {}
+
+	Assimp::IOStream* Open(const char* fileName, const char* mode = "rb") override
+	{
+		Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(fileName, mode);
+		// Files that don't exist are only the importer looking for optional ones
+		if (stream) {
+			openedFileNames->insert(getNormalFileName(fileName));
+		}
+		return stream;
+	}
+
+private:
+	std::set<std::string>* openedFileNames;
+};
+
+/* Adds the texture files the scene's materials refer to that exist, relative to the source file.
+The converter doesn't read them yet, but they're part of the asset, so changing one should rebuild it. */
+void addTextureFileNames(std::set<std::string>* inout_fileNames, const aiScene* scene, const std::string& sourceFileName)
+{
+	std::filesystem::path directory = std::filesystem::path(sourceFileName).parent_path();
+	for (uint i=0; i < scene->mNumMaterials; i++) {
+		for (int type = aiTextureType_NONE+1; type <= AI_TEXTURE_TYPE_MAX; type++) {
+			uint textureCount = scene->mMaterials[i]->GetTextureCount((aiTextureType)type);
+			for (uint j=0; j < textureCount; j++)
+			{
+				aiString path;
+				// Embedded textures are named *0, *1 and so on, and are part of the source file
+				if (scene->mMaterials[i]->GetTexture((aiTextureType)type, j, &path) != aiReturn_SUCCESS || path.C_Str()[0] == '*') {
+					continue;
+				}
+				std::string textureFileName = path.C_Str();
+				std::replace(textureFileName.begin(), textureFileName.end(), '\\', '/');
+				std::filesystem::path texturePath = directory / textureFileName;
+				std::error_code error;
+				if (std::filesystem::is_regular_file(texturePath, error)) {
+					inout_fileNames->insert(getNormalFileName(texturePath));
+				}
+			}
+		}
+	}
+}
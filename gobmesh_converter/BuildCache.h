@@ -0,0 +1,178 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Remembers what each source file was converted into, so unchanged files aren't converted again.
+A source is up to date when its key matches the one stored for it, and every output it made still exists.
+The key hashes the source's contents together with the converter version and options,
+and the names and contents of the other files the source pulled in, like an .obj's .mtl or its textures,
+so changing any of them rebuilds it.
+
+The cache is a text file:
+gobcache 2
+source <key in hex> <source file name>
+input <input file name>
+output <output file name>
+...
+with each source followed by the other files it read and the outputs it made. */
+
+static const char* buildCacheHeader = "gobcache 2";
+
+struct BuildCacheEntry
+{
+	uint64_t key;
+	// Files besides the source that it was converted from
+	std::vector<std::string> inputFileNames;
+	std::vector<std::string> outputFileNames;
+};
+
+struct BuildCache
+{
+	// Sorted by source file name, so the written file doesn't depend on conversion order
+	std::map<std::string, BuildCacheEntry> entries;
+};
+
+// FNV-1a. Pass the previous hash to continue hashing more bytes.
+uint64_t hashBytes(const void* bytes, size_t byteCount, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* input = (const unsigned char*)bytes;
+	for (size_t i=0; i<byteCount; i++) {
+		hash ^= input[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Hashes the file's contents on top of hash. Returns false if it can't be read.
+bool hashFileContents(uint64_t* inout_hash, const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ifstream::in|std::ifstream::binary);
+	if (!file) {
+		return false;
+	}
+	std::vector<char> buffer(1 << 16);
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		*inout_hash = hashBytes(buffer.data(), (size_t)file.gcount(), *inout_hash);
+	}
+	return true;
+}
+
+/* The key for a source file, before its other inputs are added with addBuildCacheInputs().
+settings describes everything else that changes the output, like the converter version and options. */
+bool getBuildCacheKey(uint64_t* out_key, const std::string& sourceFileName, const std::string& settings)
+{
+	uint64_t hash = hashBytes(settings.c_str(), settings.size()+1);
+	if (!hashFileContents(&hash, sourceFileName)) {
+		return false;
+	}
+	*out_key = hash;
+	return true;
+}
+
+// Returns false if an input can't be read anymore, so the source has to be converted again
+bool addBuildCacheInputs(uint64_t* inout_key, const std::vector<std::string>& inputFileNames)
+{
+	for (size_t i=0; i<inputFileNames.size(); i++) {
+		*inout_key = hashBytes(inputFileNames[i].c_str(), inputFileNames[i].size()+1, *inout_key);
+		if (!hashFileContents(inout_key, inputFileNames[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// sourceKey is from getBuildCacheKey(). The inputs stored with the source are added to it here.
+bool isBuildUpToDate(const BuildCache& cache, const std::string& sourceFileName, uint64_t sourceKey)
+{
+	std::map<std::string, BuildCacheEntry>::const_iterator found = cache.entries.find(sourceFileName);
+	if (found == cache.entries.end()) {
+		return false;
+	}
+	uint64_t key = sourceKey;
+	if (!addBuildCacheInputs(&key, found->second.inputFileNames) || found->second.key != key) {
+		return false;
+	}
+	for (size_t i=0; i<found->second.outputFileNames.size(); i++) {
+		if (!std::filesystem::exists(found->second.outputFileNames[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* A missing cache file is an empty cache. Returns false, with an empty cache,
+if the file isn't a cache, so it gets rebuilt instead of trusted. */
+bool readBuildCache(BuildCache* out_cache, const std::string& fileName)
+{
+	out_cache->entries.clear();
+	std::ifstream file(fileName);
+	if (!file.is_open()) {
+		return true;
+	}
+
+	std::string line;
+	if (!std::getline(file, line) || line != buildCacheHeader) {
+		return false;
+	}
+	BuildCacheEntry* entry = 0;
+	while (std::getline(file, line))
+	{
+		// File names are last on the line, so they can have spaces in them
+		if (line.compare(0, 7, "source ") == 0) {
+			size_t nameStart = line.find(' ', 7);
+			if (nameStart == std::string::npos) {
+				out_cache->entries.clear();
+				return false;
+			}
+			BuildCacheEntry newEntry;
+			newEntry.key = strtoull(line.substr(7, nameStart-7).c_str(), 0, 16);
+			entry = &(out_cache->entries[line.substr(nameStart+1)] = newEntry);
+		}
+		else if (line.compare(0, 6, "input ") == 0 && entry) {
+			entry->inputFileNames.push_back(line.substr(6));
+		}
+		else if (line.compare(0, 7, "output ") == 0 && entry) {
+			entry->outputFileNames.push_back(line.substr(7));
+		}
+		else if (!line.empty()) {
+			out_cache->entries.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool writeBuildCache(const BuildCache& cache, const std::string& fileName)
+{
+	// Written next to the cache and then renamed over it, so an interrupted build can't leave half a cache
+	std::string temporaryFileName = fileName + ".tmp";
+	{
+		std::ofstream file(temporaryFileName, std::ofstream::out|std::ofstream::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+		file << buildCacheHeader << '\n';
+		for (std::map<std::string, BuildCacheEntry>::const_iterator i = cache.entries.begin(); i != cache.entries.end(); ++i)
+		{
+			file << "source " << std::hex << i->second.key << std::dec << ' ' << i->first << '\n';
+			for (size_t j=0; j<i->second.inputFileNames.size(); j++) {
+				file << "input " << i->second.inputFileNames[j] << '\n';
+			}
+			for (size_t j=0; j<i->second.outputFileNames.size(); j++) {
+				file << "output " << i->second.outputFileNames[j] << '\n';
+			}
+		}
+		if (!file.good()) {
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryFileName, fileName, error);
+	return !error;
+}
@@ -1,7 +1,13 @@
+#ifndef GOBMESH_CONVERTER_GOBMESH_HEADER
+#define GOBMESH_CONVERTER_GOBMESH_HEADER
 #include "Algebra.h"
+#include "MeshBVH.h"
 #include <vector>
 #include <array>
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <string>
 using namespace goblin;
 
 #define SUPPORTED_JOINTS_PER_VERTEX 4
@@ -13,15 +19,54 @@ struct Face
 	unsigned int a, b, c;
 };
 
+static const uint maxMeshletVertices = 64;
+static const uint maxMeshletTriangles = 124;
+
+// Must match Meshlet in Visibility.h, since it's written to files as is
+struct Meshlet
+{
+	Vec3 center;
+	float radius;
+	Vec3 coneAxis;
+	float coneCutoff;
+	uint firstTriangle;
+	uint triangleCount;
+	uint vertexCount;
+};
+
+// A coarser version of a mesh, using the same vertices
+struct LevelOfDetail
+{
+	std::vector<Face> faces;
+	// How far, in model space units, the surface may have moved from the full mesh
+	float error;
+};
+
+// Must match MeshLOD in Goblin3D.h, since it's written to files as is
+struct MeshLOD
+{
+	uint firstTriangle;
+	uint triangleCount;
+	float error;
+};
+
 struct Mesh
 {
 	std::vector<Face> faces;
 	std::vector<Vec3> positions;
 	std::vector<Vec2> uvs;
 	std::vector<Vec3> normals;
+	// Filled by generateTangents() in MeshTangents.h. w is the bitangent's sign.
+	std::vector<Vec4> tangents;
 	// Each vertex is bound to 0 or more joints
 	std::vector<std::vector<uint>> jointIndeces;
 	std::vector<std::vector<float>> jointWeights;
+	// Filled by buildMeshlets() in Meshlets.h
+	std::vector<Meshlet> meshlets;
+	// Levels after the full mesh, from most to least detailed. Filled by generateLODs() in MeshSimplify.h
+	std::vector<LevelOfDetail> lods;
+	// A MeshBVH over the full mesh's faces, as writeMeshBVH() in MeshBVH.h writes it. Empty to leave it out.
+	std::vector<char> bvh;
 };
 
 struct Joint
@@ -70,6 +115,11 @@ void writeNull(std::ofstream *output, uint numberOfBytes)
 	}
 }
 
+void writePaddingTo4Bytes(std::ofstream *output, size_t byteCount)
+{
+	writeNull(output, (uint)(((byteCount + 3) & ~size_t(3)) - byteCount));
+}
+
 uint findJointIndexWithName(std::string name, const Skeleton& skeleton)
 {
 	for (uint i=0; i<skeleton.joints.size(); i++)
@@ -81,10 +131,16 @@ uint findJointIndexWithName(std::string name, const Skeleton& skeleton)
 	return 0;
 }
 
-void outputGOBMESH(const std::string& fileName, const Mesh& mesh)
+// Writes a version 1 .gobmesh file, with full size indices and vertex data.
+// Messages are written to log. Returns false if the file couldn't be written.
+bool outputGOBMESHVersion1(const std::string& fileName, const Mesh& mesh, std::ostream& log = std::cout)
 {
 	// Create/open output file
 	std::ofstream output(fileName, std::ofstream::binary);
+	if (!output.is_open()) {
+		log << "Failed to create file " + fileName + ".\n";
+		return false;
+	}
 
 	// Header
 	uint faceCount = mesh.faces.size();
@@ -118,7 +174,7 @@ void outputGOBMESH(const std::string& fileName, const Mesh& mesh)
 			if (mesh.jointIndeces[i].size() > SUPPORTED_JOINTS_PER_VERTEX
 			 || mesh.jointWeights[i].size() > SUPPORTED_JOINTS_PER_VERTEX)
 			{
-				std::cout << "Warning: one or more verteces are bound to more than the supported number of joints, which is " << SUPPORTED_JOINTS_PER_VERTEX << ".";
+				log << "Warning: one or more verteces are bound to more than the supported number of joints, which is " << SUPPORTED_JOINTS_PER_VERTEX << ".";
 			}
 		}
 
@@ -137,12 +193,230 @@ void outputGOBMESH(const std::string& fileName, const Mesh& mesh)
 			writeNull(&output, (SUPPORTED_JOINTS_PER_VERTEX-usedJointCount)*sizeof(float));
 		}
 	}
+	return output.good();
+}
+
+// Must match GOBMESHFlags in Goblin3D.h
+enum GobmeshFlags
+{
+	gobmesh_hasUVs = 1,
+	gobmesh_hasNormals = 2,
+	gobmesh_hasTangents = 4,
+	gobmesh_hasJoints = 8,
+	gobmesh_shortIndices = 16,
+	// Joint indices are 16 bits instead of 8, for skeletons with more than 256 joints
+	gobmesh_wideJointIndices = 32
+};
+
+static const uint gobmeshVersion2Magic = 0x32534D47; // "GMS2"
+// Chunk ids, which must match the ones the runtime looks for
+static const uint gobmeshMeshletChunkId = 0x4C48534D; // "MSHL", an array of Meshlet
+static const uint gobmeshLODChunkId = 0x53444F4C; // "LODS", an array of MeshLOD
+// gobmeshBVHChunkId comes from MeshBVH.h
+
+void writeGOBMESHChunk(std::ofstream* output, uint id, const void* bytes, uint byteCount)
+{
+	output->write((char*)&id, sizeof(id));
+	output->write((char*)&byteCount, sizeof(byteCount));
+	output->write((const char*)bytes, byteCount);
+	writePaddingTo4Bytes(output, byteCount);
+}
+
+/* Keeps a vertex's SUPPORTED_JOINTS_PER_VERTEX largest weights, rescaled to add up to 1,
+and quantizes them so they add up to exactly 65535. Unused slots are joint 0 with weight 0. */
+void quantizeJointWeights(uint out_jointIndices[SUPPORTED_JOINTS_PER_VERTEX], unsigned short out_weights[SUPPORTED_JOINTS_PER_VERTEX],
+	const std::vector<uint>& jointIndices, const std::vector<float>& weights)
+{
+	std::vector<uint> order(std::min(jointIndices.size(), weights.size()));
+	for (uint i=0; i<order.size(); i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint a, uint b) { return weights[a] > weights[b]; });
+	uint usedJointCount = std::min((uint)order.size(), (uint)SUPPORTED_JOINTS_PER_VERTEX);
+
+	float totalWeight = 0;
+	for (uint i=0; i<usedJointCount; i++) {
+		totalWeight += weights[order[i]];
+	}
+	uint totalQuantized = 0;
+	for (uint i=0; i<SUPPORTED_JOINTS_PER_VERTEX; i++)
+	{
+		out_jointIndices[i] = 0;
+		out_weights[i] = 0;
+		if (i < usedJointCount && totalWeight > 0) {
+			out_jointIndices[i] = jointIndices[order[i]];
+			out_weights[i] = (unsigned short)roundf(weights[order[i]]/totalWeight * 65535.0f);
+			totalQuantized += out_weights[i];
+		}
+	}
+	// Rounding can leave the sum a little off, so the largest weight takes up the difference
+	if (usedJointCount > 0 && totalWeight > 0) {
+		out_weights[0] = (unsigned short)((int)out_weights[0] + 65535 - (int)totalQuantized);
+	}
 }
 
-void outputGOBSKEL(const std::string& fileName, Skeleton& skeleton)
+/* Writes a version 2 .gobmesh file: 16 bit indices when there are fewer than 65536 vertices,
+half float UVs, octahedral normals and tangents, and 8 bit joint indices with 16 bit weights.
+Joint indices are 16 bits when any of them doesn't fit in 8.
+The format is described in readGOBMESHVersion2() in Goblin3D.h.
+Levels of detail have their faces after the full mesh's, and a chunk saying where each level is.
+Messages are written to log. Returns false if the file couldn't be written,
+or a joint index doesn't fit in 16 bits. */
+bool outputGOBMESH(const std::string& fileName, const Mesh& mesh, std::ostream& log = std::cout)
 {
+	// Every level's faces, one after the other
+	std::vector<Face> faces = mesh.faces;
+	std::vector<MeshLOD> lods;
+	if (mesh.lods.size() > 0) {
+		MeshLOD fullLOD = {0, (uint)mesh.faces.size(), 0};
+		lods.push_back(fullLOD);
+		for (uint i=0; i<mesh.lods.size(); i++) {
+			MeshLOD lod = {(uint)faces.size(), (uint)mesh.lods[i].faces.size(), mesh.lods[i].error};
+			lods.push_back(lod);
+			faces.insert(faces.end(), mesh.lods[i].faces.begin(), mesh.lods[i].faces.end());
+		}
+	}
+	uint faceCount = faces.size();
+	uint vertexCount = mesh.positions.size();
+	bool hasUVs = (mesh.uvs.size() > 0);
+	bool hasNormals = (mesh.normals.size() > 0);
+	bool hasTangents = (mesh.tangents.size() > 0);
+	bool hasSkeletonBindings = (mesh.jointIndeces.size() > 0);
+	bool shortIndices = (vertexCount < 65536);
+
+	// Joints
+	std::vector<uint> jointIndices;
+	std::vector<unsigned short> jointWeights;
+	bool wideJointIndices = false;
+	if (hasSkeletonBindings)
+	{
+		jointIndices.resize(vertexCount*SUPPORTED_JOINTS_PER_VERTEX);
+		jointWeights.resize(vertexCount*SUPPORTED_JOINTS_PER_VERTEX);
+		bool warnedAboutJointCount = false;
+		for (uint i=0; i<vertexCount; i++)
+		{
+			if ((mesh.jointIndeces[i].size() > SUPPORTED_JOINTS_PER_VERTEX || mesh.jointWeights[i].size() > SUPPORTED_JOINTS_PER_VERTEX)
+				&& !warnedAboutJointCount)
+			{
+				log << "Warning: one or more verteces are bound to more than the supported number of joints, which is " << SUPPORTED_JOINTS_PER_VERTEX << ". The largest weights are kept.\n";
+				warnedAboutJointCount = true;
+			}
+			quantizeJointWeights(&jointIndices[i*SUPPORTED_JOINTS_PER_VERTEX], &jointWeights[i*SUPPORTED_JOINTS_PER_VERTEX], mesh.jointIndeces[i], mesh.jointWeights[i]);
+			for (uint j=0; j<SUPPORTED_JOINTS_PER_VERTEX; j++)
+			{
+				uint jointIndex = jointIndices[i*SUPPORTED_JOINTS_PER_VERTEX + j];
+				if (jointIndex > 65535) {
+					log << "Error: " << fileName << " uses joint " << jointIndex << ", and joint indices can't be more than 65535.\n";
+					return false;
+				}
+				wideJointIndices |= (jointIndex > 255);
+			}
+		}
+	}
+
 	// Create/open output file
 	std::ofstream output(fileName, std::ofstream::binary);
+	if (!output.is_open()) {
+		log << "Failed to create file " + fileName + ".\n";
+		return false;
+	}
+
+	// Header
+	uint flags = (hasUVs ? gobmesh_hasUVs : 0)
+		| (hasNormals ? gobmesh_hasNormals : 0)
+		| (hasTangents ? gobmesh_hasTangents : 0)
+		| (hasSkeletonBindings ? gobmesh_hasJoints : 0)
+		| (shortIndices ? gobmesh_shortIndices : 0)
+		| (wideJointIndices ? gobmesh_wideJointIndices : 0);
+	uint chunkCount = ((mesh.meshlets.size() > 0) ? 1 : 0) + ((lods.size() > 0) ? 1 : 0) + ((mesh.bvh.size() > 0) ? 1 : 0);
+	output.write((char*)&gobmeshVersion2Magic, sizeof(gobmeshVersion2Magic));
+	output.write((char*)&faceCount, sizeof(faceCount));
+	output.write((char*)&vertexCount, sizeof(vertexCount));
+	output.write((char*)&flags, sizeof(flags));
+	output.write((char*)&chunkCount, sizeof(chunkCount));
+	// End of header
+
+	// Faces
+	if (shortIndices) {
+		std::vector<unsigned short> indices(faceCount*3);
+		for (uint i=0; i<faceCount; i++) {
+			indices[3*i] = (unsigned short)faces[i].a;
+			indices[3*i+1] = (unsigned short)faces[i].b;
+			indices[3*i+2] = (unsigned short)faces[i].c;
+		}
+		output.write((char*)indices.data(), indices.size()*sizeof(unsigned short));
+		writePaddingTo4Bytes(&output, indices.size()*sizeof(unsigned short));
+	}
+	else {
+		output.write((char*)faces.data(), faces.size()*sizeof(Face));
+	}
+	// Positions
+	output.write((char*)mesh.positions.data(), mesh.positions.size()*sizeof(Vec3));
+	// UVs
+	if (hasUVs) {
+		std::vector<unsigned short> halfUVs(vertexCount*2);
+		for (uint i=0; i<vertexCount; i++) {
+			halfUVs[2*i] = floatToHalf(mesh.uvs[i].x);
+			halfUVs[2*i+1] = floatToHalf(mesh.uvs[i].y);
+		}
+		output.write((char*)halfUVs.data(), halfUVs.size()*sizeof(unsigned short));
+	}
+	// Normals
+	if (hasNormals) {
+		std::vector<short> octahedralNormals(vertexCount*2);
+		for (uint i=0; i<vertexCount; i++) {
+			Vec2 encoded = encodeOctahedral(normalize(mesh.normals[i]));
+			octahedralNormals[2*i] = floatToSnorm16(encoded.x);
+			octahedralNormals[2*i+1] = floatToSnorm16(encoded.y);
+		}
+		output.write((char*)octahedralNormals.data(), octahedralNormals.size()*sizeof(short));
+	}
+	// Tangents
+	if (hasTangents) {
+		std::vector<short> octahedralTangents(vertexCount*4);
+		for (uint i=0; i<vertexCount; i++) {
+			Vec2 encoded = encodeOctahedral(normalize(mesh.tangents[i].xyz));
+			octahedralTangents[4*i] = floatToSnorm16(encoded.x);
+			octahedralTangents[4*i+1] = floatToSnorm16(encoded.y);
+			octahedralTangents[4*i+2] = (mesh.tangents[i].w < 0) ? -32767 : 32767;
+			octahedralTangents[4*i+3] = 0;
+		}
+		output.write((char*)octahedralTangents.data(), octahedralTangents.size()*sizeof(short));
+	}
+	// Joints
+	if (hasSkeletonBindings) {
+		if (wideJointIndices) {
+			std::vector<unsigned short> wideIndices(jointIndices.begin(), jointIndices.end());
+			output.write((char*)wideIndices.data(), wideIndices.size()*sizeof(unsigned short));
+		}
+		else {
+			std::vector<unsigned char> narrowIndices(jointIndices.begin(), jointIndices.end());
+			output.write((char*)narrowIndices.data(), narrowIndices.size()*sizeof(unsigned char));
+		}
+		output.write((char*)jointWeights.data(), jointWeights.size()*sizeof(unsigned short));
+	}
+
+	// Chunks
+	if (mesh.meshlets.size() > 0) {
+		writeGOBMESHChunk(&output, gobmeshMeshletChunkId, mesh.meshlets.data(), mesh.meshlets.size()*sizeof(Meshlet));
+	}
+	if (lods.size() > 0) {
+		writeGOBMESHChunk(&output, gobmeshLODChunkId, lods.data(), lods.size()*sizeof(MeshLOD));
+	}
+	if (mesh.bvh.size() > 0) {
+		writeGOBMESHChunk(&output, gobmeshBVHChunkId, mesh.bvh.data(), mesh.bvh.size());
+	}
+	return output.good();
+}
+
+bool outputGOBSKEL(const std::string& fileName, Skeleton& skeleton, std::ostream& log = std::cout)
+{
+	// Create/open output file
+	std::ofstream output(fileName, std::ofstream::binary);
+	if (!output.is_open()) {
+		log << "Failed to create file " + fileName + ".\n";
+		return false;
+	}
 
 	/* .gobskel file format
 	uint number of joints
@@ -162,15 +436,16 @@ void outputGOBSKEL(const std::string& fileName, Skeleton& skeleton)
 		output.write((char*)&(skeleton.joints[i].parentIndex), sizeof(uint));
 		output.write((char*)&(skeleton.joints[i].inverseBindMatrix), 4*4*sizeof(float));
 	}
+	return output.good();
 }
 
-void outputGOBSKELANIM(const std::string& fileName, SkeletonAnimation& animation)
+bool outputGOBSKELANIM(const std::string& fileName, SkeletonAnimation& animation, std::ostream& log = std::cout)
 {
 	// Create/open output file
 	std::ofstream output(fileName, std::ofstream::binary);
 	if (!output.is_open()) {
-		std::cout << "Failed to create file " + fileName + ".\n";
-		return;
+		log << "Failed to create file " + fileName + ".\n";
+		return false;
 	}
 
 	/* File format
@@ -225,4 +500,240 @@ void outputGOBSKELANIM(const std::string& fileName, SkeletonAnimation& animation
 				translateKeyCount*sizeof(Vec3));
 		}
 	}
-}
\ No newline at end of file
+	return output.good();
+}
+
+// Packs a unit quaternion into 48 bits: the index of its largest component in 2 bits,
+// followed by the other three components in 15 bits each.
+// The largest component is made positive, so it can be rebuilt from the other three.
+void encodeSmallestThreeQuaternion(unsigned short out_packed[3], Quaternion q)
+{
+	q = normalize(q);
+	float components[4] = {q.w, q.x, q.y, q.z};
+	uint largestIndex = 0;
+	for (uint i=1; i<4; i++) {
+		if (fabsf(components[i]) > fabsf(components[largestIndex])) {
+			largestIndex = i;
+		}
+	}
+	float sign = (components[largestIndex] < 0) ? -1.0f : 1.0f;
+
+	// The three smaller components are in [-1/sqrt(2), 1/sqrt(2)]
+	const float range = 0.70710678f;
+	unsigned long long bits = (unsigned long long)largestIndex << 45;
+	uint smallIndex = 0;
+	for (uint i=0; i<4; i++) {
+		if (i == largestIndex) continue;
+		float normalized = clamp((components[i]*sign/range + 1)/2, 0, 1);
+		unsigned long long quantized = (unsigned long long)(normalized*32767.0f + 0.5f);
+		bits |= quantized << (30 - 15*smallIndex);
+		smallIndex++;
+	}
+	out_packed[0] = (unsigned short)(bits >> 32);
+	out_packed[1] = (unsigned short)(bits >> 16);
+	out_packed[2] = (unsigned short)bits;
+}
+
+// Must match decodeSmallestThreeQuaternion() in SkeletonAnimation.h
+Quaternion decodeSmallestThreeQuaternion(const unsigned short packed[3])
+{
+	unsigned long long bits = ((unsigned long long)packed[0] << 32) | ((unsigned long long)packed[1] << 16) | (unsigned long long)packed[2];
+	uint largestIndex = (uint)(bits >> 45) & 3;
+	const float range = 0.70710678f;
+	float smallComponents[3];
+	for (uint i=0; i<3; i++) {
+		uint quantized = (uint)(bits >> (30 - 15*i)) & 0x7FFF;
+		smallComponents[i] = (float(quantized)/32767.0f*2 - 1)*range;
+	}
+	float largest = sqrtf(goblin::max(0, 1 - square(smallComponents[0]) - square(smallComponents[1]) - square(smallComponents[2])));
+
+	float components[4];
+	uint smallIndex = 0;
+	for (uint i=0; i<4; i++) {
+		components[i] = (i == largestIndex) ? largest : smallComponents[smallIndex++];
+	}
+	Quaternion q = {components[0], components[1], components[2], components[3]};
+	return q;
+}
+
+float maxComponentDifference(Vec3 a, Vec3 b)
+{
+	return goblin::max(fabsf(a.x-b.x), goblin::max(fabsf(a.y-b.y), fabsf(a.z-b.z)));
+}
+
+// q and -q are the same rotation, so compare against whichever is closer
+float maxComponentDifference(Quaternion a, Quaternion b)
+{
+	if (dot(a, b) < 0) {
+		b = b*-1;
+	}
+	return goblin::max(goblin::max(fabsf(a.w-b.w), fabsf(a.x-b.x)), goblin::max(fabsf(a.y-b.y), fabsf(a.z-b.z)));
+}
+
+// Matches CompressedSkeletonAnimation::Encoding in SkeletonAnimation.h
+enum ChannelEncoding
+{
+	ChannelEncoding_raw,
+	ChannelEncoding_constant,
+	ChannelEncoding_quantized
+};
+
+// Writes the smallest encoding whose error is within maxError, and returns the error of the encoding used.
+float writeCompressedVec3Channel(std::ofstream *output, const std::vector<float>& times, const std::vector<Vec3>& values, float maxError)
+{
+	uint keyCount = values.size();
+	uint encoding = ChannelEncoding_raw;
+	if (keyCount == 0) {
+		output->write((char*)&keyCount, sizeof(keyCount));
+		output->write((char*)&encoding, sizeof(encoding));
+		return 0;
+	}
+
+	// Constant
+	float constantError = 0;
+	for (uint i=1; i<keyCount; i++) {
+		constantError = goblin::max(constantError, maxComponentDifference(values[0], values[i]));
+	}
+	if (constantError <= maxError) {
+		uint one = 1;
+		encoding = ChannelEncoding_constant;
+		output->write((char*)&one, sizeof(one));
+		output->write((char*)&encoding, sizeof(encoding));
+		output->write((char*)&values[0], sizeof(Vec3));
+		return constantError;
+	}
+
+	// Quantized within the channel's range
+	Vec3 rangeMin = values[0];
+	Vec3 rangeMax = values[0];
+	for (uint i=1; i<keyCount; i++) {
+		rangeMin.x = goblin::min(rangeMin.x, values[i].x); rangeMax.x = goblin::max(rangeMax.x, values[i].x);
+		rangeMin.y = goblin::min(rangeMin.y, values[i].y); rangeMax.y = goblin::max(rangeMax.y, values[i].y);
+		rangeMin.z = goblin::min(rangeMin.z, values[i].z); rangeMax.z = goblin::max(rangeMax.z, values[i].z);
+	}
+	Vec3 rangeExtent = rangeMax - rangeMin;
+	std::vector<unsigned short> quantized(keyCount*3);
+	float quantizedError = 0;
+	for (uint i=0; i<keyCount; i++) {
+		Vec3 decoded;
+		for (uint c=0; c<3; c++) {
+			float extent = (&rangeExtent.x)[c];
+			float normalized = (extent > 0) ? clamp(((&values[i].x)[c] - (&rangeMin.x)[c])/extent, 0, 1) : 0;
+			quantized[i*3+c] = (unsigned short)(normalized*65535.0f + 0.5f);
+			// Decode the same way SkeletonAnimation.h does to measure the real error
+			(&decoded.x)[c] = (&rangeMin.x)[c] + extent*(float(quantized[i*3+c])/65535.0f);
+		}
+		quantizedError = goblin::max(quantizedError, maxComponentDifference(decoded, values[i]));
+	}
+	if (quantizedError <= maxError) {
+		encoding = ChannelEncoding_quantized;
+		output->write((char*)&keyCount, sizeof(keyCount));
+		output->write((char*)&encoding, sizeof(encoding));
+		output->write((char*)&times[0], keyCount*sizeof(float));
+		output->write((char*)&rangeMin, sizeof(rangeMin));
+		output->write((char*)&rangeExtent, sizeof(rangeExtent));
+		output->write((char*)&quantized[0], quantized.size()*sizeof(unsigned short));
+		writePaddingTo4Bytes(output, quantized.size()*sizeof(unsigned short));
+		return quantizedError;
+	}
+
+	// Raw
+	output->write((char*)&keyCount, sizeof(keyCount));
+	output->write((char*)&encoding, sizeof(encoding));
+	output->write((char*)&times[0], keyCount*sizeof(float));
+	output->write((char*)&values[0], keyCount*sizeof(Vec3));
+	return 0;
+}
+
+float writeCompressedQuaternionChannel(std::ofstream *output, const std::vector<float>& times, const std::vector<Quaternion>& values, float maxError)
+{
+	uint keyCount = values.size();
+	uint encoding = ChannelEncoding_raw;
+	if (keyCount == 0) {
+		output->write((char*)&keyCount, sizeof(keyCount));
+		output->write((char*)&encoding, sizeof(encoding));
+		return 0;
+	}
+
+	// Constant
+	float constantError = 0;
+	for (uint i=1; i<keyCount; i++) {
+		constantError = goblin::max(constantError, maxComponentDifference(values[0], values[i]));
+	}
+	if (constantError <= maxError) {
+		uint one = 1;
+		encoding = ChannelEncoding_constant;
+		output->write((char*)&one, sizeof(one));
+		output->write((char*)&encoding, sizeof(encoding));
+		output->write((char*)&values[0], sizeof(Quaternion));
+		return constantError;
+	}
+
+	// Smallest three
+	std::vector<unsigned short> quantized(keyCount*3);
+	float quantizedError = 0;
+	for (uint i=0; i<keyCount; i++) {
+		encodeSmallestThreeQuaternion(&quantized[i*3], values[i]);
+		Quaternion decoded = decodeSmallestThreeQuaternion(&quantized[i*3]);
+		quantizedError = goblin::max(quantizedError, maxComponentDifference(decoded, values[i]));
+	}
+	if (quantizedError <= maxError) {
+		encoding = ChannelEncoding_quantized;
+		output->write((char*)&keyCount, sizeof(keyCount));
+		output->write((char*)&encoding, sizeof(encoding));
+		output->write((char*)&times[0], keyCount*sizeof(float));
+		output->write((char*)&quantized[0], quantized.size()*sizeof(unsigned short));
+		writePaddingTo4Bytes(output, quantized.size()*sizeof(unsigned short));
+		return quantizedError;
+	}
+
+	// Raw
+	output->write((char*)&keyCount, sizeof(keyCount));
+	output->write((char*)&encoding, sizeof(encoding));
+	output->write((char*)&times[0], keyCount*sizeof(float));
+	output->write((char*)&values[0], keyCount*sizeof(Quaternion));
+	return 0;
+}
+
+/* Writes a version 2 .gobskelanim file with quantized keys and constant channels removed.
+maxError is the largest difference allowed in any component of a key:
+units for translations and scales, and unit quaternion components for rotations.
+Channels that can't be quantized within maxError are stored uncompressed.
+Prints the compression ratio compared to version 1 and the largest error. */
+bool outputGOBSKELANIMCompressed(const std::string& fileName, SkeletonAnimation& animation, float maxError, std::ostream& log = std::cout)
+{
+	std::ofstream output(fileName, std::ofstream::binary);
+	if (!output.is_open()) {
+		log << "Failed to create file " + fileName + ".\n";
+		return false;
+	}
+
+	// The file format is described in readCompressedSkeletonAnimation() in SkeletonAnimation.h
+	const uint magic = 0x32415347; // "GSA2"
+	output.write((char*)&magic, sizeof(magic));
+	output.write((char*)&(animation.duration), sizeof(animation.duration));
+	uint numberOfJoints = animation.joints.size();
+	output.write((char*)&numberOfJoints, sizeof(numberOfJoints));
+
+	// Size of the same animation as a version 1 file
+	size_t uncompressedByteCount = sizeof(float) + sizeof(uint);
+	float largestError = 0;
+	for (uint i=0; i<animation.joints.size(); i++)
+	{
+		JointAnimation& joint = animation.joints[i];
+		largestError = goblin::max(largestError, writeCompressedVec3Channel(&output, joint.scaleKeyTimes, joint.scaleKeys, maxError));
+		largestError = goblin::max(largestError, writeCompressedQuaternionChannel(&output, joint.roateKeyTimes, joint.rotationKeys, maxError));
+		largestError = goblin::max(largestError, writeCompressedVec3Channel(&output, joint.translateKeyTimes, joint.translationKeys, maxError));
+
+		uncompressedByteCount += 3*sizeof(uint)
+			+ joint.scaleKeys.size()*(sizeof(float) + sizeof(Vec3))
+			+ joint.rotationKeys.size()*(sizeof(float) + sizeof(Quaternion))
+			+ joint.translationKeys.size()*(sizeof(float) + sizeof(Vec3));
+	}
+
+	size_t compressedByteCount = (size_t)output.tellp();
+	log << fileName << ": " << uncompressedByteCount << " -> " << compressedByteCount << " bytes ("
+		<< float(uncompressedByteCount)/float(compressedByteCount) << "x), max error " << largestError << "\n";
+	return output.good();
+}
+#endif // GOBMESH_CONVERTER_GOBMESH_HEADER
@@ -0,0 +1,388 @@
+#ifndef GOBMESH_CONVERTER_MESH_OPTIMIZE_HEADER
+#define GOBMESH_CONVERTER_MESH_OPTIMIZE_HEADER
+#include "Gobmesh.h"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+/* Reorders a mesh's triangles and vertices so the GPU draws it faster, without changing how it looks.
+optimizeVertexCache() orders triangles so their vertices are reused while they're still in the post-transform cache,
+optimizeOverdraw() then moves clusters of triangles that face outwards to the front, so they hide the ones behind them,
+and optimizeVertexFetch() puts the vertices in the order they're first used, so they're read from memory in order. */
+
+struct VertexCacheStats
+{
+	// Average cache miss ratio: vertices transformed per triangle. 0.5 is about the best possible, 3 the worst.
+	float acmr;
+	// Average transform to vertex ratio: vertices transformed per vertex. 1 is the best possible.
+	float atvr;
+};
+
+// Simulates a FIFO post-transform cache, like most GPUs have, to see how many vertices get transformed
+VertexCacheStats simulateVertexCache(const std::vector<Face>& faces, uint vertexCount, uint cacheSize = 16)
+{
+	// Each vertex remembers when it was last added, so it's in the cache if fewer than cacheSize have been added since
+	std::vector<uint> addedTimes(vertexCount, 0);
+	uint missCount = 0;
+	for (uint i=0; i<faces.size(); i++)
+	{
+		uint indices[3] = {faces[i].a, faces[i].b, faces[i].c};
+		for (uint j=0; j<3; j++) {
+			uint vertex = indices[j];
+			if (addedTimes[vertex] == 0 || missCount - addedTimes[vertex] >= cacheSize) {
+				missCount++;
+				addedTimes[vertex] = missCount;
+			}
+		}
+	}
+	VertexCacheStats stats;
+	stats.acmr = faces.empty() ? 0 : float(missCount) / float(faces.size());
+	stats.atvr = (vertexCount == 0) ? 0 : float(missCount) / float(vertexCount);
+	return stats;
+}
+
+// For each vertex, the triangles that use it
+struct VertexTriangles
+{
+	std::vector<uint> offsets; // vertexCount+1, into triangles
+	std::vector<uint> triangles;
+};
+
+void buildVertexTriangles(VertexTriangles* out_adjacency, const std::vector<Face>& faces, uint vertexCount)
+{
+	out_adjacency->offsets.assign(vertexCount+1, 0);
+	for (uint i=0; i<faces.size(); i++) {
+		out_adjacency->offsets[faces[i].a+1]++;
+		out_adjacency->offsets[faces[i].b+1]++;
+		out_adjacency->offsets[faces[i].c+1]++;
+	}
+	for (uint i=0; i<vertexCount; i++) {
+		out_adjacency->offsets[i+1] += out_adjacency->offsets[i];
+	}
+	out_adjacency->triangles.resize(faces.size()*3);
+	std::vector<uint> counts(vertexCount, 0);
+	for (uint i=0; i<faces.size(); i++) {
+		uint indices[3] = {faces[i].a, faces[i].b, faces[i].c};
+		for (uint j=0; j<3; j++) {
+			out_adjacency->triangles[out_adjacency->offsets[indices[j]] + counts[indices[j]]++] = i;
+		}
+	}
+}
+
+/* Tom Forsyth's linear-speed vertex cache optimization.
+Vertices are scored by how recently they were used, in a simulated LRU cache,
+and by how few unused triangles they have left, so lone triangles aren't left behind.
+The next triangle is the highest scoring one that uses a vertex in the cache. */
+void optimizeVertexCache(std::vector<Face>* inout_faces, uint vertexCount)
+{
+	const std::vector<Face>& faces = *inout_faces;
+	uint faceCount = faces.size();
+	if (faceCount == 0) {
+		return;
+	}
+
+	const uint cacheSize = 32;
+	const uint maxValence = 32;
+	float cacheScores[cacheSize];
+	for (uint i=0; i<cacheSize; i++) {
+		// The last triangle's vertices score the same, so it doesn't matter which order they were in
+		cacheScores[i] = (i < 3) ? 0.75f : powf(1.0f - float(i-3)/float(cacheSize-3), 1.5f);
+	}
+	float valenceScores[maxValence+1];
+	valenceScores[0] = 0;
+	for (uint i=1; i<=maxValence; i++) {
+		valenceScores[i] = 2.0f / sqrtf(float(i));
+	}
+
+	VertexTriangles adjacency;
+	buildVertexTriangles(&adjacency, faces, vertexCount);
+	// Unused triangles come first in each vertex's list
+	std::vector<uint> activeCounts(vertexCount);
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint i=0; i<vertexCount; i++) {
+		activeCounts[i] = adjacency.offsets[i+1] - adjacency.offsets[i];
+	}
+
+	auto scoreVertex = [&](uint vertex) -> float {
+		uint activeCount = activeCounts[vertex];
+		if (activeCount == 0) {
+			return -1;
+		}
+		int position = cachePositions[vertex];
+		float score = (position >= 0) ? cacheScores[position] : 0;
+		return score + valenceScores[std::min(activeCount, maxValence)];
+	};
+
+	for (uint i=0; i<vertexCount; i++) {
+		vertexScores[i] = scoreVertex(i);
+	}
+	std::vector<Face> sortedFaces;
+	sortedFaces.reserve(faceCount);
+	std::vector<char> emitted(faceCount, 0);
+	std::vector<uint> cache;
+	std::vector<uint> newCache;
+	cache.reserve(cacheSize+3);
+	newCache.reserve(cacheSize+3);
+	int bestFace = 0;
+	uint nextUnemittedFace = 0;
+
+	while (sortedFaces.size() < faceCount)
+	{
+		if (bestFace < 0) {
+			// Nothing in the cache has triangles left, so start again from the next unused one
+			while (emitted[nextUnemittedFace]) {
+				nextUnemittedFace++;
+			}
+			bestFace = nextUnemittedFace;
+		}
+
+		const Face& face = faces[bestFace];
+		sortedFaces.push_back(face);
+		emitted[bestFace] = 1;
+		uint indices[3] = {face.a, face.b, face.c};
+
+		// Move the triangle out of the active part of its vertices' lists
+		for (uint j=0; j<3; j++) {
+			uint vertex = indices[j];
+			uint* triangles = &adjacency.triangles[adjacency.offsets[vertex]];
+			uint activeCount = activeCounts[vertex];
+			for (uint k=0; k<activeCount; k++) {
+				if (triangles[k] == (uint)bestFace) {
+					std::swap(triangles[k], triangles[activeCount-1]);
+					break;
+				}
+			}
+			activeCounts[vertex]--;
+		}
+
+		// The triangle's vertices go to the front of the cache
+		newCache.clear();
+		for (uint j=0; j<3; j++) {
+			if (std::find(newCache.begin(), newCache.end(), indices[j]) == newCache.end()) {
+				newCache.push_back(indices[j]);
+			}
+		}
+		size_t faceVertexCount = newCache.size();
+		for (uint j=0; j<cache.size(); j++) {
+			if (std::find(newCache.begin(), newCache.begin()+faceVertexCount, cache[j]) == newCache.begin()+faceVertexCount) {
+				newCache.push_back(cache[j]);
+			}
+		}
+		// Vertices pushed out of the cache lose their cache score
+		for (uint j=cacheSize; j<newCache.size(); j++) {
+			cachePositions[newCache[j]] = -1;
+			vertexScores[newCache[j]] = scoreVertex(newCache[j]);
+		}
+		if (newCache.size() > cacheSize) {
+			newCache.resize(cacheSize);
+		}
+		cache.swap(newCache);
+
+		// Rescore the cached vertices and their unused triangles, and pick the best of those
+		for (uint j=0; j<cache.size(); j++) {
+			cachePositions[cache[j]] = (int)j;
+		}
+		for (uint j=0; j<cache.size(); j++) {
+			vertexScores[cache[j]] = scoreVertex(cache[j]);
+		}
+		bestFace = -1;
+		float bestScore = -1;
+		for (uint j=0; j<cache.size(); j++) {
+			uint vertex = cache[j];
+			const uint* triangles = &adjacency.triangles[adjacency.offsets[vertex]];
+			for (uint k=0; k<activeCounts[vertex]; k++) {
+				uint triangle = triangles[k];
+				float score = vertexScores[faces[triangle].a] + vertexScores[faces[triangle].b] + vertexScores[faces[triangle].c];
+				if (score > bestScore) {
+					bestScore = score;
+					bestFace = (int)triangle;
+				}
+			}
+		}
+	}
+
+	inout_faces->swap(sortedFaces);
+}
+
+/* Reorders clusters of triangles so the ones facing out from the middle of the mesh are drawn first,
+hiding more of the triangles behind them, following Sander, Nehab and Barczak's "Fast Triangle Reordering".
+Runs on triangles that are already in vertex cache order, which is split into clusters where the cache restarts,
+and further where it can be without the ACMR going over threshold times what it is now. */
+void optimizeOverdraw(std::vector<Face>* inout_faces, const std::vector<Vec3>& positions, float threshold = 1.05f)
+{
+	const std::vector<Face>& faces = *inout_faces;
+	uint faceCount = faces.size();
+	uint vertexCount = positions.size();
+	if (faceCount == 0) {
+		return;
+	}
+	const uint cacheSize = 16;
+
+	/* Cache simulations share one clock, so starting a new one doesn't have to clear every vertex.
+	A vertex is in the cache if it was added since the simulation started, and fewer than cacheSize misses ago. */
+	std::vector<uint> addedTimes(vertexCount, 0);
+	uint clock = 0;
+	auto countFaceMisses = [&](const Face& face, uint startClock) -> uint {
+		uint indices[3] = {face.a, face.b, face.c};
+		uint missCount = 0;
+		for (uint j=0; j<3; j++) {
+			if (addedTimes[indices[j]] <= startClock || clock - addedTimes[indices[j]] >= cacheSize) {
+				clock++;
+				addedTimes[indices[j]] = clock;
+				missCount++;
+			}
+		}
+		return missCount;
+	};
+
+	// Hard boundaries are where every vertex of a triangle misses the cache, so the order can change for free there
+	std::vector<uint> clusterStarts;
+	for (uint i=0; i<faceCount; i++) {
+		if (countFaceMisses(faces[i], 0) == 3 || i == 0) {
+			clusterStarts.push_back(i);
+		}
+	}
+
+	// Soft boundaries split hard clusters where the ACMR so far is low enough that starting over costs little
+	std::vector<uint> softClusterStarts;
+	for (uint c=0; c<clusterStarts.size(); c++)
+	{
+		uint start = clusterStarts[c];
+		uint end = (c+1 < clusterStarts.size()) ? clusterStarts[c+1] : faceCount;
+		uint startClock = clock;
+		uint clusterMissCount = 0;
+		for (uint i=start; i<end; i++) {
+			clusterMissCount += countFaceMisses(faces[i], startClock);
+		}
+		float clusterACMR = float(clusterMissCount) / float(end-start);
+
+		uint softStart = start;
+		uint softMissCount = 0;
+		startClock = clock;
+		softClusterStarts.push_back(start);
+		for (uint i=start; i<end; i++) {
+			softMissCount += countFaceMisses(faces[i], startClock);
+			// Ending a soft cluster empties the cache, so the next one starts out with misses
+			if (i+1 < end && float(softMissCount) / float(i+1-softStart) <= threshold*clusterACMR) {
+				softClusterStarts.push_back(i+1);
+				softStart = i+1;
+				softMissCount = 0;
+				startClock = clock;
+			}
+		}
+	}
+
+	// Clusters facing out from the mesh's centre are drawn first
+	Vec3 meshCentre = {0, 0, 0};
+	float meshArea = 0;
+	struct Cluster {
+		uint start;
+		uint end;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters(softClusterStarts.size());
+	std::vector<Vec3> clusterCentres(clusters.size());
+	std::vector<Vec3> clusterNormals(clusters.size());
+	for (uint c=0; c<clusters.size(); c++)
+	{
+		clusters[c].start = softClusterStarts[c];
+		clusters[c].end = (c+1 < softClusterStarts.size()) ? softClusterStarts[c+1] : faceCount;
+		Vec3 centre = {0, 0, 0};
+		Vec3 normal = {0, 0, 0};
+		float area = 0;
+		for (uint i=clusters[c].start; i<clusters[c].end; i++) {
+			Vec3 p0 = positions[faces[i].a];
+			Vec3 p1 = positions[faces[i].b];
+			Vec3 p2 = positions[faces[i].c];
+			// The cross product's length is twice the triangle's area, so this weights by area
+			Vec3 areaNormal = cross(p1-p0, p2-p0);
+			float faceArea = length(areaNormal);
+			centre = centre + (p0+p1+p2) * (faceArea/3.0f);
+			normal = normal + areaNormal;
+			area += faceArea;
+		}
+		clusterCentres[c] = (area > 0) ? centre/area : positions[faces[clusters[c].start].a];
+		clusterNormals[c] = normal;
+		meshCentre = meshCentre + centre;
+		meshArea += area;
+	}
+	if (meshArea > 0) {
+		meshCentre = meshCentre/meshArea;
+	}
+	for (uint c=0; c<clusters.size(); c++) {
+		float normalLength = length(clusterNormals[c]);
+		Vec3 normal = (normalLength > 0) ? clusterNormals[c]/normalLength : clusterNormals[c];
+		clusters[c].sortKey = dot(clusterCentres[c] - meshCentre, normal);
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<Face> sortedFaces;
+	sortedFaces.reserve(faceCount);
+	for (uint c=0; c<clusters.size(); c++) {
+		sortedFaces.insert(sortedFaces.end(), faces.begin()+clusters[c].start, faces.begin()+clusters[c].end);
+	}
+	inout_faces->swap(sortedFaces);
+}
+
+template<typename T>
+void remapVertexStream(std::vector<T>* inout_stream, const std::vector<uint>& remap, uint newVertexCount)
+{
+	if (inout_stream->empty()) {
+		return;
+	}
+	std::vector<T> remapped(newVertexCount);
+	for (uint i=0; i<remap.size(); i++) {
+		if (remap[i] != (uint)-1) {
+			remapped[remap[i]] = (*inout_stream)[i];
+		}
+	}
+	inout_stream->swap(remapped);
+}
+
+void remapFaces(std::vector<Face>* inout_faces, std::vector<uint>* inout_remap, uint* inout_nextVertex)
+{
+	std::vector<uint>& remap = *inout_remap;
+	for (uint i=0; i<inout_faces->size(); i++) {
+		uint* indices = &(*inout_faces)[i].a;
+		for (uint j=0; j<3; j++) {
+			if (remap[indices[j]] == (uint)-1) {
+				remap[indices[j]] = (*inout_nextVertex)++;
+			}
+			indices[j] = remap[indices[j]];
+		}
+	}
+}
+
+/* Orders the vertices by when the triangles first use them, and removes any that aren't used.
+Levels of detail only use the full mesh's vertices, so they don't change the order. */
+void optimizeVertexFetch(Mesh* inout_mesh)
+{
+	uint vertexCount = inout_mesh->positions.size();
+	std::vector<uint> remap(vertexCount, (uint)-1);
+	uint nextVertex = 0;
+	remapFaces(&inout_mesh->faces, &remap, &nextVertex);
+	for (uint i=0; i<inout_mesh->lods.size(); i++) {
+		remapFaces(&inout_mesh->lods[i].faces, &remap, &nextVertex);
+	}
+	remapVertexStream(&inout_mesh->positions, remap, nextVertex);
+	remapVertexStream(&inout_mesh->uvs, remap, nextVertex);
+	remapVertexStream(&inout_mesh->normals, remap, nextVertex);
+	remapVertexStream(&inout_mesh->tangents, remap, nextVertex);
+	remapVertexStream(&inout_mesh->jointIndeces, remap, nextVertex);
+	remapVertexStream(&inout_mesh->jointWeights, remap, nextVertex);
+}
+
+/* Runs every optimization on the mesh. Anything that reorders the triangles afterwards, like buildMeshlets(),
+changes how well they use the vertex cache, so measure it with simulateVertexCache() once they're in their final order. */
+void optimizeMesh(Mesh* inout_mesh)
+{
+	uint vertexCount = inout_mesh->positions.size();
+	optimizeVertexCache(&inout_mesh->faces, vertexCount);
+	optimizeOverdraw(&inout_mesh->faces, inout_mesh->positions);
+	optimizeVertexFetch(inout_mesh);
+}
+#endif // GOBMESH_CONVERTER_MESH_OPTIMIZE_HEADER
@@ -0,0 +1,248 @@
+#include "Gobmesh.h"
+#include "MeshOptimize.h"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <stdint.h>
+
+/* Builds coarser levels of detail for a mesh by collapsing edges, Garland and Heckbert's quadric error metric way:
+each vertex keeps the sum of its triangles' planes, as a quadric that measures the squared distance from them,
+and the edges that move their vertex the least from its planes are collapsed first.
+Vertices only collapse onto other vertices, so every level uses the same vertex buffer, and only the faces change.
+
+Vertices on an edge with one triangle are never moved. That covers the mesh's holes, and also its UV, normal and
+mirror seams, since the vertices there are split, so levels don't tear apart or smear UVs across islands.
+A mesh with lots of seams won't get as small. */
+
+// Each level aims for this many times the triangles of the one before it
+static const float lodTriangleRatio = 0.5f;
+// Levels stop when one can't get below this many times the triangles of the one before it
+static const float lodMinimumReduction = 0.85f;
+
+// A symmetric 4x4 matrix, with the area it was summed from
+struct Quadric
+{
+	double aa, ab, ac, ad, bb, bc, bd, cc, cd, dd;
+	double weight;
+};
+
+// The plane dot(normal, p) + d = 0, weighted by area
+Quadric makePlaneQuadric(Vec3 normal, float d, float area)
+{
+	double a = normal.x, b = normal.y, c = normal.z;
+	Quadric q = {a*a*area, a*b*area, a*c*area, a*d*area, b*b*area, b*c*area, b*d*area, c*c*area, c*d*area, (double)d*d*area, area};
+	return q;
+}
+
+void addQuadric(Quadric* inout_q, const Quadric& other)
+{
+	Quadric& q = *inout_q;
+	q.aa += other.aa; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+	q.bb += other.bb; q.bc += other.bc; q.bd += other.bd;
+	q.cc += other.cc; q.cd += other.cd;
+	q.dd += other.dd;
+	q.weight += other.weight;
+}
+
+// The area weighted mean of the squared distances from p to the quadric's planes
+float evaluateQuadric(const Quadric& q, Vec3 p)
+{
+	if (q.weight <= 0) {
+		return 0;
+	}
+	double x = p.x, y = p.y, z = p.z;
+	double error = q.aa*x*x + 2*q.ab*x*y + 2*q.ac*x*z + 2*q.ad*x
+		+ q.bb*y*y + 2*q.bc*y*z + 2*q.bd*y
+		+ q.cc*z*z + 2*q.cd*z
+		+ q.dd;
+	return (float)std::max(0.0, error/q.weight);
+}
+
+// True if no triangle around vertex flips over, or gets close to it, when vertex moves to target
+bool isCollapseValid(const std::vector<Face>& faces, const VertexTriangles& adjacency, const std::vector<Vec3>& positions, uint vertex, uint target)
+{
+	for (uint k=adjacency.offsets[vertex]; k<adjacency.offsets[vertex+1]; k++)
+	{
+		const uint* indices = &faces[adjacency.triangles[k]].a;
+		if (indices[0] == target || indices[1] == target || indices[2] == target) {
+			continue; // Removed by the collapse
+		}
+		Vec3 before[3], after[3];
+		for (uint j=0; j<3; j++) {
+			before[j] = positions[indices[j]];
+			after[j] = positions[(indices[j] == vertex) ? target : indices[j]];
+		}
+		Vec3 normalBefore = cross(before[1] - before[0], before[2] - before[0]);
+		Vec3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+		// Turning further than about 45 degrees in one collapse lets triangles fold over after a few
+		if (dot(normalBefore, normalAfter) <= 0.7f*length(normalBefore)*length(normalAfter)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+struct EdgeCollapse
+{
+	uint vertex;
+	uint target;
+	float error;
+};
+
+/* One round of collapses, each touching vertices no other one in the round does, so the adjacency stays valid.
+Collapses at most maxCollapseCount edges, and raises inout_maxError to the largest error collapsed.
+Returns how many were collapsed. */
+uint collapseEdges(std::vector<Face>* inout_faces, std::vector<Quadric>* inout_quadrics, const std::vector<bool>& locked,
+	const std::vector<Vec3>& positions, uint maxCollapseCount, float* inout_maxError)
+{
+	std::vector<Face>& faces = *inout_faces;
+	std::vector<Quadric>& quadrics = *inout_quadrics;
+	uint vertexCount = positions.size();
+	VertexTriangles adjacency;
+	buildVertexTriangles(&adjacency, faces, vertexCount);
+
+	// Edges appear once for each triangle using them, which only costs some extra sorting
+	std::vector<EdgeCollapse> collapses;
+	collapses.reserve(faces.size()*6);
+	for (uint i=0; i<faces.size(); i++)
+	{
+		const uint* indices = &faces[i].a;
+		for (uint j=0; j<3; j++)
+		{
+			uint v0 = indices[j];
+			uint v1 = indices[(j+1)%3];
+			if (!locked[v0]) {
+				EdgeCollapse collapse = {v0, v1, evaluateQuadric(quadrics[v0], positions[v1])};
+				collapses.push_back(collapse);
+			}
+			if (!locked[v1]) {
+				EdgeCollapse collapse = {v1, v0, evaluateQuadric(quadrics[v1], positions[v0])};
+				collapses.push_back(collapse);
+			}
+		}
+	}
+	std::stable_sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b) { return a.error < b.error; });
+
+	std::vector<bool> touched(vertexCount, false);
+	uint collapseCount = 0;
+	for (uint i=0; i<collapses.size() && collapseCount < maxCollapseCount; i++)
+	{
+		const EdgeCollapse& collapse = collapses[i];
+		if (touched[collapse.vertex] || touched[collapse.target]
+		 || !isCollapseValid(faces, adjacency, positions, collapse.vertex, collapse.target)) {
+			continue;
+		}
+		// Every triangle around the vertex changes, so nothing else in this round can use them
+		for (uint k=adjacency.offsets[collapse.vertex]; k<adjacency.offsets[collapse.vertex+1]; k++) {
+			const uint* indices = &faces[adjacency.triangles[k]].a;
+			touched[indices[0]] = touched[indices[1]] = touched[indices[2]] = true;
+		}
+		touched[collapse.target] = true;
+
+		for (uint k=adjacency.offsets[collapse.vertex]; k<adjacency.offsets[collapse.vertex+1]; k++) {
+			uint* indices = &faces[adjacency.triangles[k]].a;
+			for (uint j=0; j<3; j++) {
+				if (indices[j] == collapse.vertex) {
+					indices[j] = collapse.target;
+				}
+			}
+		}
+		addQuadric(&quadrics[collapse.target], quadrics[collapse.vertex]);
+		*inout_maxError = std::max(*inout_maxError, collapse.error);
+		collapseCount++;
+	}
+
+	// Collapsed edges leave triangles with two corners on the same vertex
+	uint keptCount = 0;
+	for (uint i=0; i<faces.size(); i++) {
+		if (faces[i].a != faces[i].b && faces[i].b != faces[i].c && faces[i].c != faces[i].a) {
+			faces[keptCount++] = faces[i];
+		}
+	}
+	faces.resize(keptCount);
+	return collapseCount;
+}
+
+/* Fills inout_mesh->lods with up to lodCount-1 levels after the full mesh, each with about half the triangles
+of the one before it. Each level is simplified from the one before, and keeps its triangles in the same order.
+Stops early when a level can't be made much smaller. */
+void generateLODs(Mesh* inout_mesh, uint lodCount, std::ostream& log = std::cout)
+{
+	Mesh& mesh = *inout_mesh;
+	mesh.lods.clear();
+	uint vertexCount = mesh.positions.size();
+	if (lodCount <= 1 || mesh.faces.empty()) {
+		return;
+	}
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (uint i=0; i<mesh.faces.size(); i++)
+	{
+		const uint* indices = &mesh.faces[i].a;
+		Vec3 normal = cross(mesh.positions[indices[1]] - mesh.positions[indices[0]], mesh.positions[indices[2]] - mesh.positions[indices[0]]);
+		float doubleArea = length(normal);
+		if (doubleArea == 0) {
+			continue;
+		}
+		normal = normal/doubleArea;
+		Quadric plane = makePlaneQuadric(normal, -dot(normal, mesh.positions[indices[0]]), doubleArea*0.5f);
+		for (uint j=0; j<3; j++) {
+			addQuadric(&quadrics[indices[j]], plane);
+		}
+	}
+
+	// Edges used by one triangle are on a hole or a seam, and edges used by more than two aren't manifold
+	std::vector<uint64_t> edges;
+	edges.reserve(mesh.faces.size()*3);
+	for (uint i=0; i<mesh.faces.size(); i++) {
+		const uint* indices = &mesh.faces[i].a;
+		for (uint j=0; j<3; j++) {
+			uint v0 = std::min(indices[j], indices[(j+1)%3]);
+			uint v1 = std::max(indices[j], indices[(j+1)%3]);
+			edges.push_back(((uint64_t)v0 << 32) | v1);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	std::vector<bool> locked(vertexCount, false);
+	for (uint i=0; i<edges.size();)
+	{
+		uint end = i+1;
+		while (end < edges.size() && edges[end] == edges[i]) {
+			end++;
+		}
+		if (end - i != 2) {
+			locked[(uint)(edges[i] >> 32)] = true;
+			locked[(uint)(edges[i] & 0xFFFFFFFF)] = true;
+		}
+		i = end;
+	}
+
+	std::vector<Face> faces = mesh.faces;
+	float maxError = 0;
+	for (uint level=1; level<lodCount; level++)
+	{
+		uint previousCount = faces.size();
+		uint targetCount = (uint)(previousCount*lodTriangleRatio);
+		while (faces.size() > targetCount) {
+			// Each collapse removes about two triangles
+			uint maxCollapseCount = std::max(1u, (uint)(faces.size() - targetCount)/2);
+			if (collapseEdges(&faces, &quadrics, locked, mesh.positions, maxCollapseCount, &maxError) == 0) {
+				break;
+			}
+		}
+		if (faces.empty() || faces.size() > previousCount*lodMinimumReduction) {
+			break;
+		}
+		LevelOfDetail lod;
+		lod.faces = faces;
+		lod.error = sqrtf(maxError);
+		mesh.lods.push_back(lod);
+	}
+
+	log << "Levels of detail: " << mesh.faces.size();
+	for (uint i=0; i<mesh.lods.size(); i++) {
+		log << ", " << mesh.lods[i].faces.size() << " (error " << mesh.lods[i].error << ")";
+	}
+	log << " triangles\n";
+}
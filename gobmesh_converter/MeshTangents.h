@@ -0,0 +1,228 @@
+#include "Gobmesh.h"
+#include <vector>
+#include <map>
+#include <array>
+#include <iostream>
+#include <math.h>
+
+/* Generates the tangents for tangent-space normal mapping the way MikkTSpace does (mikktspace.com),
+which is what Blender, Substance, xNormal and most other bakers use, so their normal maps come out right:
+each triangle corner's tangent is the triangle's UV gradient, projected onto the plane of the corner's normal,
+and the corners around a vertex are summed weighted by their angle, so the way a polygon is split into triangles
+doesn't change the result.
+Like MikkTSpace, vertices with the same position, normal and UV are treated as one, whatever their index,
+and the corners around one are split into groups: corners are only summed together when their triangles
+are connected through edges around the vertex and have UVs facing the same way. A vertex in more than one group,
+like one on a UV mirror seam, is split into one vertex for each group.
+The bitangent is tangent.w*cross(normal, tangent.xyz), where w is 1 for unmirrored UVs and -1 for mirrored ones.
+
+Tangents from the source file or Assimp are always replaced, so the converter doesn't ask Assimp for them.
+Unlike MikkTSpace, triangles with no UV area don't get a tangent of their own, and their corners take
+whichever tangent their vertex ends up with. */
+
+// Any unit vector perpendicular to normal
+Vec3 getPerpendicularVector(Vec3 normal)
+{
+	Vec3 axis = (fabsf(normal.x) < 0.9f) ? Vec3{1, 0, 0} : Vec3{0, 1, 0};
+	return normalize(cross(normal, axis));
+}
+
+// Projects v onto the plane perpendicular to normal, and normalizes it. Returns false if nothing is left.
+bool projectOntoPlane(Vec3* out_projected, Vec3 v, Vec3 normal)
+{
+	Vec3 projected = v - normal*dot(normal, v);
+	float projectedLength = length(projected);
+	if (projectedLength <= 1e-20f) {
+		return false;
+	}
+	*out_projected = projected/projectedLength;
+	return true;
+}
+
+template<typename T>
+void duplicateVertex(std::vector<T>* inout_stream, uint vertex)
+{
+	if (!inout_stream->empty()) {
+		T copy = (*inout_stream)[vertex];
+		inout_stream->push_back(copy);
+	}
+}
+
+// The corner groups of generateTangents() are kept in a union-find forest
+uint findTangentGroup(std::vector<uint>* inout_parents, uint corner)
+{
+	std::vector<uint>& parents = *inout_parents;
+	while (parents[corner] != corner) {
+		parents[corner] = parents[parents[corner]];
+		corner = parents[corner];
+	}
+	return corner;
+}
+
+void joinTangentGroups(std::vector<uint>* inout_parents, uint cornerA, uint cornerB)
+{
+	uint a = findTangentGroup(inout_parents, cornerA);
+	uint b = findTangentGroup(inout_parents, cornerB);
+	// The lower corner is the root, so groups don't depend on the order they're joined in
+	if (a < b) {
+		(*inout_parents)[b] = a;
+	}
+	else if (b < a) {
+		(*inout_parents)[a] = b;
+	}
+}
+
+// Fills inout_mesh->tangents, splitting vertices whose corners fall into different groups.
+// Meshes without UVs or normals get no tangents.
+void generateTangents(Mesh* inout_mesh, std::ostream& log = std::cout)
+{
+	Mesh& mesh = *inout_mesh;
+	uint vertexCount = mesh.positions.size();
+	uint faceCount = mesh.faces.size();
+	mesh.tangents.clear();
+	if (mesh.uvs.size() != vertexCount || mesh.normals.size() != vertexCount) {
+		return;
+	}
+
+	std::vector<Vec3> normals(vertexCount);
+	for (uint i=0; i<vertexCount; i++) {
+		normals[i] = normalize(mesh.normals[i]);
+	}
+
+	// Vertices with the same position, normal and UV get the same welded index
+	std::vector<uint> welded(vertexCount);
+	std::map<std::array<float, 8>, uint> weldedIndices;
+	for (uint i=0; i<vertexCount; i++) {
+		std::array<float, 8> key = {mesh.positions[i].x, mesh.positions[i].y, mesh.positions[i].z,
+			normals[i].x, normals[i].y, normals[i].z, mesh.uvs[i].x, mesh.uvs[i].y};
+		welded[i] = weldedIndices.insert(std::make_pair(key, i)).first->second;
+	}
+
+	// 1 for unmirrored, -1 for mirrored, 0 for triangles with no UV area, which don't have a tangent
+	std::vector<int> faceOrientations(faceCount, 0);
+	std::vector<Vec3> faceTangents(faceCount, Vec3{0, 0, 0});
+	for (uint i=0; i<faceCount; i++)
+	{
+		const uint* indices = &mesh.faces[i].a;
+		Vec3 deltaPos1 = mesh.positions[indices[1]] - mesh.positions[indices[0]];
+		Vec3 deltaPos2 = mesh.positions[indices[2]] - mesh.positions[indices[0]];
+		Vec2 deltaUV1 = mesh.uvs[indices[1]] - mesh.uvs[indices[0]];
+		Vec2 deltaUV2 = mesh.uvs[indices[2]] - mesh.uvs[indices[0]];
+		float signedUVArea = deltaUV1.x*deltaUV2.y - deltaUV2.x*deltaUV1.y;
+		if (signedUVArea == 0) {
+			continue;
+		}
+		// The tangent scaled by the UV area, so its sign has to be taken back out
+		Vec3 faceTangent = deltaPos1*deltaUV2.y - deltaPos2*deltaUV1.y;
+		faceTangents[i] = (signedUVArea < 0) ? faceTangent*-1.0f : faceTangent;
+		faceOrientations[i] = (signedUVArea > 0) ? 1 : -1;
+	}
+
+	/* Corner 3*face+j starts in a group of its own. Two corners at the same welded vertex are joined
+	when their triangles share an edge out of it and face the same way, so each group is a fan of
+	connected triangles around the vertex. */
+	std::vector<uint> groups(3*faceCount);
+	for (uint i=0; i<3*faceCount; i++) {
+		groups[i] = i;
+	}
+	// The first corner seen for each {vertex, the edge's other vertex, orientation}
+	std::map<std::array<uint, 3>, uint> edgeCorners;
+	for (uint i=0; i<faceCount; i++)
+	{
+		if (faceOrientations[i] == 0) {
+			continue;
+		}
+		const uint* indices = &mesh.faces[i].a;
+		for (uint j=0; j<3; j++) {
+			for (uint k=1; k<3; k++)
+			{
+				std::array<uint, 3> edge = {welded[indices[j]], welded[indices[(j+k)%3]], (uint)(faceOrientations[i] > 0)};
+				std::pair<std::map<std::array<uint, 3>, uint>::iterator, bool> inserted = edgeCorners.insert(std::make_pair(edge, 3*i+j));
+				if (!inserted.second) {
+					joinTangentGroups(&groups, inserted.first->second, 3*i+j);
+				}
+			}
+		}
+	}
+
+	// Each group sums its corners' tangents at its root corner
+	std::vector<Vec3> tangentSums(3*faceCount, Vec3{0, 0, 0});
+	for (uint i=0; i<faceCount; i++)
+	{
+		if (faceOrientations[i] == 0) {
+			continue;
+		}
+		const uint* indices = &mesh.faces[i].a;
+		for (uint j=0; j<3; j++)
+		{
+			uint vertex = indices[j];
+			Vec3 normal = normals[vertex];
+			Vec3 cornerTangent;
+			if (!projectOntoPlane(&cornerTangent, faceTangents[i], normal)) {
+				continue;
+			}
+			// The corner's angle, measured in the plane of its normal
+			Vec3 edge1, edge2;
+			if (!projectOntoPlane(&edge1, mesh.positions[indices[(j+1)%3]] - mesh.positions[vertex], normal)
+			 || !projectOntoPlane(&edge2, mesh.positions[indices[(j+2)%3]] - mesh.positions[vertex], normal)) {
+				continue;
+			}
+			float angle = acosf(clamp(dot(edge1, edge2), -1, 1));
+			tangentSums[findTangentGroup(&groups, 3*i+j)] += cornerTangent*angle;
+		}
+	}
+
+	// The first group to reach a vertex keeps it, and every other group gets a copy
+	const uint noGroup = (uint)-1;
+	std::vector<uint> vertexGroups(vertexCount, noGroup);
+	std::vector<uint> copyGroups;
+	std::map<std::array<uint, 2>, uint> copies;
+	for (uint i=0; i<faceCount; i++)
+	{
+		if (faceOrientations[i] == 0) {
+			continue;
+		}
+		uint* indices = &mesh.faces[i].a;
+		for (uint j=0; j<3; j++)
+		{
+			uint vertex = indices[j];
+			uint group = findTangentGroup(&groups, 3*i+j);
+			if (vertexGroups[vertex] == noGroup) {
+				vertexGroups[vertex] = group;
+			}
+			else if (vertexGroups[vertex] != group)
+			{
+				std::array<uint, 2> key = {vertex, group};
+				std::map<std::array<uint, 2>, uint>::iterator found = copies.find(key);
+				if (found == copies.end()) {
+					found = copies.insert(std::make_pair(key, (uint)mesh.positions.size())).first;
+					copyGroups.push_back(group);
+					duplicateVertex(&mesh.positions, vertex);
+					duplicateVertex(&mesh.uvs, vertex);
+					duplicateVertex(&mesh.normals, vertex);
+					duplicateVertex(&mesh.jointIndeces, vertex);
+					duplicateVertex(&mesh.jointWeights, vertex);
+					normals.push_back(normals[vertex]);
+				}
+				indices[j] = found->second;
+			}
+		}
+	}
+	uint splitCount = mesh.positions.size() - vertexCount;
+
+	mesh.tangents.resize(mesh.positions.size());
+	for (uint i=0; i<mesh.positions.size(); i++)
+	{
+		// Vertices only used by triangles with no UV area still get a tangent, just not a meaningful one
+		uint group = (i < vertexCount) ? vertexGroups[i] : copyGroups[i - vertexCount];
+		Vec3 sum = (group != noGroup) ? tangentSums[group] : Vec3{0, 0, 0};
+		float sumLength = length(sum);
+		Vec3 tangent = (sumLength > 1e-20f) ? sum/sumLength : getPerpendicularVector(normals[i]);
+		bool mirrored = (group != noGroup) && faceOrientations[group/3] < 0;
+		mesh.tangents[i] = Vec4{tangent.x, tangent.y, tangent.z, mirrored ? -1.0f : 1.0f};
+	}
+
+	if (splitCount > 0) {
+		log << "Tangents: split " << splitCount << " vertices on UV mirror seams and between unconnected triangles\n";
+	}
+}
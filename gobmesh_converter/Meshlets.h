@@ -0,0 +1,239 @@
+#include "Gobmesh.h"
+#include "MeshOptimize.h"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+/* Splits a mesh into meshlets: runs of at most maxMeshletTriangles triangles, using at most maxMeshletVertices vertices,
+so the runtime can cull parts of a mesh instead of all or none of it. Each meshlet's triangles are next to each other
+in the index buffer, so the visible ones can be drawn with renderRange().
+A meshlet grows from a seed triangle by adding the neighbouring triangle that brings in the fewest new vertices,
+preferring ones that face the same way, since a narrow normal cone is what lets a meshlet be culled when it faces away. */
+
+// How much facing the same way counts against new vertices
+static const float meshletConeWeight = 0.25f;
+
+Vec3 getFaceNormal(const Face& face, const std::vector<Vec3>& positions)
+{
+	Vec3 normal = cross(positions[face.b] - positions[face.a], positions[face.c] - positions[face.a]);
+	float normalLength = length(normal);
+	if (normalLength == 0) {
+		Vec3 zero = {0, 0, 0};
+		return zero;
+	}
+	return normal/normalLength;
+}
+
+// Fills the bounding sphere and normal cone of the meshlet's triangles, which are in faces
+void computeMeshletBounds(Meshlet* inout_meshlet, const std::vector<Face>& faces, const std::vector<Vec3>& positions)
+{
+	Meshlet& meshlet = *inout_meshlet;
+	// Centred on the bounding box, which is a little bigger than the smallest sphere, but never misses a vertex
+	Vec3 boundsMin = positions[faces[meshlet.firstTriangle].a];
+	Vec3 boundsMax = boundsMin;
+	Vec3 normalSum = {0, 0, 0};
+	for (uint i=meshlet.firstTriangle; i<meshlet.firstTriangle+meshlet.triangleCount; i++)
+	{
+		const uint* indices = &faces[i].a;
+		for (uint j=0; j<3; j++) {
+			Vec3 p = positions[indices[j]];
+			boundsMin = Vec3{std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z)};
+			boundsMax = Vec3{std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z)};
+		}
+		normalSum += getFaceNormal(faces[i], positions);
+	}
+	meshlet.center = (boundsMin + boundsMax)*0.5f;
+	meshlet.radius = 0;
+	for (uint i=meshlet.firstTriangle; i<meshlet.firstTriangle+meshlet.triangleCount; i++) {
+		const uint* indices = &faces[i].a;
+		for (uint j=0; j<3; j++) {
+			meshlet.radius = std::max(meshlet.radius, length(positions[indices[j]] - meshlet.center));
+		}
+	}
+
+	/* The cone's axis is the average normal, and it's as wide as the normal furthest from it.
+	Every triangle faces away from a camera at c when dot(center - c, coneAxis) >= coneCutoff*length(center - c) + radius,
+	where coneCutoff is the sine of the cone's half angle. Cones 90 degrees or wider can't ever be culled, so get a cutoff of 1. */
+	meshlet.coneCutoff = 1;
+	meshlet.coneAxis = Vec3{0, 0, 0};
+	float normalSumLength = length(normalSum);
+	if (normalSumLength == 0) {
+		return;
+	}
+	meshlet.coneAxis = normalSum/normalSumLength;
+	float minDot = 1;
+	for (uint i=meshlet.firstTriangle; i<meshlet.firstTriangle+meshlet.triangleCount; i++) {
+		minDot = std::min(minDot, dot(getFaceNormal(faces[i], positions), meshlet.coneAxis));
+	}
+	if (minDot > 0) {
+		meshlet.coneCutoff = sqrtf(1 - minDot*minDot);
+	}
+}
+
+/* Fills inout_mesh->meshlets and reorders the faces so each meshlet's triangles are together.
+Seeds are taken in the faces' current order, so a mesh already sorted for overdraw mostly stays that way.
+With keepFaceOrder, the faces aren't reordered, and the meshlets are just runs of them. */
+void buildMeshlets(Mesh* inout_mesh, bool keepFaceOrder, std::ostream& log = std::cout)
+{
+	std::vector<Face>& faces = inout_mesh->faces;
+	const std::vector<Vec3>& positions = inout_mesh->positions;
+	uint faceCount = faces.size();
+	uint vertexCount = positions.size();
+	inout_mesh->meshlets.clear();
+	if (faceCount == 0) {
+		return;
+	}
+
+	VertexTriangles adjacency;
+	std::vector<Vec3> faceNormals(faceCount);
+	if (!keepFaceOrder) {
+		buildVertexTriangles(&adjacency, faces, vertexCount);
+		for (uint i=0; i<faceCount; i++) {
+			faceNormals[i] = getFaceNormal(faces[i], positions);
+		}
+	}
+
+	std::vector<Face> orderedFaces;
+	orderedFaces.reserve(faceCount);
+	std::vector<bool> emitted(faceCount, false);
+	// Which meshlet last used each vertex, so counting new vertices doesn't need clearing between meshlets
+	std::vector<uint> vertexMeshlet(vertexCount, (uint)-1);
+	std::vector<uint> meshletVertices;
+	uint nextSeed = 0;
+
+	while (orderedFaces.size() < faceCount)
+	{
+		uint meshletIndex = inout_mesh->meshlets.size();
+		Meshlet meshlet = {};
+		meshlet.firstTriangle = orderedFaces.size();
+		meshletVertices.clear();
+		Vec3 normalSum = {0, 0, 0};
+
+		while (emitted[nextSeed]) {
+			nextSeed++;
+		}
+		uint triangle = nextSeed;
+		while (triangle != (uint)-1)
+		{
+			const uint* indices = &faces[triangle].a;
+			for (uint j=0; j<3; j++) {
+				if (vertexMeshlet[indices[j]] != meshletIndex) {
+					vertexMeshlet[indices[j]] = meshletIndex;
+					meshletVertices.push_back(indices[j]);
+				}
+			}
+			emitted[triangle] = true;
+			orderedFaces.push_back(faces[triangle]);
+			meshlet.triangleCount++;
+			if (meshlet.triangleCount == maxMeshletTriangles) {
+				break;
+			}
+
+			// Pick the next triangle, from the neighbours of the one just added,
+			// or any triangle using the meshlet's vertices if they're all used
+			uint lastTriangle = triangle;
+			triangle = (uint)-1;
+			if (keepFaceOrder) {
+				uint next = lastTriangle+1;
+				if (next < faceCount) {
+					uint newVertexCount = 0;
+					for (uint j=0; j<3; j++) {
+						newVertexCount += (vertexMeshlet[(&faces[next].a)[j]] != meshletIndex) ? 1 : 0;
+					}
+					if (meshletVertices.size() + newVertexCount <= maxMeshletVertices) {
+						triangle = next;
+					}
+				}
+				continue;
+			}
+
+			normalSum += faceNormals[lastTriangle];
+			float normalSumLength = length(normalSum);
+			Vec3 averageNormal = (normalSumLength > 0) ? normalSum/normalSumLength : normalSum;
+			float bestScore = 1e30f;
+			for (uint pass=0; pass<2 && triangle == (uint)-1; pass++)
+			{
+				const uint* searchVertices = &faces[lastTriangle].a;
+				uint searchVertexCount = 3;
+				if (pass == 1) {
+					searchVertices = meshletVertices.data();
+					searchVertexCount = meshletVertices.size();
+				}
+				for (uint v=0; v<searchVertexCount; v++)
+				{
+					uint vertex = searchVertices[v];
+					for (uint k=adjacency.offsets[vertex]; k<adjacency.offsets[vertex+1]; k++)
+					{
+						uint candidate = adjacency.triangles[k];
+						if (emitted[candidate]) {
+							continue;
+						}
+						uint newVertexCount = 0;
+						for (uint j=0; j<3; j++) {
+							newVertexCount += (vertexMeshlet[(&faces[candidate].a)[j]] != meshletIndex) ? 1 : 0;
+						}
+						if (meshletVertices.size() + newVertexCount > maxMeshletVertices) {
+							continue;
+						}
+						float score = newVertexCount + meshletConeWeight*(1 - dot(faceNormals[candidate], averageNormal));
+						if (score < bestScore) {
+							bestScore = score;
+							triangle = candidate;
+						}
+					}
+				}
+			}
+		}
+
+		meshlet.vertexCount = meshletVertices.size();
+		inout_mesh->meshlets.push_back(meshlet);
+	}
+	faces.swap(orderedFaces);
+
+	uint culledCount = 0;
+	for (uint i=0; i<inout_mesh->meshlets.size(); i++) {
+		computeMeshletBounds(&inout_mesh->meshlets[i], faces, positions);
+		culledCount += (inout_mesh->meshlets[i].coneCutoff < 1) ? 1 : 0;
+	}
+	log << "Meshlets: " << inout_mesh->meshlets.size() << ", averaging " << float(faceCount)/inout_mesh->meshlets.size()
+		<< " triangles, " << culledCount << " with normal cones narrow enough to cull\n";
+}
+
+/* Growing meshlets undoes most of optimizeVertexCache()'s ordering, so this orders each meshlet's triangles for the cache again,
+without moving any triangle to another meshlet. Each meshlet's vertices are numbered from 0 while it's optimized,
+so the work is for its few vertices instead of the whole mesh's. */
+void optimizeMeshletVertexCache(Mesh* inout_mesh)
+{
+	std::vector<Face>& faces = inout_mesh->faces;
+	std::vector<uint> localVertex(inout_mesh->positions.size(), (uint)-1);
+	std::vector<uint> meshletVertices;
+	std::vector<Face> meshletFaces;
+	for (uint i=0; i<inout_mesh->meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = inout_mesh->meshlets[i];
+		meshletVertices.clear();
+		meshletFaces.assign(faces.begin() + meshlet.firstTriangle, faces.begin() + meshlet.firstTriangle + meshlet.triangleCount);
+		for (uint t=0; t<meshletFaces.size(); t++) {
+			uint* indices = &meshletFaces[t].a;
+			for (uint j=0; j<3; j++) {
+				if (localVertex[indices[j]] == (uint)-1) {
+					localVertex[indices[j]] = meshletVertices.size();
+					meshletVertices.push_back(indices[j]);
+				}
+				indices[j] = localVertex[indices[j]];
+			}
+		}
+		optimizeVertexCache(&meshletFaces, meshletVertices.size());
+		for (uint t=0; t<meshletFaces.size(); t++) {
+			uint* indices = &meshletFaces[t].a;
+			for (uint j=0; j<3; j++) {
+				indices[j] = meshletVertices[indices[j]];
+			}
+			faces[meshlet.firstTriangle + t] = meshletFaces[t];
+		}
+		for (uint v=0; v<meshletVertices.size(); v++) {
+			localVertex[meshletVertices[v]] = (uint)-1;
+		}
+	}
+}
@@ -1,37 +1,107 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <queue>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <assert.h>
+#include <stdlib.h>
 #include "Algebra.h"
 #include "AssimpConvert.h"
+#include "MeshOptimize.h"
+#include "Meshlets.h"
+#include "MeshSimplify.h"
+#include "MeshTangents.h"
+#include "assimp/Importer.hpp"
+#include "BuildCache.h"
 
-void convertFile(std::string fileName)
+// Change this whenever the converter's output changes, so cached files get rebuilt
+static const char* converterVersion = "7";
+
+struct ConvertOptions
+{
+	// Write version 2 .gobskelanim files with quantized keys
+	bool compressAnimations;
+	// The largest error allowed when compressing animations
+	float animationMaxError;
+	// Remove animation keys that interpolation can rebuild within this distance. 0 keeps every key.
+	float keyReductionTolerance;
+	// Write triangles and vertices in Assimp's order, instead of reordering them for the vertex cache and overdraw
+	bool skipMeshOptimization;
+	// Levels of detail to write, counting the full mesh. 0 and 1 only write the full mesh.
+	uint lodCount;
+	// Store a bounding volume hierarchy for raycasts on the CPU
+	bool buildBVH;
+};
+
+// Everything besides the source file that changes what the converter writes, for build cache keys
+std::string getConvertSettings(const ConvertOptions& options)
+{
+	std::ostringstream settings;
+	settings.precision(9);
+	settings << "gobmesh_converter " << converterVersion
+		<< " compress " << options.compressAnimations << ' ' << options.animationMaxError
+		<< " reduce " << options.keyReductionTolerance
+		<< " optimize " << !options.skipMeshOptimization
+		<< " lods " << std::max(options.lodCount, 1u)
+		<< " bvh " << options.buildBVH;
+	return settings.str();
+}
+
+// The output files are named after the input file, with its extension replaced by .gob*
+std::string getOutputFileStem(const std::string& fileName)
 {
-	// The output file name and location is the same as the input file,
-	// but may be longer, and has the extention replaced with .gob*
-	int endSubStrPos = fileName.find_last_of('.');
-	std::string outputFileName = fileName.substr(0, endSubStrPos);
+	return std::filesystem::path(fileName).replace_extension().lexically_normal().generic_string();
+}
+
+/* Converts one file, writing its messages to log, and adding the names of the files it writes to out_outputFileNames.
+out_inputFileNames gets the other files it was converted from, like an .obj's .mtl and textures, sorted.
+Each call has its own importer, so files can be converted on several threads at once.
+Returns false if anything failed. */
+bool convertFile(std::string fileName, const ConvertOptions& options, std::ostream& log = std::cout,
+	std::vector<std::string>* out_outputFileNames = 0, std::vector<std::string>* out_inputFileNames = 0)
+{
+	std::string outputFileName = getOutputFileStem(fileName);
 
 	/*aiLogStream logStream;
 	logStream = aiGetPredefinedLogStream(aiDefaultLogStream_STDOUT, NULL);
 	aiAttachLogStream(&logStream);*/
 
-	const aiScene* assetScene = 0;
-	assetScene = aiImportFile(fileName.c_str(), aiProcessPreset_TargetRealtime_MaxQuality);
+	// The importer owns the scene, and frees it when it goes out of scope
+	Assimp::Importer importer;
+	std::set<std::string> inputFileNames;
+	// The importer deletes it
+	importer.SetIOHandler(new RecordingIOSystem(&inputFileNames));
+	// generateTangents() replaces Assimp's tangents, so it isn't asked for them
+	const aiScene* assetScene = importer.ReadFile(fileName, aiProcessPreset_TargetRealtime_MaxQuality & ~aiProcess_CalcTangentSpace);
 
 	if (!assetScene) {
-		std::cout << aiGetErrorString() << '\n';
-		return;
+		log << fileName << ": " << importer.GetErrorString() << '\n';
+		return false;
+	}
+	if (out_inputFileNames) {
+		addTextureFileNames(&inputFileNames, assetScene, fileName);
+		inputFileNames.erase(getNormalFileName(fileName));
+		out_inputFileNames->assign(inputFileNames.begin(), inputFileNames.end());
 	}
 
+	bool success = true;
 	Skeleton* outputSkeleton = 0;
 	aiNode* skeletonNode = getSkeleton(assetScene);
 	if (skeletonNode) {
 		outputSkeleton = new Skeleton;
 		convertAssimpSkeleton(outputSkeleton, skeletonNode);
-		outputGOBSKEL(outputFileName + ".gobskel", *outputSkeleton);
+		success &= outputGOBSKEL(outputFileName + ".gobskel", *outputSkeleton, log);
+		if (out_outputFileNames) {
+			out_outputFileNames->push_back(outputFileName + ".gobskel");
+		}
 
 		// Output each animation to an individual file.
 		for (unsigned int i=0; i < assetScene->mNumAnimations; i++)
@@ -44,12 +114,27 @@ void convertFile(std::string fileName)
 			int lastPipeChar = animationName.find_last_of('|');
 			animationName = animationName.substr(lastPipeChar+1);
 
+			animation.name = animationName;
+			if (options.keyReductionTolerance > 0) {
+				reduceAnimationKeys(&animation, *outputSkeleton, options.keyReductionTolerance, log);
+			}
+
 			// Check that the animation has the same number of joints as the skeleton
 			if (animation.joints.size() != outputSkeleton->joints.size()) {
-				std::cout << "Error: the skeleton and the animation '" << assetScene->mAnimations[i]->mName.C_Str() << "' have different numbers of joints.\n";
+				log << "Error: the skeleton and the animation '" << assetScene->mAnimations[i]->mName.C_Str() << "' have different numbers of joints.\n";
+				success = false;
 			}
 			else {
-				outputGOBSKELANIM(outputFileName + "_" + animationName + ".gobskelanim", animation);
+				std::string animationFileName = outputFileName + "_" + animationName + ".gobskelanim";
+				if (options.compressAnimations) {
+					success &= outputGOBSKELANIMCompressed(animationFileName, animation, options.animationMaxError, log);
+				}
+				else {
+					success &= outputGOBSKELANIM(animationFileName, animation, log);
+				}
+				if (out_outputFileNames) {
+					out_outputFileNames->push_back(animationFileName);
+				}
 			}
 		}
 	}
@@ -59,19 +144,328 @@ void convertFile(std::string fileName)
 		// If the input file contains multiple meshes, we'll merge them together into one.
 		Mesh outputMesh;
 		convertAssimpMeshesInScene(&outputMesh, assetScene, outputSkeleton);
-		outputGOBMESH(outputFileName + ".gobmesh", outputMesh);
+		// Before optimizing, so the vertices split on mirror seams get reordered with the rest
+		generateTangents(&outputMesh, log);
+		if (!options.skipMeshOptimization) {
+			VertexCacheStats before = simulateVertexCache(outputMesh.faces, outputMesh.positions.size());
+			optimizeMesh(&outputMesh);
+			buildMeshlets(&outputMesh, false, log);
+			optimizeMeshletVertexCache(&outputMesh);
+			generateLODs(&outputMesh, options.lodCount, log);
+			for (uint i=0; i<outputMesh.lods.size(); i++) {
+				optimizeVertexCache(&outputMesh.lods[i].faces, outputMesh.positions.size());
+			}
+			// Meshlets regroup the triangles, so put the vertices back in the order they're used
+			optimizeVertexFetch(&outputMesh);
+			// Measured on the order that's written, after the meshlets regrouped the triangles
+			VertexCacheStats after = simulateVertexCache(outputMesh.faces, outputMesh.positions.size());
+			log << "Vertex cache: ACMR " << before.acmr << " -> " << after.acmr
+				<< ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+		}
+		else {
+			buildMeshlets(&outputMesh, true, log);
+			generateLODs(&outputMesh, options.lodCount, log);
+		}
+		// After the faces are in their final order, since the BVH refers to them by index
+		if (options.buildBVH) {
+			// On this thread alone, since -j spreads the work over threads by converting several files at once
+			MeshBVH bvh;
+			buildMeshBVH(&bvh, outputMesh.positions.data(), (const uint*)outputMesh.faces.data(), outputMesh.faces.size(), 1);
+			outputMesh.bvh.resize(getMeshBVHByteCount(bvh));
+			writeMeshBVH(outputMesh.bvh.data(), bvh);
+			log << "BVH: " << bvh.nodeCount << " nodes\n";
+			destroyMeshBVH(&bvh);
+		}
+		success &= outputGOBMESH(outputFileName + ".gobmesh", outputMesh, log);
+		if (out_outputFileNames) {
+			out_outputFileNames->push_back(outputFileName + ".gobmesh");
+		}
 	}
 
 	delete outputSkeleton;
-	aiReleaseImport(assetScene);
+	return success;
+}
+
+enum FileResult {
+	file_failed,
+	file_converted,
+	file_upToDate,
+	file_outOfDate // Would have been converted, in a dry run
+};
+
+/* Converts files on jobCount threads. Each file's messages are buffered,
+and printed in the order the files were given, so the output is the same for any job count.
+If cacheFileName isn't empty, files whose build cache entry is up to date are skipped,
+and the cache is updated with the files that were converted.
+A dry run only lists the files that would be converted.
+Returns the number of files that failed. */
+uint convertFiles(const std::vector<std::string>& fileNames, const ConvertOptions& options, uint jobCount,
+	const std::string& cacheFileName, bool dryRun)
+{
+	uint fileCount = (uint)fileNames.size();
+	bool useCache = !cacheFileName.empty();
+	BuildCache cache;
+	if (useCache && !readBuildCache(&cache, cacheFileName)) {
+		std::cout << "Warning: " << cacheFileName << " isn't a build cache, so every file will be converted.\n";
+	}
+	std::string settings = getConvertSettings(options);
+
+	std::vector<std::ostringstream> logs(fileCount);
+	std::vector<std::vector<std::string>> outputFileNames(fileCount);
+	std::vector<std::vector<std::string>> inputFileNames(fileCount);
+	std::vector<uint64_t> keys(fileCount, 0);
+	std::vector<char> hasKey(fileCount, 0);
+	std::vector<FileResult> results(fileCount, file_failed);
+	std::vector<char> finished(fileCount, 0);
+	std::atomic<uint> nextFile(0);
+	std::mutex printMutex;
+	uint nextPrintedFile = 0;
+
+	// Files like a.fbx and a.obj would write the same outputs, so neither is converted
+	std::vector<int> collidesWith(fileCount, -1);
+	std::unordered_map<std::string, uint> firstFileWithStem;
+	for (uint i=0; i<fileCount; i++) {
+		std::pair<std::unordered_map<std::string, uint>::iterator, bool> inserted = firstFileWithStem.insert(std::make_pair(getOutputFileStem(fileNames[i]), i));
+		if (!inserted.second) {
+			uint first = inserted.first->second;
+			collidesWith[i] = (int)first;
+			if (collidesWith[first] < 0) {
+				collidesWith[first] = (int)i;
+			}
+		}
+	}
+
+	auto convertNextFiles = [&]() {
+		for (uint i = nextFile++; i < fileCount; i = nextFile++)
+		{
+			// Unreadable files aren't cached, and the importer reports the error
+			hasKey[i] = useCache && getBuildCacheKey(&keys[i], fileNames[i], settings);
+			FileResult result;
+			if (collidesWith[i] >= 0) {
+				logs[i] << "Error: " << fileNames[i] << " and " << fileNames[collidesWith[i]]
+					<< " would both write " << getOutputFileStem(fileNames[i]) << ".gob*, so neither is converted. Rename one of them.\n";
+				result = file_failed;
+			}
+			else if (hasKey[i] && isBuildUpToDate(cache, fileNames[i], keys[i])) {
+				result = file_upToDate;
+			}
+			else if (dryRun) {
+				logs[i] << "Would convert " << fileNames[i] << '\n';
+				result = file_outOfDate;
+			}
+			else {
+				bool success = convertFile(fileNames[i], options, logs[i], &outputFileNames[i], &inputFileNames[i]);
+				// An input that's gone already gets the file converted again next time
+				hasKey[i] = hasKey[i] && addBuildCacheInputs(&keys[i], inputFileNames[i]);
+				result = success ? file_converted : file_failed;
+			}
+
+			// Print every finished file up to the first one that's still converting
+			std::lock_guard<std::mutex> lock(printMutex);
+			results[i] = result;
+			finished[i] = 1;
+			while (nextPrintedFile < fileCount && finished[nextPrintedFile]) {
+				std::cout << logs[nextPrintedFile].str() << std::flush;
+				logs[nextPrintedFile].str(std::string());
+				nextPrintedFile++;
+			}
+		}
+	};
+
+	// The calling thread is one of the workers
+	jobCount = std::max(1u, std::min(jobCount, fileCount));
+	std::vector<std::thread> helpers;
+	for (uint i=1; i<jobCount; ++i) {
+		helpers.push_back(std::thread(convertNextFiles));
+	}
+	convertNextFiles();
+	for (uint i=0; i<helpers.size(); ++i) {
+		helpers[i].join();
+	}
+
+	uint failedCount = 0;
+	uint convertedCount = 0;
+	uint upToDateCount = 0;
+	uint outOfDateCount = 0;
+	for (uint i=0; i<fileCount; ++i)
+	{
+		switch (results[i]) {
+			case file_failed:
+				if (failedCount == 0) {
+					std::cout << "Failed to convert:\n";
+				}
+				std::cout << "  " << fileNames[i] << '\n';
+				failedCount++;
+				// Make sure it's tried again next time
+				cache.entries.erase(fileNames[i]);
+				break;
+			case file_converted:
+				convertedCount++;
+				if (hasKey[i]) {
+					BuildCacheEntry entry = {keys[i], inputFileNames[i], outputFileNames[i]};
+					cache.entries[fileNames[i]] = entry;
+				}
+				break;
+			case file_upToDate:
+				upToDateCount++;
+				break;
+			case file_outOfDate:
+				outOfDateCount++;
+				break;
+		}
+	}
+
+	if (dryRun) {
+		std::cout << outOfDateCount << " of " << fileCount << " files would be converted.\n";
+		return failedCount;
+	}
+	if (useCache && (convertedCount > 0 || failedCount > 0) && !writeBuildCache(cache, cacheFileName)) {
+		std::cout << "Warning: couldn't write the build cache " << cacheFileName << '\n';
+	}
+	if (fileCount > 1 || useCache) {
+		std::cout << "Converted " << convertedCount << " of " << fileCount << " files";
+		if (useCache) {
+			std::cout << ", " << upToDateCount << " were up to date";
+		}
+		std::cout << ".\n";
+	}
+	return failedCount;
+}
+
+// Reads file names from a manifest, one per line. Empty lines and lines starting with # are skipped.
+bool readManifest(std::vector<std::string>* inout_fileNames, const std::string& manifestFileName)
+{
+	std::ifstream manifest(manifestFileName);
+	if (!manifest.is_open()) {
+		std::cout << "Error: couldn't read manifest " << manifestFileName << '\n';
+		return false;
+	}
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		// Allow Windows line endings and trailing spaces
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+			line.pop_back();
+		}
+		if (!line.empty() && line[0] != '#') {
+			inout_fileNames->push_back(line);
+		}
+	}
+	return true;
+}
+
+// Adds every file under a directory that Assimp can import, sorted so runs are repeatable
+bool addDirectoryFiles(std::vector<std::string>* inout_fileNames, const std::string& directoryName)
+{
+	std::filesystem::path directory(directoryName);
+	if (!std::filesystem::is_directory(directory)) {
+		std::cout << "Error: " << directoryName << " is not a directory.\n";
+		return false;
+	}
+
+	Assimp::Importer importer;
+	std::vector<std::string> found;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory))
+	{
+		std::string extension = entry.path().extension().string();
+		// Skip the converter's own output
+		if (!entry.is_regular_file() || extension.empty() || extension.compare(0, 4, ".gob") == 0) {
+			continue;
+		}
+		if (importer.IsExtensionSupported(extension)) {
+			found.push_back(entry.path().generic_string());
+		}
+	}
+	std::sort(found.begin(), found.end());
+	inout_fileNames->insert(inout_fileNames->end(), found.begin(), found.end());
+	return true;
+}
+
+void printUsage()
+{
+	std::cout << "Usage: gobmesh_converter [options] files...\n"
+		"Options:\n"
+		"  -compress <max error>  Write compressed animations, keeping keys within max error of the original\n"
+		"  -reduce <tolerance>    Remove animation keys that interpolation rebuilds within tolerance, in model space units\n"
+		"  -no-optimize           Keep triangles and vertices in the order they were imported\n"
+		"  -lods <count>          Write this many levels of detail, counting the full mesh, each with about half\n"
+		"                         the triangles of the one before. The default is 1.\n"
+		"  -bvh                   Store a bounding volume hierarchy for raycasts, so it needn't be built when loading\n"
+		"  -j <jobs>              Convert this many files at once. 0 uses every core. The default is 1.\n"
+		"  -list <manifest>       Also convert the files listed in manifest, one per line\n"
+		"  -dir <directory>       Also convert every importable file in directory and its subdirectories\n"
+		"  -cache <cache file>    Skip files that haven't changed since they were converted with the same options,\n"
+		"                         keeping track of them in cache file\n"
+		"  -dry-run               Only list the files that would be converted\n";
 }
 
 int main(int argCount, const char* args[])
 {
+	ConvertOptions options = {};
+	std::vector<std::string> fileNames;
+	uint jobCount = 1;
+	std::string cacheFileName;
+	bool dryRun = false;
+
 	for (int i=1; i<argCount; ++i)
 	{
-		convertFile(args[i]);
+		std::string arg = args[i];
+		if (arg == "-compress" && i+1 < argCount) {
+			options.compressAnimations = true;
+			options.animationMaxError = (float)atof(args[++i]);
+		}
+		else if (arg == "-reduce" && i+1 < argCount) {
+			options.keyReductionTolerance = (float)atof(args[++i]);
+		}
+		else if (arg == "-no-optimize") {
+			options.skipMeshOptimization = true;
+		}
+		else if (arg == "-lods" && i+1 < argCount) {
+			options.lodCount = (uint)atoi(args[++i]);
+		}
+		else if (arg == "-bvh") {
+			options.buildBVH = true;
+		}
+		else if (arg == "-j" && i+1 < argCount) {
+			jobCount = (uint)atoi(args[++i]);
+			if (jobCount == 0) {
+				jobCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+		}
+		else if (arg == "-list" && i+1 < argCount) {
+			if (!readManifest(&fileNames, args[++i])) {
+				return 1;
+			}
+		}
+		else if (arg == "-dir" && i+1 < argCount) {
+			if (!addDirectoryFiles(&fileNames, args[++i])) {
+				return 1;
+			}
+		}
+		else if (arg == "-cache" && i+1 < argCount) {
+			cacheFileName = args[++i];
+		}
+		else if (arg == "-dry-run" || arg == "--dry-run") {
+			dryRun = true;
+		}
+		else if (arg.size() > 1 && arg[0] == '-') {
+			printUsage();
+			return 1;
+		}
+		else {
+			fileNames.push_back(arg);
+		}
+	}
+
+	// A file given twice, like by both -dir and -list, is only converted once
+	std::vector<std::string> uniqueFileNames;
+	std::unordered_set<std::string> seenFileNames;
+	for (uint i=0; i<fileNames.size(); i++) {
+		if (seenFileNames.insert(std::filesystem::path(fileNames[i]).lexically_normal().generic_string()).second) {
+			uniqueFileNames.push_back(fileNames[i]);
+		}
 	}
 
-	return 0;
+	uint failedCount = convertFiles(uniqueFileNames, options, jobCount, cacheFileName, dryRun);
+	return (failedCount > 0) ? 1 : 0;
 }
\ No newline at end of file
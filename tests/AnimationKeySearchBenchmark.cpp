@@ -0,0 +1,101 @@
+/* Times finding animation keys with a linear scan, a binary search (findAnimationKeys()),
+and a hint from the frame before (findAnimationKeysFromHint()), then sampling a whole
+animation with and without a SkeletonAnimationCursor. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include <vector>
+
+using namespace goblin;
+
+// How keys were found before binary search, for comparison
+void findAnimationKeysLinear(unsigned int* out_firstKey, unsigned int* out_secondKey, float time, float* arrayOfTimes, unsigned int numberOfTimes)
+{
+	for (unsigned int i=1; i<numberOfTimes; i++) {
+		if (arrayOfTimes[i] > time) {
+			*out_firstKey = i-1;
+			*out_secondKey = i;
+			return;
+		}
+	}
+	*out_firstKey = *out_secondKey = numberOfTimes-1;
+}
+
+int main()
+{
+	const unsigned int keyCounts[] = {8, 64, 512, 4096};
+	const unsigned int queryCount = 10000;
+	printf("Key search, nanoseconds per search:\n");
+	printf("%8s %10s %10s %14s\n", "keys", "linear", "binary", "forward hint");
+	for (unsigned int keyCount : keyCounts)
+	{
+		SkeletonAnimation animation;
+		createTestSkeletonAnimation(&animation, 1, keyCount, 10);
+		float* times = animation.jointAnimations[0].rotateKeyTimes;
+
+		// Random times for the linear and binary searches, and times moving forward a frame at a time for the hint
+		std::vector<float> randomTimes(queryCount);
+		std::vector<float> forwardTimes(queryCount);
+		unsigned int random = 12345;
+		for (unsigned int i=0; i<queryCount; i++) {
+			random = random*1664525 + 1013904223;
+			randomTimes[i] = (random >> 8)*(10.0f/(1 << 24));
+			forwardTimes[i] = i*(10.0f/queryCount);
+		}
+
+		unsigned int checksum = 0;
+		double linearSeconds = timeRepeatedly([&]() {
+			for (unsigned int i=0; i<queryCount; i++) {
+				unsigned int first, second;
+				findAnimationKeysLinear(&first, &second, randomTimes[i], times, keyCount);
+				checksum += first;
+			}
+		});
+		double binarySeconds = timeRepeatedly([&]() {
+			for (unsigned int i=0; i<queryCount; i++) {
+				unsigned int first, second;
+				findAnimationKeys(&first, &second, randomTimes[i], times, keyCount);
+				checksum += first;
+			}
+		});
+		double hintSeconds = timeRepeatedly([&]() {
+			unsigned int hint = 1;
+			for (unsigned int i=0; i<queryCount; i++) {
+				unsigned int first, second;
+				findAnimationKeysFromHint(&first, &second, &hint, forwardTimes[i], times, keyCount);
+				checksum += first;
+			}
+		});
+		printf("%8u %10.1f %10.1f %14.1f\n", keyCount, linearSeconds/queryCount*1e9, binarySeconds/queryCount*1e9, hintSeconds/queryCount*1e9);
+		if (checksum == 0) {
+			printf("(unreachable, keeps the searches from being optimized away)\n");
+		}
+		destroySkeletonAnimation(&animation);
+	}
+
+	// Forward playback at 60 frames per second, the case the cursor is for
+	const unsigned int jointCount = 64;
+	const unsigned int frameCount = 600;
+	SkeletonAnimation animation;
+	createTestSkeletonAnimation(&animation, jointCount, 256, 10);
+	SkeletonAnimationCursor cursor;
+	createSkeletonAnimationCursor(&cursor, animation);
+	std::vector<Transform> pose(jointCount);
+	double searchingSeconds = timeRepeatedly([&]() {
+		for (unsigned int frame=0; frame<frameCount; frame++) {
+			sampleSkeletonAnimation(pose.data(), frame/60.0f, animation);
+		}
+	});
+	double cursorSeconds = timeRepeatedly([&]() {
+		for (unsigned int frame=0; frame<frameCount; frame++) {
+			sampleSkeletonAnimation(pose.data(), frame/60.0f, animation, &cursor);
+		}
+	});
+	printf("Sampling %u joints with 256 keys each, microseconds per pose: %.2f searching, %.2f with a cursor\n",
+		jointCount, searchingSeconds/frameCount*1e6, cursorSeconds/frameCount*1e6);
+	destroySkeletonAnimationCursor(&cursor);
+	destroySkeletonAnimation(&animation);
+	return 0;
+}
@@ -0,0 +1,170 @@
+/* Packs a directory with gobarchive_packer's packDirectory(), with and without compression,
+and checks every file loads back through a FileSystem with the same bytes.
+Also checks corrupt entries fail to load instead of reading past the archive: an uncompressed size
+that doesn't match the stored size, a name offset past the names, and a name whose terminator would be past the end. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include "gobarchive_packer/ArchivePacker.h"
+#include <filesystem>
+#include <fstream>
+#include <string.h>
+#include <vector>
+
+struct TestFile
+{
+	std::string name;
+	std::vector<char> bytes;
+};
+
+void writeTestFile(const std::filesystem::path& directory, const TestFile& testFile)
+{
+	std::filesystem::path path = directory / testFile.name;
+	std::filesystem::create_directories(path.parent_path());
+	std::ofstream file(path, std::ios::binary);
+	file.write(testFile.bytes.data(), testFile.bytes.size());
+}
+
+std::vector<char> readTestFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeBytes(const std::filesystem::path& path, const std::vector<char>& bytes)
+{
+	std::ofstream file(path, std::ios::binary|std::ios::trunc);
+	file.write(bytes.data(), bytes.size());
+}
+
+bool loadsSameBytes(platform::FileSystem& fs, const TestFile& testFile)
+{
+	platform::File file;
+	if (!platform::loadFile(&file, fs, testFile.name)) {
+		return false;
+	}
+	bool same = file.byteCount == testFile.bytes.size() && (file.byteCount == 0 || memcmp(file.bytes, testFile.bytes.data(), file.byteCount) == 0);
+	platform::releaseFile(&file);
+	return same;
+}
+
+// Where the entry for the name is in the archive's bytes
+size_t getEntryByteOffset(const std::filesystem::path& archivePath, const char* name)
+{
+	platform::Archive archive;
+	platform::openArchive(&archive, archivePath.string());
+	platform::Archive::Entry* entry = platform::findArchiveEntry(archive, name);
+	assert(entry);
+	size_t offset = (char*)entry - archive.file.bytes;
+	platform::closeArchive(&archive);
+	return offset;
+}
+
+// Whether the name loads from a copy of the archive with the bytes changed
+bool loadsFromCorruptCopy(const std::filesystem::path& corruptPath, const std::vector<char>& bytes, const char* name)
+{
+	writeBytes(corruptPath, bytes);
+	platform::Archive archive;
+	if (!platform::openArchive(&archive, corruptPath.string())) {
+		return false;
+	}
+	platform::File file;
+	bool loaded = platform::loadArchiveFile(&file, archive, name);
+	if (loaded) {
+		platform::releaseFile(&file);
+	}
+	platform::closeArchive(&archive);
+	return loaded;
+}
+
+int main()
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "goblin_archive_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::path sourceDirectory = directory / "source";
+	std::filesystem::create_directories(sourceDirectory);
+
+	// Something too short to compress, something that compresses well, nothing at all, and noise that doesn't compress
+	std::vector<TestFile> testFiles(4);
+	testFiles[0].name = "small.txt";
+	const char text[] = "A few bytes";
+	testFiles[0].bytes.assign(text, text + sizeof(text)-1);
+	testFiles[1].name = "textures/repeated.bin";
+	for (unsigned int i=0; i<65536; i++) {
+		testFiles[1].bytes.push_back((char)((i/7) % 13));
+	}
+	testFiles[2].name = "empty";
+	testFiles[3].name = "models/noise.bin";
+	unsigned int seed = 3;
+	for (unsigned int i=0; i<10000; i++) {
+		seed = seed*1664525 + 1013904223;
+		testFiles[3].bytes.push_back((char)(seed >> 24));
+	}
+	for (const TestFile& testFile : testFiles) {
+		writeTestFile(sourceDirectory, testFile);
+	}
+
+	for (int compress=0; compress<2; compress++)
+	{
+		PackOptions options = {};
+		options.compress = (compress == 1);
+		options.minCompressionRatio = 0.9f;
+		std::filesystem::path archivePath = directory / (compress ? "compressed.gobarchive" : "uncompressed.gobarchive");
+		TEST_CHECK(packDirectory(sourceDirectory.string(), archivePath.string(), options));
+
+		platform::FileSystem fs = {};
+		platform::addFileLocation(&fs, archivePath.string());
+		TEST_CHECK(fs.archives.size() == 1);
+		if (fs.archives.size() != 1) {
+			continue;
+		}
+		for (const TestFile& testFile : testFiles) {
+			TEST_CHECK(loadsSameBytes(fs, testFile));
+		}
+		platform::File missing;
+		TEST_CHECK(!platform::loadFile(&missing, fs, "missing.txt"));
+		// Only the file that shrinks is compressed, and only when asked
+		platform::Archive& archive = fs.archives[0];
+		TEST_CHECK(((platform::findArchiveEntry(archive, "textures/repeated.bin")->flags & platform::Archive::entry_compressed) != 0) == options.compress);
+		TEST_CHECK(!(platform::findArchiveEntry(archive, "models/noise.bin")->flags & platform::Archive::entry_compressed));
+		TEST_CHECK(!(platform::findArchiveEntry(archive, "small.txt")->flags & platform::Archive::entry_compressed));
+		platform::destroyFileSystem(&fs);
+	}
+
+	// Corrupt copies of the uncompressed archive, each starting from the good bytes
+	std::filesystem::path archivePath = directory / "uncompressed.gobarchive";
+	std::filesystem::path corruptPath = directory / "corrupt.gobarchive";
+	std::vector<char> goodBytes = readTestFile(archivePath);
+	TEST_CHECK(loadsFromCorruptCopy(corruptPath, goodBytes, "small.txt"));
+
+	size_t entryOffset = getEntryByteOffset(archivePath, "small.txt");
+	std::vector<char> bytes = goodBytes;
+	platform::Archive::Entry* entry = (platform::Archive::Entry*)(bytes.data() + entryOffset);
+	entry->byteCount = entry->storedByteCount + (unsigned int)goodBytes.size();
+	TEST_CHECK(!loadsFromCorruptCopy(corruptPath, bytes, "small.txt"));
+
+	bytes = goodBytes;
+	entry = (platform::Archive::Entry*)(bytes.data() + entryOffset);
+	entry->nameOffset = 0xFFFFFF00;
+	TEST_CHECK(!loadsFromCorruptCopy(corruptPath, bytes, "small.txt"));
+
+	/* Cut off right after the name, so its terminator would be past the end of the file,
+	with the entry made an empty file at the end */
+	bytes = goodBytes;
+	entry = (platform::Archive::Entry*)(bytes.data() + entryOffset);
+	platform::Archive::Header* header = (platform::Archive::Header*)bytes.data();
+	size_t nameEnd = sizeof(platform::Archive::Header) + header->slotCount*sizeof(platform::Archive::Entry) + entry->nameOffset + strlen("small.txt");
+	entry->offset = nameEnd;
+	entry->storedByteCount = entry->byteCount = 0;
+	bytes.resize(nameEnd);
+	TEST_CHECK(!loadsFromCorruptCopy(corruptPath, bytes, "small.txt"));
+	// The same with the terminator is fine
+	bytes.push_back(0);
+	entry = (platform::Archive::Entry*)(bytes.data() + entryOffset);
+	entry->offset = bytes.size();
+	TEST_CHECK(loadsFromCorruptCopy(corruptPath, bytes, "small.txt"));
+
+	std::filesystem::remove_all(directory);
+	return finishTests("ArchiveTest");
+}
@@ -0,0 +1,179 @@
+/* Checks the array kernels in Algebra.h against the single versions they're named after,
+for counts that leave every number of elements past the last full set of lanes,
+and with the outputs in the same arrays as the inputs.
+Build it with -mavx, without, and with -DGOBLIN_DISABLE_SIMD to cover each version. */
+
+#include "TestUtilities.h"
+#include <assert.h>
+#include "Algebra.h"
+#include <vector>
+
+using namespace goblin;
+
+static unsigned int randomState = 12345;
+
+float randomFloat(float low, float high)
+{
+	randomState = randomState*1664525 + 1013904223;
+	return low + (high-low)*((randomState >> 8)*(1.0f/(1 << 24)));
+}
+
+Vec3 randomVec3(float low, float high)
+{
+	Vec3 v = {randomFloat(low, high), randomFloat(low, high), randomFloat(low, high)};
+	return v;
+}
+
+Transform randomTransform()
+{
+	Transform t;
+	t.position = randomVec3(-10, 10);
+	t.rotation = axisAngleToQuaternion(normalize(randomVec3(-1, 1)), randomFloat(-pi, pi));
+	// Sometimes negated, since q and -q are the same rotation and nlerp has to handle both
+	if (randomFloat(0, 1) < 0.3f) {
+		t.rotation = t.rotation*-1;
+	}
+	t.scale = randomVec3(0.5f, 2);
+	return t;
+}
+
+Matrix4x4 randomMatrix()
+{
+	Matrix4x4 m;
+	for (unsigned int r=0; r<4; r++) {
+		for (unsigned int c=0; c<4; c++) {
+			m.c[r][c] = randomFloat(-2, 2);
+		}
+	}
+	return m;
+}
+
+// Relative to the size of the values, since positions and matrix products can be large
+float vec3Difference(Vec3 a, Vec3 b)
+{
+	return length(a - b)/max(1.0f, length(a));
+}
+
+// Compares the quaternions themselves, not just their rotations, since the kernels should pick the same sign
+float transformDifference(const Transform& a, const Transform& b)
+{
+	Quaternion rotation = a.rotation + b.rotation*-1;
+	return max(max(vec3Difference(a.position, b.position), vec3Difference(a.scale, b.scale)), length(rotation));
+}
+
+float matrixDifference(const Matrix4x4& a, const Matrix4x4& b)
+{
+	float largest = 1;
+	float difference = 0;
+	for (unsigned int r=0; r<4; r++) {
+		for (unsigned int c=0; c<4; c++) {
+			largest = max(largest, fabsf(a.c[r][c]));
+			difference = max(difference, fabsf(a.c[r][c] - b.c[r][c]));
+		}
+	}
+	return difference/largest;
+}
+
+const float tolerance = 1e-5f;
+
+void checkTransformKernels(unsigned int count)
+{
+	std::vector<Transform> a(count), b(count);
+	for (unsigned int i=0; i<count; i++) {
+		a[i] = randomTransform();
+		b[i] = randomTransform();
+	}
+	const float t = 0.3f;
+	std::vector<Transform> out(count);
+	float worst = 0;
+
+	concatenateTransformsN(out.data(), a.data(), b.data(), count);
+	for (unsigned int i=0; i<count; i++) {
+		worst = max(worst, transformDifference(out[i], concatenateTransforms(a[i], b[i])));
+	}
+	TEST_CHECK(worst < tolerance);
+
+	worst = 0;
+	lerpTransformsN(out.data(), a.data(), b.data(), t, count);
+	for (unsigned int i=0; i<count; i++) {
+		worst = max(worst, transformDifference(out[i], lerp(a[i], b[i], t)));
+	}
+	TEST_CHECK(worst < tolerance);
+
+	worst = 0;
+	std::vector<Matrix4x4> matrices(count);
+	transformsToMatrices4x4N(matrices.data(), a.data(), count);
+	for (unsigned int i=0; i<count; i++) {
+		worst = max(worst, matrixDifference(matrices[i], transformToMatrix4x4(a[i])));
+	}
+	TEST_CHECK(worst < tolerance);
+
+	// Outputs in the same array as the first input, then the second
+	std::vector<Transform> aliased;
+	for (unsigned int input=0; input<2; input++)
+	{
+		worst = 0;
+		aliased = (input == 0) ? a : b;
+		Transform* parents = (input == 0) ? aliased.data() : a.data();
+		Transform* children = (input == 0) ? b.data() : aliased.data();
+		concatenateTransformsN(aliased.data(), parents, children, count);
+		for (unsigned int i=0; i<count; i++) {
+			worst = max(worst, transformDifference(aliased[i], concatenateTransforms(a[i], b[i])));
+		}
+		TEST_CHECK(worst < tolerance);
+
+		worst = 0;
+		aliased = (input == 0) ? a : b;
+		Transform* lerpA = (input == 0) ? aliased.data() : a.data();
+		Transform* lerpB = (input == 0) ? b.data() : aliased.data();
+		lerpTransformsN(aliased.data(), lerpA, lerpB, t, count);
+		for (unsigned int i=0; i<count; i++) {
+			worst = max(worst, transformDifference(aliased[i], lerp(a[i], b[i], t)));
+		}
+		TEST_CHECK(worst < tolerance);
+	}
+}
+
+void checkMatrixKernels(unsigned int count)
+{
+	std::vector<Matrix4x4> a(count), b(count);
+	for (unsigned int i=0; i<count; i++) {
+		a[i] = randomMatrix();
+		b[i] = randomMatrix();
+	}
+	std::vector<Matrix4x4> out(count);
+	float worst = 0;
+	mat4MulN(out.data(), a.data(), b.data(), count);
+	for (unsigned int i=0; i<count; i++) {
+		worst = max(worst, matrixDifference(out[i], a[i]*b[i]));
+	}
+	TEST_CHECK(worst < tolerance);
+
+	// out_matrices can be the same array as a
+	worst = 0;
+	std::vector<Matrix4x4> aliased = a;
+	mat4MulN(aliased.data(), aliased.data(), b.data(), count);
+	for (unsigned int i=0; i<count; i++) {
+		worst = max(worst, matrixDifference(aliased[i], a[i]*b[i]));
+	}
+	TEST_CHECK(worst < tolerance);
+}
+
+int main()
+{
+	#if defined(GOBLIN_SIMD_AVX)
+		printf("Checking the AVX kernels\n");
+	#elif defined(GOBLIN_SIMD_SSE)
+		printf("Checking the SSE kernels\n");
+	#else
+		printf("Checking the plain float kernels\n");
+	#endif
+	// Every remainder for both 4 and 8 lanes, and a few full sets
+	for (unsigned int count=0; count<=17; count++) {
+		checkTransformKernels(count);
+		checkMatrixKernels(count);
+	}
+	checkTransformKernels(1000);
+	checkMatrixKernels(1000);
+	return finishTests("ArrayKernelTest");
+}
@@ -0,0 +1,116 @@
+/* Times loading thousands of small files, in files per second: with loadFile() one after another on the calling thread,
+and with an AsyncFileLoader from 1 worker up to one per core (at least 4), counting from the first request to the last callback.
+Then times how long updateAsyncFileLoader() takes to hand files that already loaded to their callbacks,
+which should stay the same per file however many are waiting.
+The files are small ones written to a temporary directory first, and read once before timing so they're all in the OS's cache. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include <filesystem>
+#include <vector>
+
+static unsigned int callbackCount = 0;
+static unsigned int failedCount = 0;
+
+void countLoadedFile(void* userData, platform::AsyncFileHandle handle, platform::File* file, bool success)
+{
+	callbackCount++;
+	if (!success) {
+		failedCount++;
+	}
+	platform::releaseFile(file);
+}
+
+// Requests every file, then updates until every callback was called
+void loadFilesAsync(platform::AsyncFileLoader* loader, const std::vector<std::string>& fileNames)
+{
+	callbackCount = 0;
+	failedCount = 0;
+	for (const std::string& fileName : fileNames) {
+		platform::loadFileAsync(loader, fileName, countLoadedFile, 0);
+	}
+	while (callbackCount < fileNames.size()) {
+		if (platform::updateAsyncFileLoader(loader, 1) == 0) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+int main()
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "goblin_async_file_loader_benchmark";
+	std::filesystem::create_directories(directory);
+	const unsigned int maxFileCount = 16000;
+	std::vector<std::string> fileNames;
+	for (unsigned int i=0; i<maxFileCount; i++) {
+		fileNames.push_back("asset" + std::to_string(i));
+		std::ofstream file(directory / fileNames.back(), std::ios::binary);
+		file << "asset " << i;
+	}
+	platform::FileSystem fs = {};
+	platform::addFileLocation(&fs, directory.string());
+
+	// Loading on the calling thread
+	bool allLoaded = true;
+	double syncSeconds = timeRepeatedly([&]() {
+		for (const std::string& fileName : fileNames) {
+			platform::File file;
+			allLoaded &= platform::loadFile(&file, fs, fileName);
+			platform::releaseFile(&file);
+		}
+	});
+	TEST_CHECK(allLoaded);
+	printf("Loading %u small files, files per second:\n", maxFileCount);
+	printf("%8s %14s %10s\n", "workers", "files/s", "speedup");
+	printf("%8s %14.0f %10.2f\n", "loadFile", maxFileCount/syncSeconds, 1.0);
+
+	unsigned int maxWorkerCount = platform::getProcessorCount();
+	if (maxWorkerCount < 4) {
+		maxWorkerCount = 4;
+	}
+	for (unsigned int workerCount=1; workerCount<=maxWorkerCount; workerCount++)
+	{
+		platform::AsyncFileLoader loader;
+		platform::createAsyncFileLoader(&loader, fs, workerCount);
+		double asyncSeconds = timeRepeatedly([&]() {
+			loadFilesAsync(&loader, fileNames);
+		});
+		TEST_CHECK(failedCount == 0);
+		printf("%8u %14.0f %10.2f\n", workerCount, maxFileCount/asyncSeconds, syncSeconds/asyncSeconds);
+		platform::destroyAsyncFileLoader(&loader);
+	}
+
+	const unsigned int fileCounts[] = {1000, 4000, 16000};
+	printf("Handing every loaded file to its callback in one update:\n");
+	printf("%8s %14s %18s\n", "files", "update ms", "microseconds/file");
+	for (unsigned int fileCount : fileCounts)
+	{
+		platform::AsyncFileLoader loader;
+		platform::createAsyncFileLoader(&loader, fs);
+		std::vector<platform::AsyncFileHandle> handles(fileCount);
+		for (unsigned int i=0; i<fileCount; i++) {
+			handles[i] = platform::loadFileAsync(&loader, fileNames[i], countLoadedFile, 0);
+		}
+		// Wait for every file to load, so the update only measures the callbacks
+		for (unsigned int i=0; i<fileCount; i++) {
+			while (platform::getAsyncFileStatus(&loader, handles[i]) != platform::AsyncFileStatus_loaded) {
+				std::this_thread::yield();
+			}
+		}
+
+		callbackCount = 0;
+		failedCount = 0;
+		double start = getTestSeconds();
+		platform::updateAsyncFileLoader(&loader, 1000);
+		double seconds = getTestSeconds() - start;
+		TEST_CHECK(callbackCount == fileCount);
+		TEST_CHECK(failedCount == 0);
+		printf("%8u %14.2f %18.3f\n", fileCount, seconds*1e3, seconds/fileCount*1e6);
+		platform::destroyAsyncFileLoader(&loader);
+	}
+
+	platform::destroyFileSystem(&fs);
+	std::filesystem::remove_all(directory);
+	return finishTests("AsyncFileLoaderBenchmark");
+}
@@ -0,0 +1,76 @@
+/* Times sampling a BakedSkeletonAnimation against the SkeletonAnimation it was baked from,
+with and without cursors, and checks every way gives bit-identical poses while it's at it. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include <string.h>
+#include <vector>
+
+using namespace goblin;
+
+int main()
+{
+	const unsigned int jointCounts[] = {16, 64, 256};
+	const unsigned int frameCount = 600;
+	printf("Sampling at 60 frames per second, microseconds per pose:\n");
+	printf("%8s %10s %10s %10s %14s\n", "joints", "keys", "cursor", "baked", "baked cursor");
+	for (unsigned int jointCount : jointCounts)
+	{
+		SkeletonAnimation animation;
+		createTestSkeletonAnimation(&animation, jointCount, 128, 10);
+		SkeletonAnimationCursor cursor;
+		createSkeletonAnimationCursor(&cursor, animation);
+		BakedSkeletonAnimation baked;
+		createBakedSkeletonAnimation(&baked, animation);
+		SkeletonAnimationCursor bakedCursor;
+		createSkeletonAnimationCursor(&bakedCursor, baked);
+
+		std::vector<Transform> pose(jointCount);
+		std::vector<Transform> bakedPose(jointCount);
+		std::vector<Transform> bakedCursorPose(jointCount);
+		bool identical = true;
+		for (unsigned int frame=0; frame<frameCount; frame++) {
+			sampleSkeletonAnimation(pose.data(), frame/60.0f, animation);
+			sampleBakedSkeletonAnimation(bakedPose.data(), frame/60.0f, baked);
+			sampleBakedSkeletonAnimation(bakedCursorPose.data(), frame/60.0f, baked, &bakedCursor);
+			identical &= memcmp(pose.data(), bakedPose.data(), jointCount*sizeof(Transform)) == 0;
+			identical &= memcmp(pose.data(), bakedCursorPose.data(), jointCount*sizeof(Transform)) == 0;
+		}
+		// Jumping back to the start with a cursor
+		sampleSkeletonAnimation(pose.data(), 0.5f, animation);
+		sampleBakedSkeletonAnimation(bakedCursorPose.data(), 0.5f, baked, &bakedCursor);
+		identical &= memcmp(pose.data(), bakedCursorPose.data(), jointCount*sizeof(Transform)) == 0;
+		TEST_CHECK(identical);
+
+		double keySeconds = timeRepeatedly([&]() {
+			for (unsigned int frame=0; frame<frameCount; frame++) {
+				sampleSkeletonAnimation(pose.data(), frame/60.0f, animation);
+			}
+		});
+		double cursorSeconds = timeRepeatedly([&]() {
+			for (unsigned int frame=0; frame<frameCount; frame++) {
+				sampleSkeletonAnimation(pose.data(), frame/60.0f, animation, &cursor);
+			}
+		});
+		double bakedSeconds = timeRepeatedly([&]() {
+			for (unsigned int frame=0; frame<frameCount; frame++) {
+				sampleBakedSkeletonAnimation(bakedPose.data(), frame/60.0f, baked);
+			}
+		});
+		double bakedCursorSeconds = timeRepeatedly([&]() {
+			for (unsigned int frame=0; frame<frameCount; frame++) {
+				sampleBakedSkeletonAnimation(bakedPose.data(), frame/60.0f, baked, &bakedCursor);
+			}
+		});
+		printf("%8u %10.2f %10.2f %10.2f %14.2f\n", jointCount, keySeconds/frameCount*1e6, cursorSeconds/frameCount*1e6,
+			bakedSeconds/frameCount*1e6, bakedCursorSeconds/frameCount*1e6);
+
+		destroySkeletonAnimationCursor(&bakedCursor);
+		destroyBakedSkeletonAnimation(&baked);
+		destroySkeletonAnimationCursor(&cursor);
+		destroySkeletonAnimation(&animation);
+	}
+	return finishTests("BakedAnimationBenchmark");
+}
@@ -0,0 +1,183 @@
+/* Checks blend tree weights: 1D blend spaces between the samples on either side, and 2D blend spaces
+that add up to one and change smoothly as the point moves, without jumping where samples swap places in distance.
+Also checks inputs with no weight aren't sampled, that a tree needs fewer pose buffers than clips,
+and that evaluating it again with the same scratch arena gives the same pose as blending its branches by hand. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include "AnimationBlendTree.h"
+#include <string.h>
+#include <vector>
+
+using namespace goblin;
+
+// The parameters the test trees read
+enum {
+	clipTimeParameter,
+	blendSpace2DXParameter,
+	blendSpace2DYParameter,
+	blendSpace1DParameter,
+	lerpParameter,
+	parameterCount
+};
+
+BlendTreeNode makeClipNode(SkeletonAnimation* animation)
+{
+	BlendTreeNode node = {};
+	node.type = BlendTreeNode_clip;
+	node.animation = animation;
+	node.parameter = clipTimeParameter;
+	return node;
+}
+
+// The weights of a tree's root
+void getRootWeights(float* out_weights, const BlendTree& tree, float x, float y)
+{
+	float parameters[parameterCount] = {};
+	parameters[blendSpace1DParameter] = x;
+	parameters[blendSpace2DXParameter] = x;
+	parameters[blendSpace2DYParameter] = y;
+	computeBlendTreeInputWeights(out_weights, tree.instructions[tree.instructionCount-1], parameters);
+}
+
+bool isSamePose(const Transform* a, const Transform* b, unsigned int jointCount)
+{
+	return memcmp(a, b, sizeof(Transform)*jointCount) == 0;
+}
+
+int main()
+{
+	const unsigned int jointCount = 16;
+	SkeletonAnimation animations[7];
+	for (unsigned int i=0; i<7; i++) {
+		createTestSkeletonAnimation(&animations[i], jointCount, 10, 2, (float)i);
+	}
+
+	/* Node 0 lerps from a 2D blend space (node 1) over clips 3 to 6 on the unit square's corners,
+	to a 1D blend space (node 2) over clips 7 to 9 at 0, 1 and 3 */
+	BlendTreeNode nodes[10] = {};
+	nodes[0].type = BlendTreeNode_lerp;
+	nodes[0].inputs[0] = 1;
+	nodes[0].inputs[1] = 2;
+	nodes[0].inputCount = 2;
+	nodes[0].parameter = lerpParameter;
+	nodes[1].type = BlendTreeNode_blendSpace2D;
+	nodes[1].inputCount = 4;
+	nodes[1].parameter = blendSpace2DXParameter;
+	nodes[1].parameterY = blendSpace2DYParameter;
+	const float corners[4][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}};
+	for (unsigned int i=0; i<4; i++) {
+		nodes[1].inputs[i] = 3+i;
+		nodes[1].samplePositions[i][0] = corners[i][0];
+		nodes[1].samplePositions[i][1] = corners[i][1];
+		nodes[3+i] = makeClipNode(&animations[i]);
+	}
+	nodes[2].type = BlendTreeNode_blendSpace1D;
+	nodes[2].inputCount = 3;
+	nodes[2].parameter = blendSpace1DParameter;
+	const float linePositions[3] = {0, 1, 3};
+	for (unsigned int i=0; i<3; i++) {
+		nodes[2].inputs[i] = 7+i;
+		nodes[2].samplePositions[i][0] = linePositions[i];
+		nodes[7+i] = makeClipNode(&animations[4+i]);
+	}
+	BlendTree tree, blendSpace2D, blendSpace1D;
+	createBlendTree(&tree, nodes, 10, 0, jointCount);
+	createBlendTree(&blendSpace2D, nodes, 10, 1, jointCount);
+	createBlendTree(&blendSpace1D, nodes, 10, 2, jointCount);
+
+	// 1D: the ends past the first and last samples, and between the two samples on either side
+	float weights[maxBlendTreeNodeInputs];
+	getRootWeights(weights, blendSpace1D, -1, 0);
+	TEST_CHECK(weights[0] == 1 && weights[1] == 0 && weights[2] == 0);
+	getRootWeights(weights, blendSpace1D, 2, 0);
+	TEST_CHECK(weights[0] == 0 && weights[1] == 0.5f && weights[2] == 0.5f);
+	getRootWeights(weights, blendSpace1D, 5, 0);
+	TEST_CHECK(weights[0] == 0 && weights[1] == 0 && weights[2] == 1);
+
+	// 2D: only the sample the point is on, and none for the far corner from a point past another
+	getRootWeights(weights, blendSpace2D, 1, 0);
+	TEST_CHECK(weights[0] == 0 && weights[1] == 1 && weights[2] == 0 && weights[3] == 0);
+	getRootWeights(weights, blendSpace2D, -0.3f, -0.2f);
+	TEST_CHECK(weights[0] > 0.5f && weights[3] == 0);
+	// Across the line where the third and fourth closest corners swap
+	float below[maxBlendTreeNodeInputs], above[maxBlendTreeNodeInputs];
+	getRootWeights(below, blendSpace2D, 0.3f, 0.4999f);
+	getRootWeights(above, blendSpace2D, 0.3f, 0.5001f);
+	for (unsigned int i=0; i<4; i++) {
+		TEST_CHECK(fabsf(below[i] - above[i]) < 0.001f);
+	}
+	// Small steps over the square and around it never move much weight, and the weights always add up to one
+	const float step = 0.01f;
+	float largestChange = 0;
+	float largestSumError = 0;
+	bool nonNegative = true;
+	for (float y=-0.5f; y<=1.5f; y+=step) {
+		getRootWeights(below, blendSpace2D, -0.5f, y);
+		for (float x=-0.5f+step; x<=1.5f; x+=step)
+		{
+			getRootWeights(above, blendSpace2D, x, y);
+			float sum = 0;
+			for (unsigned int i=0; i<4; i++) {
+				largestChange = max(largestChange, fabsf(above[i] - below[i]));
+				nonNegative &= (above[i] >= 0);
+				sum += above[i];
+				below[i] = above[i];
+			}
+			largestSumError = max(largestSumError, fabsf(sum - 1));
+		}
+	}
+	TEST_CHECK(largestChange < 0.05f);
+	TEST_CHECK(largestSumError < 1e-5f);
+	TEST_CHECK(nonNegative);
+
+	// Seven clips, but a buffer for each of the 2D blend space's inputs is the most that's needed at once
+	TEST_CHECK(tree.bufferCount == 4);
+
+	FrameArena scratch;
+	createFrameArena(&scratch, 64*1024);
+	float parameters[parameterCount] = {};
+	parameters[clipTimeParameter] = 0.7f;
+	std::vector<Transform> pose(jointCount), again(jointCount), expected(jointCount);
+	std::vector<Transform> pose2D(jointCount), pose1D(jointCount);
+
+	// Inputs with no weight aren't sampled, nor is anything under them
+	parameters[lerpParameter] = 0;
+	parameters[blendSpace2DXParameter] = 0;
+	parameters[blendSpace2DYParameter] = 1;
+	TEST_CHECK(evaluateBlendTree(pose.data(), tree, parameters, &scratch) == 1);
+	sampleSkeletonAnimation(expected.data(), 0.7f, animations[2]);
+	TEST_CHECK(isSamePose(pose.data(), expected.data(), jointCount));
+	parameters[lerpParameter] = 1;
+	parameters[blendSpace1DParameter] = 2;
+	TEST_CHECK(evaluateBlendTree(pose.data(), tree, parameters, &scratch) == 2);
+	TEST_CHECK(scratch.usedByteCount == 0);
+
+	// Every clip's buffer in use, then the same parameters again after different ones
+	parameters[lerpParameter] = 0.4f;
+	parameters[blendSpace2DXParameter] = 0.6f;
+	parameters[blendSpace2DYParameter] = 0.5f;
+	parameters[blendSpace1DParameter] = 0.25f;
+	TEST_CHECK(evaluateBlendTree(pose.data(), tree, parameters, &scratch) == 6);
+	evaluateBlendTree(pose2D.data(), blendSpace2D, parameters, &scratch);
+	evaluateBlendTree(pose1D.data(), blendSpace1D, parameters, &scratch);
+	lerpBlendSkeletonPoses(expected.data(), pose2D.data(), pose1D.data(), jointCount, 0.4f);
+	TEST_CHECK(isSamePose(pose.data(), expected.data(), jointCount));
+	float otherParameters[parameterCount] = {1.3f, 0.9f, 0.1f, 2.5f, 0.8f};
+	evaluateBlendTree(again.data(), tree, otherParameters, &scratch);
+	TEST_CHECK(!isSamePose(again.data(), pose.data(), jointCount));
+	evaluateBlendTree(again.data(), tree, parameters, &scratch);
+	TEST_CHECK(isSamePose(again.data(), pose.data(), jointCount));
+	TEST_CHECK(scratch.usedByteCount == 0);
+
+	destroyFrameArena(&scratch);
+	destroyBlendTree(&tree);
+	destroyBlendTree(&blendSpace2D);
+	destroyBlendTree(&blendSpace1D);
+	for (unsigned int i=0; i<7; i++) {
+		destroySkeletonAnimation(&animations[i]);
+	}
+	return finishTests("BlendTreeTest");
+}
@@ -0,0 +1,148 @@
+/* Writes an animation with gobmesh_converter's outputGOBSKELANIMCompressed() and reads it back,
+checking every encoding is used and that sampling it anywhere in its duration is within the converter's maxError of sampling the original.
+Also checks that reading a compressed .gobskelanim fails cleanly on files that are cut short
+or claim more joints than they hold, instead of allocating for them. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include <assert.h>
+// Before SkeletonAnimation.h, since it has its own SkeletonAnimation outside the goblin namespace
+#include "gobmesh_converter/Gobmesh.h"
+#include "SkeletonAnimation.h"
+#include "TestSkeletons.h"
+#include <filesystem>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+bool readHeaderOnly(unsigned int jointCount, bool copyBytes)
+{
+	char bytes[12];
+	unsigned int magic = goblin::gobskelanimVersion2Magic;
+	float duration = 1;
+	memcpy(bytes, &magic, 4);
+	memcpy(bytes + 4, &duration, 4);
+	memcpy(bytes + 8, &jointCount, 4);
+	goblin::CompressedSkeletonAnimation animation;
+	bool read = goblin::createCompressedSkeletonAnimationFromGOBSKELANIM(&animation, bytes, sizeof(bytes), copyBytes);
+	if (read) {
+		goblin::destroyCompressedSkeletonAnimation(&animation);
+	}
+	return read;
+}
+
+// The converter's copy of a runtime animation's keys
+void convertTestSkeletonAnimation(::SkeletonAnimation* out_animation, const goblin::SkeletonAnimation& animation)
+{
+	::SkeletonAnimation converted;
+	converted.name = "test";
+	converted.duration = animation.duration;
+	converted.keysPerSecond = 30;
+	for (unsigned int i=0; i<animation.jointCount; i++)
+	{
+		const goblin::SkeletonAnimation::JointAnimation& joint = animation.jointAnimations[i];
+		JointAnimation convertedJoint;
+		convertedJoint.scaleKeyTimes.assign(joint.scaleKeyTimes, joint.scaleKeyTimes + joint.scaleKeyCount);
+		convertedJoint.scaleKeys.assign(joint.scaleKeyValues, joint.scaleKeyValues + joint.scaleKeyCount);
+		convertedJoint.roateKeyTimes.assign(joint.rotateKeyTimes, joint.rotateKeyTimes + joint.rotateKeyCount);
+		convertedJoint.rotationKeys.assign(joint.rotateKeyValues, joint.rotateKeyValues + joint.rotateKeyCount);
+		convertedJoint.translateKeyTimes.assign(joint.translateKeyTimes, joint.translateKeyTimes + joint.translateKeyCount);
+		convertedJoint.translationKeys.assign(joint.translateKeyValues, joint.translateKeyValues + joint.translateKeyCount);
+		converted.joints.push_back(convertedJoint);
+	}
+	*out_animation = converted;
+}
+
+float getMaxComponentDifference(goblin::Transform a, goblin::Transform b)
+{
+	// Same as the converter measures it, with q and -q the same rotation
+	return goblin::max(goblin::max(maxComponentDifference(a.scale, b.scale), maxComponentDifference(a.position, b.position)),
+		maxComponentDifference(a.rotation, b.rotation));
+}
+
+int main()
+{
+	TEST_CHECK(readHeaderOnly(0, false));
+	TEST_CHECK(!readHeaderOnly(1, false));
+	TEST_CHECK(!readHeaderOnly(1, true));
+	// Would have been hundreds of gigabytes of joint animations
+	TEST_CHECK(!readHeaderOnly(0xFFFFFFFF, false));
+	TEST_CHECK(!readHeaderOnly(0x7FFFFFFF, true));
+
+	const unsigned int jointCount = 12;
+	const float maxError = 0.001f;
+	goblin::SkeletonAnimation animation;
+	createTestSkeletonAnimation(&animation, jointCount, 40, 2, 0.5f);
+	/* The test animation's scale y never changes, so make some channels constant within maxError,
+	and one joint's translation too far apart to quantize within it */
+	for (unsigned int k=0; k<animation.jointAnimations[1].scaleKeyCount; k++) {
+		animation.jointAnimations[1].scaleKeyValues[k] = goblin::Vec3{1, 1 + 0.0004f*(k % 3), 1};
+		animation.jointAnimations[2].rotateKeyValues[k] = (k % 2) ? goblin::Quaternion::identity : goblin::Quaternion::identity*-1;
+		animation.jointAnimations[3].translateKeyValues[k].x = ((k % 2) ? 10000.0f : 0.0f) + k*0.37f;
+	}
+
+	::SkeletonAnimation converted;
+	convertTestSkeletonAnimation(&converted, animation);
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "goblin_compressed_animation_test.gobskelanim";
+	std::ostringstream log;
+	TEST_CHECK(outputGOBSKELANIMCompressed(path.string(), converted, maxError, log));
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	std::filesystem::remove(path);
+
+	goblin::CompressedSkeletonAnimation compressed;
+	TEST_CHECK(goblin::readCompressedSkeletonAnimation(&compressed, bytes.data(), bytes.size()));
+	TEST_CHECK(compressed.jointCount == jointCount);
+	TEST_CHECK(compressed.duration == animation.duration);
+	if (compressed.jointCount != jointCount) {
+		return finishTests("CompressedAnimationFileTest");
+	}
+	typedef goblin::CompressedSkeletonAnimation C;
+	TEST_CHECK(compressed.jointAnimations[1].scale.encoding == C::encoding_constant);
+	TEST_CHECK(compressed.jointAnimations[2].rotation.encoding == C::encoding_constant);
+	TEST_CHECK(compressed.jointAnimations[3].translation.encoding == C::encoding_raw);
+	TEST_CHECK(compressed.jointAnimations[0].scale.encoding == C::encoding_quantized);
+	TEST_CHECK(compressed.jointAnimations[0].rotation.encoding == C::encoding_quantized);
+	TEST_CHECK(compressed.jointAnimations[0].translation.encoding == C::encoding_quantized);
+
+	/* Between keys both sides interpolate keys that are each within maxError, so the samples are too,
+	give or take float rounding */
+	std::vector<goblin::Transform> expected(jointCount), sampled(jointCount);
+	float largestError = 0;
+	const unsigned int sampleCount = 1000;
+	for (unsigned int s=0; s<=sampleCount; s++)
+	{
+		float time = (float)s/sampleCount*animation.duration;
+		goblin::sampleSkeletonAnimation(expected.data(), time, animation);
+		goblin::sampleCompressedSkeletonAnimation(sampled.data(), time, compressed);
+		for (unsigned int i=0; i<jointCount; i++) {
+			largestError = goblin::max(largestError, getMaxComponentDifference(expected[i], sampled[i]));
+		}
+	}
+	TEST_CHECK(largestError <= maxError + 1e-5f);
+	// The quantized channels shouldn't be exact
+	TEST_CHECK(largestError > 0);
+
+	// Decoding gives the same keys as sampling
+	goblin::SkeletonAnimation decoded;
+	goblin::decodeCompressedSkeletonAnimation(&decoded, compressed);
+	TEST_CHECK(decoded.jointCount == jointCount);
+	bool decodedMatches = true;
+	for (unsigned int s=0; s<=sampleCount; s+=10)
+	{
+		float time = (float)s/sampleCount*animation.duration;
+		goblin::sampleSkeletonAnimation(expected.data(), time, decoded);
+		goblin::sampleCompressedSkeletonAnimation(sampled.data(), time, compressed);
+		for (unsigned int i=0; i<jointCount; i++) {
+			decodedMatches &= getMaxComponentDifference(expected[i], sampled[i]) <= 1e-5f;
+		}
+	}
+	TEST_CHECK(decodedMatches);
+
+	goblin::destroySkeletonAnimation(&decoded);
+	delete[] compressed.jointAnimations;
+	goblin::destroySkeletonAnimation(&animation);
+	return finishTests("CompressedAnimationFileTest");
+}
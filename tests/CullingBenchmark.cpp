@@ -0,0 +1,196 @@
+/* Times culling 100k objects every frame, for a camera turning around in a field of spheres and boxes
+behind a ring of walls: cullSpheres() and cullBoxes() against one isSphereInFrustum() or isBoxInFrustum() call per object,
+and drawing the walls into an OcclusionBuffer then cullOccludedBoxes() on what the frustum kept.
+Checks every frame keeps the same objects as the one at a time tests, and that no box behind the walls is visible. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include <assert.h>
+#include "Visibility.h"
+#include "TestCameras.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+using namespace goblin;
+
+struct CullingScene
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> radius;
+	std::vector<float> extentX, extentY, extentZ;
+	// The walls, as quads around the origin with gaps between them
+	std::vector<Vec3> occluderPositions;
+	std::vector<IndexedTriangle> occluderFaces;
+};
+
+// Spheres and boxes share centers, spread over a flat slab 200 wide, with sizes from 0.1 to 5
+void createCullingScene(CullingScene* out_scene, unsigned int objectCount, unsigned int wallCount)
+{
+	CullingScene scene;
+	unsigned int seed = 5;
+	auto random = [&seed](float low, float high) {
+		seed = seed*1664525 + 1013904223;
+		return low + (high - low)*(seed >> 8)*(1.0f/16777216);
+	};
+	for (unsigned int i=0; i<objectCount; i++) {
+		scene.centerX.push_back(random(-100, 100));
+		scene.centerY.push_back(random(-20, 20));
+		scene.centerZ.push_back(random(-100, 100));
+		scene.radius.push_back(random(0.1f, 5));
+		scene.extentX.push_back(random(0.1f, 5));
+		scene.extentY.push_back(random(0.1f, 5));
+		scene.extentZ.push_back(random(0.1f, 5));
+	}
+	const float wallDistance = 30;
+	for (unsigned int i=0; i<wallCount; i++)
+	{
+		// Each wall covers two thirds of its share of the circle
+		float startAngle = 2*pi*i/wallCount;
+		float endAngle = startAngle + 2*pi/wallCount*0.67f;
+		unsigned int first = (unsigned int)scene.occluderPositions.size();
+		scene.occluderPositions.push_back(Vec3{cosf(startAngle), 0, sinf(startAngle)}*wallDistance + Vec3{0, -20, 0});
+		scene.occluderPositions.push_back(Vec3{cosf(endAngle), 0, sinf(endAngle)}*wallDistance + Vec3{0, -20, 0});
+		scene.occluderPositions.push_back(Vec3{cosf(endAngle), 0, sinf(endAngle)}*wallDistance + Vec3{0, 8, 0});
+		scene.occluderPositions.push_back(Vec3{cosf(startAngle), 0, sinf(startAngle)}*wallDistance + Vec3{0, 8, 0});
+		IndexedTriangle a = {{first, first+1, first+2}};
+		IndexedTriangle b = {{first, first+2, first+3}};
+		scene.occluderFaces.push_back(a);
+		scene.occluderFaces.push_back(b);
+	}
+	*out_scene = scene;
+}
+
+bool isPointBehindOccluders(const OcclusionBuffer& buffer, Vec3 point)
+{
+	Vec4 clip = buffer.viewProjection*point;
+	float x = (clip.x/clip.w*0.5f + 0.5f)*buffer.levelWidths[0];
+	float y = (clip.y/clip.w*0.5f + 0.5f)*buffer.levelHeights[0];
+	// Off the screen can't be seen either
+	if (x < 0 || y < 0 || x >= buffer.levelWidths[0] || y >= buffer.levelHeights[0] || clip.z > clip.w) {
+		return true;
+	}
+	return buffer.levels[0][(unsigned int)y*buffer.levelWidths[0] + (unsigned int)x] < clip.z/clip.w;
+}
+
+// The box's corners, the middles of its faces and edges, and its center are all behind the drawn depths
+bool isBoxBehindOccluders(const OcclusionBuffer& buffer, Vec3 center, Vec3 extents)
+{
+	for (int x=-1; x<=1; x++) {
+		for (int y=-1; y<=1; y++) {
+			for (int z=-1; z<=1; z++) {
+				if (!isPointBehindOccluders(buffer, center + Vec3{x*extents.x, y*extents.y, z*extents.z})) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	const unsigned int objectCount = 100000;
+	const unsigned int frameCount = 200;
+	CullingScene scene;
+	createCullingScene(&scene, objectCount, 8);
+	// One past the start of each array, so cullSpheres() reads unaligned arrays
+	BoundingSphereArrays spheres = {scene.centerX.data()+1, scene.centerY.data()+1, scene.centerZ.data()+1, scene.radius.data()+1, objectCount-1};
+	BoundingBoxArrays boxes = {scene.centerX.data(), scene.centerY.data(), scene.centerZ.data(),
+		scene.extentX.data(), scene.extentY.data(), scene.extentZ.data(), objectCount};
+	OcclusionBuffer buffer;
+	createOcclusionBuffer(&buffer, 256, 144);
+	Matrix4x4 projection = makePerspectiveProjectionMatrix(1.0f, 16, 9, 0.1f, 150);
+
+	std::vector<unsigned int> visibleSpheres(objectCount), visibleBoxes(objectCount), unoccludedBoxes(objectCount);
+	std::vector<unsigned int> expected;
+	expected.reserve(objectCount);
+	double sphereSeconds = 0, scalarSphereSeconds = 0, boxSeconds = 0, scalarBoxSeconds = 0;
+	double occluderSeconds = 0, occlusionSeconds = 0;
+	unsigned long long visibleSphereCount = 0, visibleBoxCount = 0, unoccludedBoxCount = 0;
+	bool spheresMatch = true, boxesMatch = true, occlusionMatches = true, occlusionConservative = true;
+	for (unsigned int frame=0; frame<frameCount; frame++)
+	{
+		float angle = 2*pi*frame/frameCount;
+		Vec3 eye = {0, 2, 0};
+		Matrix4x4 viewProjection = projection*makeTestViewMatrix(eye, eye + Vec3{cosf(angle), 0.1f*sinf(3*angle), sinf(angle)});
+		Frustum frustum;
+		getFrustumPlanes(&frustum, viewProjection);
+
+		double start = getTestSeconds();
+		unsigned int sphereCount = cullSpheres(visibleSpheres.data(), spheres, frustum);
+		sphereSeconds += getTestSeconds() - start;
+		start = getTestSeconds();
+		expected.clear();
+		for (unsigned int i=0; i<spheres.count; i++) {
+			if (isSphereInFrustum(frustum, Vec3{spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]}, spheres.radius[i])) {
+				expected.push_back(i);
+			}
+		}
+		scalarSphereSeconds += getTestSeconds() - start;
+		spheresMatch &= (expected.size() == sphereCount) && std::equal(expected.begin(), expected.end(), visibleSpheres.begin());
+		visibleSphereCount += sphereCount;
+
+		start = getTestSeconds();
+		unsigned int boxCount = cullBoxes(visibleBoxes.data(), boxes, frustum);
+		boxSeconds += getTestSeconds() - start;
+		start = getTestSeconds();
+		expected.clear();
+		for (unsigned int i=0; i<boxes.count; i++) {
+			if (isBoxInFrustum(frustum, Vec3{boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]}, Vec3{boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]})) {
+				expected.push_back(i);
+			}
+		}
+		scalarBoxSeconds += getTestSeconds() - start;
+		boxesMatch &= (expected.size() == boxCount) && std::equal(expected.begin(), expected.end(), visibleBoxes.begin());
+		visibleBoxCount += boxCount;
+
+		start = getTestSeconds();
+		clearOcclusionBuffer(&buffer, viewProjection);
+		drawOccluder(&buffer, Matrix4x4::identity, scene.occluderPositions.data(), scene.occluderFaces.data(), (unsigned int)scene.occluderFaces.size());
+		updateOcclusionBufferLevels(&buffer);
+		occluderSeconds += getTestSeconds() - start;
+		std::copy(visibleBoxes.begin(), visibleBoxes.begin() + boxCount, unoccludedBoxes.begin());
+		start = getTestSeconds();
+		unsigned int unoccludedCount = cullOccludedBoxes(unoccludedBoxes.data(), boxCount, boxes, buffer);
+		occlusionSeconds += getTestSeconds() - start;
+		unoccludedBoxCount += unoccludedCount;
+
+		// Every box the frustum kept is either kept again, or wholly behind the walls
+		unsigned int kept = 0;
+		for (unsigned int i=0; i<boxCount; i++)
+		{
+			unsigned int index = visibleBoxes[i];
+			Vec3 center = {boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]};
+			Vec3 extents = {boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]};
+			bool occluded = isBoxOccluded(buffer, center, extents);
+			if (!occluded) {
+				occlusionMatches &= (kept < unoccludedCount && unoccludedBoxes[kept] == index);
+				kept++;
+			}
+			else {
+				occlusionConservative &= isBoxBehindOccluders(buffer, center, extents);
+			}
+		}
+		occlusionMatches &= (kept == unoccludedCount);
+	}
+	destroyOcclusionBuffer(&buffer);
+
+	printf("Culling %u objects, averaged over %u frames turning around, %u floats at a time:\n", objectCount, frameCount, floatLaneCount);
+	printf("%-26s %10s %10s %10s %10s\n", "", "ms/frame", "scalar ms", "speedup", "visible");
+	printf("%-26s %10.3f %10.3f %10.2f %10llu\n", "cullSpheres", sphereSeconds*1e3/frameCount, scalarSphereSeconds*1e3/frameCount,
+		scalarSphereSeconds/sphereSeconds, visibleSphereCount/frameCount);
+	printf("%-26s %10.3f %10.3f %10.2f %10llu\n", "cullBoxes", boxSeconds*1e3/frameCount, scalarBoxSeconds*1e3/frameCount,
+		scalarBoxSeconds/boxSeconds, visibleBoxCount/frameCount);
+	printf("%-26s %10.3f %10s %10s %10s\n", "drawing occluders", occluderSeconds*1e3/frameCount, "", "", "");
+	printf("%-26s %10.3f %10s %10s %10llu\n", "cullOccludedBoxes", occlusionSeconds*1e3/frameCount, "", "", unoccludedBoxCount/frameCount);
+	TEST_CHECK(spheresMatch);
+	TEST_CHECK(boxesMatch);
+	TEST_CHECK(occlusionMatches);
+	TEST_CHECK(occlusionConservative);
+	// The walls hide something, but not everything
+	TEST_CHECK(unoccludedBoxCount < visibleBoxCount);
+	TEST_CHECK(unoccludedBoxCount > 0);
+	return finishTests("CullingBenchmark");
+}
@@ -0,0 +1,87 @@
+/* Times jobs that wait for jobs of their own, three ways:
+a blocking join, where a waiting job holds its worker until its children finish,
+waitForJobCounter() without fibers, where the waiting worker runs other jobs on its own stack,
+and fiber mode, where the waiting job is put aside and its worker goes on to other jobs.
+Once every thread is holding a blocked job nothing runs the children, so the blocking join's
+pool gets an extra worker for every job that waits. That's what blocking joins cost in practice. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+
+using namespace platform;
+
+static ThreadPool pool;
+static bool blockingJoin = false;
+
+const uint parentCount = 64;
+const uint childrenPerParent = 16;
+
+int childJob(void* parameter)
+{
+	// Around ten microseconds of work
+	volatile float x = 0;
+	for (int i=0; i<10000; i++) {
+		x = x + 1;
+	}
+	return 0;
+}
+
+int parentJob(void* parameter)
+{
+	JobCounter counter = {};
+	for (uint i=0; i<childrenPerParent; i++) {
+		addThreadJob(&pool, childJob, 0, &counter);
+	}
+	if (blockingJoin) {
+		while (counter.unfinishedCount.load(std::memory_order_acquire) > 0) {
+			std::this_thread::yield();
+		}
+	}
+	else {
+		waitForJobCounter(&pool, &counter);
+	}
+	return 0;
+}
+
+double timeParents()
+{
+	return timeRepeatedly([]() {
+		JobCounter counter = {};
+		for (uint i=0; i<parentCount; i++) {
+			addThreadJob(&pool, parentJob, 0, &counter);
+		}
+		waitForJobCounter(&pool, &counter);
+	});
+}
+
+int main()
+{
+	printf("%u jobs that each wait for %u children, milliseconds:\n", parentCount, childrenPerParent);
+	printf("%8s %14s %14s %14s\n", "workers", "blocking join", "no fibers", "fibers");
+	fflush(stdout);
+	uint maxWorkerCount = getProcessorCount();
+	if (maxWorkerCount < 4) {
+		maxWorkerCount = 4;
+	}
+	for (uint workerCount=1; workerCount<=maxWorkerCount; workerCount++)
+	{
+		createThreadPool(&pool, workerCount + parentCount);
+		blockingJoin = true;
+		double blockingSeconds = timeParents();
+		blockingJoin = false;
+		destroyThreadPool(&pool);
+
+		createThreadPool(&pool, workerCount);
+		double helpingSeconds = timeParents();
+		destroyThreadPool(&pool);
+
+		createThreadPool(&pool, workerCount, parentCount);
+		double fiberSeconds = timeParents();
+		destroyThreadPool(&pool);
+
+		printf("%8u %14.2f %14.2f %14.2f\n", workerCount, blockingSeconds*1e3, helpingSeconds*1e3, fiberSeconds*1e3);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,228 @@
+/* Stresses the ThreadPool's fiber mode with waits nested many levels deep:
+a tree of jobs that each wait for their children, chains of jobs that each wait for the next one,
+and many jobs waiting on the same counter. Some pools have fewer fibers than waiting jobs,
+so workers also have to run jobs on their own stacks once every fiber is waiting.
+Run it under -fsanitize=address too. ThreadSanitizer doesn't follow swapcontext(), so it can't check fiber mode. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include <vector>
+
+using namespace platform;
+
+static ThreadPool pool;
+
+// A job for every call, which waits for its two children
+struct Fibonacci
+{
+	int n;
+	long result;
+};
+
+int fibonacciJob(void* parameter)
+{
+	Fibonacci* f = (Fibonacci*)parameter;
+	if (f->n < 2) {
+		f->result = f->n;
+		return 0;
+	}
+	Fibonacci a = {f->n-1, 0};
+	Fibonacci b = {f->n-2, 0};
+	JobCounter counter = {};
+	addThreadJob(&pool, fibonacciJob, &a, &counter);
+	addThreadJob(&pool, fibonacciJob, &b, &counter);
+	waitForJobCounter(&pool, &counter);
+	f->result = a.result + b.result;
+	return 0;
+}
+
+// Each link waits for the next one, so the whole chain is waiting at once
+struct ChainLink
+{
+	int depth;
+	int reached; // The depth of the last link, passed back up
+};
+
+int chainJob(void* parameter)
+{
+	ChainLink* link = (ChainLink*)parameter;
+	if (link->depth == 0) {
+		link->reached = 0;
+		return 0;
+	}
+	ChainLink next = {link->depth-1, -1};
+	JobCounter counter = {};
+	addThreadJob(&pool, chainJob, &next, &counter);
+	waitForJobCounter(&pool, &counter);
+	link->reached = next.reached;
+	return 0;
+}
+
+// Many jobs wait for one slow job, then all record that they got past the wait
+struct SharedWait
+{
+	JobCounter slowJobDone;
+	std::atomic<int> slowJobFinished;
+	std::atomic<int> waitersPastWait;
+	std::atomic<int> waitersTooEarly;
+};
+
+int slowJob(void* parameter)
+{
+	SharedWait* shared = (SharedWait*)parameter;
+	volatile float x = 0;
+	for (int i=0; i<200000; i++) {
+		x = x + 1;
+	}
+	shared->slowJobFinished = 1;
+	return 0;
+}
+
+int waiterJob(void* parameter)
+{
+	SharedWait* shared = (SharedWait*)parameter;
+	waitForJobCounter(&pool, &shared->slowJobDone);
+	if (shared->slowJobFinished.load() != 1) {
+		shared->waitersTooEarly++;
+	}
+	shared->waitersPastWait++;
+	return 0;
+}
+
+/* A job on a fiber that waits for a counter released from outside the pool, and a job on a worker's own stack,
+once every fiber is waiting, that waits for the first job */
+struct ParkedWait
+{
+	JobCounter released;
+	JobCounter parkedDone;
+	std::atomic<int> parkedStarted;
+	std::atomic<int> stackJobStarted;
+};
+
+int parkedJob(void* parameter)
+{
+	ParkedWait* wait = (ParkedWait*)parameter;
+	wait->parkedStarted = 1;
+	waitForJobCounter(&pool, &wait->released);
+	return 0;
+}
+
+int stackJob(void* parameter)
+{
+	ParkedWait* wait = (ParkedWait*)parameter;
+	wait->stackJobStarted = 1;
+	waitForJobCounter(&pool, &wait->parkedDone);
+	return 0;
+}
+
+size_t getWaitingFiberCount()
+{
+	lockMutex(&pool.fiberMutex);
+	size_t count = pool.waitingFibers.size();
+	unlockMutex(&pool.fiberMutex);
+	return count;
+}
+
+// Spins instead of helping, so the main thread doesn't run the jobs itself. Returns false if it took over 5 seconds.
+bool spinUntil(const std::atomic<int>& value, int expected)
+{
+	double start = getTestSeconds();
+	while (value.load() != expected) {
+		if (getTestSeconds() - start > 5) {
+			return false;
+		}
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+long runFibonacci(int n)
+{
+	Fibonacci f = {n, 0};
+	JobCounter counter = {};
+	addThreadJob(&pool, fibonacciJob, &f, &counter);
+	waitForJobCounter(&pool, &counter);
+	return f.result;
+}
+
+int main()
+{
+	const uint workerCounts[] = {1, 2, 4};
+	// Fewer fibers than waiting jobs, about as many, and plenty
+	const uint fiberCounts[] = {2, 16, 256};
+	for (uint workerCount : workerCounts) {
+		for (uint fiberCount : fiberCounts)
+		{
+			createThreadPool(&pool, workerCount, fiberCount);
+
+			TEST_CHECK(runFibonacci(18) == 2584);
+
+			for (int repeat=0; repeat<10; repeat++) {
+				ChainLink chain = {200, -1};
+				JobCounter counter = {};
+				addThreadJob(&pool, chainJob, &chain, &counter);
+				waitForJobCounter(&pool, &counter);
+				TEST_CHECK(chain.reached == 0);
+			}
+
+			SharedWait shared;
+			shared.slowJobDone.unfinishedCount = 0;
+			shared.slowJobFinished = 0;
+			shared.waitersPastWait = 0;
+			shared.waitersTooEarly = 0;
+			const int waiterCount = 100;
+			JobCounter waitersDone = {};
+			addThreadJob(&pool, slowJob, &shared, &shared.slowJobDone);
+			for (int i=0; i<waiterCount; i++) {
+				addThreadJob(&pool, waiterJob, &shared, &waitersDone);
+			}
+			waitForJobCounter(&pool, &waitersDone);
+			TEST_CHECK(shared.waitersPastWait.load() == waiterCount);
+			TEST_CHECK(shared.waitersTooEarly.load() == 0);
+
+			// A thread that isn't a worker waiting at the same time as the main thread
+			std::atomic<int> otherThreadFailures(0);
+			std::thread otherThread([&]() {
+				for (int repeat=0; repeat<10; repeat++) {
+					if (runFibonacci(12) != 144) {
+						otherThreadFailures++;
+					}
+				}
+			});
+			for (int repeat=0; repeat<10; repeat++) {
+				TEST_CHECK(runFibonacci(12) == 144);
+			}
+			otherThread.join();
+			TEST_CHECK(otherThreadFailures.load() == 0);
+
+			destroyThreadPool(&pool);
+		}
+	}
+	/* One worker and one fiber: the parked job holds the only fiber, so the worker runs the other job on its own stack,
+	and that has to resume the parked job's fiber while it waits, or neither ever finishes */
+	createThreadPool(&pool, 1, 1);
+	ParkedWait wait;
+	wait.released.unfinishedCount = 1;
+	wait.parkedDone.unfinishedCount = 0;
+	wait.parkedStarted = 0;
+	wait.stackJobStarted = 0;
+	JobCounter stackJobDone = {};
+	addThreadJob(&pool, parkedJob, &wait, &wait.parkedDone);
+	TEST_CHECK(spinUntil(wait.parkedStarted, 1));
+	while (getWaitingFiberCount() == 0) {
+		std::this_thread::yield();
+	}
+	addThreadJob(&pool, stackJob, &wait, &stackJobDone);
+	TEST_CHECK(spinUntil(wait.stackJobStarted, 1));
+	wait.released.unfinishedCount.fetch_sub(1);
+	bool stackJobFinished = spinUntil(stackJobDone.unfinishedCount, 0);
+	TEST_CHECK(stackJobFinished);
+	if (!stackJobFinished) {
+		// The worker is stuck, so the pool can't be destroyed
+		return finishTests("FiberTest");
+	}
+	destroyThreadPool(&pool);
+
+	return finishTests("FiberTest");
+}
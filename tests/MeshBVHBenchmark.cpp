@@ -0,0 +1,155 @@
+/* Times building a MeshBVH over a 300k triangle grid on 1 thread up to one per core (at least 4),
+and raycasting it, in millions of rays per second: rays from a camera through every pixel, which go through the same nodes,
+and rays scattered over the mesh from all over, which don't. Each set is cast one ray at a time with raycastMeshBVH()
+and isRayBlockedByMeshBVH(), and a packet at a time with raycastMeshBVHPackets().
+Checks every thread count builds the same tree, that every way of casting agrees, and that some rays match testing every triangle. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include <assert.h>
+#include "MeshBVH.h"
+#include "TestMeshes.h"
+#include <string.h>
+#include <vector>
+
+using namespace goblin;
+
+struct RaySet
+{
+	const char* name;
+	std::vector<Vec3> origins;
+	std::vector<Vec3> directions;
+};
+
+// Rays through the pixels of a width by height image, from a camera above the grid looking down at its middle
+void createCameraRays(RaySet* out_rays, unsigned int width, unsigned int height)
+{
+	RaySet rays;
+	rays.name = "camera";
+	Vec3 eye = {0.5f, 0.6f, -0.3f};
+	Vec3 forward = normalize(Vec3{0.5f, 0, 0.5f} - eye);
+	Vec3 right = normalize(cross(forward, Vec3{0, 1, 0}));
+	Vec3 up = cross(right, forward);
+	for (unsigned int y=0; y<height; y++) {
+		for (unsigned int x=0; x<width; x++) {
+			float screenX = (x + 0.5f)/width*2 - 1;
+			float screenY = (y + 0.5f)/height*2 - 1;
+			rays.origins.push_back(eye);
+			rays.directions.push_back(normalize(forward + right*(screenX*0.8f) + up*(screenY*0.45f)));
+		}
+	}
+	*out_rays = rays;
+}
+
+// Rays from random points above and below the grid towards random points on it, with directions of different lengths
+void createScatteredRays(RaySet* out_rays, unsigned int rayCount)
+{
+	RaySet rays;
+	rays.name = "scattered";
+	unsigned int seed = 7;
+	auto random = [&seed]() {
+		seed = seed*1664525 + 1013904223;
+		return (seed >> 8)*(1.0f/16777216);
+	};
+	for (unsigned int i=0; i<rayCount; i++) {
+		Vec3 origin = {random()*2 - 0.5f, random()*2 - 1, random()*2 - 0.5f};
+		Vec3 target = {random(), 0, random()};
+		rays.origins.push_back(origin);
+		rays.directions.push_back((target - origin)*(0.5f + random()));
+	}
+	*out_rays = rays;
+}
+
+bool isSameHit(const RayHit& a, const RayHit& b)
+{
+	return a.triangle == b.triangle || fabsf(a.distance - b.distance) <= 1e-5f;
+}
+
+int main()
+{
+	TestMesh mesh;
+	createTestGridMesh(&mesh, 388, 388);
+	unsigned int triangleCount = (unsigned int)mesh.faces.size();
+	const Vec3* positions = mesh.positions.data();
+	const unsigned int* vertexIndices = (const unsigned int*)mesh.faces.data();
+
+	MeshBVH bvh;
+	double serialSeconds = timeRepeatedly([&]() {
+		buildMeshBVH(&bvh, positions, vertexIndices, triangleCount, 1);
+		destroyMeshBVH(&bvh);
+	});
+	buildMeshBVH(&bvh, positions, vertexIndices, triangleCount, 1);
+	printf("Building a MeshBVH over %u triangles, %u nodes:\n", triangleCount, bvh.nodeCount);
+	printf("%8s %10s %10s\n", "threads", "ms", "speedup");
+	printf("%8u %10.2f %10.2f\n", 1, serialSeconds*1e3, 1.0);
+	unsigned int maxThreadCount = std::thread::hardware_concurrency();
+	if (maxThreadCount < 4) {
+		maxThreadCount = 4;
+	}
+	for (unsigned int threadCount=2; threadCount<=maxThreadCount; threadCount++)
+	{
+		MeshBVH threadedBVH;
+		double threadedSeconds = timeRepeatedly([&]() {
+			buildMeshBVH(&threadedBVH, positions, vertexIndices, triangleCount, threadCount);
+			destroyMeshBVH(&threadedBVH);
+		});
+		buildMeshBVH(&threadedBVH, positions, vertexIndices, triangleCount, threadCount);
+		TEST_CHECK(threadedBVH.nodeCount == bvh.nodeCount);
+		TEST_CHECK(memcmp(threadedBVH.nodes, bvh.nodes, bvh.nodeCount*sizeof(BVHNode)) == 0);
+		TEST_CHECK(memcmp(threadedBVH.triangles, bvh.triangles, triangleCount*sizeof(unsigned int)) == 0);
+		destroyMeshBVH(&threadedBVH);
+		printf("%8u %10.2f %10.2f\n", threadCount, threadedSeconds*1e3, serialSeconds/threadedSeconds);
+	}
+
+	RaySet raySets[2];
+	createCameraRays(&raySets[0], 256, 144);
+	createScatteredRays(&raySets[1], 256*144);
+	printf("Raycasting, millions of rays per second, %u floats at a time:\n", floatLaneCount);
+	printf("%-12s %8s %12s %12s %12s\n", "rays", "hit", "one by one", "blocked", "packets");
+	for (const RaySet& rays : raySets)
+	{
+		unsigned int rayCount = (unsigned int)rays.origins.size();
+		std::vector<RayHit> hits(rayCount), packetHits(rayCount);
+		std::vector<char> blocked(rayCount);
+		unsigned int hitCount = 0;
+		double singleSeconds = timeRepeatedly([&]() {
+			hitCount = 0;
+			for (unsigned int i=0; i<rayCount; i++) {
+				hitCount += raycastMeshBVH(&hits[i], bvh, positions, vertexIndices, rays.origins[i], rays.directions[i]);
+			}
+		});
+		double blockedSeconds = timeRepeatedly([&]() {
+			for (unsigned int i=0; i<rayCount; i++) {
+				blocked[i] = isRayBlockedByMeshBVH(bvh, positions, vertexIndices, rays.origins[i], rays.directions[i]);
+			}
+		});
+		unsigned int packetHitCount = 0;
+		double packetSeconds = timeRepeatedly([&]() {
+			packetHitCount = raycastMeshBVHPackets(packetHits.data(), bvh, positions, vertexIndices, rays.origins.data(), rays.directions.data(), rayCount);
+		});
+		printf("%-12s %7.0f%% %12.2f %12.2f %12.2f\n", rays.name, 100.0*hitCount/rayCount,
+			rayCount/singleSeconds*1e-6, rayCount/blockedSeconds*1e-6, rayCount/packetSeconds*1e-6);
+
+		bool castsAgree = (packetHitCount == hitCount);
+		for (unsigned int i=0; i<rayCount; i++) {
+			bool hit = (hits[i].triangle != rayMissed);
+			castsAgree &= (blocked[i] == hit) && (packetHits[i].triangle != rayMissed) == hit && (!hit || isSameHit(packetHits[i], hits[i]));
+		}
+		TEST_CHECK(castsAgree);
+		// Every triangle for some of the rays, with the triangle test the tree uses
+		bool matchesEveryTriangle = true;
+		for (unsigned int i=0; i<rayCount; i+=97)
+		{
+			RayHit closest = {1e30f, rayMissed, 0, 0};
+			for (unsigned int t=0; t<triangleCount; t++) {
+				intersectTriangle(&closest, t, positions, vertexIndices, rays.origins[i], rays.directions[i]);
+			}
+			matchesEveryTriangle &= (closest.triangle == rayMissed) ? (hits[i].triangle == rayMissed) : isSameHit(closest, hits[i]);
+		}
+		TEST_CHECK(matchesEveryTriangle);
+		TEST_CHECK(hitCount > 0 && hitCount < rayCount);
+	}
+	destroyMeshBVH(&bvh);
+	return finishTests("MeshBVHBenchmark");
+}
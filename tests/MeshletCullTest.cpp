@@ -0,0 +1,297 @@
+/* Splits a sphere into meshlets with the converter's buildMeshlets(), and checks every meshlet is within
+the vertex and triangle limits, that its triangles are next to each other, and that no triangle is lost or repeated.
+Then flies cameras along made up paths around the sphere, and culls the meshlets every frame with cullMeshlets().
+Checks nothing visible is culled: every triangle of a frustum culled meshlet is outside one of the planes,
+and every triangle of a cone culled meshlet faces away from the camera. Prints how much MeshletCullStats says was culled. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include <assert.h>
+// Before Visibility.h, since the converter has its own Mesh and Meshlet outside the goblin namespace
+#include "gobmesh_converter/Meshlets.h"
+#include "Visibility.h"
+#include "TestCameras.h"
+#include <math.h>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+// The converter writes its meshlets to files as is, for the runtime to read back
+static_assert(sizeof(::Meshlet) == sizeof(goblin::Meshlet), "Meshlets.h and Visibility.h disagree on Meshlet");
+
+struct MeshletMesh
+{
+	std::vector<IndexedTriangle> faces;
+	std::vector<Vec3> positions;
+	std::vector<goblin::Meshlet> meshlets;
+};
+
+Vec3 getTriangleNormal(const MeshletMesh& mesh, const IndexedTriangle& face)
+{
+	const unsigned int* v = face.vertexIndex;
+	Vec3 normal = cross(mesh.positions[v[1]] - mesh.positions[v[0]], mesh.positions[v[2]] - mesh.positions[v[0]]);
+	return normalize(normal);
+}
+
+bool isFaceBefore(const Face& a, const Face& b)
+{
+	return (a.a != b.a) ? a.a < b.a : (a.b != b.b) ? a.b < b.b : a.c < b.c;
+}
+
+/* Whether the meshlets cover the faces in order, each within maxMeshletVertices and maxMeshletTriangles with the vertex count it says,
+and the faces are the ones the mesh had before. Raises inout_mostVertices and inout_mostTriangles to the largest meshlet's counts. */
+bool areMeshletsWithinLimits(const ::Mesh& mesh, std::vector<Face> originalFaces, uint* inout_mostVertices, uint* inout_mostTriangles)
+{
+	bool correct = true;
+	uint nextTriangle = 0;
+	std::vector<uint> vertexMeshlet(mesh.positions.size(), (uint)-1);
+	for (uint i=0; i<mesh.meshlets.size(); i++)
+	{
+		const ::Meshlet& meshlet = mesh.meshlets[i];
+		correct &= (meshlet.firstTriangle == nextTriangle) && meshlet.triangleCount > 0 && meshlet.triangleCount <= ::maxMeshletTriangles;
+		nextTriangle = meshlet.firstTriangle + meshlet.triangleCount;
+		if (nextTriangle > mesh.faces.size()) {
+			return false;
+		}
+		uint vertexCount = 0;
+		for (uint t=meshlet.firstTriangle; t<nextTriangle; t++) {
+			const uint* indices = &mesh.faces[t].a;
+			for (uint j=0; j<3; j++) {
+				if (vertexMeshlet[indices[j]] != i) {
+					vertexMeshlet[indices[j]] = i;
+					vertexCount++;
+				}
+			}
+		}
+		correct &= (vertexCount == meshlet.vertexCount) && vertexCount <= ::maxMeshletVertices;
+		*inout_mostVertices = (vertexCount > *inout_mostVertices) ? vertexCount : *inout_mostVertices;
+		*inout_mostTriangles = (meshlet.triangleCount > *inout_mostTriangles) ? meshlet.triangleCount : *inout_mostTriangles;
+	}
+	correct &= (nextTriangle == mesh.faces.size());
+
+	std::vector<Face> faces = mesh.faces;
+	std::sort(faces.begin(), faces.end(), isFaceBefore);
+	std::sort(originalFaces.begin(), originalFaces.end(), isFaceBefore);
+	return correct && faces.size() == originalFaces.size() && memcmp(faces.data(), originalFaces.data(), faces.size()*sizeof(Face)) == 0;
+}
+
+// A unit sphere of segments by rings quads, with the triangles at the poles left out, facing outwards
+void createSphereMesh(::Mesh* out_mesh, unsigned int segments, unsigned int rings)
+{
+	::Mesh mesh;
+	for (unsigned int ring=0; ring<=rings; ring++) {
+		for (unsigned int segment=0; segment<=segments; segment++)
+		{
+			float latitude = pi*ring/rings;
+			float longitude = 2*pi*segment/segments;
+			mesh.positions.push_back(Vec3{sinf(latitude)*cosf(longitude), cosf(latitude), -sinf(latitude)*sinf(longitude)});
+		}
+	}
+	// Skips the first and last rings, whose quads have a corner at a pole
+	for (unsigned int ring=1; ring<rings-1; ring++) {
+		for (unsigned int segment=0; segment<segments; segment++)
+		{
+			unsigned int corner = ring*(segments+1) + segment;
+			Face a = {corner, corner+segments+1, corner+1};
+			Face b = {corner+1, corner+segments+1, corner+segments+2};
+			mesh.faces.push_back(a);
+			mesh.faces.push_back(b);
+		}
+	}
+	*out_mesh = mesh;
+}
+
+// Every triangle between vertexCount points, so far more triangles than vertices fit in a meshlet
+void createEveryTriangleMesh(::Mesh* out_mesh, unsigned int vertexCount)
+{
+	::Mesh mesh;
+	for (unsigned int i=0; i<vertexCount; i++) {
+		float angle = 2*pi*i/vertexCount;
+		mesh.positions.push_back(Vec3{cosf(angle), sinf(angle*3)*0.5f, sinf(angle)});
+	}
+	for (unsigned int a=0; a<vertexCount; a++) {
+		for (unsigned int b=a+1; b<vertexCount; b++) {
+			for (unsigned int c=b+1; c<vertexCount; c++) {
+				Face face = {a, b, c};
+				mesh.faces.push_back(face);
+			}
+		}
+	}
+	*out_mesh = mesh;
+}
+
+// The runtime's copy of a mesh the converter split into meshlets
+void createMeshletMesh(MeshletMesh* out_mesh, const ::Mesh& mesh)
+{
+	MeshletMesh meshletMesh;
+	meshletMesh.positions = mesh.positions;
+	for (const Face& face : mesh.faces) {
+		IndexedTriangle triangle = {{face.a, face.b, face.c}};
+		meshletMesh.faces.push_back(triangle);
+	}
+	meshletMesh.meshlets.resize(mesh.meshlets.size());
+	memcpy(meshletMesh.meshlets.data(), mesh.meshlets.data(), mesh.meshlets.size()*sizeof(goblin::Meshlet));
+	*out_mesh = meshletMesh;
+}
+
+bool isTriangleOutsideFrustum(const MeshletMesh& mesh, const IndexedTriangle& face, const Frustum& frustum)
+{
+	for (unsigned int p=0; p<Frustum::planeCount; p++)
+	{
+		bool allOutside = true;
+		for (unsigned int j=0; j<3; j++) {
+			Vec3 v = mesh.positions[face.vertexIndex[j]];
+			allOutside &= (dot(frustum.planes[p].xyz, v) + frustum.planes[p].w < 1e-4f);
+		}
+		if (allOutside) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool isTriangleFacingAway(const MeshletMesh& mesh, const IndexedTriangle& face, Vec3 cameraPosition)
+{
+	return dot(getTriangleNormal(mesh, face), mesh.positions[face.vertexIndex[0]] - cameraPosition) > -1e-4f;
+}
+
+/* Culls the meshlets from a camera at eye looking at target, and checks the result against every triangle.
+Adds to inout_stats. Returns false if anything visible was culled, or the ranges don't match the stats. */
+bool checkCulledFrame(MeshletCullStats* inout_stats, const MeshletMesh& mesh, Vec3 eye, Vec3 target)
+{
+	Matrix4x4 projection = makePerspectiveProjectionMatrix(pi/3, 16, 9, 0.05f, 100);
+	Frustum frustum;
+	getFrustumPlanes(&frustum, projection*makeTestViewMatrix(eye, target));
+
+	unsigned int meshletCount = (unsigned int)mesh.meshlets.size();
+	std::vector<TriangleRange> ranges(meshletCount);
+	MeshletCullStats stats = {};
+	unsigned int rangeCount = cullMeshlets(ranges.data(), mesh.meshlets.data(), meshletCount, frustum, eye, &stats);
+
+	// Which triangles the ranges draw
+	std::vector<bool> drawn(mesh.faces.size(), false);
+	unsigned int drawnCount = 0;
+	for (unsigned int i=0; i<rangeCount; i++) {
+		for (unsigned int t=ranges[i].firstTriangle; t<ranges[i].firstTriangle+ranges[i].triangleCount; t++) {
+			drawn[t] = true;
+			drawnCount++;
+		}
+	}
+	bool correct = (drawnCount == stats.visibleTriangleCount)
+		&& (stats.visibleTriangleCount + stats.frustumCulledTriangleCount + stats.coneCulledTriangleCount == stats.triangleCount);
+	for (unsigned int t=0; t<mesh.faces.size(); t++) {
+		if (!drawn[t] && !isTriangleOutsideFrustum(mesh, mesh.faces[t], frustum) && !isTriangleFacingAway(mesh, mesh.faces[t], eye)) {
+			correct = false;
+		}
+	}
+
+	inout_stats->meshletCount += stats.meshletCount;
+	inout_stats->visibleMeshletCount += stats.visibleMeshletCount;
+	inout_stats->triangleCount += stats.triangleCount;
+	inout_stats->visibleTriangleCount += stats.visibleTriangleCount;
+	inout_stats->frustumCulledTriangleCount += stats.frustumCulledTriangleCount;
+	inout_stats->coneCulledTriangleCount += stats.coneCulledTriangleCount;
+	return correct;
+}
+
+void printStats(const char* pathName, const MeshletCullStats& stats)
+{
+	printf("%-22s %12.1f %12.1f %12.1f %12.1f\n", pathName,
+		100.0*stats.visibleMeshletCount/stats.meshletCount,
+		100.0*stats.visibleTriangleCount/stats.triangleCount,
+		100.0*stats.frustumCulledTriangleCount/stats.triangleCount,
+		100.0*stats.coneCulledTriangleCount/stats.triangleCount);
+}
+
+int main()
+{
+	// Grown from neighbours, and as runs of the faces in order, which stop at the vertex limit
+	std::ostringstream log;
+	::Mesh sphere, sphereRuns;
+	createSphereMesh(&sphere, 128, 64);
+	std::vector<Face> sphereFaces = sphere.faces;
+	sphereRuns = sphere;
+	buildMeshlets(&sphere, false, log);
+	buildMeshlets(&sphereRuns, true, log);
+	uint mostVertices = 0, mostTriangles = 0;
+	TEST_CHECK(areMeshletsWithinLimits(sphere, sphereFaces, &mostVertices, &mostTriangles));
+	TEST_CHECK(mostVertices == ::maxMeshletVertices);
+	uint mostRunVertices = 0, mostRunTriangles = 0;
+	TEST_CHECK(areMeshletsWithinLimits(sphereRuns, sphereFaces, &mostRunVertices, &mostRunTriangles));
+	TEST_CHECK(memcmp(sphereRuns.faces.data(), sphereFaces.data(), sphereFaces.size()*sizeof(Face)) == 0);
+	TEST_CHECK(mostRunVertices == ::maxMeshletVertices);
+	// Few vertices shared by many triangles, which stop at the triangle limit instead
+	::Mesh dense;
+	createEveryTriangleMesh(&dense, 12);
+	std::vector<Face> denseFaces = dense.faces;
+	buildMeshlets(&dense, false, log);
+	uint mostDenseVertices = 0, mostDenseTriangles = 0;
+	TEST_CHECK(areMeshletsWithinLimits(dense, denseFaces, &mostDenseVertices, &mostDenseTriangles));
+	TEST_CHECK(mostDenseTriangles == ::maxMeshletTriangles);
+	// Ordering each meshlet for the vertex cache keeps every triangle in its meshlet
+	float meshletACMR = simulateVertexCache(sphere.faces, sphere.positions.size()).acmr;
+	optimizeMeshletVertexCache(&sphere);
+	TEST_CHECK(simulateVertexCache(sphere.faces, sphere.positions.size()).acmr < meshletACMR);
+	TEST_CHECK(areMeshletsWithinLimits(sphere, sphereFaces, &mostVertices, &mostTriangles));
+
+	MeshletMesh mesh;
+	createMeshletMesh(&mesh, sphere);
+	const unsigned int frameCount = 360;
+	printf("%u meshlets, %u triangles, %u frames per path, percent of all frames:\n", (unsigned int)mesh.meshlets.size(), (unsigned int)mesh.faces.size(), frameCount);
+	printf("%-22s %12s %12s %12s %12s\n", "path", "meshlets", "triangles", "frustum", "cone");
+	Vec3 origin = {0, 0, 0};
+
+	// Circling the whole sphere, which is always in view, so only cones cull anything
+	MeshletCullStats orbit = {};
+	bool orbitCorrect = true;
+	for (unsigned int i=0; i<frameCount; i++) {
+		float angle = 2*pi*i/frameCount;
+		Vec3 eye = {4*cosf(angle), 1.5f*sinf(3*angle), 4*sinf(angle)};
+		orbitCorrect &= checkCulledFrame(&orbit, mesh, eye, origin);
+	}
+	printStats("orbit", orbit);
+	TEST_CHECK(orbitCorrect);
+	TEST_CHECK(orbit.frustumCulledTriangleCount == 0);
+	TEST_CHECK(orbit.coneCulledTriangleCount > orbit.triangleCount/4);
+
+	// Skimming over the surface, looking ahead along it, so most of the sphere is out of view
+	MeshletCullStats flyover = {};
+	bool flyoverCorrect = true;
+	for (unsigned int i=0; i<frameCount; i++) {
+		float angle = 2*pi*i/frameCount;
+		Vec3 eye = Vec3{cosf(angle), 0.3f*sinf(2*angle), sinf(angle)}*1.2f;
+		Vec3 ahead = Vec3{cosf(angle+0.3f), 0, sinf(angle+0.3f)};
+		flyoverCorrect &= checkCulledFrame(&flyover, mesh, eye, ahead);
+	}
+	printStats("flyover", flyover);
+	TEST_CHECK(flyoverCorrect);
+	TEST_CHECK(flyover.frustumCulledTriangleCount > 0);
+
+	// Circling the sphere while looking away from it, so nothing is in view
+	MeshletCullStats lookingAway = {};
+	bool lookingAwayCorrect = true;
+	for (unsigned int i=0; i<frameCount; i++) {
+		float angle = 2*pi*i/frameCount;
+		Vec3 eye = Vec3{cosf(angle), 0, sinf(angle)}*4;
+		lookingAwayCorrect &= checkCulledFrame(&lookingAway, mesh, eye, eye*2);
+	}
+	printStats("looking away", lookingAway);
+	TEST_CHECK(lookingAwayCorrect);
+	TEST_CHECK(lookingAway.visibleTriangleCount == 0);
+
+	// Inside the sphere, which only shows its back faces, looking around
+	MeshletCullStats inside = {};
+	bool insideCorrect = true;
+	for (unsigned int i=0; i<frameCount; i++) {
+		float angle = 2*pi*i/frameCount;
+		Vec3 eye = Vec3{0.2f*cosf(angle), 0.1f, 0.2f*sinf(angle)};
+		Vec3 target = eye + Vec3{cosf(2*angle), 0.5f*sinf(angle), sinf(2*angle)};
+		insideCorrect &= checkCulledFrame(&inside, mesh, eye, target);
+	}
+	printStats("inside", inside);
+	TEST_CHECK(insideCorrect);
+	TEST_CHECK(inside.coneCulledTriangleCount > 0);
+
+	return finishTests("MeshletCullTest");
+}
@@ -0,0 +1,105 @@
+/* Checks that evaluateSkeletonInstances() on a ThreadPool doesn't allocate anything once it's warmed up,
+by replacing the global operator new with one that counts. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include <vector>
+#include <new>
+#include <stdlib.h>
+
+static std::atomic<unsigned int> allocationCount(0);
+
+void* operator new(size_t byteCount)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* memory = malloc(byteCount ? byteCount : 1);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+void* operator new[](size_t byteCount)
+{
+	return operator new(byteCount);
+}
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+using namespace goblin;
+
+int main()
+{
+	const unsigned int instanceCount = 500;
+	const unsigned int jointCount = 48;
+	const unsigned int frameCount = 100;
+	Skeleton skeleton;
+	createTestSkeleton(&skeleton, jointCount);
+	SkeletonAnimation walk;
+	SkeletonAnimation wave;
+	createTestSkeletonAnimation(&walk, jointCount, 32, 2);
+	createTestSkeletonAnimation(&wave, jointCount, 32, 3, 1);
+
+	SkeletonAnimation* animations[] = {&walk, &wave};
+	float weights[] = {1, 0.5f};
+	std::vector<float> times(2*instanceCount, 0.0f);
+	std::vector<SkeletonInstance> instances(instanceCount);
+	for (unsigned int i=0; i<instanceCount; i++) {
+		SkeletonInstance instance = {&skeleton, animations, &times[2*i], weights, 2};
+		instances[i] = instance;
+	}
+	std::vector<unsigned int> offsets(instanceCount);
+	std::vector<Matrix4x4> matrices(getSkinningMatrixOffsets(offsets.data(), instances.data(), instanceCount));
+
+	// The main thread helps run the batches, so it needs scratch memory like the workers
+	FrameArena mainScratch;
+	createFrameArena(&mainScratch, 64*1024);
+	platform::setThreadScratchArena(&mainScratch);
+
+	const unsigned int fiberCounts[] = {0, 8};
+	for (unsigned int fiberCount : fiberCounts)
+	{
+		platform::ThreadPool pool;
+		platform::createThreadPool(&pool, 3, fiberCount);
+
+		// The first frames can allocate, like a fiber's first wait
+		for (unsigned int frame=0; frame<3; frame++) {
+			evaluateSkeletonInstances(matrices.data(), offsets.data(), instances.data(), instanceCount, &pool);
+		}
+		unsigned int countBefore = allocationCount.load();
+		for (unsigned int frame=0; frame<frameCount; frame++) {
+			for (unsigned int i=0; i<2*instanceCount; i++) {
+				times[i] += 1/60.0f;
+			}
+			evaluateSkeletonInstances(matrices.data(), offsets.data(), instances.data(), instanceCount, &pool);
+		}
+		unsigned int frameAllocationCount = allocationCount.load() - countBefore;
+		printf("%u fibers: %u allocations in %u frames\n", fiberCount, frameAllocationCount, frameCount);
+		TEST_CHECK(frameAllocationCount == 0);
+		TEST_CHECK(mainScratch.usedByteCount == 0);
+
+		platform::destroyThreadPool(&pool);
+	}
+
+	platform::setThreadScratchArena(0);
+	destroyFrameArena(&mainScratch);
+	destroySkeletonAnimation(&wave);
+	destroySkeletonAnimation(&walk);
+	destroySkeleton(&skeleton);
+	return finishTests("SkeletonInstanceAllocationTest");
+}
@@ -0,0 +1,73 @@
+/* Times evaluateSkeletonInstances() on 1000 instances, each blending two animations,
+on the calling thread and then on ThreadPools with more and more workers.
+Also checks every pool gets the same matrices as the calling thread alone. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include <vector>
+
+using namespace goblin;
+
+int main()
+{
+	const unsigned int instanceCount = 1000;
+	const unsigned int jointCount = 64;
+	Skeleton skeleton;
+	createTestSkeleton(&skeleton, jointCount);
+	SkeletonAnimation walk;
+	SkeletonAnimation run;
+	createTestSkeletonAnimation(&walk, jointCount, 64, 2);
+	createTestSkeletonAnimation(&run, jointCount, 64, 1, 1);
+
+	std::vector<SkeletonAnimation*> animations(2*instanceCount);
+	std::vector<float> times(2*instanceCount);
+	std::vector<float> weights(2*instanceCount);
+	std::vector<SkeletonInstance> instances(instanceCount);
+	for (unsigned int i=0; i<instanceCount; i++) {
+		animations[2*i] = &walk;
+		animations[2*i+1] = &run;
+		times[2*i] = i*0.013f;
+		times[2*i+1] = i*0.007f;
+		weights[2*i] = 1;
+		weights[2*i+1] = (i % 10)/10.0f;
+		SkeletonInstance instance = {&skeleton, &animations[2*i], &times[2*i], &weights[2*i], 2};
+		instances[i] = instance;
+	}
+	std::vector<unsigned int> offsets(instanceCount);
+	unsigned int matrixCount = getSkinningMatrixOffsets(offsets.data(), instances.data(), instanceCount);
+	std::vector<Matrix4x4> expected(matrixCount);
+	std::vector<Matrix4x4> matrices(matrixCount);
+
+	evaluateSkeletonInstances(expected.data(), offsets.data(), instances.data(), instanceCount);
+	double serialSeconds = timeRepeatedly([&]() {
+		evaluateSkeletonInstances(matrices.data(), offsets.data(), instances.data(), instanceCount);
+	});
+	printf("%u instances of %u joints, milliseconds per frame:\n", instanceCount, jointCount);
+	printf("%8s %10s %10s\n", "workers", "ms", "speedup");
+	printf("%8s %10.3f %10.2f\n", "none", serialSeconds*1e3, 1.0);
+
+	// At least up to 4 workers, so the scaling shows even on small machines
+	unsigned int maxWorkerCount = platform::getProcessorCount();
+	if (maxWorkerCount < 4) {
+		maxWorkerCount = 4;
+	}
+	for (unsigned int workerCount=1; workerCount<=maxWorkerCount; workerCount++)
+	{
+		platform::ThreadPool pool;
+		platform::createThreadPool(&pool, workerCount);
+		evaluateSkeletonInstances(matrices.data(), offsets.data(), instances.data(), instanceCount, &pool);
+		TEST_CHECK(memcmp(matrices.data(), expected.data(), matrixCount*sizeof(Matrix4x4)) == 0);
+		double poolSeconds = timeRepeatedly([&]() {
+			evaluateSkeletonInstances(matrices.data(), offsets.data(), instances.data(), instanceCount, &pool);
+		});
+		printf("%8u %10.3f %10.2f\n", workerCount, poolSeconds*1e3, serialSeconds/poolSeconds);
+		platform::destroyThreadPool(&pool);
+	}
+
+	destroySkeletonAnimation(&run);
+	destroySkeletonAnimation(&walk);
+	destroySkeleton(&skeleton);
+	return finishTests("SkeletonInstanceBenchmark");
+}
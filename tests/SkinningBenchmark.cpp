@@ -0,0 +1,86 @@
+/* Times skinning positions, normals and tangents on the CPU, in millions of vertices per second,
+with skinVertices() on the calling thread and skinVerticesParallel() on pools with more and more workers.
+Also checks every pool skins the same vertices as the calling thread alone. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include <vector>
+
+using namespace goblin;
+
+int main()
+{
+	const unsigned int vertexCount = 200000;
+	const unsigned int jointCount = 64;
+	Skeleton skeleton;
+	createTestSkeleton(&skeleton, jointCount);
+	SkeletonAnimation animation;
+	createTestSkeletonAnimation(&animation, jointCount, 32, 2);
+	std::vector<Transform> pose(jointCount);
+	sampleSkeletonAnimation(pose.data(), 0.5f, animation);
+	jointPosesToModelSpace(pose.data(), pose.data(), skeleton);
+	std::vector<Matrix4x4> skinningMatrices(jointCount);
+	buildSkinningMatrix(skinningMatrices.data(), pose.data(), skeleton);
+
+	std::vector<Vec3> positions(vertexCount);
+	std::vector<Vec3> normals(vertexCount);
+	std::vector<Vec4> tangents(vertexCount);
+	std::vector<unsigned int> jointIndices(vertexCount*jointsPerVertex);
+	std::vector<float> jointWeights(vertexCount*jointsPerVertex);
+	for (unsigned int v=0; v<vertexCount; v++)
+	{
+		float angle = v*0.01f;
+		Vec3 position = {cosf(angle), v*0.0001f, sinf(angle)};
+		Vec3 normal = {cosf(angle), 0, sinf(angle)};
+		Vec4 tangent = {-sinf(angle), 0, cosf(angle), 1};
+		positions[v] = position;
+		normals[v] = normal;
+		tangents[v] = tangent;
+		float weightSum = 0;
+		for (unsigned int j=0; j<jointsPerVertex; j++) {
+			jointIndices[v*jointsPerVertex + j] = (v/64 + j*7) % jointCount;
+			jointWeights[v*jointsPerVertex + j] = (float)(jointsPerVertex - j);
+			weightSum += jointsPerVertex - j;
+		}
+		for (unsigned int j=0; j<jointsPerVertex; j++) {
+			jointWeights[v*jointsPerVertex + j] /= weightSum;
+		}
+	}
+
+	std::vector<Vec3> expectedPositions(vertexCount), skinnedPositions(vertexCount);
+	std::vector<Vec3> expectedNormals(vertexCount), skinnedNormals(vertexCount);
+	std::vector<Vec4> expectedTangents(vertexCount), skinnedTangents(vertexCount);
+	double serialSeconds = timeRepeatedly([&]() {
+		skinVertices(expectedPositions.data(), expectedNormals.data(), expectedTangents.data(), skinningMatrices.data(),
+			positions.data(), normals.data(), tangents.data(), jointIndices.data(), jointWeights.data(), 0, vertexCount);
+	});
+	printf("Skinning %u vertices with normals and tangents, millions of vertices per second:\n", vertexCount);
+	printf("%8s %10s %10s\n", "workers", "Mverts/s", "speedup");
+	printf("%8s %10.1f %10.2f\n", "none", vertexCount/serialSeconds*1e-6, 1.0);
+
+	// At least up to 4 workers, so the scaling shows even on small machines
+	unsigned int maxWorkerCount = platform::getProcessorCount();
+	if (maxWorkerCount < 4) {
+		maxWorkerCount = 4;
+	}
+	for (unsigned int workerCount=1; workerCount<=maxWorkerCount; workerCount++)
+	{
+		platform::ThreadPool pool;
+		platform::createThreadPool(&pool, workerCount);
+		double poolSeconds = timeRepeatedly([&]() {
+			skinVerticesParallel(skinnedPositions.data(), skinnedNormals.data(), skinnedTangents.data(), skinningMatrices.data(),
+				positions.data(), normals.data(), tangents.data(), jointIndices.data(), jointWeights.data(), vertexCount, &pool);
+		});
+		TEST_CHECK(memcmp(skinnedPositions.data(), expectedPositions.data(), vertexCount*sizeof(Vec3)) == 0);
+		TEST_CHECK(memcmp(skinnedNormals.data(), expectedNormals.data(), vertexCount*sizeof(Vec3)) == 0);
+		TEST_CHECK(memcmp(skinnedTangents.data(), expectedTangents.data(), vertexCount*sizeof(Vec4)) == 0);
+		printf("%8u %10.1f %10.2f\n", workerCount, vertexCount/poolSeconds*1e-6, serialSeconds/poolSeconds);
+		platform::destroyThreadPool(&pool);
+	}
+
+	destroySkeletonAnimation(&animation);
+	destroySkeleton(&skeleton);
+	return finishTests("SkinningBenchmark");
+}
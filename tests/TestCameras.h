@@ -0,0 +1,25 @@
+#ifndef GOBLIN_TEST_CAMERAS_HEADER
+#define GOBLIN_TEST_CAMERAS_HEADER
+
+// Cameras for the tests and benchmarks that cull or draw from a point of view
+
+#include <assert.h>
+#include "Algebra.h"
+
+// A GL view matrix for a camera at eye looking towards target, which mustn't be straight above or below it
+inline goblin::Matrix4x4 makeTestViewMatrix(goblin::Vec3 eye, goblin::Vec3 target, goblin::Vec3 up = goblin::Vec3{0, 1, 0})
+{
+	using namespace goblin;
+	Vec3 forward = normalize(target - eye);
+	Vec3 right = normalize(cross(forward, up));
+	Vec3 cameraUp = cross(right, forward);
+	Matrix4x4 view = {
+		right.x, right.y, right.z, -dot(right, eye),
+		cameraUp.x, cameraUp.y, cameraUp.z, -dot(cameraUp, eye),
+		-forward.x, -forward.y, -forward.z, dot(forward, eye),
+		0, 0, 0, 1
+	};
+	return view;
+}
+
+#endif // header include guard
@@ -0,0 +1,63 @@
+#ifndef GOBLIN_TEST_MESHES_HEADER
+#define GOBLIN_TEST_MESHES_HEADER
+
+// Made up meshes for the tests and benchmarks, so they don't need asset files
+
+#include <assert.h>
+#include "Goblin3D.h"
+#include <math.h>
+#include <vector>
+
+struct TestMesh
+{
+	std::vector<goblin::IndexedTriangle> faces;
+	std::vector<goblin::Vec3> positions;
+	std::vector<goblin::Vec2> uvs;
+	std::vector<goblin::Vec3> normals;
+};
+
+/* A wavy grid of columns by rows vertices, two triangles per cell. The right half's UVs are mirrored,
+like a symmetric character's, so both tangent handednesses show up.
+The faces are in rows, which keeps each vertex's faces close together like a mesh optimized for the vertex cache,
+unless shuffleFaces is true, which spreads them across the whole array. */
+inline void createTestGridMesh(TestMesh* out_mesh, unsigned int columns, unsigned int rows, bool shuffleFaces = false)
+{
+	using namespace goblin;
+	assert(columns >= 2 && rows >= 2);
+	TestMesh mesh;
+	for (unsigned int y=0; y<rows; y++) {
+		for (unsigned int x=0; x<columns; x++)
+		{
+			float u = x/(float)(columns-1);
+			float v = y/(float)(rows-1);
+			float height = 0.1f*sinf(u*20)*cosf(v*15);
+			Vec3 position = {u, height, v};
+			Vec3 normal = normalize(Vec3{-2*cosf(u*20)*cosf(v*15), 1, 1.5f*sinf(u*20)*sinf(v*15)});
+			Vec2 uv = {(u < 0.5f) ? u : 1-u, v};
+			mesh.positions.push_back(position);
+			mesh.normals.push_back(normal);
+			mesh.uvs.push_back(uv);
+		}
+	}
+	for (unsigned int y=0; y+1<rows; y++) {
+		for (unsigned int x=0; x+1<columns; x++)
+		{
+			unsigned int corner = y*columns + x;
+			IndexedTriangle a = {{corner, corner+columns, corner+1}};
+			IndexedTriangle b = {{corner+1, corner+columns, corner+columns+1}};
+			mesh.faces.push_back(a);
+			mesh.faces.push_back(b);
+		}
+	}
+	unsigned int randomState = 12345;
+	for (size_t i=mesh.faces.size()-1; i>0 && shuffleFaces; i--) {
+		randomState = randomState*1664525 + 1013904223;
+		size_t j = (randomState >> 8) % (i+1);
+		IndexedTriangle swapped = mesh.faces[i];
+		mesh.faces[i] = mesh.faces[j];
+		mesh.faces[j] = swapped;
+	}
+	*out_mesh = mesh;
+}
+
+#endif // header include guard
@@ -0,0 +1,69 @@
+#ifndef GOBLIN_TEST_SKELETONS_HEADER
+#define GOBLIN_TEST_SKELETONS_HEADER
+
+// Made up skeletons and animations for the tests and benchmarks, so they don't need asset files
+
+#include <assert.h>
+#include "SkeletonAnimation.h"
+#include <math.h>
+
+// Each joint's parent is an earlier joint, branching like a binary tree
+inline void createTestSkeleton(goblin::Skeleton* out_skeleton, unsigned int jointCount)
+{
+	goblin::Skeleton skeleton = {};
+	skeleton.jointCount = jointCount;
+	skeleton.joints = new goblin::Skeleton::Joint[jointCount];
+	for (unsigned int i=0; i<jointCount; i++) {
+		skeleton.joints[i].parentIndex = (i == 0) ? 0 : (i-1)/2;
+		skeleton.joints[i].modelSpaceBindPoseInverse = goblin::Matrix4x4::identity;
+	}
+	*out_skeleton = skeleton;
+}
+
+/* Every channel has keyCount keys, from 0 to duration, unevenly spaced like a converted file's.
+seed changes the values, so two animations for the same skeleton don't match. */
+inline void createTestSkeletonAnimation(goblin::SkeletonAnimation* out_animation, unsigned int jointCount, unsigned int keyCount, float duration, float seed = 0)
+{
+	using namespace goblin;
+	assert(keyCount >= 2);
+	goblin::SkeletonAnimation animation = {};
+	animation.duration = duration;
+	animation.jointCount = jointCount;
+	animation.jointAnimations = new goblin::SkeletonAnimation::JointAnimation[jointCount];
+	for (unsigned int i=0; i<jointCount; i++)
+	{
+		goblin::SkeletonAnimation::JointAnimation& joint = animation.jointAnimations[i];
+		joint.scaleKeyCount = joint.rotateKeyCount = joint.translateKeyCount = keyCount;
+		joint.scaleKeyTimes = new float[keyCount];
+		joint.rotateKeyTimes = new float[keyCount];
+		joint.translateKeyTimes = new float[keyCount];
+		joint.scaleKeyValues = new Vec3[keyCount];
+		joint.rotateKeyValues = new Quaternion[keyCount];
+		joint.translateKeyValues = new Vec3[keyCount];
+		for (unsigned int k=0; k<keyCount; k++)
+		{
+			// Evenly spaced, then nudged by up to a third of the spacing
+			float t = (float)k/(keyCount-1);
+			if (k > 0 && k < keyCount-1) {
+				t += sinf(k*7.1f + i*3.3f + seed)*0.33f/(keyCount-1);
+			}
+			float time = t*duration;
+			joint.scaleKeyTimes[k] = joint.rotateKeyTimes[k] = joint.translateKeyTimes[k] = time;
+			float phase = time*3 + i*0.7f + seed;
+			joint.scaleKeyValues[k] = Vec3{1 + 0.1f*sinf(phase), 1, 1 + 0.1f*cosf(phase)};
+			joint.rotateKeyValues[k] = axisAngleToQuaternion(normalize(Vec3{sinf(i + seed), 1, cosf(i*1.3f)}), sinf(phase)*2);
+			joint.translateKeyValues[k] = Vec3{sinf(phase), cosf(phase*0.5f), (float)i*0.1f};
+		}
+	}
+	*out_animation = animation;
+}
+
+inline float getTransformDifference(goblin::Transform a, goblin::Transform b)
+{
+	using namespace goblin;
+	// q and -q are the same rotation
+	float rotationDifference = 1 - fabsf(dot(a.rotation, b.rotation));
+	return max(max(length(a.position - b.position), length(a.scale - b.scale)), rotationDifference);
+}
+
+#endif // header include guard
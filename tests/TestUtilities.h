@@ -0,0 +1,54 @@
+#ifndef GOBLIN_TEST_UTILITIES_HEADER
+#define GOBLIN_TEST_UTILITIES_HEADER
+
+/* Shared by the programs in tests/. Each one is a single file with its own main().
+Tests return 1 from main() if any check failed, and benchmarks print their timings. */
+
+#include <stdio.h>
+#include <chrono>
+
+static int testFailureCount = 0;
+
+// Reports a failed check and keeps going, so one run shows every failure
+#define TEST_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			testFailureCount++; \
+		} \
+	} while (0)
+
+// What main() should return
+inline int finishTests(const char* testName)
+{
+	if (testFailureCount > 0) {
+		printf("%s: %d checks failed\n", testName, testFailureCount);
+		return 1;
+	}
+	printf("%s: passed\n", testName);
+	return 0;
+}
+
+inline double getTestSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Calls function over and over for at least minSeconds, and returns the average seconds per call
+template<typename Function>
+double timeRepeatedly(Function function, double minSeconds = 0.25)
+{
+	// Once first, so caches and lazily allocated memory are warm
+	function();
+	unsigned int callCount = 0;
+	double start = getTestSeconds();
+	double elapsed = 0;
+	while (elapsed < minSeconds) {
+		function();
+		callCount++;
+		elapsed = getTestSeconds() - start;
+	}
+	return elapsed/callCount;
+}
+
+#endif // header include guard
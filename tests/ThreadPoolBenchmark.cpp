@@ -0,0 +1,67 @@
+/* Times the ThreadPool on pools of 1 worker up to one per processor (at least 4):
+parallelFor() over work that's heavy enough to scale, and lots of tiny jobs,
+which mostly measures adding, stealing and finishing them. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include <math.h>
+#include <vector>
+
+using namespace platform;
+
+static std::vector<float> values;
+
+void computeRange(void* parameter, uint first, uint count)
+{
+	for (uint i=first; i<first+count; i++) {
+		float x = i*0.001f;
+		for (int k=0; k<8; k++) {
+			x = sinf(x) + 0.5f;
+		}
+		values[i] = x;
+	}
+}
+
+int emptyJob(void* parameter)
+{
+	return 0;
+}
+
+int main()
+{
+	const uint itemCount = 1 << 20;
+	const uint grainSize = 4096;
+	const uint jobCount = 100000;
+	values.resize(itemCount);
+
+	double serialSeconds = timeRepeatedly([&]() {
+		computeRange(0, 0, itemCount);
+	});
+	printf("parallelFor() over %u items in ranges of %u, and %u empty jobs:\n", itemCount, grainSize, jobCount);
+	printf("%8s %14s %10s %16s\n", "workers", "parallelFor ms", "speedup", "ns per empty job");
+	printf("%8s %14.2f %10.2f %16s\n", "none", serialSeconds*1e3, 1.0, "");
+
+	uint maxWorkerCount = getProcessorCount();
+	if (maxWorkerCount < 4) {
+		maxWorkerCount = 4;
+	}
+	for (uint workerCount=1; workerCount<=maxWorkerCount; workerCount++)
+	{
+		ThreadPool pool;
+		createThreadPool(&pool, workerCount);
+		double parallelSeconds = timeRepeatedly([&]() {
+			parallelFor(&pool, itemCount, grainSize, computeRange, 0);
+		});
+		double jobSeconds = timeRepeatedly([&]() {
+			JobCounter counter = {};
+			for (uint i=0; i<jobCount; i++) {
+				addThreadJob(&pool, emptyJob, 0, &counter);
+			}
+			waitForJobCounter(&pool, &counter);
+		});
+		printf("%8u %14.2f %10.2f %16.1f\n", workerCount, parallelSeconds*1e3, serialSeconds/parallelSeconds, jobSeconds/jobCount*1e9);
+		destroyThreadPool(&pool);
+	}
+	return 0;
+}
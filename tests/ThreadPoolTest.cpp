@@ -0,0 +1,122 @@
+/* Checks the ThreadPool runs every job once: parallelFor() with uneven and tiny counts,
+jobs that add and wait for more jobs, a queue filled past maxQueuedJobs,
+and a thread that isn't a worker adding jobs at the same time as the main thread.
+Run it under -fsanitize=thread too. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include <vector>
+
+using namespace platform;
+
+static ThreadPool pool;
+
+void countRange(void* parameter, uint first, uint count)
+{
+	std::vector<std::atomic<unsigned int>>& timesSeen = *(std::vector<std::atomic<unsigned int>>*)parameter;
+	for (uint i=first; i<first+count; i++) {
+		timesSeen[i].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+// Every item is visited exactly once
+bool checkParallelFor(uint count, uint grainSize)
+{
+	std::vector<std::atomic<unsigned int>> timesSeen(count);
+	for (uint i=0; i<count; i++) {
+		timesSeen[i] = 0;
+	}
+	parallelFor(&pool, count, grainSize, countRange, &timesSeen);
+	for (uint i=0; i<count; i++) {
+		if (timesSeen[i].load() != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Fibonacci the slow way, with a job for every call that waits for its two children
+struct Fibonacci
+{
+	int n;
+	long result;
+};
+
+int fibonacciJob(void* parameter)
+{
+	Fibonacci* f = (Fibonacci*)parameter;
+	if (f->n < 2) {
+		f->result = f->n;
+		return 0;
+	}
+	Fibonacci a = {f->n-1, 0};
+	Fibonacci b = {f->n-2, 0};
+	JobCounter counter = {};
+	addThreadJob(&pool, fibonacciJob, &a, &counter);
+	addThreadJob(&pool, fibonacciJob, &b, &counter);
+	waitForJobCounter(&pool, &counter);
+	f->result = a.result + b.result;
+	return 0;
+}
+
+long runFibonacci(int n)
+{
+	Fibonacci f = {n, 0};
+	JobCounter counter = {};
+	addThreadJob(&pool, fibonacciJob, &f, &counter);
+	waitForJobCounter(&pool, &counter);
+	return f.result;
+}
+
+int incrementJob(void* parameter)
+{
+	((std::atomic<int>*)parameter)->fetch_add(1, std::memory_order_relaxed);
+	return 0;
+}
+
+int main()
+{
+	const uint workerCounts[] = {1, 2, 4};
+	for (uint workerCount : workerCounts)
+	{
+		createThreadPool(&pool, workerCount);
+
+		TEST_CHECK(checkParallelFor(0, 10));
+		TEST_CHECK(checkParallelFor(1, 10));
+		TEST_CHECK(checkParallelFor(7, 3));
+		TEST_CHECK(checkParallelFor(100, 0));
+		for (int repeat=0; repeat<50; repeat++) {
+			TEST_CHECK(checkParallelFor(100000, 997));
+		}
+
+		TEST_CHECK(runFibonacci(20) == 6765);
+
+		// More jobs than a queue holds, so some run right away on the thread adding them
+		std::atomic<int> incrementCount(0);
+		JobCounter counter = {};
+		for (uint i=0; i<3*ThreadPool::maxQueuedJobs; i++) {
+			addThreadJob(&pool, incrementJob, &incrementCount, &counter);
+		}
+		waitForJobCounter(&pool, &counter);
+		TEST_CHECK(incrementCount.load() == 3*(int)ThreadPool::maxQueuedJobs);
+
+		// Two threads that aren't workers share a queue
+		std::atomic<int> otherThreadFailures(0);
+		std::thread otherThread([&]() {
+			for (int repeat=0; repeat<20; repeat++) {
+				if (runFibonacci(12) != 144) {
+					otherThreadFailures++;
+				}
+			}
+		});
+		for (int repeat=0; repeat<20; repeat++) {
+			TEST_CHECK(runFibonacci(12) == 144);
+		}
+		otherThread.join();
+		TEST_CHECK(otherThreadFailures.load() == 0);
+
+		destroyThreadPool(&pool);
+	}
+	return finishTests("ThreadPoolTest");
+}
@@ -0,0 +1,56 @@
+/* Checks that a UniformSkeletonAnimation matches its source on its frames and at its end,
+including when the duration isn't a whole number of frames. */
+
+// Doesn't need GamePlatform.h's ThreadPool
+#define GOBLIN_DISABLE_THREAD_POOL
+#include "TestUtilities.h"
+#include "TestSkeletons.h"
+#include <vector>
+
+using namespace goblin;
+
+void checkUniformAnimation(float duration, unsigned int framesPerSecond)
+{
+	const unsigned int jointCount = 8;
+	SkeletonAnimation animation;
+	createTestSkeletonAnimation(&animation, jointCount, 20, duration);
+	UniformSkeletonAnimation uniform;
+	createUniformSkeletonAnimation(&uniform, animation, framesPerSecond);
+
+	std::vector<Transform> expected(jointCount);
+	std::vector<Transform> sampled(jointCount);
+	float maxDifference = 0;
+	// Every whole frame, then the end, then past the end
+	float times[] = {0, 1.0f/framesPerSecond, 5.0f/framesPerSecond, duration, duration + 1};
+	for (float time : times)
+	{
+		sampleSkeletonAnimation(expected.data(), min(time, duration), animation);
+		sampleUniformSkeletonAnimation(sampled.data(), time, uniform);
+		for (unsigned int j=0; j<jointCount; j++) {
+			maxDifference = max(maxDifference, getTransformDifference(expected[j], sampled[j]));
+		}
+	}
+	TEST_CHECK(maxDifference < 1e-5f);
+
+	// Between the last two frames, the pose moves towards the end pose and gets there at the end
+	float lastWholeFrameTime = (uniform.frameCount-2)/(float)framesPerSecond;
+	sampleUniformSkeletonAnimation(sampled.data(), (lastWholeFrameTime + duration)*0.5f, uniform);
+	sampleSkeletonAnimation(expected.data(), (lastWholeFrameTime + duration)*0.5f, animation);
+	for (unsigned int j=0; j<jointCount; j++) {
+		TEST_CHECK(getTransformDifference(expected[j], sampled[j]) < 0.05f);
+	}
+
+	destroyUniformSkeletonAnimation(&uniform);
+	destroySkeletonAnimation(&animation);
+}
+
+int main()
+{
+	// Whole number of frames
+	checkUniformAnimation(2, 30);
+	// The end falls between frames
+	checkUniformAnimation(1.01f, 30);
+	checkUniformAnimation(0.75f, 24);
+	checkUniformAnimation(3.3333f, 60);
+	return finishTests("UniformAnimationTest");
+}
@@ -0,0 +1,43 @@
+/* Times generating tangents for a mesh loaded without them, in millions of vertices per second,
+with fillVertexTangentArray() on the calling thread and fillVertexTangentArrayParallel() on pools with more and more workers. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include "TestMeshes.h"
+#include <vector>
+
+using namespace goblin;
+
+int main()
+{
+	TestMesh mesh;
+	createTestGridMesh(&mesh, 1000, 500);
+	unsigned int faceCount = (unsigned int)mesh.faces.size();
+	unsigned int vertexCount = (unsigned int)mesh.positions.size();
+	std::vector<Vec4> tangents(vertexCount);
+
+	double serialSeconds = timeRepeatedly([&]() {
+		fillVertexTangentArray(tangents.data(), faceCount, vertexCount, mesh.faces.data(), mesh.positions.data(), mesh.uvs.data(), mesh.normals.data());
+	});
+	printf("Tangents for %u vertices and %u faces, millions of vertices per second:\n", vertexCount, faceCount);
+	printf("%8s %10s %10s\n", "workers", "Mverts/s", "speedup");
+	printf("%8s %10.1f %10.2f\n", "none", vertexCount/serialSeconds*1e-6, 1.0);
+
+	// At least up to 4 workers, so the scaling shows even on small machines
+	unsigned int maxWorkerCount = platform::getProcessorCount();
+	if (maxWorkerCount < 4) {
+		maxWorkerCount = 4;
+	}
+	for (unsigned int workerCount=1; workerCount<=maxWorkerCount; workerCount++)
+	{
+		platform::ThreadPool pool;
+		platform::createThreadPool(&pool, workerCount);
+		double poolSeconds = timeRepeatedly([&]() {
+			fillVertexTangentArrayParallel(tangents.data(), faceCount, vertexCount, mesh.faces.data(), mesh.positions.data(), mesh.uvs.data(), mesh.normals.data(), &pool);
+		});
+		printf("%8u %10.1f %10.2f\n", workerCount, vertexCount/poolSeconds*1e-6, serialSeconds/poolSeconds);
+		platform::destroyThreadPool(&pool);
+	}
+	return 0;
+}
@@ -0,0 +1,68 @@
+/* Checks fillVertexTangentArrayParallel() gives the same tangents as fillVertexTangentArray(),
+on pools of different sizes, with no pool, for meshes too small to split up,
+for vertices that no face uses, with the faces in any order, and for meshes big enough
+that each range of faces has to be bigger than the smallest. */
+
+#include <assert.h>
+#include "GamePlatform.h"
+#include "TestUtilities.h"
+#include "TestMeshes.h"
+#include <math.h>
+#include <vector>
+
+using namespace goblin;
+
+// Equal apart from float rounding, with the same handedness
+bool tangentsMatch(const std::vector<Vec4>& a, const std::vector<Vec4>& b)
+{
+	for (size_t i=0; i<a.size(); i++) {
+		if (fabsf(a[i].x-b[i].x) > 1e-5f || fabsf(a[i].y-b[i].y) > 1e-5f || fabsf(a[i].z-b[i].z) > 1e-5f || a[i].w != b[i].w) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool checkParallelTangents(const TestMesh& mesh, platform::ThreadPool* pool)
+{
+	unsigned int faceCount = (unsigned int)mesh.faces.size();
+	unsigned int vertexCount = (unsigned int)mesh.positions.size();
+	std::vector<Vec4> expected(vertexCount);
+	std::vector<Vec4> tangents(vertexCount);
+	fillVertexTangentArray(expected.data(), faceCount, vertexCount, mesh.faces.data(), mesh.positions.data(), mesh.uvs.data(), mesh.normals.data());
+	fillVertexTangentArrayParallel(tangents.data(), faceCount, vertexCount, mesh.faces.data(), mesh.positions.data(), mesh.uvs.data(), mesh.normals.data(), pool);
+	return tangentsMatch(tangents, expected);
+}
+
+int main()
+{
+	// A vertex count that isn't a multiple of any SIMD width, with each vertex's faces far apart
+	TestMesh mesh;
+	createTestGridMesh(&mesh, 131, 97, true);
+	TestMesh smallMesh;
+	createTestGridMesh(&smallMesh, 7, 5);
+	// Over 64 ranges of 4096 faces
+	TestMesh bigMesh;
+	createTestGridMesh(&bigMesh, 400, 400, true);
+	// Vertices at the end that no face uses get zero tangents either way
+	TestMesh unusedVertices = mesh;
+	for (unsigned int i=0; i<13; i++) {
+		unusedVertices.positions.push_back(Vec3{0, 0, 0});
+		unusedVertices.uvs.push_back(Vec2{0, 0});
+		unusedVertices.normals.push_back(Vec3{0, 1, 0});
+	}
+
+	TEST_CHECK(checkParallelTangents(mesh, 0));
+	const unsigned int workerCounts[] = {1, 2, 4};
+	for (unsigned int workerCount : workerCounts)
+	{
+		platform::ThreadPool pool;
+		platform::createThreadPool(&pool, workerCount);
+		TEST_CHECK(checkParallelTangents(mesh, &pool));
+		TEST_CHECK(checkParallelTangents(smallMesh, &pool));
+		TEST_CHECK(checkParallelTangents(unusedVertices, &pool));
+		TEST_CHECK(checkParallelTangents(bigMesh, &pool));
+		platform::destroyThreadPool(&pool);
+	}
+	return finishTests("VertexTangentTest");
+}